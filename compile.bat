@@ -5,8 +5,12 @@ echo КОМПИЛЯЦИЯ ПРОГРАММЫ АЛГОРИТМА ХАФФМАНА
 echo ============================================
 echo.
 
+echo Компиляция библиотеки libhuffman.a...
+gcc -c huffman.c -o huffman.o -Wall -Wextra
+ar rcs libhuffman.a huffman.o
+
 echo Компиляция main.c в huffman.exe...
-gcc main.c -o huffman.exe -Wall -Wextra
+gcc main.c libhuffman.a -o huffman.exe -Wall -Wextra
 
 if %errorlevel% equ 0 (
     echo Успешно скомпилировано!
@@ -17,10 +21,19 @@ if %errorlevel% equ 0 (
     exit /b 1
 )
 
+echo Компиляция набора замеров в huffman_bench.exe...
+gcc main.c libhuffman.a -o huffman_bench.exe -Wall -Wextra -DHUFFMAN_BENCH_SUITE
+
 echo.
 echo ============================================
 echo Для запуска программы используйте:
 echo   1. huffman.exe                     - меню
-echo   2. huffman.exe input.txt out.bin decoded.txt
+echo   2. huffman.exe input.txt out.bin [decoded.txt]
+echo   3. huffman.exe compress [--threads N] [--block-size 1M] [--max-code-length 15] [--adaptive ^| --order1 ^| --utf8 ^| --dict d.hdict] [--table-cache 5] [--streams 4] [--profile p.json] input.txt out.huf
+echo   4. huffman.exe decompress [--threads N] [--dict d.hdict] [--range 1G:64K] [--profile p.json] out.huf restored.txt
+echo   5. huffman.exe verify [--threads N] out.huf
+echo   6. huffman.exe batch [--threads N] [--output-dir packed] [--list files.txt] папка_или_файлы
+echo   7. huffman.exe train d.hdict samples
+echo   8. huffman_bench.exe [--sizes 64K,1M,16M] [--format csv^|json] [--output bench.csv]
 echo ============================================
 pause
\ No newline at end of file
@@ -0,0 +1,5141 @@
+/*
+ * Библиотека libhuffman: кодек сжатого формата "HUFF"
+ *
+ * Здесь собраны построение кодов, кодирование и декодирование блоков всех
+ * режимов, разбор и запись заголовков, индекса и словарей. Программа
+ * (main.c) отвечает только за файлы, потоки и вывод и обращается к кодеку
+ * через huffman.h. Все внутренние функции статические; библиотека не
+ * завершает процесс и ничего не выводит: нехватка памяти и поврежденные
+ * данные возвращаются кодами HUFFMAN_ERROR_*.
+ */
+
+#include <stdlib.h>     // malloc, realloc, free, qsort
+#include <string.h>     // memcpy, memset, memcmp
+#include <stdint.h>     // Целые типы фиксированной ширины (uint32_t, uint64_t)
+#include "huffman.h"    // Интерфейс библиотеки
+#include "huffman_internal.h" // Пределы формата и помощники, общие с программой
+#ifdef _WIN32
+#include <windows.h>    // InitOnceExecuteOnce: однократное построение таблиц CRC-32
+#else
+#include <pthread.h>    // pthread_once: однократное построение таблиц CRC-32
+#endif
+
+// Замеры стадий через HuffmanProfiler: при USE_PROFILE=0 они не компилируются вовсе
+#ifndef USE_PROFILE
+#define USE_PROFILE 1
+#endif
+
+// ========== КОНСТАНТЫ И СТРУКТУРЫ ==========
+
+#define SORT_INSERTION_LIMIT 48   // До стольких листьев сортируются вставками, а не поразрядно
+#define DECODE_TABLE_BITS 11      // Разрядность первичной таблицы декодирования
+#define CRC_SLICES 8              // Байт за итерацию CRC-32 (и количество таблиц остатков)
+#define HISTOGRAM_LANES 4         // Количество чередующихся подгистограмм при подсчете частот
+
+// Формат сжатых данных (контейнера)
+#define CONTAINER_MAGIC "HUFF"    // Сигнатура в начале сжатых данных
+#define CONTAINER_VERSION 3       // Версия формата
+#define CONTAINER_HEADER_SIZE (4 + 1 + 1 + 8 + 4 + 4) // Размер заголовка в байтах
+#define CONTAINER_COMPACT_SIZE (4 + 1 + 1 + 4) // Размер заголовка с флагом CONTAINER_FLAG_COMPACT
+#define BLOCK_PREFIX_SIZE (4 + 4 + 4 + 1)             // Размер общей части заголовка блока в байтах
+#define BLOCK_HEADER_MAX_SIZE (BLOCK_PREFIX_SIZE + 1 + ORDER1_TABLE_BYTES * (ORDER1_MAX_TABLES + 1)) // Наибольший размер заголовка блока
+#define BLOCK_SLACK 8             // Запас буфера блока: кодировщик записывает аккумулятор 8-байтовым словом
+#define BLOCK_MODE_STATIC HUFFMAN_MODE_STATIC           // Режим блока: своя таблица канонических кодов (два прохода)
+#define BLOCK_MODE_ADAPTIVE HUFFMAN_MODE_ADAPTIVE       // Режим блока: адаптивный код Хаффмана (один проход, без таблицы)
+#define BLOCK_MODE_ORDER1 HUFFMAN_MODE_ORDER1           // Режим блока: контекст первого порядка (таблица выбирается по предыдущему байту)
+#define BLOCK_MODE_DICTIONARY HUFFMAN_MODE_DICTIONARY   // Режим блока: коды из обученного словаря (таблицы в блоке нет)
+#define BLOCK_MODE_REUSE HUFFMAN_MODE_REUSE             // Режим блока: таблица кодов одного из предыдущих блоков сегмента
+#define BLOCK_MODE_INTERLEAVED HUFFMAN_MODE_INTERLEAVED // Режим блока: своя таблица кодов, блок разбит на независимые потоки
+#define BLOCK_MODE_STORED HUFFMAN_MODE_STORED           // Режим блока: данные без сжатия (несжимаемые данные)
+#define BLOCK_MODE_RUNS HUFFMAN_MODE_RUNS               // Режим блока: серии одинаковых байт (RLE)
+#define BLOCK_MODE_PACKED HUFFMAN_MODE_PACKED           // Режим блока: номера символов малого алфавита фиксированной ширины
+#define BLOCK_MODE_UTF8 HUFFMAN_MODE_UTF8               // Режим блока: символы - кодовые точки UTF-8 (таблица переменного размера)
+#define BLOCK_MODE_COUNT HUFFMAN_MODE_COUNT             // Количество известных режимов блока
+#define INTERLEAVED_MIN_STREAM_SIZE (1 << 10) // Наименьшая часть блока на один поток (1 KiB)
+#define STORED_MIN_GAIN 64        // Блок хранится без сжатия, если энтропия обещает выигрыш меньше 1/64 размера
+#define RUN_SAMPLES 1024          // Сколько пар соседних байт проверяется при оценке количества серий
+#define RUN_MAX_BYTES (1 + 5)     // Наибольший размер записи серии: байт символа и длина в LEB128
+#define PACKED_MAX_SYMBOLS 16     // Наибольший алфавит блока BLOCK_MODE_PACKED (номер символа до 4 бит)
+#define UTF8_RAW_SYMBOL 0x110000  // Символ UTF-8 "отдельный байт b" - UTF8_RAW_SYMBOL + b (обрывки на краях блока)
+#define UTF8_DIRECT_SYMBOLS 0x800 // Кодовые точки до 0x7FF (ASCII, латиница, кириллица) считаются без хеширования
+#define UTF8_HASH_MIN_BITS 10     // Начальная разрядность хеш-таблицы остальных кодовых точек
+#define UTF8_HASH_MAX_BITS 17     // Наибольшая разрядность: UTF8_MAX_SYMBOLS символов заполняют ее не больше чем наполовину
+#define UTF8_MAX_CODE_LENGTH 15   // Длины кодов UTF-8 хранятся по 4 бита
+#define UTF8_MAX_SYMBOLS (1 << UTF8_MAX_CODE_LENGTH) // Наибольший алфавит блока BLOCK_MODE_UTF8
+#define TABLE_CACHE_SIGNATURE_LEVELS 15 // Уровней квантования идеальной длины кода в сигнатуре гистограммы
+#define ORDER1_MAX_TABLES 16      // Наибольшее количество таблиц кодов в блоке order-1
+#define ORDER1_CANDIDATES 16      // Сколько самых частых предыдущих байтов получают свой начальный контекст
+#define ORDER1_MAX_CODE_LENGTH 15 // Длины кодов order-1 хранятся по 4 бита
+#define ORDER1_TABLE_BYTES (ASCII_SIZE / 2) // Таблица длин или карта контекстов order-1: 4 бита на символ
+#define DICTIONARY_MAGIC "HDIC"   // Сигнатура в начале словаря
+#define DICTIONARY_VERSION 1      // Версия формата словаря
+#define DICTIONARY_FILE_SIZE HUFFMAN_DICTIONARY_SIZE // Размер словаря в байтах
+#define DICTIONARY_FLAG_ESCAPE 0x01 // Флаг словаря: есть escape-код для байтов, не встречавшихся при обучении
+#define DICTIONARY_ID_SIZE 4      // Таблица блока BLOCK_MODE_DICTIONARY: идентификатор словаря
+#define DICTIONARY_ESCAPE_MAX_LENGTH 48 // Ограничение длины кода словаря с escape: escape-код и 8 бит байта - не длиннее DECODE_MAX_CODE_LENGTH
+#define CONTAINER_FLAG_INDEX HUFFMAN_FRAME_INDEX     // Флаг: в конце данных есть индекс блоков
+#define CONTAINER_FLAG_STREAM HUFFMAN_FRAME_STREAM   // Флаг: потоковый формат (размеры заранее неизвестны)
+#define CONTAINER_FLAG_COMPACT HUFFMAN_FRAME_COMPACT // Флаг: короткий заголовок, один блок, без индекса (записи со словарем)
+#define STREAM_END_SIZE HUFFMAN_STREAM_END_SIZE      // Признак конца потока: нулевой размер блока и общий размер
+#define INDEX_MAGIC "HIDX"        // Сигнатура в конце индекса блоков
+#define INDEX_ENTRY_SIZE (8 + 4)  // Элемент индекса: смещение блока и размер его исходных данных
+#define INDEX_TRAILER_SIZE (8 + 4) // Окончание индекса: смещение начала индекса и сигнатура
+#define DECODE_OUT_SLACK 128      // Запас выходного буфера для быстрого цикла декодера
+#define ADAPTIVE_MAX_NODES (2 * ASCII_SIZE + 1) // Узлов адаптивного дерева: 256 листьев, NYT и внутренние
+#define PROFILE_COUNT HUFFMAN_STAGE_HISTOGRAM // Стадия замеров: подсчет частот
+#define PROFILE_BUILD HUFFMAN_STAGE_BUILD     // Стадия замеров: построение кодов и таблиц декодирования
+#define PROFILE_ENCODE HUFFMAN_STAGE_ENCODE   // Стадия замеров: кодирование
+#define PROFILE_DECODE HUFFMAN_STAGE_DECODE   // Стадия замеров: декодирование
+#define PROFILE_CHECK HUFFMAN_STAGE_CHECK     // Стадия замеров: контрольная сумма CRC-32
+
+// Показания профилировщика в начале участка
+typedef HuffmanProfileSample ProfileSample;
+
+/*
+ * Структура HuffmanArena - память для построения длин кодов без malloc
+ * Узлы дерева хранятся в плоских массивах и ссылаются друг на друга
+ * индексами: листья занимают индексы 0..n-1 (по возрастанию веса),
+ * внутренние узлы - n..2n-2. Арена занимает около 16 КБ и может лежать
+ * на стеке; повторное построение кодов не обращается к куче.
+ */
+typedef struct HuffmanArena {
+    uint64_t weight[2 * ASCII_SIZE];                 // Веса узлов
+    short parent[2 * ASCII_SIZE];                    // Индекс родителя узла
+    unsigned char depth[2 * ASCII_SIZE];             // Глубина узла (у листа - длина кода)
+    unsigned char symbol[ASCII_SIZE];                // Символы листьев по возрастанию веса
+    unsigned char sort_buffer[ASCII_SIZE];           // Второй массив поразрядной сортировки
+    int leaf_count;                                  // Количество листьев
+    uint64_t level[2][2 * ASCII_SIZE];               // package-merge: веса двух соседних уровней
+    uint64_t package_bits[DECODE_MAX_CODE_LENGTH][2 * ASCII_SIZE / 64]; // package-merge: 1 - элемент уровня является пакетом
+} HuffmanArena;
+
+/*
+ * Структура Order1Model - рабочая память сжатия блока в режиме order-1
+ * Предыдущие байты объединяются в кластеры (контексты), у каждого кластера
+ * своя таблица кодов. Начальные кластеры - самые частые предыдущие байты
+ * и один общий кластер для остальных; затем жадно сливаются пары, слияние
+ * которых дешевле всего (или выгодно само по себе).
+ */
+typedef struct Order1Model {
+    unsigned int pairs[ASCII_SIZE][ASCII_SIZE];              // Частоты пар (предыдущий байт, текущий)
+    unsigned int hist[ORDER1_CANDIDATES + 1][ASCII_SIZE];    // Гистограммы кластеров
+    uint64_t cost[ORDER1_CANDIDATES + 1];                    // Цена кластера в битах (поток и таблица)
+    int64_t delta[ORDER1_CANDIDATES + 1][ORDER1_CANDIDATES + 1]; // Изменение цены при слиянии пары
+    int alive[ORDER1_CANDIDATES + 1];                        // 1 - кластер еще существует
+    HuffmanArena arena;                                      // Память для построения кодов
+} Order1Model;
+
+/*
+ * Структура Utf8Alphabet - символы блока в режиме UTF-8 и их частоты
+ * Символ получает номер при первой встрече. Кодовые точки до
+ * UTF8_DIRECT_SYMBOLS (ASCII и двухбайтовые последовательности: латиница,
+ * кириллица, греческий) находятся по плоскому массиву, остальные - по
+ * хеш-таблице с открытой адресацией, поэтому работа зависит от количества
+ * разных символов, а не от 1.1 млн возможных кодовых точек.
+ *
+ * Массивы рассчитаны на наибольший алфавит (UTF8_MAX_SYMBOLS символов),
+ * выделяются один раз на контекст и очищаются после каждого блока
+ * (см. resetUtf8Alphabet), поэтому блоки UTF-8 не обращаются к куче.
+ */
+typedef struct Utf8Alphabet {
+    uint32_t direct[UTF8_DIRECT_SYMBOLS];    // Номер кодовой точки + 1 (0 - не встречалась)
+    uint32_t keys[1 << UTF8_HASH_MAX_BITS];  // Хеш-таблица: символ + 1 (0 - ячейка пуста)
+    uint32_t slots[1 << UTF8_HASH_MAX_BITS]; // Хеш-таблица: номер символа
+    int hash_bits;                           // Разрядность занятой части хеш-таблицы
+    uint32_t hashed;                         // Занято ячеек хеш-таблицы
+    uint32_t limit;                          // Наибольшее количество символов блока (2^длина кода)
+    uint32_t count;                          // Количество разных символов
+    uint32_t symbols[UTF8_MAX_SYMBOLS];      // Символ по номеру
+    uint32_t counts[UTF8_MAX_SYMBOLS];       // Частота по номеру
+    unsigned char lengths[UTF8_MAX_SYMBOLS]; // Длина кода по номеру
+    uint32_t order[UTF8_MAX_SYMBOLS];        // Номера символов по частоте (построение длин)
+    uint32_t weights[UTF8_MAX_SYMBOLS];      // Веса, затем глубины (построение длин)
+    uint32_t sorted[UTF8_MAX_SYMBOLS];       // Номера символов по значению (канонические коды)
+    uint64_t aligned[UTF8_MAX_SYMBOLS];      // Коды по номеру, выровненные по старшему разряду
+    uint64_t sort_keys[UTF8_MAX_SYMBOLS];    // Ключи сортировки символов
+} Utf8Alphabet;
+
+/*
+ * Структура Utf8Decoder - таблицы восстановления блока UTF-8
+ */
+typedef struct Utf8Decoder {
+    unsigned char symbol_bytes[UTF8_MAX_SYMBOLS][4]; // Байты символа по номеру в таблице блока
+    unsigned char symbol_length[UTF8_MAX_SYMBOLS];   // Длина символа в байтах
+    unsigned char lengths[UTF8_MAX_SYMBOLS];         // Длина кода символа
+    uint32_t canonical[UTF8_MAX_SYMBOLS];            // Символы в порядке кодов
+    uint16_t fast[1 << DECODE_TABLE_BITS];           // Номер в canonical и длина кода по первым битам потока
+} Utf8Decoder;
+
+/*
+ * Структура DecodeTable - таблица быстрого декодирования кодов Хаффмана
+ * Первичная таблица индексируется следующими DECODE_TABLE_BITS битами потока
+ * и за одно обращение выдает один или два символа целиком. Коды длиннее
+ * DECODE_TABLE_BITS разрешаются через вторичные таблицы, на которые
+ * ссылаются элементы первичной таблицы.
+ *
+ * Формат элемента таблицы (32 бита):
+ *   биты 27-31 - сколько битов забрать из потока (у ссылки - разрядность вторичной таблицы)
+ *   биты 25-26 - количество символов в элементе (1 или 2; 0 - ссылка на вторичную таблицу)
+ *   биты 0-7   - первый символ, биты 8-15 - второй символ (у листьев)
+ *   биты 0-24  - смещение вторичной таблицы в массиве entries (у ссылок)
+ */
+typedef struct DecodeTable {
+    uint32_t* entries;                 // Первичная таблица (первые 2^DECODE_TABLE_BITS элементов) и вторичные таблицы
+    int size;                          // Количество занятых элементов в массиве entries
+    int capacity;                      // Емкость массива entries
+    int max_length;                    // Максимальная длина кода в битах
+    unsigned char lengths[ASCII_SIZE]; // Длины кодов символов (нужны для разбора хвоста потока)
+    uint16_t* chained;                 // Таблица блоков order-1: символ, длина и следующий контекст (NULL - не нужна)
+} DecodeTable;
+
+// Макросы для разбора элементов таблицы chained (длина 0 - длинный или недопустимый код)
+#define CT_SYMBOL(e)  ((unsigned char)((e) & 0xFF))
+#define CT_LENGTH(e)  ((int)(((e) >> 8) & 0xF))
+#define CT_NEXT(e)    ((int)((e) >> 12))
+
+// Макросы для разбора и сборки элементов таблицы декодирования
+#define DT_LENGTH(e)  ((int)((e) >> 27))
+#define DT_COUNT(e)   ((int)(((e) >> 25) & 3))
+#define DT_SYMBOL1(e) ((unsigned char)((e) & 0xFF))
+#define DT_SYMBOL2(e) ((unsigned char)(((e) >> 8) & 0xFF))
+#define DT_OFFSET(e)  ((int)((e) & 0x1FFFFFF))
+#define DT_LEAF(sym, len)        (((uint32_t)(len) << 27) | (1u << 25) | (uint32_t)(sym))
+#define DT_PAIR(sym1, sym2, len) (((uint32_t)(len) << 27) | (2u << 25) | ((uint32_t)(sym2) << 8) | (uint32_t)(sym1))
+#define DT_LINK(offset, bits)    (((uint32_t)(bits) << 27) | (uint32_t)(offset))
+
+/*
+ * Структура ContainerHeader - заголовок сжатых данных (кадра)
+ * Данные делятся на блоки по block_size байт (последний может быть короче),
+ * каждый блок сжимается независимо со своей таблицей кодов.
+ *
+ * Расположение (многобайтовые числа - little-endian):
+ *   0  - сигнатура "HUFF" (4 байта)
+ *   4  - версия формата (1 байт)
+ *   5  - флаги (1 байт, CONTAINER_FLAG_*)
+ *   6  - размер исходных данных в байтах (8 байт)
+ *   14 - размер блока в байтах (4 байта)
+ *   18 - количество блоков (4 байта)
+ * Сразу за заголовком по порядку идут блоки (см. BlockHeader).
+ *
+ * С флагом CONTAINER_FLAG_INDEX за последним блоком идет индекс:
+ * для каждого блока смещение его заголовка от начала кадра (8 байт) и размер
+ * исходных данных (4 байта), затем смещение начала индекса (8 байт) и
+ * сигнатура "HIDX". По индексу блоки можно восстанавливать независимо.
+ *
+ * С флагом CONTAINER_FLAG_COMPACT (запись из одного блока, сжатая со
+ * словарем) заголовок короче: за флагами идет только размер исходных
+ * данных (4 байта, от 1 до MAX_BLOCK_SIZE), блок ровно один, его размер
+ * равен размеру данных, индекса нет. Так служебные данные маленькой
+ * записи - 10 байт заголовка и заголовок блока вместо 63 байт.
+ *
+ * С флагом CONTAINER_FLAG_STREAM (сжатие из stdin) размер исходных данных
+ * и количество блоков в заголовке равны 0: блоки идут до признака конца -
+ * 4 нулевых байт на месте размера блока, за которыми следует общий размер
+ * исходных данных (8 байт). Такой кадр читается строго последовательно.
+ */
+typedef struct ContainerHeader {
+    unsigned char flags;                 // Флаги CONTAINER_FLAG_*
+    uint64_t original_size;              // Размер исходных данных
+    uint32_t block_size;                 // Размер блока
+    uint32_t block_count;                // Количество блоков
+} ContainerHeader;
+
+/*
+ * Структура BlockHeader - заголовок одного блока
+ *
+ * Расположение:
+ *   0  - размер исходных данных блока (4 байта)
+ *   4  - количество значимых битов в потоке блока (4 байта)
+ *   8  - контрольная сумма CRC-32 исходных данных блока (4 байта)
+ *   12 - режим блока (1 байт, BLOCK_MODE_*)
+ *   13 - таблица режима: у BLOCK_MODE_STATIC длины канонических кодов
+ *        для символов 0-255 (256 байт), у BLOCK_MODE_ADAPTIVE таблицы нет
+ * Таблица BLOCK_MODE_ORDER1: количество таблиц кодов T (1 байт), карта
+ * контекстов - номер таблицы для каждого предыдущего байта (128 байт,
+ * по 4 бита), затем T таблиц длин кодов (по 128 байт, по 4 бита на символ).
+ * Таблица BLOCK_MODE_DICTIONARY: идентификатор словаря (4 байта), коды
+ * берутся из словаря (см. Dictionary).
+ * Таблица BLOCK_MODE_REUSE: расстояние d (1 байт) до статического блока
+ * того же сегмента из TABLE_CACHE_SEGMENT блоков, чьи длины кодов
+ * используются; блок с номером i ссылается на блок i - d (см. TableCache).
+ * Поток такого блока устроен так же, как у блока, на который он ссылается.
+ * Таблица BLOCK_MODE_INTERLEAVED - как у BLOCK_MODE_STATIC, но данные
+ * блока делятся на S частей подряд, и каждая кодируется своим битовым
+ * потоком. Поток блока начинается с S (1 байт) и количеств битов первых
+ * S - 1 потоков (по 4 байта), за ними идут потоки, каждый дополнен до
+ * целого байта (см. encodeStreams).
+ * У BLOCK_MODE_STORED и BLOCK_MODE_RUNS таблицы нет: поток блока - это
+ * сами данные или последовательность серий (байт символа и длина серии
+ * без единицы в LEB128), а количество битов кратно 8 (см. encodeRuns).
+ * Таблица BLOCK_MODE_PACKED: количество символов K (1 байт, от 2 до
+ * PACKED_MAX_SYMBOLS) и сами символы по возрастанию (K байт); поток - номера
+ * символов по w бит, w - наименьшая ширина, в которую помещается K - 1
+ * (см. encodePacked).
+ * У BLOCK_MODE_UTF8 таблица переменного размера лежит в начале потока:
+ * количество символов N (LEB128), символы по возрастанию (первый - сам,
+ * остальные - разностью с предыдущим без единицы, LEB128) и длины кодов
+ * (по 4 бита, N / 2 байт с округлением вверх). Символ - кодовая точка или
+ * UTF8_RAW_SYMBOL + байт; количество битов считается от начала таблицы
+ * (см. encodeUtf8).
+ * Сразу за заголовком идет битовый поток блока, дополненный до целого байта.
+ */
+typedef struct BlockHeader {
+    uint32_t raw_size;                   // Размер исходных данных блока
+    uint32_t bit_count;                  // Количество значимых битов потока
+    uint32_t checksum;                   // CRC-32 исходных данных блока
+    unsigned char mode;                  // Режим блока BLOCK_MODE_*
+    uint32_t size;                       // Размер заголовка (вместе с таблицей)
+    unsigned char lengths[ASCII_SIZE];   // Длины канонических кодов (0 - символ не встречается)
+    unsigned char table_count;           // order-1: количество таблиц кодов, BLOCK_MODE_PACKED: количество символов
+    unsigned char context_map[ASCII_SIZE]; // order-1: номер таблицы по предыдущему байту
+    unsigned char context_lengths[ORDER1_MAX_TABLES][ASCII_SIZE]; // order-1: длины кодов каждой таблицы
+    uint32_t dictionary_id;              // Словарный режим: идентификатор словаря
+    unsigned char distance;              // BLOCK_MODE_REUSE: на сколько блоков назад лежит таблица
+    unsigned char symbols[PACKED_MAX_SYMBOLS]; // BLOCK_MODE_PACKED: алфавит блока (table_count символов)
+} BlockHeader;
+
+/*
+ * Структура Dictionary - обученный словарь: готовая таблица кодов для маленьких блоков
+ *
+ * Формат словаря (DICTIONARY_FILE_SIZE байт):
+ *   0 - сигнатура "HDIC" (4 байта)
+ *   4 - версия формата (1 байт)
+ *   5 - флаги (1 байт, DICTIONARY_FLAG_*)
+ *   6 - escape-символ (1 байт, значим только с DICTIONARY_FLAG_ESCAPE)
+ *   7 - длины канонических кодов символов 0-255 (256 байт)
+ * Идентификатор словаря - CRC-32 всего словаря; он записывается в каждый
+ * блок, сжатый со словарем, чтобы восстановить блок с другим словарем
+ * было нельзя.
+ *
+ * Байт, не встречавшийся при обучении (длина 0), и сам escape-символ
+ * кодируются кодом escape-символа и следующими за ним 8 битами байта.
+ * Такой код - обычный префиксный код на 256 символов, поэтому кодирование
+ * и декодирование идут теми же быстрыми циклами, что и у статических блоков.
+ */
+typedef struct Dictionary {
+    uint32_t id;                       // CRC-32 словаря
+    int escape;                        // Escape-символ (-1 - словарь содержит все байты)
+    unsigned char lengths[ASCII_SIZE]; // Длины кодов из словаря
+    uint64_t aligned[ASCII_SIZE];      // Итоговые коды байтов (с escape), выровненные по старшему разряду
+    int code_lengths[ASCII_SIZE];      // Итоговые длины кодов байтов
+    int max_length;                    // Максимальная итоговая длина кода
+    DecodeTable table;                 // Таблица декодирования итоговых кодов
+} Dictionary;
+
+/*
+ * Структура TableCacheEntry - таблица кодов, записанная в одном из блоков сегмента
+ */
+typedef struct TableCacheEntry {
+    uint32_t block;             // Номер блока, в заголовке которого записана таблица
+    uint32_t signature;         // Сигнатура гистограммы этого блока
+    unsigned char mode;         // Режим блока: BLOCK_MODE_STATIC или BLOCK_MODE_INTERLEAVED
+    Code codes[ASCII_SIZE];     // Канонические коды таблицы
+} TableCacheEntry;
+
+/*
+ * Структура TableCache - кэш недавно построенных таблиц кодов (params.table_cache)
+ *
+ * Перед построением дерева для статического блока оценивается, во сколько
+ * бит обойдется блок с каждой таблицей из кэша (сумма частот, умноженных
+ * на длины кодов), и если потеря по сравнению со своей таблицей вместе
+ * с ее 256 байтами не больше loss процентов, блок записывается в режиме
+ * BLOCK_MODE_REUSE со ссылкой на блок с этой таблицей. Сначала проверяются
+ * таблицы с той же сигнатурой гистограммы (квантованные идеальные длины
+ * кодов): на однородных данных совпадение находится сразу.
+ *
+ * Кэш очищается в начале каждого сегмента из TABLE_CACHE_SEGMENT блоков,
+ * поэтому ссылки не выходят за сегмент: результат не зависит от количества
+ * потоков, а любой блок восстанавливается по своему заголовку и заголовку
+ * одного блока перед ним.
+ */
+typedef struct TableCache {
+    TableCacheEntry entries[TABLE_CACHE_SEGMENT]; // Таблицы текущего сегмента
+    int count;                  // Количество таблиц в entries
+    int loss;                   // Допустимая потеря сжатия в процентах
+    uint64_t lookups;           // Статических блоков, для которых искалась таблица
+    uint64_t hits;              // Из них записаны со ссылкой на таблицу из кэша
+    uint64_t signature_hits;    // Из них найдены по совпадению сигнатуры
+    uint64_t saved_bytes;       // Сэкономлено байт заголовков блоков
+} TableCache;
+
+/*
+ * Структура SegmentTables - длины кодов статических блоков текущего сегмента (при восстановлении)
+ */
+typedef struct SegmentTables {
+    uint32_t block[TABLE_CACHE_SEGMENT]; // Номер блока + 1, чья таблица в ячейке (0 - ячейка пуста)
+    unsigned char mode[TABLE_CACHE_SEGMENT]; // Режим блока (от него зависит устройство потока ссылки)
+    unsigned char lengths[TABLE_CACHE_SEGMENT][ASCII_SIZE]; // Длины кодов; ячейка - номер блока в сегменте
+} SegmentTables;
+
+/*
+ * Структура CodecOptions - параметры сжатия блоков
+ */
+typedef struct CodecOptions {
+    uint32_t block_size;        // Размер блока в байтах
+    int mode;                   // Режим блоков BLOCK_MODE_*
+    int max_code_length;        // Ограничение длины кода в битах
+    const Dictionary* dictionary; // Словарь (BLOCK_MODE_DICTIONARY)
+    int table_cache;            // Допустимая потеря сжатия при повторе таблицы из кэша, % (-1 - без кэша)
+    int streams;                // Потоков в статическом блоке (1 - один поток, см. BLOCK_MODE_INTERLEAVED)
+} CodecOptions;
+
+/*
+ * Структура Workspace - рабочая память кодировщиков и декодеров контекста
+ * Модели order-1 и UTF-8 занимают сотни килобайт и выделяются при первом
+ * блоке своего режима, таблицы декодирования растут до размеров самого
+ * сложного блока; дальше блоки обходятся без выделения памяти.
+ */
+typedef struct Workspace {
+    DecodeTable tables[ORDER1_MAX_TABLES];   // Таблицы декодирования (у статического блока - первая)
+    Order1Model* order1;                     // Модель сжатия order-1 (NULL - еще не нужна)
+    Utf8Alphabet* alphabet;                  // Алфавит сжатия UTF-8 (NULL - еще не нужен)
+    Utf8Decoder* utf8;                       // Таблицы восстановления UTF-8 (NULL - еще не нужны)
+} Workspace;
+
+/*
+ * Структура BitWriter - запись битового потока через 64-битный аккумулятор
+ * Коды целиком добавляются в аккумулятор операцией OR, а аккумулятор
+ * сбрасывается в выходной буфер 8-байтовым словом.
+ */
+typedef struct BitWriter {
+    unsigned char* buffer;      // Выходной буфер (с запасом 8 байт для записи слова)
+    size_t pos;                 // Количество заполненных байт в буфере
+    uint64_t bits;              // Аккумулятор (биты выровнены по старшему разряду)
+    int count;                  // Количество битов в аккумуляторе
+} BitWriter;
+
+/*
+ * Структура BitReader - чтение битового потока через 64-битный буфер
+ * Битовый буфер пополняется сразу на 7-8 байт, поэтому одно пополнение
+ * обслуживает несколько символов.
+ */
+typedef struct BitReader {
+    const unsigned char* buffer; // Байты потока
+    size_t pos;                 // Позиция следующего непрочитанного байта
+    size_t end;                 // Количество байт потока
+    uint64_t bits;              // Битовый буфер (биты выровнены по старшему разряду)
+    int count;                  // Количество валидных битов в битовом буфере
+} BitReader;
+
+/*
+ * Структура AdaptiveTree - дерево адаптивного кода Хаффмана (алгоритм FGK)
+ * Узлы берутся из встроенного массива, поэтому дерево не выделяет память.
+ * Номера узлов идут по неубыванию веса, корень имеет наибольший номер;
+ * после каждого символа кодировщик и декодер одинаково перестраивают дерево.
+ */
+typedef struct AdaptiveTree {
+    Node nodes[ADAPTIVE_MAX_NODES];      // Все узлы дерева
+    Node* order[ADAPTIVE_MAX_NODES];     // Узел по его номеру
+    Node* leaves[ASCII_SIZE];            // Лист символа (NULL - символ еще не встречался)
+    Node* nyt;                           // Узел NYT: через него передаются новые символы
+    int used;                            // Количество занятых узлов в nodes
+} AdaptiveTree;
+
+/*
+ * Структура HuffmanContext - контекст библиотеки (объявлен в huffman.h)
+ * Буферы растут до размеров самого большого блока и самого длинного
+ * индекса и переиспользуются следующими вызовами.
+ */
+struct HuffmanContext {
+    CodecOptions options;                    // Параметры сжатия
+    EncodedBlock block;                      // Сжатый блок, если выходной буфер меньше huffmanBlockBound
+    uint64_t* offsets;                       // Смещения блоков для индекса (huffmanCompress)
+    size_t offsets_capacity;                 // Емкость массива offsets
+    Workspace work;                          // Рабочая память кодировщиков и декодеров
+    Dictionary* dictionary;                  // Словарь из huffmanSetDictionary (NULL - нет)
+    TableCache cache;                        // Кэш таблиц кодов (options.table_cache >= 0)
+    SegmentTables segment;                   // Таблицы восстановленных блоков для BLOCK_MODE_REUSE
+    unsigned char* scratch;                  // Блок, который диапазон задевает не целиком
+    size_t scratch_capacity;                 // Емкость буфера scratch
+};
+
+/*
+ * Структура HuffmanDecodeTable - таблица декодирования кодов одного буфера (объявлена в huffman.h)
+ */
+struct HuffmanDecodeTable {
+    DecodeTable table;
+};
+
+// ========== ОДНОКРАТНАЯ ИНИЦИАЛИЗАЦИЯ ==========
+
+#ifdef _WIN32
+typedef INIT_ONCE OnceFlag;
+#define ONCE_INITIALIZER INIT_ONCE_STATIC_INIT
+static BOOL CALLBACK onceCallback(PINIT_ONCE once, PVOID func, PVOID* context) {
+    (void)once;
+    (void)context;
+    ((void (*)(void))func)();
+    return TRUE;
+}
+static void callOnce(OnceFlag* flag, void (*func)(void)) {
+    InitOnceExecuteOnce(flag, onceCallback, (PVOID)func, NULL);
+}
+#else
+typedef pthread_once_t OnceFlag;
+#define ONCE_INITIALIZER PTHREAD_ONCE_INIT
+static void callOnce(OnceFlag* flag, void (*func)(void)) { pthread_once(flag, func); }
+#endif
+
+// ========== ЗАМЕРЫ ПО СТАДИЯМ ==========
+
+static HuffmanProfiler profiler;             // Обработчики из huffmanSetProfiler
+static int profiling;                        // 1 - обработчики заданы
+
+/*
+ * Макросы замеров: участок между PROFILE_BEGIN и PROFILE_END передается
+ * профилировщику программы (huffmanSetProfiler). Пока он не задан, макрос -
+ * одна проверка флага, а размеры в PROFILE_END даже не вычисляются;
+ * при USE_PROFILE=0 макросы пусты.
+ */
+#if USE_PROFILE
+#define PROFILE_BEGIN(sample) do { if (profiling) profiler.begin(&(sample)); } while (0)
+#define PROFILE_END(stage, sample, in, out) \
+    do { if (profiling) profiler.end((stage), &(sample), (in), (out)); } while (0)
+#else
+#define PROFILE_BEGIN(sample) ((void)(sample))
+#define PROFILE_END(stage, sample, in, out) ((void)(sample))
+#endif
+
+// ========== ПОСТРОЕНИЕ КОДОВ ==========
+
+/**
+ * Функция assignCanonicalCodes - заменяет коды на канонические коды той же длины
+ * @param codes - массив кодов; используются только длины, значения перезаписываются
+ *
+ * Канонические коды однозначно восстанавливаются по одним длинам:
+ * коды одной длины идут подряд в порядке возрастания символов, а первый
+ * код каждой следующей длины получается из последнего кода предыдущей
+ * добавлением единицы и сдвигом влево. Поэтому в заголовке сжатого файла
+ * достаточно хранить 256 длин вместо всего дерева.
+ */
+static void assignCanonicalCodes(Code codes[]) {
+    int length_count[MAX_CODE_LENGTH + 1] = {0};     // Количество кодов каждой длины
+    uint64_t next_code[MAX_CODE_LENGTH + 1];         // Следующий свободный код каждой длины
+
+    for (int i = 0; i < ASCII_SIZE; i++) {
+        length_count[codes[i].length]++;
+    }
+    length_count[0] = 0;
+
+    uint64_t code = 0;
+    next_code[0] = 0;
+    for (int len = 1; len <= MAX_CODE_LENGTH; len++) {
+        code = (code + length_count[len - 1]) << 1;  // Первый код длины len
+        next_code[len] = code;
+    }
+
+    for (int i = 0; i < ASCII_SIZE; i++) {
+        if (codes[i].length > 0) {
+            codes[i].value = next_code[codes[i].length]++;
+        }
+    }
+}
+
+/**
+ * Функция sortLeaves - записывает в арену листья по возрастанию частот
+ * @param arena - арена построения кодов
+ * @param frequencies - частоты символов
+ *
+ * Поразрядная сортировка (LSD) по байтам частоты: до четырех проходов по 256
+ * корзинам без сравнений; проходы по старшим байтам пропускаются, если все
+ * частоты меньше 2^(8k). Несколько листьев быстрее отсортировать вставками.
+ * Обе сортировки устойчивые, поэтому листья одного веса идут в порядке
+ * возрастания символов и результат детерминирован.
+ */
+static void sortLeaves(HuffmanArena* arena, const unsigned int frequencies[]) {
+    unsigned int largest = 0;
+    int n = 0;
+    for (int i = 0; i < ASCII_SIZE; i++) {
+        if (frequencies[i] > 0) {
+            arena->symbol[n++] = (unsigned char)i;
+            if (frequencies[i] > largest) {
+                largest = frequencies[i];
+            }
+        }
+    }
+    arena->leaf_count = n;
+
+    if (n <= SORT_INSERTION_LIMIT) {
+        for (int k = 1; k < n; k++) {
+            unsigned char symbol = arena->symbol[k];
+            int j = k - 1;
+            while (j >= 0 && frequencies[arena->symbol[j]] > frequencies[symbol]) {
+                arena->symbol[j + 1] = arena->symbol[j];
+                j--;
+            }
+            arena->symbol[j + 1] = symbol;
+        }
+        largest = 0;                                 // Поразрядные проходы не нужны
+    }
+
+    unsigned char* from = arena->symbol;
+    unsigned char* to = arena->sort_buffer;
+    for (int shift = 0; shift < 32 && (largest >> shift) > 0; shift += 8) {
+        int start[ASCII_SIZE + 1] = {0};             // Начало каждой корзины
+        for (int k = 0; k < n; k++) {
+            start[((frequencies[from[k]] >> shift) & 0xFF) + 1]++;
+        }
+        for (int b = 0; b < ASCII_SIZE; b++) {
+            start[b + 1] += start[b];
+        }
+        for (int k = 0; k < n; k++) {
+            to[start[(frequencies[from[k]] >> shift) & 0xFF]++] = from[k];
+        }
+        unsigned char* temp = from;
+        from = to;
+        to = temp;
+    }
+    if (from != arena->symbol) {
+        memcpy(arena->symbol, from, n);
+    }
+    for (int k = 0; k < n; k++) {
+        arena->weight[k] = frequencies[arena->symbol[k]];
+    }
+}
+
+/**
+ * Функция huffmanDepths - строит дерево Хаффмана методом двух очередей
+ * @param arena - арена с отсортированными листьями
+ * @return наибольшая глубина листа
+ *
+ * Листья занимают индексы 0..n-1 по возрастанию веса, внутренние узлы
+ * создаются по порядку с индекса n, и их веса тоже не убывают. Поэтому
+ * два наименьших узла всегда находятся в начале одной из двух очередей,
+ * и дерево строится за O(n) без кучи. Вместо указателей хранятся индексы
+ * родителей; глубины вычисляются одним проходом от корня к листьям.
+ */
+static int huffmanDepths(HuffmanArena* arena) {
+    int n = arena->leaf_count;
+    int leaf = 0;                                    // Начало очереди листьев
+    int internal = n;                                // Начало очереди внутренних узлов
+    int next = n;                                    // Индекс следующего внутреннего узла
+
+    for (; next < 2 * n - 1; next++) {
+        uint64_t sum = 0;
+        for (int pick = 0; pick < 2; pick++) {       // Два наименьших узла из начал очередей
+            int node;
+            if (leaf < n && (internal == next || arena->weight[leaf] <= arena->weight[internal])) {
+                node = leaf++;
+            } else {
+                node = internal++;
+            }
+            arena->parent[node] = (short)next;
+            sum += arena->weight[node];
+        }
+        arena->weight[next] = sum;
+    }
+
+    int deepest = 0;
+    arena->depth[2 * n - 2] = 0;                     // Корень - последний созданный узел
+    for (int node = 2 * n - 3; node >= 0; node--) {  // Родитель всегда создан позже потомка
+        arena->depth[node] = (unsigned char)(arena->depth[arena->parent[node]] + 1);
+        if (node < n && arena->depth[node] > deepest) {
+            deepest = arena->depth[node];
+        }
+    }
+    return deepest;
+}
+
+/**
+ * Функция packageMerge - оптимальные длины кодов не длиннее max_length
+ * @param arena - арена с отсортированными листьями (длины пишутся в depth)
+ * @param max_length - наибольшая допустимая длина кода (2^max_length >= n)
+ *
+ * Алгоритм package-merge. Уровни соответствуют длинам от самой большой
+ * к единице. Нижний уровень - листья по возрастанию веса; каждый следующий -
+ * слияние тех же листьев с "пакетами", то есть суммами соседних пар
+ * предыдущего уровня. С верхнего уровня берутся первые 2n - 2 элемента,
+ * каждый взятый пакет требует двух элементов уровнем ниже. Длина кода листа
+ * равна числу уровней, на которых он взят.
+ *
+ * Листья на каждом уровне идут в одном и том же порядке, поэтому взятые
+ * листья уровня - всегда несколько первых по весу. Для обратного прохода
+ * достаточно помнить, какие элементы уровня были пакетами (по биту на
+ * элемент), а веса хранятся только для двух соседних уровней.
+ * Время O(n * max_length), без выделения памяти.
+ */
+static void packageMerge(HuffmanArena* arena, int max_length) {
+    int n = arena->leaf_count;
+    uint64_t* below = arena->level[0];
+    uint64_t* current = arena->level[1];
+    int below_count = n;
+
+    memcpy(below, arena->weight, n * sizeof(uint64_t));  // Нижний уровень - только листья
+    memset(arena->package_bits[0], 0, sizeof(arena->package_bits[0]));
+    for (int level = 1; level < max_length; level++) {
+        uint64_t* bits = arena->package_bits[level];
+        memset(bits, 0, sizeof(arena->package_bits[level]));
+        int packages = below_count / 2;
+        int i = 0, j = 0, k = 0;
+        while (i < n || j < packages) {              // Слияние листьев и пакетов по весу
+            uint64_t package = j < packages ? below[2 * j] + below[2 * j + 1] : 0;
+            if (j == packages || (i < n && arena->weight[i] <= package)) {
+                current[k++] = arena->weight[i++];
+            } else {
+                bits[k >> 6] |= 1ULL << (k & 63);
+                current[k++] = package;
+                j++;
+            }
+        }
+        below_count = k;
+        uint64_t* temp = below;
+        below = current;
+        current = temp;
+    }
+
+    memset(arena->depth, 0, n);
+    int take = 2 * n - 2;                            // Сколько элементов взять на текущем уровне
+    for (int level = max_length - 1; level >= 0; level--) {
+        const uint64_t* bits = arena->package_bits[level];
+        int packages = 0;
+        for (int k = 0; k < take; k++) {
+            packages += (int)((bits[k >> 6] >> (k & 63)) & 1);
+        }
+        for (int r = 0; r < take - packages; r++) {  // Взятые листья - первые по весу
+            arena->depth[r]++;
+        }
+        take = 2 * packages;
+    }
+}
+
+/**
+ * Функция buildCodeLengths - вычисляет длины кодов Хаффмана без выделения памяти
+ * @param arena - арена построения кодов (переиспользуется между вызовами)
+ * @param frequencies - частоты символов
+ * @param max_length - наибольшая длина кода (не меньше MIN_CODE_LENGTH_LIMIT;
+ *                     0 - без ограничения)
+ * @param codes - сюда записываются длины кодов (значения - 0,
+ *                их назначает assignCanonicalCodes)
+ *
+ * Листья сортируются один раз, дерево строится методом двух очередей
+ * в плоском массиве арены. Если оно оказалось глубже max_length, длины
+ * пересчитываются алгоритмом package-merge. Единственный символ получает
+ * код длиной 1 бит, как и в generateCodes.
+ */
+static void buildCodeLengths(HuffmanArena* arena, const unsigned int frequencies[], int max_length,
+                      Code codes[]) {
+    for (int i = 0; i < ASCII_SIZE; i++) {
+        codes[i].value = 0;
+        codes[i].length = 0;
+    }
+    sortLeaves(arena, frequencies);
+    int n = arena->leaf_count;
+    if (n == 1) {
+        codes[arena->symbol[0]].length = 1;          // Единственный символ: код из одного бита
+        return;
+    }
+    if (n == 0) {
+        return;
+    }
+
+    int deepest = huffmanDepths(arena);
+    if (max_length > 0 && deepest > max_length) {
+        packageMerge(arena, max_length);
+    }
+    for (int k = 0; k < n; k++) {
+        codes[arena->symbol[k]].length = arena->depth[k];
+    }
+}
+
+/**
+ * Функция validateCodeLengths - проверяет длины кодов, прочитанные из заголовка
+ * @param lengths - длины кодов для символов 0-255
+ * @return 1 если по длинам можно построить префиксный код, 0 если нет
+ *
+ * Проверяет неравенство Крафта: сумма 2^(-длина) не должна превышать 1.
+ * Иначе канонические коды пересекутся, и файл заведомо поврежден.
+ */
+static int validateCodeLengths(const unsigned char lengths[]) {
+    uint64_t kraft_sum = 0;                          // Сумма 2^(DECODE_MAX_CODE_LENGTH - длина)
+    for (int i = 0; i < ASCII_SIZE; i++) {
+        if (lengths[i] > DECODE_MAX_CODE_LENGTH) {
+            return 0;
+        }
+        if (lengths[i] > 0) {
+            kraft_sum += 1ULL << (DECODE_MAX_CODE_LENGTH - lengths[i]);
+        }
+    }
+    return kraft_sum <= (1ULL << DECODE_MAX_CODE_LENGTH);
+}
+
+/**
+ * Функция histogramBuffer - добавляет к гистограмме частоты символов блока памяти
+ * @param data - данные
+ * @param size - размер данных в байтах
+ * @param frequencies - гистограмма, к которой прибавляются частоты
+ *
+ * Счет идет в HISTOGRAM_LANES независимых подгистограмм, которые складываются
+ * в конце. Соседние байты попадают в разные подгистограммы, поэтому на длинных
+ * сериях одного символа инкременты не ждут друг друга через память
+ * (запись-затем-чтение одного и того же счетчика). Данные читаются
+ * 64-битными словами, из которых байты извлекаются сдвигами.
+ */
+static void histogramBuffer(const unsigned char* data, size_t size, unsigned int frequencies[]) {
+    uint32_t lanes[HISTOGRAM_LANES][ASCII_SIZE];
+    memset(lanes, 0, sizeof(lanes));
+
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, 8);                  // Порядок байт не важен: считаются все 8
+        lanes[0][word & 0xFF]++;
+        lanes[1][(word >> 8) & 0xFF]++;
+        lanes[2][(word >> 16) & 0xFF]++;
+        lanes[3][(word >> 24) & 0xFF]++;
+        lanes[0][(word >> 32) & 0xFF]++;
+        lanes[1][(word >> 40) & 0xFF]++;
+        lanes[2][(word >> 48) & 0xFF]++;
+        lanes[3][word >> 56]++;
+    }
+    for (; i < size; i++) {                          // Хвост короче слова
+        lanes[0][data[i]]++;
+    }
+
+    for (int s = 0; s < ASCII_SIZE; s++) {
+        frequencies[s] += lanes[0][s] + lanes[1][s] + lanes[2][s] + lanes[3][s];
+    }
+}
+
+/**
+ * Функция countFrequenciesBuffer - подсчитывает частоты символов в блоке памяти
+ * @param data - данные
+ * @param size - размер данных в байтах
+ * @param frequencies - массив для сохранения частот (индекс = код символа)
+ */
+static void countFrequenciesBuffer(const unsigned char* data, size_t size, unsigned int frequencies[]) {
+    for (int i = 0; i < ASCII_SIZE; i++) {
+        frequencies[i] = 0;
+    }
+    histogramBuffer(data, size, frequencies);
+}
+
+/**
+ * Функция storeBigEndian64 - записывает 64-битное число в 8 байт (старший байт первым)
+ * @param p - куда записать
+ * @param value - записываемое значение
+ */
+static inline void storeBigEndian64(unsigned char* p, uint64_t value) {
+    p[0] = (unsigned char)(value >> 56); p[1] = (unsigned char)(value >> 48);
+    p[2] = (unsigned char)(value >> 40); p[3] = (unsigned char)(value >> 32);
+    p[4] = (unsigned char)(value >> 24); p[5] = (unsigned char)(value >> 16);
+    p[6] = (unsigned char)(value >> 8);  p[7] = (unsigned char)value;
+}
+
+/**
+ * Функция putBits - добавляет код в аккумулятор
+ * @param writer - состояние записи битового потока
+ * @param aligned - код, выровненный по старшему разряду 64-битного слова
+ * @param length - длина кода в битах
+ *
+ * Вызывающая сторона гарантирует, что в аккумуляторе хватает места.
+ */
+static inline void putBits(BitWriter* writer, uint64_t aligned, int length) {
+    writer->bits |= aligned >> writer->count;
+    writer->count += length;
+}
+
+/**
+ * Функция flushBits - переносит целые байты аккумулятора в выходной буфер
+ * @param writer - состояние записи битового потока
+ *
+ * Всегда записывает 8-байтовое слово целиком, а позицию сдвигает только
+ * на количество полных байт: так сброс не содержит ветвлений.
+ * В аккумуляторе остается меньше 8 битов.
+ */
+static inline void flushBits(BitWriter* writer) {
+    int bytes = writer->count >> 3;                  // Сколько полных байт накоплено
+    storeBigEndian64(writer->buffer + writer->pos, writer->bits);
+    writer->pos += bytes;
+    writer->bits <<= bytes * 8;
+    writer->count &= 7;
+}
+
+/**
+ * Функция encodeBuffer - кодирует блок данных в битовый поток
+ * @param writer - состояние записи битового потока
+ * @param data - исходные данные
+ * @param size - размер данных в байтах
+ * @param aligned - коды символов, выровненные по старшему разряду
+ * @param lengths - длины кодов символов
+ * @param max_length - максимальная длина кода
+ *
+ * Между сбросами аккумулятора добавляется столько кодов, сколько гарантированно
+ * помещается в 64 бита вместе с остатком (до 7 битов) от предыдущего сброса.
+ *
+ * Цикл работает с локальной копией состояния: запись слова в выходной буфер
+ * через unsigned char* может, по правилам языка, изменить любой объект, и
+ * с полями *writer компилятор сохранял бы аккумулятор в память после
+ * каждого кода. Локальная копия остается в регистрах (в 1.5-2 раза быстрее).
+ */
+static void encodeBuffer(BitWriter* writer, const unsigned char* data, size_t size,
+                         const uint64_t aligned[], const int lengths[], int max_length) {
+    BitWriter local = *writer;
+    size_t i = 0;
+
+    if (max_length <= 14) {                          // 7 + 4 * 14 <= 64: четыре кода на сброс
+        for (; i + 4 <= size; i += 4) {
+            putBits(&local, aligned[data[i]], lengths[data[i]]);
+            putBits(&local, aligned[data[i + 1]], lengths[data[i + 1]]);
+            putBits(&local, aligned[data[i + 2]], lengths[data[i + 2]]);
+            putBits(&local, aligned[data[i + 3]], lengths[data[i + 3]]);
+            flushBits(&local);
+        }
+    } else if (max_length <= 28) {                   // 7 + 2 * 28 <= 64: два кода на сброс
+        for (; i + 2 <= size; i += 2) {
+            putBits(&local, aligned[data[i]], lengths[data[i]]);
+            putBits(&local, aligned[data[i + 1]], lengths[data[i + 1]]);
+            flushBits(&local);
+        }
+    }
+
+    for (; i < size; i++) {                          // Оставшиеся символы (или очень длинные коды)
+        putBits(&local, aligned[data[i]], lengths[data[i]]);
+        flushBits(&local);
+    }
+    *writer = local;
+}
+
+
+/*
+ * Структура DecodeSymbol - вспомогательная запись для построения таблицы декодирования
+ * Хранит код символа в виде целого числа (старший бит кода - первый в потоке)
+ */
+typedef struct DecodeSymbol {
+    uint64_t code;              // Значение кода
+    int length;                 // Длина кода в битах
+    unsigned char symbol;       // Кодируемый символ
+} DecodeSymbol;
+
+/**
+ * Функция allocateDecodeEntries - резервирует в таблице место под новую (под)таблицу
+ * @param table - таблица декодирования
+ * @param count - количество элементов
+ * @return смещение зарезервированной области в массиве entries, -1 - не хватило памяти
+ *
+ * Массив entries может быть перераспределен, поэтому ссылки между
+ * таблицами хранятся как смещения, а не как указатели.
+ */
+static int allocateDecodeEntries(DecodeTable* table, int count) {
+    if (table->size + count > table->capacity) {
+        int new_capacity = table->capacity > 0 ? table->capacity : (1 << DECODE_TABLE_BITS);
+        while (table->size + count > new_capacity) {
+            new_capacity *= 2;                       // Растим емкость вдвое
+        }
+        uint32_t* entries = (uint32_t*)realloc(table->entries, new_capacity * sizeof(uint32_t));
+        if (entries == NULL) {
+            return -1;
+        }
+        table->entries = entries;
+        table->capacity = new_capacity;
+    }
+
+    int offset = table->size;
+    memset(table->entries + offset, 0, count * sizeof(uint32_t));  // Нулевой элемент - недопустимый код
+    table->size += count;
+    return offset;
+}
+
+/**
+ * Функция fillDecodeLevel - заполняет один уровень таблицы декодирования
+ * @param table - таблица декодирования
+ * @param offset - смещение уровня в массиве entries
+ * @param bits - разрядность уровня (сколько битов потока его индексирует)
+ * @param symbols - символы, коды которых начинаются с уже разобранного префикса
+ * @param count - количество таких символов
+ * @param consumed - длина уже разобранного префикса в битах
+ * @return 1 при успехе, 0 - не хватило памяти для вторичных таблиц
+ *
+ * Коды, целиком помещающиеся в уровень, размножаются по всем индексам с их префиксом.
+ * Для более длинных кодов создается вторичная таблица, разрядность которой равна
+ * длине самого длинного оставшегося хвоста (но не больше DECODE_TABLE_BITS).
+ */
+static int fillDecodeLevel(DecodeTable* table, int offset, int bits,
+                           const DecodeSymbol symbols[], int count, int consumed) {
+    // Короткие коды: заполняем все индексы, начинающиеся с кода
+    for (int i = 0; i < count; i++) {
+        int rest = symbols[i].length - consumed;     // Сколько битов кода осталось разобрать
+        if (rest > bits) {
+            continue;
+        }
+        uint64_t tail = symbols[i].code & ((1ULL << rest) - 1);
+        int first = (int)(tail << (bits - rest));    // Первый индекс с таким префиксом
+        for (int k = 0; k < (1 << (bits - rest)); k++) {
+            table->entries[offset + first + k] = DT_LEAF(symbols[i].symbol, rest);
+        }
+    }
+
+    // Длинные коды: группируем по индексу на этом уровне и строим вторичные таблицы
+    for (int i = 0; i < count; i++) {
+        int rest = symbols[i].length - consumed;
+        if (rest <= bits) {
+            continue;
+        }
+        int index = (int)((symbols[i].code >> (rest - bits)) & ((1ULL << bits) - 1));
+        if (table->entries[offset + index] != 0) {
+            continue;                                // Группа с этим индексом уже обработана
+        }
+
+        DecodeSymbol group[ASCII_SIZE];              // Символы с тем же индексом
+        int group_count = 0;
+        int max_rest = 0;                            // Самый длинный хвост в группе
+        for (int j = i; j < count; j++) {
+            int rest_j = symbols[j].length - consumed;
+            if (rest_j > bits &&
+                (int)((symbols[j].code >> (rest_j - bits)) & ((1ULL << bits) - 1)) == index) {
+                group[group_count++] = symbols[j];
+                if (rest_j - bits > max_rest) {
+                    max_rest = rest_j - bits;
+                }
+            }
+        }
+
+        int sub_bits = max_rest < DECODE_TABLE_BITS ? max_rest : DECODE_TABLE_BITS;
+        int sub_offset = allocateDecodeEntries(table, 1 << sub_bits);
+        if (sub_offset < 0) {
+            return 0;
+        }
+        table->entries[offset + index] = DT_LINK(sub_offset, sub_bits);
+        if (!fillDecodeLevel(table, sub_offset, sub_bits, group, group_count, consumed + bits)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * Функция rebuildDecodeTable - строит таблицу заново, сохраняя выделенную память
+ * @param table - таблица, уже построенная этой функцией или buildDecodeTable
+ *                (или обнуленная: entries == NULL, capacity == 0)
+ * @param codes - массив кодов Хаффмана для каждого символа
+ * @return 1 при успехе, 0 - не хватило памяти (память таблицы остается за ней)
+ *
+ * Массив entries переиспользуется и растет только при нехватке места,
+ * поэтому при восстановлении блоков подряд память выделяется один раз.
+ */
+static int rebuildDecodeTable(DecodeTable* table, const Code codes[]) {
+    DecodeSymbol symbols[ASCII_SIZE];                // Символы с ненулевой длиной кода
+    int count = 0;
+
+    table->size = 0;
+    table->max_length = 0;
+
+    for (int i = 0; i < ASCII_SIZE; i++) {
+        table->lengths[i] = (unsigned char)codes[i].length;
+        if (codes[i].length == 0) {
+            continue;
+        }
+        symbols[count].code = codes[i].value;
+        symbols[count].length = codes[i].length;
+        symbols[count].symbol = (unsigned char)i;
+        count++;
+        if (codes[i].length > table->max_length) {
+            table->max_length = codes[i].length;
+        }
+    }
+
+    int primary = allocateDecodeEntries(table, 1 << DECODE_TABLE_BITS);
+    if (primary < 0 || !fillDecodeLevel(table, primary, DECODE_TABLE_BITS, symbols, count, 0)) {
+        table->size = 0;
+        return 0;
+    }
+
+    // Упаковка пар символов в первичную таблицу
+    uint32_t single[1 << DECODE_TABLE_BITS];         // Копия таблицы с одиночными символами
+    memcpy(single, table->entries, sizeof(single));
+    for (int i = 0; i < (1 << DECODE_TABLE_BITS); i++) {
+        uint32_t first = single[i];
+        if (DT_COUNT(first) != 1 || DT_LENGTH(first) >= DECODE_TABLE_BITS) {
+            continue;
+        }
+        int length1 = DT_LENGTH(first);
+        // Оставшиеся (DECODE_TABLE_BITS - length1) битов индекса - начало следующего кода
+        uint32_t second = single[(i << length1) & ((1 << DECODE_TABLE_BITS) - 1)];
+        if (DT_COUNT(second) == 1 && DT_LENGTH(second) <= DECODE_TABLE_BITS - length1) {
+            table->entries[i] = DT_PAIR(DT_SYMBOL1(first), DT_SYMBOL1(second),
+                                        length1 + DT_LENGTH(second));
+        }
+    }
+    return 1;
+}
+
+/**
+ * Функция buildDecodeTable - строит таблицу быстрого декодирования по кодам символов
+ * @param table - структура для заполнения (освобождается функцией freeDecodeTable)
+ * @param codes - массив кодов Хаффмана для каждого символа
+ * @return 1 при успехе, 0 - не хватило памяти
+ *
+ * 1. Заполняет первичную таблицу на DECODE_TABLE_BITS битов и вторичные таблицы
+ * 2. Упаковывает в элементы первичной таблицы пары символов, если оба кода
+ *    вместе помещаются в DECODE_TABLE_BITS битов: так за одно обращение
+ *    декодируются сразу два коротких кода
+ */
+static int buildDecodeTable(DecodeTable* table, const Code codes[]) {
+    table->entries = NULL;
+    table->capacity = 0;
+    table->chained = NULL;
+    return rebuildDecodeTable(table, codes);
+}
+
+/**
+ * Функция freeDecodeTable - освобождает память таблицы декодирования
+ * @param table - таблица декодирования
+ */
+static void freeDecodeTable(DecodeTable* table) {
+    free(table->entries);
+    free(table->chained);
+    table->entries = NULL;
+    table->chained = NULL;
+    table->size = table->capacity = 0;
+}
+
+/**
+ * Функция loadBigEndian64 - читает 8 байт как 64-битное число (первый байт - старший)
+ * @param p - указатель на данные
+ * @return прочитанное значение
+ */
+static inline uint64_t loadBigEndian64(const unsigned char* p) {
+    return ((uint64_t)p[0] << 56) | ((uint64_t)p[1] << 48) | ((uint64_t)p[2] << 40) |
+           ((uint64_t)p[3] << 32) | ((uint64_t)p[4] << 24) | ((uint64_t)p[5] << 16) |
+           ((uint64_t)p[6] << 8)  | (uint64_t)p[7];
+}
+
+/**
+ * Функция refillBitReader - пополняет 64-битный битовый буфер
+ * @param reader - состояние чтения битового потока
+ *
+ * Если в байтовом буфере есть хотя бы 8 байт, пополнение выполняется одной
+ * загрузкой 64-битного слова без ветвлений по отдельным байтам; после него
+ * в битовом буфере не меньше 56 валидных битов. Хвост потока дочитывается побайтно.
+ */
+static inline void refillBitReader(BitReader* reader) {
+    if (reader->end - reader->pos >= 8) {
+        reader->bits |= loadBigEndian64(reader->buffer + reader->pos) >> reader->count;
+        reader->pos += (63 - reader->count) >> 3;    // Сколько целых байт поместилось в буфер
+        reader->count |= 56;
+    } else {
+        while (reader->count <= 56 && reader->pos < reader->end) {
+            reader->bits |= (uint64_t)reader->buffer[reader->pos++] << (56 - reader->count);
+            reader->count += 8;
+        }
+    }
+}
+
+/**
+ * Функция decodeSymbols - декодирует один элемент таблицы из начала битового буфера
+ * @param table - таблица декодирования
+ * @param bits - битовый буфер (биты выровнены по старшему разряду)
+ * @param out - куда записать символы (не меньше 2 байт свободного места)
+ * @param produced - сюда записывается количество декодированных символов (1 или 2)
+ * @return количество использованных битов, 0 - если код недопустим
+ */
+static inline int decodeSymbols(const DecodeTable* table, uint64_t bits,
+                                unsigned char* out, int* produced) {
+    uint32_t entry = table->entries[bits >> (64 - DECODE_TABLE_BITS)];
+    int consumed = 0;                                // Биты, разобранные предыдущими уровнями
+    int level_bits = DECODE_TABLE_BITS;              // Разрядность текущего уровня
+
+    // Переходы по ссылкам во вторичные таблицы (только для длинных кодов)
+    while (DT_COUNT(entry) == 0) {
+        int sub_bits = DT_LENGTH(entry);
+        if (sub_bits == 0) {
+            return 0;                                // Недопустимый код - поток поврежден
+        }
+        consumed += level_bits;
+        level_bits = sub_bits;
+        entry = table->entries[DT_OFFSET(entry) + (int)((bits << consumed) >> (64 - sub_bits))];
+    }
+
+    out[0] = DT_SYMBOL1(entry);
+    out[1] = DT_SYMBOL2(entry);                      // Записывается всегда, учитывается только для пар
+    *produced = DT_COUNT(entry);
+    return consumed + DT_LENGTH(entry);
+}
+
+/**
+ * Функция decodeBits - декодирует битовый поток в буфер памяти
+ * @param reader - состояние чтения битового потока (продолжается между вызовами)
+ * @param table - таблица декодирования, построенная buildDecodeTable
+ * @param remaining - количество оставшихся значимых битов (уменьшается)
+ * @param out - выходной буфер
+ * @param capacity - размер выходного буфера в байтах
+ * @return количество декодированных байт
+ *
+ * Быстрый цикл работает, пока в буфере остается не меньше DECODE_OUT_SLACK
+ * свободных байт: за одно пополнение битового буфера он может выдать
+ * несколько десятков символов. Последние байты буфера и хвост потока
+ * заполняются осторожным циклом, поэтому буфер заполняется ровно до capacity.
+ * Если поток поврежден или короче заявленного, возвращается 0
+ * при *remaining > 0.
+ *
+ * Алгоритм декодирования:
+ * 1. Битовый буфер пополняется сразу на 56-64 бита
+ * 2. Следующие DECODE_TABLE_BITS битов индексируют таблицу, которая сразу
+ *    выдает один или два символа и длину их кодов
+ * 3. Пока значимых битов достаточно для самого длинного кода, декодирование
+ *    идет без проверок конца потока; хвост разбирается отдельно
+ */
+static size_t decodeBits(BitReader* reader, const DecodeTable* table, uint64_t* remaining,
+                         unsigned char* out, size_t capacity) {
+    BitReader state = *reader;                       // Локальная копия: поля держатся в регистрах
+    size_t out_pos = 0;                              // Заполненность выходного буфера
+    uint64_t left = *remaining;                      // Сколько значимых битов осталось
+    int produced = 0;                                // Количество символов за один шаг
+    // Наибольшее число битов, которое может забрать один шаг декодирования
+    int max_step = table->max_length > DECODE_TABLE_BITS ? table->max_length : DECODE_TABLE_BITS;
+
+    // Основной цикл: каждый шаг целиком лежит внутри значимых битов
+    while (left >= (uint64_t)max_step && out_pos + DECODE_OUT_SLACK <= capacity) {
+        refillBitReader(&state);
+        if (state.count < max_step) {
+            break;                                   // Поток короче заявленного числа битов
+        }
+        while (state.count >= max_step && left >= (uint64_t)max_step) {
+            int used = decodeSymbols(table, state.bits, out + out_pos, &produced);
+            if (used == 0) {
+                goto done;                           // Поврежденный поток: прекращаем декодирование
+            }
+            out_pos += produced;
+            state.bits <<= used;
+            state.count -= used;
+            left -= used;
+        }
+    }
+
+    // Осторожный цикл: хвост потока и последние байты выходного буфера.
+    // Элемент-пара может выходить за последний значимый бит или за конец буфера.
+    while (left > 0 && out_pos < capacity) {
+        unsigned char symbols[2];
+        refillBitReader(&state);
+        int used = decodeSymbols(table, state.bits, symbols, &produced);
+        if (used == 0) {
+            break;                                   // Поврежденный поток
+        }
+        if (produced == 2 && ((uint64_t)used > left || out_pos + 2 > capacity)) {
+            used -= table->lengths[symbols[1]];      // Оставляем только первый символ пары
+            produced = 1;
+        }
+        if ((uint64_t)used > left) {
+            break;                                   // Код выходит за конец потока
+        }
+        if (used > state.count) {
+            break;                                   // Поток короче заявленного числа битов
+        }
+        out[out_pos] = symbols[0];
+        if (produced == 2) {
+            out[out_pos + 1] = symbols[1];
+        }
+        out_pos += produced;
+        state.bits <<= used;
+        state.count -= used;
+        left -= used;
+    }
+
+done:
+    *reader = state;
+    *remaining = left;
+    return out_pos;
+}
+
+
+static uint32_t crc32_table[CRC_SLICES][256];       // crc32_table[k][b]: остаток байта b, за которым k нулевых байт
+
+/**
+ * Функция crc32Tables - строит таблицы остатков CRC-32 (вызывается один раз из crc32Update)
+ */
+static void crc32Tables(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t value = i;
+        for (int bit = 0; bit < 8; bit++) {
+            value = (value & 1) ? (value >> 1) ^ 0xEDB88320u : value >> 1;
+        }
+        crc32_table[0][i] = value;
+    }
+    for (int k = 1; k < CRC_SLICES; k++) {
+        for (int i = 0; i < 256; i++) {
+            crc32_table[k][i] = (crc32_table[k - 1][i] >> 8) ^ crc32_table[0][crc32_table[k - 1][i] & 0xFF];
+        }
+    }
+}
+
+/**
+ * Функция crc32Update - обновляет контрольную сумму CRC-32 блоком данных
+ * @param crc - текущее значение (0 для начала вычисления)
+ * @param data - данные
+ * @param size - размер данных в байтах
+ * @return новое значение контрольной суммы
+ *
+ * Стандартный CRC-32 (полином 0xEDB88320, как в zip и PNG), вариант
+ * slicing-by-8: по 8 таблиц на 256 значений, за одну итерацию
+ * обрабатывается 8 байт без зависимости между поисками в таблицах.
+ * Побайтный вариант упирается в цепочку зависимостей через crc и
+ * медленнее декодера в несколько раз. Таблицы строятся при первом вызове
+ * (crc32Tables) ровно один раз, даже если первыми функцию одновременно
+ * вызывают несколько рабочих потоков.
+ */
+static uint32_t crc32Update(uint32_t crc, const unsigned char* data, size_t size) {
+    static OnceFlag tables_once = ONCE_INITIALIZER;
+    callOnce(&tables_once, crc32Tables);
+    const uint32_t (*table)[256] = crc32_table;
+
+    crc = ~crc;
+    while (size >= CRC_SLICES) {
+        uint32_t low = crc ^ ((uint32_t)data[0] | ((uint32_t)data[1] << 8) |
+                              ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24));
+        uint32_t high = (uint32_t)data[4] | ((uint32_t)data[5] << 8) |
+                        ((uint32_t)data[6] << 16) | ((uint32_t)data[7] << 24);
+        crc = table[7][low & 0xFF] ^ table[6][(low >> 8) & 0xFF] ^
+              table[5][(low >> 16) & 0xFF] ^ table[4][low >> 24] ^
+              table[3][high & 0xFF] ^ table[2][(high >> 8) & 0xFF] ^
+              table[1][(high >> 16) & 0xFF] ^ table[0][high >> 24];
+        data += CRC_SLICES;
+        size -= CRC_SLICES;
+    }
+    for (size_t i = 0; i < size; i++) {
+        crc = table[0][(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+/**
+ * Функция loadLittleEndian - читает число из bytes байт (младший байт первым)
+ * @param p - указатель на данные
+ * @param bytes - количество байт (4 или 8)
+ * @return прочитанное значение
+ */
+static uint64_t loadLittleEndian(const unsigned char* p, int bytes) {
+    uint64_t value = 0;
+    for (int i = bytes - 1; i >= 0; i--) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+/**
+ * Функция containerHeaderSize - размер заголовка сжатых данных
+ * @param flags - флаги заголовка (байт 5)
+ * @return CONTAINER_COMPACT_SIZE или CONTAINER_HEADER_SIZE; с этого смещения начинается первый блок
+ */
+static size_t containerHeaderSize(unsigned char flags) {
+    return (flags & CONTAINER_FLAG_COMPACT) ? CONTAINER_COMPACT_SIZE : CONTAINER_HEADER_SIZE;
+}
+
+/**
+ * Функция compactContainer - подходит ли для сжатых данных короткий заголовок
+ * @param size - размер исходных данных
+ * @param options - параметры сжатия
+ * @return 1 если данные - одна запись, сжимаемая со словарем (CONTAINER_FLAG_COMPACT)
+ *
+ * Словарь нужен маленьким записям, у которых обычные заголовок и
+ * индекс (63 байта на блок) съели бы весь выигрыш сжатия.
+ */
+static int compactContainer(uint64_t size, const CodecOptions* options) {
+    return options->dictionary != NULL && size > 0 && size <= options->block_size;
+}
+
+/**
+ * Функция storeContainerHeader - записывает заголовок сжатых данных в память
+ * @param buffer - containerHeaderSize(header->flags) байт для заполнения
+ * @param header - заполненный заголовок
+ *
+ * Формат заголовка описан у структуры ContainerHeader. Числа записываются
+ * побайтно в little-endian, поэтому формат не зависит от платформы.
+ */
+static void storeContainerHeader(unsigned char* buffer, const ContainerHeader* header) {
+    memcpy(buffer, CONTAINER_MAGIC, 4);              // Сигнатура
+    buffer[4] = CONTAINER_VERSION;                   // Версия формата
+    buffer[5] = header->flags;                       // Флаги
+    if (header->flags & CONTAINER_FLAG_COMPACT) {
+        storeLittleEndian(buffer + 6, header->original_size, 4);
+        return;                                      // Размер и количество блоков следуют из размера данных
+    }
+    storeLittleEndian(buffer + 6, header->original_size, 8);
+    storeLittleEndian(buffer + 14, header->block_size, 4);
+    storeLittleEndian(buffer + 18, header->block_count, 4);
+}
+
+/**
+ * Функция parseContainerHeader - разбирает и проверяет заголовок сжатых данных
+ * @param buffer - заголовок: CONTAINER_HEADER_SIZE байт (с флагом CONTAINER_FLAG_COMPACT -
+ *                 CONTAINER_COMPACT_SIZE)
+ * @param header - структура для заполнения
+ * @return 1 при успехе, 0 если данные не являются корректным кадром "HUFF"
+ *
+ * Проверяет сигнатуру, версию формата и согласованность размеров.
+ */
+static int parseContainerHeader(const unsigned char* buffer, ContainerHeader* header) {
+    if (memcmp(buffer, CONTAINER_MAGIC, 4) != 0) {
+        return 0;
+    }
+    if (buffer[4] != CONTAINER_VERSION) {
+        return 0;
+    }
+
+    header->flags = buffer[5];
+    if (header->flags & CONTAINER_FLAG_COMPACT) {
+        header->original_size = loadLittleEndian(buffer + 6, 4);
+        header->block_size = (uint32_t)header->original_size;
+        header->block_count = 1;
+        if (header->original_size == 0 || header->original_size > MAX_BLOCK_SIZE ||
+            (header->flags & (CONTAINER_FLAG_INDEX | CONTAINER_FLAG_STREAM))) {
+            return 0;
+        }
+        return 1;
+    }
+    header->original_size = loadLittleEndian(buffer + 6, 8);
+    header->block_size = (uint32_t)loadLittleEndian(buffer + 14, 4);
+    header->block_count = (uint32_t)loadLittleEndian(buffer + 18, 4);
+
+    // Блоки должны в точности покрывать исходные данные (в потоке размеры неизвестны)
+    int stream = (header->flags & CONTAINER_FLAG_STREAM) != 0;
+    if (header->block_size == 0 || header->block_size > MAX_BLOCK_SIZE ||
+        (stream && (header->original_size != 0 || header->block_count != 0)) ||
+        (!stream && header->block_count !=
+                    (header->original_size + header->block_size - 1) / header->block_size)) {
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * Функция blockTableSize - размер таблицы в заголовке блока
+ * @param mode - режим блока BLOCK_MODE_*
+ * @param table_count - первый байт таблицы (количество таблиц; важен только для order-1)
+ * @return количество байт таблицы за общей частью заголовка
+ *
+ * При недопустимом количестве таблиц order-1 или символов BLOCK_MODE_PACKED
+ * возвращается размер одного байта количества, чтобы заголовок дочитался
+ * до проверки в parseBlockHeader.
+ */
+static size_t blockTableSize(unsigned char mode, unsigned char table_count) {
+    if (mode == BLOCK_MODE_ORDER1) {
+        if (table_count == 0 || table_count > ORDER1_MAX_TABLES) {
+            return 1;
+        }
+        return 1 + (size_t)ORDER1_TABLE_BYTES * (table_count + 1);
+    }
+    if (mode == BLOCK_MODE_DICTIONARY) {
+        return DICTIONARY_ID_SIZE;
+    }
+    if (mode == BLOCK_MODE_REUSE) {
+        return 1;
+    }
+    if (mode == BLOCK_MODE_PACKED) {
+        return table_count >= 2 && table_count <= PACKED_MAX_SYMBOLS ? 1 + (size_t)table_count : 1;
+    }
+    return mode == BLOCK_MODE_STATIC || mode == BLOCK_MODE_INTERLEAVED ? ASCII_SIZE : 0;
+}
+
+/**
+ * Функция unpackNibbles - разворачивает 256 значений по 4 бита
+ * @param packed - ORDER1_TABLE_BYTES байт (четный индекс - младшие 4 бита)
+ * @param values - массив на 256 значений
+ */
+static void unpackNibbles(const unsigned char* packed, unsigned char values[]) {
+    for (int i = 0; i < ORDER1_TABLE_BYTES; i++) {
+        values[2 * i] = packed[i] & 0x0F;
+        values[2 * i + 1] = packed[i] >> 4;
+    }
+}
+
+/**
+ * Функция packNibbles - упаковывает 256 значений меньше 16 по 4 бита
+ * @param values - массив на 256 значений
+ * @param packed - куда записать ORDER1_TABLE_BYTES байт
+ */
+static void packNibbles(const unsigned char values[], unsigned char* packed) {
+    for (int i = 0; i < ORDER1_TABLE_BYTES; i++) {
+        packed[i] = (unsigned char)(values[2 * i] | (values[2 * i + 1] << 4));
+    }
+}
+
+/**
+ * Функция parseBlockHeader - разбирает и проверяет заголовок блока в памяти
+ * @param buffer - байты заголовка
+ * @param available - сколько байт доступно в buffer
+ * @param header - структура для заполнения (header->size - размер заголовка)
+ * @param expected_size - ожидаемый размер исходных данных блока
+ * @return 1 при успехе, 0 если заголовок блока поврежден
+ */
+static int parseBlockHeader(const unsigned char* buffer, size_t available, BlockHeader* header,
+                     uint32_t expected_size) {
+    if (available < BLOCK_PREFIX_SIZE) {
+        return 0;
+    }
+    header->raw_size = (uint32_t)loadLittleEndian(buffer, 4);
+    header->bit_count = (uint32_t)loadLittleEndian(buffer + 4, 4);
+    header->checksum = (uint32_t)loadLittleEndian(buffer + 8, 4);
+    header->mode = buffer[12];
+    header->table_count = available > BLOCK_PREFIX_SIZE ? buffer[BLOCK_PREFIX_SIZE] : 0;
+    header->size = (uint32_t)(BLOCK_PREFIX_SIZE + blockTableSize(header->mode, header->table_count));
+
+    if (header->raw_size != expected_size || header->mode >= BLOCK_MODE_COUNT ||
+        header->size > available) {
+        return 0;
+    }
+    if (header->mode == BLOCK_MODE_ORDER1) {
+        const unsigned char* table = buffer + BLOCK_PREFIX_SIZE + 1;
+        int valid = header->table_count >= 1 && header->table_count <= ORDER1_MAX_TABLES;
+        if (valid) {
+            unpackNibbles(table, header->context_map);
+            for (int i = 0; i < ASCII_SIZE; i++) {
+                valid &= header->context_map[i] < header->table_count;
+            }
+            for (int t = 0; t < header->table_count; t++) {
+                unpackNibbles(table + ORDER1_TABLE_BYTES * (t + 1), header->context_lengths[t]);
+                valid &= validateCodeLengths(header->context_lengths[t]);
+            }
+        }
+        if (!valid) {
+            return 0;
+        }
+    }
+    if (header->mode == BLOCK_MODE_DICTIONARY) {
+        header->dictionary_id = (uint32_t)loadLittleEndian(buffer + BLOCK_PREFIX_SIZE, 4);
+    }
+    if (header->mode == BLOCK_MODE_REUSE) {
+        header->distance = buffer[BLOCK_PREFIX_SIZE];
+        if (header->distance == 0 || header->distance >= TABLE_CACHE_SEGMENT) {
+            return 0;
+        }
+    }
+    if (header->mode == BLOCK_MODE_PACKED) {
+        int valid = header->table_count >= 2 && header->table_count <= PACKED_MAX_SYMBOLS;
+        for (int i = 0; valid && i < header->table_count; i++) {
+            header->symbols[i] = buffer[BLOCK_PREFIX_SIZE + 1 + i];
+            valid = i == 0 || header->symbols[i] > header->symbols[i - 1];
+        }
+        if (!valid) {
+            return 0;
+        }
+    }
+    if (header->mode == BLOCK_MODE_STATIC || header->mode == BLOCK_MODE_INTERLEAVED) {
+        memcpy(header->lengths, buffer + BLOCK_PREFIX_SIZE, ASCII_SIZE);
+        if (!validateCodeLengths(header->lengths)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * Функция blockBound - наибольший размер сжатого блока
+ * @param size - размер исходных данных блока
+ * @return размер буфера, в который encodeBlockWith пишет блок любого режима
+ *
+ * Поток блока не длиннее исходных данных (см. encodeBlockWith), а кодировщики
+ * сбрасывают аккумулятор 8-байтовым словом, поэтому к данным добавляются
+ * наибольший заголовок и BLOCK_SLACK байт.
+ */
+static size_t blockBound(size_t size) {
+    return BLOCK_HEADER_MAX_SIZE + size + BLOCK_SLACK;
+}
+
+/**
+ * Функция storeBlockPrefix - записывает общую часть заголовка блока
+ * @param p - куда записать (BLOCK_PREFIX_SIZE байт)
+ * @param data - исходные данные блока (для контрольной суммы)
+ * @param size - размер исходных данных блока
+ * @param bit_count - количество значимых битов потока
+ * @param mode - режим блока BLOCK_MODE_*
+ */
+static void storeBlockPrefix(unsigned char* p, const unsigned char* data, size_t size,
+                             uint64_t bit_count, int mode) {
+    storeLittleEndian(p, size, 4);
+    storeLittleEndian(p + 4, bit_count, 4);
+    ProfileSample sample;
+    PROFILE_BEGIN(sample);
+    storeLittleEndian(p + 8, crc32Update(0, data, size), 4);
+    PROFILE_END(PROFILE_CHECK, sample, size, 0);
+    p[12] = (unsigned char)mode;
+}
+
+// ---------- Адаптивный код Хаффмана (FGK) ----------
+
+/**
+ * Функция adaptiveInit - готовит адаптивное дерево к новому блоку
+ * @param tree - дерево
+ *
+ * В начале дерево состоит из одного узла NYT ("еще не передан") с наибольшим
+ * номером. Символ, который встречается впервые, передается кодом NYT
+ * и следующими за ним 8 битами самого символа.
+ */
+static void adaptiveInit(AdaptiveTree* tree) {
+    memset(tree->leaves, 0, sizeof(tree->leaves));
+    Node* root = &tree->nodes[0];
+    root->symbol = 0;
+    root->freq = 0;
+    root->left = root->right = root->parent = NULL;
+    root->number = ADAPTIVE_MAX_NODES - 1;
+    tree->order[root->number] = root;
+    tree->nyt = root;
+    tree->used = 1;
+}
+
+/**
+ * Функция adaptiveAddSymbol - добавляет в дерево лист нового символа
+ * @param tree - дерево
+ * @param symbol - символ, встреченный впервые
+ * @return лист символа (с нулевым весом)
+ *
+ * Узел NYT становится внутренним: левый потомок - новый NYT,
+ * правый - лист символа. Новые узлы получают два следующих по убыванию номера.
+ */
+static Node* adaptiveAddSymbol(AdaptiveTree* tree, unsigned char symbol) {
+    Node* parent = tree->nyt;
+    Node* leaf = &tree->nodes[tree->used++];
+    Node* nyt = &tree->nodes[tree->used++];
+
+    leaf->symbol = symbol;
+    leaf->freq = 0;
+    leaf->left = leaf->right = NULL;
+    leaf->parent = parent;
+    leaf->number = parent->number - 1;
+
+    nyt->symbol = 0;
+    nyt->freq = 0;
+    nyt->left = nyt->right = NULL;
+    nyt->parent = parent;
+    nyt->number = parent->number - 2;
+
+    parent->left = nyt;
+    parent->right = leaf;
+    tree->order[leaf->number] = leaf;
+    tree->order[nyt->number] = nyt;
+    tree->leaves[symbol] = leaf;
+    tree->nyt = nyt;
+    return leaf;
+}
+
+/**
+ * Функция adaptiveLeader - находит узел с наибольшим номером среди узлов того же веса
+ * @param tree - дерево
+ * @param node - узел
+ * @return лидер группы узлов с весом node->freq
+ *
+ * Номера узлов упорядочены по неубыванию веса, поэтому узлы одного веса
+ * занимают непрерывный отрезок номеров и лидер находится двоичным поиском.
+ */
+static Node* adaptiveLeader(const AdaptiveTree* tree, Node* node) {
+    int low = node->number;                          // Вес узла с номером low равен node->freq
+    int high = ADAPTIVE_MAX_NODES - 1;
+    while (low < high) {
+        int middle = (low + high + 1) / 2;
+        if (tree->order[middle]->freq == node->freq) {
+            low = middle;
+        } else {
+            high = middle - 1;
+        }
+    }
+    return tree->order[low];
+}
+
+/**
+ * Функция adaptiveSwap - меняет местами два поддерева вместе с их номерами
+ * @param tree - дерево
+ * @param a - первый узел (не корень)
+ * @param b - второй узел (не корень и не предок a)
+ */
+static void adaptiveSwap(AdaptiveTree* tree, Node* a, Node* b) {
+    Node* parent_a = a->parent;
+    Node* parent_b = b->parent;
+
+    if (parent_a == parent_b) {                      // Братья: меняем местами потомков
+        Node* temp = parent_a->left;
+        parent_a->left = parent_a->right;
+        parent_a->right = temp;
+    } else {
+        if (parent_a->left == a) parent_a->left = b; else parent_a->right = b;
+        if (parent_b->left == b) parent_b->left = a; else parent_b->right = a;
+        a->parent = parent_b;
+        b->parent = parent_a;
+    }
+
+    int number = a->number;
+    a->number = b->number;
+    b->number = number;
+    tree->order[a->number] = a;
+    tree->order[b->number] = b;
+}
+
+/**
+ * Функция adaptiveUpdate - учитывает очередной символ в дереве
+ * @param tree - дерево
+ * @param node - лист закодированного символа
+ *
+ * По пути от листа к корню каждый узел сначала меняется местами с лидером
+ * своей группы веса (если это не его родитель), а затем его вес
+ * увеличивается на 1. Так сохраняется упорядоченность номеров по весу,
+ * и дерево остается деревом Хаффмана для уже переданных символов.
+ */
+static void adaptiveUpdate(AdaptiveTree* tree, Node* node) {
+    while (node != NULL) {
+        Node* leader = adaptiveLeader(tree, node);
+        if (leader != node && leader != node->parent) {
+            adaptiveSwap(tree, node, leader);
+        }
+        node->freq++;
+        node = node->parent;
+    }
+}
+
+/**
+ * Функция adaptiveCode - вычисляет текущий код узла
+ * @param node - узел дерева
+ * @param code - сюда записывается код (первый бит пути - старший)
+ * @return длина кода в битах
+ *
+ * Дерево всегда остается деревом Хаффмана для весов не больше MAX_BLOCK_SIZE,
+ * поэтому его глубина (как у дерева на числах Фибоначчи) не превышает 40.
+ */
+static inline int adaptiveCode(const Node* node, uint64_t* code) {
+    uint64_t value = 0;
+    int length = 0;
+    for (; node->parent != NULL; node = node->parent) {
+        value |= (uint64_t)(node->parent->right == node) << length;
+        length++;
+    }
+    *code = value;
+    return length;
+}
+
+/**
+ * Функция encodeAdaptive - кодирует блок адаптивным кодом Хаффмана за один проход
+ * @param data - исходные данные блока
+ * @param size - размер блока
+ * @param block - буфер результата (не меньше offset + size + BLOCK_SLACK байт)
+ * @param offset - смещение потока в буфере (место под заголовок)
+ * @return количество значимых битов потока; больше size * 8 - поток длиннее
+ *         данных, и кодирование прервано
+ *
+ * Частоты заранее не считаются: дерево перестраивается после каждого символа,
+ * а декодер повторяет те же перестроения. Таблица кодов в заголовок не пишется.
+ * Поток, переросший исходные данные, все равно не будет записан, поэтому
+ * буфер не растет, а кодирование останавливается.
+ */
+static uint64_t encodeAdaptive(const unsigned char* data, size_t size, EncodedBlock* block,
+                               size_t offset) {
+    AdaptiveTree tree;
+    adaptiveInit(&tree);
+
+    BitWriter writer = {block->data + offset, 0, 0, 0};
+
+    for (size_t i = 0; i < size; i++) {
+        if (writer.pos > size) {                     // Код символа с NYT - не больше 48 бит: слово влезает в запас
+            break;
+        }
+        Node* leaf = tree.leaves[data[i]];
+        uint64_t code;
+        int length;
+        if (leaf != NULL) {
+            length = adaptiveCode(leaf, &code);      // Лист не корень: length >= 1
+        } else {
+            length = adaptiveCode(tree.nyt, &code) + BYTE_SIZE;
+            code = (code << BYTE_SIZE) | data[i];    // За кодом NYT - сам символ
+            leaf = adaptiveAddSymbol(&tree, data[i]);
+        }
+        putBits(&writer, code << (64 - length), length);
+        flushBits(&writer);
+        adaptiveUpdate(&tree, leaf);
+    }
+
+    uint64_t bit_count = (uint64_t)writer.pos * BYTE_SIZE + (uint64_t)writer.count;
+    if (writer.count > 0) {
+        writer.buffer[writer.pos++] = (unsigned char)(writer.bits >> 56);
+    }
+    return bit_count;
+}
+
+/**
+ * Функция decodeAdaptive - восстанавливает блок, сжатый encodeAdaptive
+ * @param payload - битовый поток блока
+ * @param payload_size - размер потока в байтах
+ * @param bit_count - количество значимых битов потока
+ * @param output - буфер на size байт
+ * @param size - размер исходных данных блока
+ * @return 1 если восстановлено ровно size символов и поток исчерпан, иначе 0
+ */
+static int decodeAdaptive(const unsigned char* payload, size_t payload_size, uint64_t bit_count,
+                          unsigned char* output, size_t size) {
+    AdaptiveTree tree;
+    adaptiveInit(&tree);
+    BitReader reader = {payload, 0, payload_size, 0, 0};
+    uint64_t remaining = bit_count;
+
+    for (size_t i = 0; i < size; i++) {
+        refillBitReader(&reader);
+        Node* node = tree.order[ADAPTIVE_MAX_NODES - 1];  // Корень
+        int used = 0;
+        while (node->left != NULL && used < 48) {    // Спуск по битам пути до листа
+            node = (reader.bits << used) >> 63 ? node->right : node->left;
+            used++;
+        }
+        if (node->left != NULL) {
+            return 0;                                // Слишком длинный путь - поток поврежден
+        }
+
+        unsigned char symbol = node->symbol;
+        if (node == tree.nyt) {
+            symbol = (unsigned char)((reader.bits << used) >> 56);
+            used += BYTE_SIZE;
+            if (tree.leaves[symbol] != NULL) {
+                return 0;                            // Повторная передача символа - поток поврежден
+            }
+            node = adaptiveAddSymbol(&tree, symbol);
+        }
+        if (used > reader.count || (uint64_t)used > remaining) {
+            return 0;                                // Поток закончился раньше данных
+        }
+        reader.bits <<= used;
+        reader.count -= used;
+        remaining -= used;
+
+        output[i] = symbol;
+        adaptiveUpdate(&tree, node);
+    }
+    return remaining == 0;
+}
+
+// ---------- Контекст первого порядка (order-1) ----------
+
+/**
+ * Функция clusterCost - цена кластера контекстов в битах
+ * @param arena - арена построения кодов
+ * @param hist - гистограмма кластера
+ * @param max_length - ограничение длины кода
+ * @return размер потока кластера плюс размер его таблицы длин в заголовке
+ */
+static uint64_t clusterCost(HuffmanArena* arena, const unsigned int hist[], int max_length) {
+    Code codes[ASCII_SIZE];
+    buildCodeLengths(arena, hist, max_length, codes);
+    return encodedBitCount(hist, codes) + ORDER1_TABLE_BYTES * BYTE_SIZE;
+}
+
+/**
+ * Функция mergeDelta - изменение общей цены при слиянии двух кластеров
+ * @param model - рабочая память order-1
+ * @param a - первый кластер
+ * @param b - второй кластер
+ * @param max_length - ограничение длины кода
+ * @return цена объединенного кластера минус цены исходных (меньше 0 - слияние выгодно)
+ */
+static int64_t mergeDelta(Order1Model* model, int a, int b, int max_length) {
+    unsigned int merged[ASCII_SIZE];
+    for (int s = 0; s < ASCII_SIZE; s++) {
+        merged[s] = model->hist[a][s] + model->hist[b][s];
+    }
+    return (int64_t)clusterCost(&model->arena, merged, max_length) -
+           (int64_t)model->cost[a] - (int64_t)model->cost[b];
+}
+
+/**
+ * Функция buildOrder1Contexts - разбивает предыдущие байты на контексты
+ * @param model - рабочая память order-1
+ * @param data - исходные данные блока
+ * @param size - размер блока
+ * @param max_length - ограничение длины кода
+ * @param context_map - сюда записывается номер таблицы для каждого предыдущего байта
+ * @return количество таблиц (их гистограммы - в model->hist[0..count-1])
+ *
+ * Считаются частоты пар (предыдущий байт, текущий); перед первым байтом
+ * блока предыдущим считается 0. Самые частые ORDER1_CANDIDATES предыдущих
+ * байтов получают свой кластер, остальные - один общий. Затем жадно
+ * сливается пара кластеров с наименьшим ростом цены (поток плюс таблица
+ * в заголовке), пока кластеров больше ORDER1_MAX_TABLES или пока
+ * слияние уменьшает цену.
+ */
+static int buildOrder1Contexts(Order1Model* model, const unsigned char* data, size_t size,
+                               int max_length, unsigned char context_map[]) {
+    memset(model->pairs, 0, sizeof(model->pairs));
+    unsigned char previous = 0;
+    for (size_t i = 0; i < size; i++) {
+        model->pairs[previous][data[i]]++;
+        previous = data[i];
+    }
+
+    unsigned int rows[ASCII_SIZE];                   // Сколько раз байт был предыдущим
+    for (int p = 0; p < ASCII_SIZE; p++) {
+        rows[p] = 0;
+        for (int s = 0; s < ASCII_SIZE; s++) {
+            rows[p] += model->pairs[p][s];
+        }
+    }
+
+    // Начальные кластеры: самые частые предыдущие байты (выбором) и общий для остальных
+    int cluster_of[ASCII_SIZE];
+    for (int p = 0; p < ASCII_SIZE; p++) {
+        cluster_of[p] = -1;
+    }
+    int clusters = 0;
+    for (; clusters < ORDER1_CANDIDATES; clusters++) {
+        int best = -1;
+        for (int p = 0; p < ASCII_SIZE; p++) {
+            if (cluster_of[p] < 0 && rows[p] > 0 && (best < 0 || rows[p] > rows[best])) {
+                best = p;
+            }
+        }
+        if (best < 0) {
+            break;
+        }
+        cluster_of[best] = clusters;
+        memcpy(model->hist[clusters], model->pairs[best], sizeof(model->hist[clusters]));
+    }
+    int rest = clusters;
+    memset(model->hist[rest], 0, sizeof(model->hist[rest]));
+    for (int p = 0; p < ASCII_SIZE; p++) {
+        if (cluster_of[p] < 0 && rows[p] > 0) {
+            cluster_of[p] = rest;
+            for (int s = 0; s < ASCII_SIZE; s++) {
+                model->hist[rest][s] += model->pairs[p][s];
+            }
+            clusters = rest + 1;
+        }
+    }
+
+    for (int c = 0; c < clusters; c++) {
+        model->alive[c] = 1;
+        model->cost[c] = clusterCost(&model->arena, model->hist[c], max_length);
+    }
+    for (int a = 0; a < clusters; a++) {
+        for (int b = a + 1; b < clusters; b++) {
+            model->delta[a][b] = mergeDelta(model, a, b, max_length);
+        }
+    }
+
+    // Жадное слияние кластеров
+    int alive = clusters;
+    while (alive > 1) {
+        int best_a = -1, best_b = -1;
+        for (int a = 0; a < clusters; a++) {
+            for (int b = a + 1; b < clusters && model->alive[a]; b++) {
+                if (model->alive[b] && (best_a < 0 || model->delta[a][b] < model->delta[best_a][best_b])) {
+                    best_a = a;
+                    best_b = b;
+                }
+            }
+        }
+        if (alive <= ORDER1_MAX_TABLES && model->delta[best_a][best_b] >= 0) {
+            break;
+        }
+        for (int s = 0; s < ASCII_SIZE; s++) {
+            model->hist[best_a][s] += model->hist[best_b][s];
+        }
+        model->cost[best_a] += model->cost[best_b] + model->delta[best_a][best_b];
+        model->alive[best_b] = 0;
+        alive--;
+        for (int p = 0; p < ASCII_SIZE; p++) {
+            if (cluster_of[p] == best_b) {
+                cluster_of[p] = best_a;
+            }
+        }
+        for (int c = 0; c < clusters; c++) {
+            if (model->alive[c] && c != best_a) {
+                int64_t delta = mergeDelta(model, best_a, c, max_length);
+                if (c < best_a) model->delta[c][best_a] = delta; else model->delta[best_a][c] = delta;
+            }
+        }
+    }
+
+    // Оставшиеся кластеры получают номера таблиц по порядку
+    int table_of[ORDER1_CANDIDATES + 1];
+    int tables = 0;
+    for (int c = 0; c < clusters; c++) {
+        if (model->alive[c]) {
+            if (tables != c) {
+                memcpy(model->hist[tables], model->hist[c], sizeof(model->hist[tables]));
+            }
+            table_of[c] = tables++;
+        }
+    }
+    for (int p = 0; p < ASCII_SIZE; p++) {
+        context_map[p] = (unsigned char)(cluster_of[p] >= 0 ? table_of[cluster_of[p]] : 0);
+    }
+    return tables;
+}
+
+/**
+ * Функция encodeOrder1 - сжимает блок кодами, выбираемыми по предыдущему байту
+ * @param data - исходные данные блока (не пустые)
+ * @param size - размер блока
+ * @param options - ограничение длины кода (не больше ORDER1_MAX_CODE_LENGTH)
+ * @param model - рабочая память order-1 (переиспользуется между блоками)
+ * @param block - буфер для результата (не меньше blockBound(size) байт)
+ * @return 1 если блок записан, 0 если с таблицами он не короче исходных данных
+ *
+ * Формат таблицы в заголовке описан у BlockHeader. Коды трех символов
+ * (до 3 * 15 бит) помещаются в аккумулятор за один сброс. Размер потока
+ * известен до кодирования, поэтому невыгодный блок не кодируется.
+ */
+static int encodeOrder1(const unsigned char* data, size_t size, const CodecOptions* options,
+                        Order1Model* model, EncodedBlock* block) {
+    int max_length = options->max_code_length < ORDER1_MAX_CODE_LENGTH ?
+                     options->max_code_length : ORDER1_MAX_CODE_LENGTH;
+    unsigned char context_map[ASCII_SIZE];
+    ProfileSample sample;
+    PROFILE_BEGIN(sample);                           // Подсчет пар и слияние кластеров - построение кодов
+    int tables = buildOrder1Contexts(model, data, size, max_length, context_map);
+
+    uint64_t aligned[ORDER1_MAX_TABLES][ASCII_SIZE];  // Коды, выровненные по старшему разряду
+    unsigned char lengths[ORDER1_MAX_TABLES][ASCII_SIZE];
+    uint64_t bit_count = 0;
+    for (int t = 0; t < tables; t++) {
+        Code codes[ASCII_SIZE];
+        buildCodeLengths(&model->arena, model->hist[t], max_length, codes);
+        assignCanonicalCodes(codes);
+        bit_count += encodedBitCount(model->hist[t], codes);
+        for (int s = 0; s < ASCII_SIZE; s++) {
+            lengths[t][s] = (unsigned char)codes[s].length;
+            aligned[t][s] = codes[s].length > 0 ? codes[s].value << (64 - codes[s].length) : 0;
+        }
+    }
+    PROFILE_END(PROFILE_BUILD, sample, size, 0);
+
+    size_t header_size = BLOCK_PREFIX_SIZE + blockTableSize(BLOCK_MODE_ORDER1, (unsigned char)tables);
+    if (header_size + (bit_count + 7) / 8 >= BLOCK_PREFIX_SIZE + (uint64_t)size) {
+        return 0;                                    // Дешевле хранить блок без сжатия
+    }
+    storeBlockPrefix(block->data, data, size, bit_count, BLOCK_MODE_ORDER1);
+    unsigned char* table = block->data + BLOCK_PREFIX_SIZE;
+    table[0] = (unsigned char)tables;
+    packNibbles(context_map, table + 1);
+    for (int t = 0; t < tables; t++) {
+        packNibbles(lengths[t], table + 1 + ORDER1_TABLE_BYTES * (t + 1));
+    }
+
+    PROFILE_BEGIN(sample);
+    BitWriter writer = {block->data + header_size, 0, 0, 0};
+    unsigned char previous = 0;
+    size_t i = 0;
+    for (; i + 3 <= size; i += 3) {                  // 7 + 3 * 15 <= 64: три кода на сброс
+        int t0 = context_map[previous];
+        int t1 = context_map[data[i]];
+        int t2 = context_map[data[i + 1]];
+        putBits(&writer, aligned[t0][data[i]], lengths[t0][data[i]]);
+        putBits(&writer, aligned[t1][data[i + 1]], lengths[t1][data[i + 1]]);
+        putBits(&writer, aligned[t2][data[i + 2]], lengths[t2][data[i + 2]]);
+        flushBits(&writer);
+        previous = data[i + 2];
+    }
+    for (; i < size; i++) {
+        int t = context_map[previous];
+        putBits(&writer, aligned[t][data[i]], lengths[t][data[i]]);
+        flushBits(&writer);
+        previous = data[i];
+    }
+    if (writer.count > 0) {
+        writer.buffer[writer.pos++] = (unsigned char)(writer.bits >> 56);
+    }
+    PROFILE_END(PROFILE_ENCODE, sample, size, writer.pos);
+    block->size = header_size + writer.pos;
+    return 1;
+}
+
+/**
+ * Функция decodeOrder1 - восстанавливает блок, сжатый encodeOrder1
+ * @param header - заголовок блока с таблицами контекстов
+ * @param payload - битовый поток блока
+ * @param payload_size - размер потока в байтах
+ * @param output - буфер на header->raw_size байт
+ * @param tables - ORDER1_MAX_TABLES таблиц декодирования (перестраиваются)
+ * @return HUFFMAN_OK, HUFFMAN_ERROR_CORRUPT, если поток не дает ровно raw_size
+ *         символов, или HUFFMAN_ERROR_MEMORY
+ *
+ * Для каждой таблицы строится обычная таблица декодирования и по ее
+ * первичному уровню - таблица chained, в элементе которой уже записан номер
+ * таблицы для следующего символа. Так смена контекста не требует
+ * обращения к context_map. Основной цикл декодирует три символа на одно
+ * пополнение буфера (3 * ORDER1_MAX_CODE_LENGTH <= 56), длинные коды
+ * разбираются обычной таблицей, хвост блока - осторожным циклом с
+ * проверкой каждого символа.
+ */
+static int decodeOrder1(const BlockHeader* header, const unsigned char* payload, size_t payload_size,
+                        unsigned char* output, DecodeTable tables[]) {
+    const uint16_t* chained[ORDER1_MAX_TABLES];
+    for (int t = 0; t < header->table_count; t++) {
+        Code codes[ASCII_SIZE];
+        for (int s = 0; s < ASCII_SIZE; s++) {
+            codes[s].value = 0;
+            codes[s].length = header->context_lengths[t][s];
+        }
+        assignCanonicalCodes(codes);
+        if (!rebuildDecodeTable(&tables[t], codes)) {
+            return HUFFMAN_ERROR_MEMORY;
+        }
+
+        if (tables[t].chained == NULL) {
+            tables[t].chained = (uint16_t*)malloc((1 << DECODE_TABLE_BITS) * sizeof(uint16_t));
+            if (tables[t].chained == NULL) {
+                return HUFFMAN_ERROR_MEMORY;
+            }
+        }
+        for (int k = 0; k < (1 << DECODE_TABLE_BITS); k++) {
+            uint32_t entry = tables[t].entries[k];
+            uint16_t fast = 0;                       // Длинный или недопустимый код
+            if (DT_COUNT(entry) != 0) {
+                unsigned char symbol = DT_SYMBOL1(entry);
+                fast = (uint16_t)(symbol | (tables[t].lengths[symbol] << 8) |
+                                  (header->context_map[symbol] << 12));
+            }
+            tables[t].chained[k] = fast;
+        }
+        chained[t] = tables[t].chained;
+    }
+
+    BitReader reader = {payload, 0, payload_size, 0, 0};
+    uint64_t remaining = header->bit_count;
+    int current = header->context_map[0];            // Таблица для первого символа (предыдущий байт 0)
+    uint32_t i = 0;
+    int ok = 1;
+
+    // Быстрый цикл: хватает битов потока, байтов буфера и места в выходе на три символа
+    while (ok && header->raw_size - i >= 3 && remaining >= 3 * ORDER1_MAX_CODE_LENGTH &&
+           reader.end - reader.pos >= 8) {
+        refillBitReader(&reader);                    // Теперь в буфере не меньше 56 битов
+        for (int k = 0; k < 3; k++) {
+            uint16_t fast = chained[current][reader.bits >> (64 - DECODE_TABLE_BITS)];
+            int used = CT_LENGTH(fast);
+            unsigned char symbol = CT_SYMBOL(fast);
+            if (used != 0) {
+                current = CT_NEXT(fast);
+            } else {
+                unsigned char symbols[2];
+                int produced = 0;
+                used = decodeSymbols(&tables[current], reader.bits, symbols, &produced);
+                if (used == 0) {
+                    ok = 0;                          // Недопустимый код
+                    break;
+                }
+                symbol = symbols[0];
+                used = tables[current].lengths[symbol];
+                current = header->context_map[symbol];
+            }
+            reader.bits <<= used;
+            reader.count -= used;
+            remaining -= used;
+            output[i++] = symbol;
+        }
+    }
+
+    for (; ok && i < header->raw_size; i++) {
+        if (reader.count < ORDER1_MAX_CODE_LENGTH) {
+            refillBitReader(&reader);
+        }
+        const DecodeTable* table = &tables[current];
+        unsigned char symbols[2];
+        int produced = 0;
+        int used = decodeSymbols(table, reader.bits, symbols, &produced);
+        if (produced == 2) {
+            used = table->lengths[symbols[0]];       // Второй символ пары - из другого контекста
+        }
+        if (used == 0 || used > reader.count || (uint64_t)used > remaining) {
+            ok = 0;                                  // Недопустимый код или поток закончился раньше
+            break;
+        }
+        reader.bits <<= used;
+        reader.count -= used;
+        remaining -= used;
+        output[i] = symbols[0];
+        current = header->context_map[symbols[0]];
+    }
+    return ok && remaining == 0 ? HUFFMAN_OK : HUFFMAN_ERROR_CORRUPT;
+}
+
+// ---------- Обученные словари ----------
+
+/**
+ * Функция prepareDictionary - строит итоговые коды и таблицу декодирования словаря
+ * @param dictionary - словарь с заполненными escape и lengths
+ * @return 1 при успехе, 0 - не хватило памяти для таблицы декодирования
+ *
+ * Канонические коды назначаются по длинам из словаря. Байт без своего кода
+ * (и сам escape-символ) получает код escape-символа, дополненный 8 битами
+ * байта: такие коды не пересекаются со своими кодами словаря, поэтому
+ * вместе они образуют префиксный код, и таблица декодирования строится
+ * обычной функцией buildDecodeTable.
+ */
+static int prepareDictionary(Dictionary* dictionary) {
+    Code codes[ASCII_SIZE];
+    for (int i = 0; i < ASCII_SIZE; i++) {
+        codes[i].value = 0;
+        codes[i].length = dictionary->lengths[i];
+    }
+    assignCanonicalCodes(codes);
+
+    Code expanded[ASCII_SIZE];                       // Итоговые коды байтов
+    dictionary->max_length = 0;
+    for (int i = 0; i < ASCII_SIZE; i++) {
+        if (codes[i].length > 0 && i != dictionary->escape) {
+            expanded[i].value = codes[i].value;
+            expanded[i].length = codes[i].length;
+        } else {
+            const Code* escape = &codes[dictionary->escape];
+            expanded[i].value = (escape->value << BYTE_SIZE) | (uint64_t)i;
+            expanded[i].length = escape->length + BYTE_SIZE;
+        }
+        dictionary->code_lengths[i] = expanded[i].length;
+        dictionary->aligned[i] = expanded[i].value << (64 - expanded[i].length);
+        if (expanded[i].length > dictionary->max_length) {
+            dictionary->max_length = expanded[i].length;
+        }
+    }
+    return buildDecodeTable(&dictionary->table, expanded);
+}
+
+/**
+ * Функция freeDictionary - освобождает таблицу декодирования словаря
+ * @param dictionary - словарь
+ */
+static void freeDictionary(Dictionary* dictionary) {
+    freeDecodeTable(&dictionary->table);
+}
+
+/**
+ * Функция parseDictionary - разбирает и проверяет словарь в памяти
+ * @param buffer - содержимое словаря
+ * @param size - размер содержимого
+ * @param dictionary - структура для заполнения (освобождается freeDictionary)
+ * @return HUFFMAN_OK, HUFFMAN_ERROR_PARAMS, если данные не являются корректным
+ *         словарем, или HUFFMAN_ERROR_MEMORY
+ *
+ * Длины кодов должны образовывать полный префиксный код. Без escape-кода
+ * свой код нужен каждому байту, с ним итоговые коды не должны быть
+ * длиннее DECODE_MAX_CODE_LENGTH.
+ */
+static int parseDictionary(const unsigned char* buffer, size_t size, Dictionary* dictionary) {
+    if (size != DICTIONARY_FILE_SIZE || memcmp(buffer, DICTIONARY_MAGIC, 4) != 0 ||
+        buffer[4] != DICTIONARY_VERSION) {
+        return HUFFMAN_ERROR_PARAMS;
+    }
+    dictionary->escape = (buffer[5] & DICTIONARY_FLAG_ESCAPE) ? buffer[6] : -1;
+    memcpy(dictionary->lengths, buffer + 7, ASCII_SIZE);
+
+    int valid = validateCodeLengths(dictionary->lengths);
+    for (int i = 0; i < ASCII_SIZE && valid; i++) {
+        if (dictionary->lengths[i] == 0) {
+            valid = dictionary->escape >= 0;         // Без escape-кода байт нечем закодировать
+        }
+    }
+    if (dictionary->escape >= 0) {
+        int escape_length = dictionary->lengths[dictionary->escape];
+        valid &= escape_length > 0 && escape_length + BYTE_SIZE <= DECODE_MAX_CODE_LENGTH;
+    }
+    if (!valid) {
+        return HUFFMAN_ERROR_PARAMS;
+    }
+
+    dictionary->id = crc32Update(0, buffer, size);
+    if (!prepareDictionary(dictionary)) {
+        freeDictionary(dictionary);
+        return HUFFMAN_ERROR_MEMORY;
+    }
+    return HUFFMAN_OK;
+}
+
+/**
+ * Функция trainDictionary - строит словарь по суммарным частотам байтов образцов
+ * @param totals - частоты байтов всех образцов
+ * @param max_code_length - ограничение длины кода словаря
+ * @param buffer - куда записать словарь (DICTIONARY_FILE_SIZE байт)
+ * @param stats - сюда записываются сведения о словаре (NULL - не нужны)
+ * @return HUFFMAN_OK, HUFFMAN_ERROR_PARAMS (образцы пусты) или HUFFMAN_ERROR_MEMORY
+ *
+ * По частотам строятся коды, как для одного большого блока. Если какие-то
+ * байты в образцах не встречаются, наименьший из них становится
+ * escape-символом. Его частота - количество байтов, встреченных ровно
+ * один раз (оценка Гуда-Тьюринга вероятности увидеть новый байт), но не
+ * меньше 1.
+ */
+static int trainDictionary(const uint64_t totals_in[], int max_code_length, unsigned char buffer[],
+                           HuffmanDictionaryStats* stats) {
+    uint64_t totals[ASCII_SIZE];
+    uint64_t total = 0;
+    for (int s = 0; s < ASCII_SIZE; s++) {
+        totals[s] = totals_in[s];
+        total += totals[s];
+    }
+    if (total == 0) {
+        return HUFFMAN_ERROR_PARAMS;
+    }
+
+    int escape = -1;
+    uint64_t singletons = 0;                         // Байты, встреченные ровно один раз
+    int distinct = 0;
+    for (int s = 0; s < ASCII_SIZE; s++) {
+        if (totals[s] == 0 && escape < 0) {
+            escape = s;
+        }
+        singletons += totals[s] == 1;
+        distinct += totals[s] > 0;
+    }
+    if (escape >= 0) {
+        totals[escape] = singletons > 0 ? singletons : 1;
+        if (max_code_length + BYTE_SIZE > DECODE_MAX_CODE_LENGTH) {
+            max_code_length = DECODE_MAX_CODE_LENGTH - BYTE_SIZE;  // Место для 8 бит после escape-кода
+        }
+    }
+
+    // Частоты приводятся к unsigned int, ненулевые остаются ненулевыми
+    unsigned int frequencies[ASCII_SIZE];
+    int shift = 0;
+    while ((total >> shift) > UINT32_MAX / 2) {
+        shift++;
+    }
+    for (int s = 0; s < ASCII_SIZE; s++) {
+        frequencies[s] = totals[s] == 0 ? 0 :
+                         (unsigned int)((totals[s] >> shift) > 0 ? totals[s] >> shift : 1);
+    }
+
+    HuffmanArena arena;
+    Code codes[ASCII_SIZE];
+    buildCodeLengths(&arena, frequencies, max_code_length, codes);
+
+    memcpy(buffer, DICTIONARY_MAGIC, 4);
+    buffer[4] = DICTIONARY_VERSION;
+    buffer[5] = escape >= 0 ? DICTIONARY_FLAG_ESCAPE : 0;
+    buffer[6] = (unsigned char)(escape >= 0 ? escape : 0);
+    for (int s = 0; s < ASCII_SIZE; s++) {
+        buffer[7 + s] = (unsigned char)codes[s].length;
+    }
+
+    Dictionary dictionary;                           // Средняя длина итоговых кодов на образцах
+    int status = parseDictionary(buffer, DICTIONARY_FILE_SIZE, &dictionary);
+    if (status != HUFFMAN_OK) {
+        return status;
+    }
+    double bits = 0;
+    for (int s = 0; s < ASCII_SIZE; s++) {
+        if (s != escape) {
+            bits += (double)totals[s] * dictionary.code_lengths[s];
+        }
+    }
+    freeDictionary(&dictionary);
+
+    if (stats != NULL) {
+        stats->id = dictionary.id;
+        stats->escape = escape;
+        stats->distinct = distinct;
+        stats->bits_per_byte = bits / (double)total;
+    }
+    return HUFFMAN_OK;
+}
+
+/**
+ * Функция encodeDictionary - сжимает блок кодами словаря
+ * @param data - исходные данные блока
+ * @param size - размер блока в байтах
+ * @param frequencies - частоты символов блока
+ * @param dictionary - словарь
+ * @param block - буфер для результата (не меньше blockBound(size) байт)
+ * @return количество значимых битов потока; больше size * 8 - блок не записан
+ *
+ * Коды не строятся: заголовок блока содержит только идентификатор словаря,
+ * а поток сразу пишется готовыми кодами. Поэтому маленький блок не тратит
+ * 256 байт на таблицу и время на дерево. Длина потока известна по частотам
+ * заранее, и поток длиннее данных не кодируется.
+ */
+static uint64_t encodeDictionary(const unsigned char* data, size_t size, const unsigned int frequencies[],
+                                 const Dictionary* dictionary, EncodedBlock* block) {
+    uint64_t expected_bits = 0;
+    for (int i = 0; i < ASCII_SIZE; i++) {
+        expected_bits += (uint64_t)frequencies[i] * (uint64_t)dictionary->code_lengths[i];
+    }
+    if (expected_bits > (uint64_t)size * BYTE_SIZE) {
+        return expected_bits;                        // Данные не похожи на образцы словаря
+    }
+    size_t header_size = BLOCK_PREFIX_SIZE + DICTIONARY_ID_SIZE;
+    storeLittleEndian(block->data + BLOCK_PREFIX_SIZE, dictionary->id, 4);
+
+    ProfileSample sample;
+    PROFILE_BEGIN(sample);
+    BitWriter writer = {block->data + header_size, 0, 0, 0};
+    encodeBuffer(&writer, data, size, dictionary->aligned, dictionary->code_lengths,
+                 dictionary->max_length);
+    uint64_t bit_count = (uint64_t)writer.pos * BYTE_SIZE + (uint64_t)writer.count;
+    if (writer.count > 0) {
+        writer.buffer[writer.pos++] = (unsigned char)(writer.bits >> 56);
+    }
+    PROFILE_END(PROFILE_ENCODE, sample, size, writer.pos);
+    block->size = header_size + writer.pos;
+    return bit_count;
+}
+
+// ---------- Блоки из нескольких потоков ----------
+
+/**
+ * Функция streamCount - количество потоков для статического блока
+ * @param size - размер блока в байтах
+ * @param streams - запрошенное количество потоков (options->streams)
+ * @return от 1 до streams: на каждый поток приходится не меньше INTERLEAVED_MIN_STREAM_SIZE байт
+ */
+static int streamCount(size_t size, int streams) {
+    size_t fit = size / INTERLEAVED_MIN_STREAM_SIZE;
+    if ((size_t)streams > fit) {
+        streams = (int)fit;
+    }
+    return streams > 1 ? streams : 1;
+}
+
+/**
+ * Функция encodeStreams - кодирует блок несколькими независимыми битовыми потоками
+ * @param buffer - куда записать поток блока (с запасом на таблицу переходов, дополнение потоков и 8 байт)
+ * @param data - исходные данные блока
+ * @param size - размер блока в байтах
+ * @param streams - количество потоков (от 1 до INTERLEAVED_MAX_STREAMS)
+ * @param aligned - коды символов, выровненные по старшему разряду
+ * @param lengths - длины кодов символов
+ * @param max_length - максимальная длина кода
+ * @return количество значимых битов потока блока
+ *
+ * Блок делится на streams частей по ceil(size / streams) байт (последняя
+ * короче), и каждая часть кодируется своим потоком, дополненным до целого
+ * байта. Перед потоками записываются их количество и таблица переходов -
+ * количества битов всех потоков, кроме последнего: по ней декодер сразу
+ * находит начало каждого потока и ведет их одновременно (см. decodeStreams).
+ */
+static uint64_t encodeStreams(unsigned char* buffer, const unsigned char* data, size_t size, int streams,
+                              const uint64_t aligned[], const int lengths[], int max_length) {
+    size_t part = (size + streams - 1) / streams;
+    size_t pos = 1 + 4 * (size_t)(streams - 1);      // Поток начинается за таблицей переходов
+    uint64_t last_bits = 0;
+    buffer[0] = (unsigned char)streams;
+    for (int k = 0; k < streams; k++) {
+        size_t start = (size_t)k * part < size ? (size_t)k * part : size;
+        size_t end = size - start < part ? size : start + part;
+        BitWriter writer = {buffer + pos, 0, 0, 0};
+        encodeBuffer(&writer, data + start, end - start, aligned, lengths, max_length);
+        uint64_t bits = (uint64_t)writer.pos * BYTE_SIZE + (uint64_t)writer.count;
+        if (writer.count > 0) {
+            writer.buffer[writer.pos++] = (unsigned char)(writer.bits >> 56);
+        }
+        if (k + 1 < streams) {
+            storeLittleEndian(buffer + 1 + 4 * k, bits, 4);
+            pos += writer.pos;
+        } else {
+            last_bits = bits;
+        }
+    }
+    return (uint64_t)pos * BYTE_SIZE + last_bits;
+}
+
+// ---------- Кэш таблиц кодов ----------
+
+/**
+ * Функция log2Fixed - двоичный логарифм целого числа с 8 дробными битами
+ * @param value - число (не меньше 1)
+ * @return log2(value) * 256, округленный вниз
+ *
+ * Целая часть - номер старшего единичного бита, дробные биты получаются
+ * последовательным возведением мантиссы в квадрат. Плавающая точка
+ * и libm не нужны.
+ */
+static uint32_t log2Fixed(uint64_t value) {
+    int integer = 0;
+    while ((value >> integer) > 1) {
+        integer++;
+    }
+    // Мантисса в [1, 2) с 31 дробным битом: ее квадрат помещается в 64 бита
+    uint64_t mantissa = integer >= 31 ? value >> (integer - 31) : value << (31 - integer);
+    uint32_t result = (uint32_t)integer << 8;
+    for (int bit = 7; bit >= 0; bit--) {
+        mantissa = (mantissa * mantissa) >> 31;
+        if (mantissa >= (2ull << 31)) {
+            mantissa >>= 1;
+            result |= 1u << bit;
+        }
+    }
+    return result;
+}
+
+/**
+ * Функция histogramSignature - сигнатура гистограммы и оценка размера блока со своей таблицей
+ * @param frequencies - частоты символов блока
+ * @param total - сумма частот
+ * @param entropy_bits - сюда записывается энтропия блока в битах (нижняя граница потока)
+ * @return сигнатура: хеш FNV-1a идеальных длин кодов, округленных до целых
+ *
+ * Почти одинаковые гистограммы дают одинаковые округленные длины, поэтому
+ * их сигнатуры совпадают, а порядок величины частот в сигнатуру не входит.
+ */
+static uint32_t histogramSignature(const unsigned int frequencies[], uint64_t total,
+                                   uint64_t* entropy_bits) {
+    uint32_t log_total = total > 0 ? log2Fixed(total) : 0;
+    uint32_t hash = 2166136261u;
+    uint64_t entropy = 0;                            // В 1/256 бита
+    for (int i = 0; i < ASCII_SIZE; i++) {
+        uint32_t level = 0;                          // 0 - символ не встречается
+        if (frequencies[i] > 0) {
+            uint32_t ideal = log_total - log2Fixed(frequencies[i]);
+            entropy += (uint64_t)frequencies[i] * ideal;
+            level = (ideal + 128) >> 8;
+            level = level < TABLE_CACHE_SIGNATURE_LEVELS ? level + 1 : TABLE_CACHE_SIGNATURE_LEVELS + 1;
+        }
+        hash = (hash ^ level) * 16777619u;
+    }
+    *entropy_bits = entropy >> 8;
+    return hash;
+}
+
+/**
+ * Функция tableCacheCost - размер потока блока с таблицей из кэша
+ * @param entry - таблица из кэша
+ * @param frequencies - частоты символов блока
+ * @return количество битов потока или UINT64_MAX, если в таблице нет кода для символа блока
+ */
+static uint64_t tableCacheCost(const TableCacheEntry* entry, const unsigned int frequencies[]) {
+    uint64_t bits = 0;
+    for (int i = 0; i < ASCII_SIZE; i++) {
+        if (frequencies[i] > 0) {
+            if (entry->codes[i].length == 0) {
+                return UINT64_MAX;
+            }
+            bits += (uint64_t)frequencies[i] * entry->codes[i].length;
+        }
+    }
+    return bits;
+}
+
+/**
+ * Функция initTableCache - подготавливает пустой кэш таблиц
+ * @param cache - кэш
+ * @param loss - допустимая потеря сжатия в процентах (options->table_cache)
+ */
+static void initTableCache(TableCache* cache, int loss) {
+    cache->count = 0;
+    cache->loss = loss;
+    cache->lookups = 0;
+    cache->hits = 0;
+    cache->signature_hits = 0;
+    cache->saved_bytes = 0;
+}
+
+/**
+ * Функция tableCacheLookup - ищет в кэше таблицу, подходящую для блока
+ * @param cache - кэш
+ * @param index - номер блока
+ * @param frequencies - частоты символов блока
+ * @param size - размер блока в байтах
+ * @param signature - сигнатура гистограммы блока (см. histogramSignature)
+ * @param entropy_bits - энтропия блока в битах
+ * @return таблица из кэша или NULL, если блоку нужна своя таблица
+ *
+ * Своя таблица оценивается энтропией блока и 256 байтами таблицы в
+ * заголовке, чужая - точным размером потока и байтом ссылки. Чужая
+ * годится, если она хуже не больше чем на cache->loss процентов и поток
+ * блока не длиннее его данных. Среди таблиц с той же сигнатурой берется
+ * первая подходящая, среди остальных - дающая самый короткий поток.
+ * Кэш очищается, когда блок index начинает новый сегмент.
+ */
+static const TableCacheEntry* tableCacheLookup(TableCache* cache, uint32_t index,
+                                               const unsigned int frequencies[], size_t size,
+                                               uint32_t signature, uint64_t entropy_bits) {
+    if (cache->count > 0 && (cache->entries[0].block / TABLE_CACHE_SEGMENT != index / TABLE_CACHE_SEGMENT ||
+                             cache->entries[cache->count - 1].block >= index)) {
+        cache->count = 0;
+    }
+    cache->lookups++;
+
+    uint64_t fresh_bits = entropy_bits + ASCII_SIZE * BYTE_SIZE;
+    uint64_t limit = fresh_bits * (100 + (uint64_t)cache->loss) / 100;
+    if (limit > (uint64_t)size * BYTE_SIZE + BYTE_SIZE) {
+        limit = (uint64_t)size * BYTE_SIZE + BYTE_SIZE;  // Поток не длиннее данных (см. encodeBlock)
+    }
+    limit -= BYTE_SIZE;                              // Байт ссылки в заголовке
+
+    const TableCacheEntry* best = NULL;
+    uint64_t best_bits = UINT64_MAX;
+    for (int pass = 0; pass < 2 && best == NULL; pass++) {
+        for (int e = cache->count - 1; e >= 0; e--) {    // Сначала самые свежие таблицы
+            const TableCacheEntry* entry = &cache->entries[e];
+            if ((entry->signature == signature) != (pass == 0)) {
+                continue;
+            }
+            uint64_t bits = tableCacheCost(entry, frequencies);
+            if (bits <= limit && bits < best_bits) {
+                best = entry;
+                best_bits = bits;
+                if (pass == 0) {
+                    break;
+                }
+            }
+        }
+        if (best != NULL && pass == 0) {
+            cache->signature_hits++;
+        }
+    }
+    if (best != NULL) {
+        cache->hits++;
+        cache->saved_bytes += ASCII_SIZE - 1;
+    }
+    return best;
+}
+
+/**
+ * Функция tableCacheInsert - добавляет в кэш таблицу, записанную в блоке index
+ * @param cache - кэш (после tableCacheLookup для этого же блока)
+ * @param index - номер блока
+ * @param signature - сигнатура гистограммы блока
+ * @param mode - режим блока (BLOCK_MODE_STATIC или BLOCK_MODE_INTERLEAVED)
+ * @param codes - канонические коды блока
+ */
+static void tableCacheInsert(TableCache* cache, uint32_t index, uint32_t signature, unsigned char mode,
+                             const Code codes[]) {
+    if (cache->count < TABLE_CACHE_SEGMENT) {        // В сегменте не больше TABLE_CACHE_SEGMENT таблиц
+        TableCacheEntry* entry = &cache->entries[cache->count++];
+        entry->block = index;
+        entry->signature = signature;
+        entry->mode = mode;
+        memcpy(entry->codes, codes, sizeof(entry->codes));
+    }
+}
+
+// ---------- Несжимаемые и однородные блоки ----------
+
+/**
+ * Функция storeRawBlock - записывает блок без сжатия (BLOCK_MODE_STORED)
+ * @param data - исходные данные блока
+ * @param size - размер блока в байтах
+ * @param block - буфер для результата
+ */
+static void storeRawBlock(const unsigned char* data, size_t size, EncodedBlock* block) {
+    memcpy(block->data + BLOCK_PREFIX_SIZE, data, size);
+    storeBlockPrefix(block->data, data, size, (uint64_t)size * BYTE_SIZE, BLOCK_MODE_STORED);
+    block->size = BLOCK_PREFIX_SIZE + size;
+}
+
+/**
+ * Функция estimateRuns - оценивает количество серий одинаковых байт в блоке
+ * @param data - исходные данные блока
+ * @param size - размер блока в байтах
+ * @return оценка количества серий
+ *
+ * Проверяются RUN_SAMPLES пар соседних байт, равномерно разнесенных по
+ * блоку: доля пар, на которых серия кончается, равна доле серий среди
+ * всех байтов. Шаг нечетный, чтобы выборка не совпадала с периодом данных
+ * вроде таблиц из 2, 4 или 8-байтовых чисел.
+ */
+static uint64_t estimateRuns(const unsigned char* data, size_t size) {
+    if (size < 2) {
+        return size;
+    }
+    size_t pairs = size - 1;
+    size_t step = (pairs > RUN_SAMPLES ? pairs / RUN_SAMPLES : 1) | 1;
+    uint64_t samples = 0;
+    uint64_t breaks = 0;                             // Пары на границе серий
+    for (size_t i = 0; i < pairs; i += step) {
+        breaks += data[i] != data[i + 1];
+        samples++;
+    }
+    return 1 + breaks * pairs / samples;
+}
+
+/**
+ * Функция encodeRuns - кодирует блок сериями одинаковых байт (BLOCK_MODE_RUNS)
+ * @param data - исходные данные блока (не пустые)
+ * @param size - размер блока в байтах
+ * @param limit - наибольший допустимый размер потока в байтах
+ * @param block - буфер для результата
+ * @return 1 если блок записан, 0 если серии заняли бы больше limit байт
+ *
+ * Серия записывается байтом символа и длиной без единицы в LEB128
+ * (по 7 бит, начиная с младших; старший бит байта - признак продолжения).
+ * Кодирование прерывается, как только поток превысил limit, поэтому
+ * неудачная попытка не проходит весь блок.
+ */
+static int encodeRuns(const unsigned char* data, size_t size, size_t limit, EncodedBlock* block) {
+    unsigned char* output = block->data + BLOCK_PREFIX_SIZE;
+    size_t pos = 0;
+    size_t i = 0;
+    while (i < size) {
+        if (pos > limit) {
+            return 0;
+        }
+        unsigned char symbol = data[i];
+        size_t end = i + 1;
+        while (end < size && data[end] == symbol) {
+            end++;
+        }
+        uint64_t rest = end - i - 1;                 // Длина серии без единицы
+        output[pos++] = symbol;
+        while (rest >= 0x80) {
+            output[pos++] = (unsigned char)(rest | 0x80);
+            rest >>= 7;
+        }
+        output[pos++] = (unsigned char)rest;
+        i = end;
+    }
+    if (pos > limit) {
+        return 0;
+    }
+    storeBlockPrefix(block->data, data, size, (uint64_t)pos * BYTE_SIZE, BLOCK_MODE_RUNS);
+    block->size = BLOCK_PREFIX_SIZE + pos;
+    return 1;
+}
+
+/**
+ * Функция packedWidth - ширина номера символа в блоке BLOCK_MODE_PACKED
+ * @param count - количество символов алфавита (от 2 до PACKED_MAX_SYMBOLS)
+ * @return наименьшее количество бит, в которое помещается номер count - 1
+ */
+static int packedWidth(int count) {
+    int width = 1;
+    while ((1 << width) < count) {
+        width++;
+    }
+    return width;
+}
+
+/**
+ * Функция packedBlockSize - размер блока BLOCK_MODE_PACKED без общей части заголовка
+ * @param frequencies - частоты символов блока
+ * @param size - размер блока в байтах
+ * @return байт таблицы и потока или UINT64_MAX, если символов меньше 2 или больше PACKED_MAX_SYMBOLS
+ */
+static uint64_t packedBlockSize(const unsigned int frequencies[], size_t size) {
+    int count = 0;
+    for (int i = 0; i < ASCII_SIZE; i++) {
+        count += frequencies[i] > 0;
+    }
+    if (count < 2 || count > PACKED_MAX_SYMBOLS) {
+        return UINT64_MAX;
+    }
+    return 1 + (uint64_t)count + ((uint64_t)size * packedWidth(count) + 7) / 8;
+}
+
+/**
+ * Функция encodePacked - кодирует блок малого алфавита номерами фиксированной ширины (BLOCK_MODE_PACKED)
+ * @param data - исходные данные блока
+ * @param size - размер блока в байтах
+ * @param frequencies - частоты символов блока (от 2 до PACKED_MAX_SYMBOLS ненулевых)
+ * @param block - буфер для результата
+ *
+ * Каждые 8 символов дают группу из w байт: номер символа j группы занимает
+ * биты j * w ... j * w + w - 1 (младший байт первым). Последняя неполная
+ * группа записывается только нужными байтами. Дерево и таблица из 256
+ * длин не нужны, а для двух символов или равномерного алфавита из 4 или
+ * 16 символов поток не длиннее, чем у кода Хаффмана.
+ */
+static void encodePacked(const unsigned char* data, size_t size, const unsigned int frequencies[],
+                         EncodedBlock* block) {
+    unsigned char index[ASCII_SIZE];                 // Номер символа в алфавите блока
+    unsigned char symbols[PACKED_MAX_SYMBOLS];
+    int count = 0;
+    for (int i = 0; i < ASCII_SIZE; i++) {
+        if (frequencies[i] > 0) {
+            index[i] = (unsigned char)count;
+            symbols[count++] = (unsigned char)i;
+        }
+    }
+    int width = packedWidth(count);
+    uint64_t bit_count = (uint64_t)size * width;
+    size_t header_size = BLOCK_PREFIX_SIZE + 1 + (size_t)count;
+    block->data[BLOCK_PREFIX_SIZE] = (unsigned char)count;
+    memcpy(block->data + BLOCK_PREFIX_SIZE + 1, symbols, (size_t)count);
+
+    ProfileSample sample;
+    PROFILE_BEGIN(sample);
+    unsigned char* output = block->data + header_size;
+    size_t pos = 0;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint32_t group = 0;
+        for (int j = 0; j < 8; j++) {
+            group |= (uint32_t)index[data[i + j]] << (j * width);
+        }
+        storeLittleEndian(output + pos, group, 4);
+        pos += (size_t)width;
+    }
+    if (i < size) {
+        uint32_t group = 0;
+        for (int j = 0; i + j < size; j++) {
+            group |= (uint32_t)index[data[i + j]] << (j * width);
+        }
+        storeLittleEndian(output + pos, group, 4);
+        pos += ((size - i) * width + 7) / 8;
+    }
+    PROFILE_END(PROFILE_ENCODE, sample, size, pos);
+    storeBlockPrefix(block->data, data, size, bit_count, BLOCK_MODE_PACKED);
+    block->size = header_size + pos;
+}
+
+/**
+ * Функция encodeSimpleBlock - записывает блок без кода Хаффмана, если код не окупится
+ * @param data - исходные данные блока
+ * @param size - размер блока в байтах
+ * @param options - режим блока
+ * @param frequencies - частоты символов блока
+ * @param cached_tables - 1 если статический блок может сослаться на таблицу из кэша
+ * @param entropy_bits - энтропия блока в битах (см. histogramSignature)
+ * @param block - буфер для результата
+ * @return 1 если блок записан в режиме BLOCK_MODE_STORED, BLOCK_MODE_RUNS или BLOCK_MODE_PACKED,
+ *         0 если его нужно кодировать в режиме options->mode
+ *
+ * Блок из одного символа сразу записывается одной серией. Энтропия -
+ * нижняя граница потока любого кода символов блока, а код Хаффмана
+ * тратит не меньше бита на символ. Если эта граница вместе с таблицей
+ * режима (и размер блока малого алфавита, см. packedBlockSize) обещает
+ * выигрыш меньше 1/STORED_MIN_GAIN размера, блок
+ * хранится как есть: на уже сжатых данных дерево не строится и биты не
+ * упаковываются. Если же по выборке (estimateRuns) серий одинаковых байт
+ * мало, блок пробно кодируется сериями и остается таким, когда серии
+ * короче той же границы. Блок из 2 - PACKED_MAX_SYMBOLS разных байт, чьи
+ * номера фиксированной ширины не длиннее этой границы, кодируется ими
+ * (см. encodePacked): так всегда бывает с двумя символами. Контекст
+ * первого порядка может обойти энтропию нулевого порядка, поэтому для
+ * него граница - только бит на символ, а для кода кодовых точек UTF-8 -
+ * бит на 4 байта (и таблица переменного размера).
+ */
+static int encodeSimpleBlock(const unsigned char* data, size_t size, const CodecOptions* options,
+                             const unsigned int frequencies[], int cached_tables, uint64_t entropy_bits,
+                             EncodedBlock* block) {
+    if (size == 0) {
+        return 0;
+    }
+    int order1 = options->mode == BLOCK_MODE_ORDER1;
+    int utf8 = options->mode == BLOCK_MODE_UTF8;
+    uint64_t table = 0;                              // Байт таблицы в заголовке блока
+    if (order1) {
+        table = 1 + 2 * ORDER1_TABLE_BYTES;          // Хотя бы карта контекстов и одна таблица
+    } else if (options->mode == BLOCK_MODE_DICTIONARY && options->dictionary != NULL) {
+        table = DICTIONARY_ID_SIZE;
+    } else if (options->mode != BLOCK_MODE_ADAPTIVE && !utf8) {
+        table = cached_tables ? 1 : ASCII_SIZE;
+    }
+    uint64_t bits = order1 || entropy_bits < size ? size : entropy_bits;
+    if (utf8) {
+        bits = size / 4;                             // Бит на символ из 1-4 байт
+    }
+    uint64_t bound = bits / BYTE_SIZE + table;       // Наименьший возможный размер потока и таблицы
+
+    int distinct = 0;
+    for (int i = 0; i < ASCII_SIZE; i++) {
+        distinct += frequencies[i] > 0;
+    }
+    if (distinct == 1 && encodeRuns(data, size, RUN_MAX_BYTES, block)) {
+        return 1;                                    // Один символ: весь блок - одна серия
+    }
+    uint64_t packed = packedBlockSize(frequencies, size);
+    uint64_t limit = packed < bound ? packed : bound;
+    if (!order1 && limit + size / STORED_MIN_GAIN >= size) {
+        storeRawBlock(data, size, block);
+        return 1;
+    }
+    if (estimateRuns(data, size) * 2 < limit && encodeRuns(data, size, (size_t)limit, block)) {
+        return 1;                                    // Серия занимает хотя бы 2 байта
+    }
+    if (packed <= bound) {
+        encodePacked(data, size, frequencies, block);
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * Функция decodeRuns - восстанавливает блок BLOCK_MODE_RUNS
+ * @param header - заголовок блока
+ * @param payload - поток блока
+ * @param payload_size - размер потока в байтах
+ * @param output - буфер на header->raw_size байт
+ * @return 1 если восстановлено ровно raw_size байт и поток исчерпан, иначе 0
+ */
+static int decodeRuns(const BlockHeader* header, const unsigned char* payload, size_t payload_size,
+                      unsigned char* output) {
+    size_t bytes = header->bit_count / BYTE_SIZE;
+    if (header->bit_count % BYTE_SIZE != 0 || bytes > payload_size) {
+        return 0;
+    }
+    size_t pos = 0;
+    size_t produced = 0;
+    while (pos < bytes) {
+        unsigned char symbol = payload[pos++];
+        uint64_t rest = 0;
+        for (int shift = 0;; shift += 7) {
+            if (pos >= bytes || shift > 28) {
+                return 0;                            // Длина серии обрезана или слишком длинная
+            }
+            unsigned char byte = payload[pos++];
+            rest |= (uint64_t)(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                break;
+            }
+        }
+        if (rest >= header->raw_size - produced) {
+            return 0;
+        }
+        memset(output + produced, symbol, (size_t)rest + 1);
+        produced += (size_t)rest + 1;
+    }
+    return produced == header->raw_size;
+}
+
+/**
+ * Функция decodePacked - восстанавливает блок BLOCK_MODE_PACKED
+ * @param header - заголовок блока
+ * @param payload - поток блока
+ * @param payload_size - размер потока в байтах
+ * @param output - буфер на header->raw_size байт
+ * @return 1 если количество битов соответствует размеру блока, иначе 0
+ *
+ * Группа из 8 номеров читается одним словом. Номер за пределами алфавита
+ * возможен только в поврежденном потоке: он дает нулевой байт, и блок
+ * отвергает проверка контрольной суммы.
+ */
+static int decodePacked(const BlockHeader* header, const unsigned char* payload, size_t payload_size,
+                        unsigned char* output) {
+    int width = packedWidth(header->table_count);
+    uint64_t bit_count = (uint64_t)header->raw_size * width;
+    if (header->bit_count != bit_count || (bit_count + 7) / 8 > payload_size) {
+        return 0;
+    }
+    unsigned char symbols[PACKED_MAX_SYMBOLS] = {0};
+    memcpy(symbols, header->symbols, header->table_count);
+    uint32_t mask = (1u << width) - 1;
+    size_t size = header->raw_size;
+    size_t pos = 0;
+    size_t i = 0;
+    for (; i + 8 <= size && pos + 4 <= payload_size; i += 8) {
+        uint32_t group = (uint32_t)loadLittleEndian(payload + pos, 4);
+        for (int j = 0; j < 8; j++) {
+            output[i + j] = symbols[(group >> (j * width)) & mask];
+        }
+        pos += (size_t)width;
+    }
+    for (; i < size; i++) {                          // Хвост, до которого нельзя прочитать целое слово
+        uint64_t bit = (uint64_t)i * width;
+        unsigned int value = (payload[bit / 8] >> (bit % 8)) & mask;  // Ширина делит 8 или равна 3
+        if (bit % 8 + width > 8) {
+            value |= ((unsigned int)payload[bit / 8 + 1] << (8 - bit % 8)) & mask;
+        }
+        output[i] = symbols[value];
+    }
+    return 1;
+}
+
+// ---------- Символы UTF-8 ----------
+
+/**
+ * Функция utf8SequenceLength - длина последовательности UTF-8 по первому байту
+ * @param lead - первый байт
+ * @return 1-4 или 0, если байт не может начинать последовательность
+ */
+static inline int utf8SequenceLength(unsigned char lead) {
+    if (lead < 0x80) {
+        return 1;
+    }
+    if (lead >= 0xC2 && lead <= 0xDF) {
+        return 2;
+    }
+    if (lead >= 0xE0 && lead <= 0xEF) {
+        return 3;
+    }
+    return lead >= 0xF0 && lead <= 0xF4 ? 4 : 0;
+}
+
+/**
+ * Функция utf8Decode - разбирает одну последовательность UTF-8
+ * @param p - начало последовательности
+ * @param left - сколько байт доступно
+ * @param symbol - сюда записывается кодовая точка
+ * @return длина последовательности (1-4), 0 если она недопустима или обрезана
+ *
+ * Отвергаются лишние продолжения, слишком длинные записи, суррогаты
+ * и кодовые точки больше 0x10FFFF: у каждой кодовой точки ровно одна
+ * запись, поэтому блок восстанавливается байт в байт.
+ */
+static inline int utf8Decode(const unsigned char* p, size_t left, uint32_t* symbol) {
+    unsigned char lead = p[0];
+    int length = utf8SequenceLength(lead);
+    if (length == 1) {
+        *symbol = lead;
+        return 1;
+    }
+    if (length == 0 || (size_t)length > left) {
+        return 0;
+    }
+    uint32_t value = lead & (0x7F >> length);
+    for (int k = 1; k < length; k++) {
+        if ((p[k] & 0xC0) != 0x80) {
+            return 0;
+        }
+        value = (value << 6) | (p[k] & 0x3F);
+    }
+    if ((length == 3 && (value < 0x800 || (value >= 0xD800 && value <= 0xDFFF))) ||
+        (length == 4 && (value < 0x10000 || value > 0x10FFFF))) {
+        return 0;
+    }
+    *symbol = value;
+    return length;
+}
+
+/**
+ * Функция utf8Encode - записывает символ блока UTF-8 в виде байтов
+ * @param symbol - кодовая точка или UTF8_RAW_SYMBOL + байт
+ * @param bytes - сюда записываются байты (4 байта, лишние - нули)
+ * @return количество байт символа (1-4)
+ */
+static int utf8Encode(uint32_t symbol, unsigned char bytes[4]) {
+    memset(bytes, 0, 4);
+    if (symbol >= UTF8_RAW_SYMBOL) {
+        bytes[0] = (unsigned char)(symbol - UTF8_RAW_SYMBOL);
+        return 1;
+    }
+    if (symbol < 0x80) {
+        bytes[0] = (unsigned char)symbol;
+        return 1;
+    }
+    int length = symbol < 0x800 ? 2 : symbol < 0x10000 ? 3 : 4;
+    for (int k = length - 1; k > 0; k--) {
+        bytes[k] = (unsigned char)(0x80 | (symbol & 0x3F));
+        symbol >>= 6;
+    }
+    bytes[0] = (unsigned char)((0xFF00 >> length) | symbol);  // 110xxxxx, 1110xxxx или 11110xxx
+    return length;
+}
+
+/**
+ * Функция utf8Edges - находит обрывки последовательностей на краях блока
+ * @param data - данные блока
+ * @param size - размер блока
+ * @param begin - сюда записывается начало целых последовательностей
+ * @param end - сюда записывается их конец
+ *
+ * Граница блока может разрезать символ: до 3 байт продолжения в начале
+ * и начало последовательности, которой не хватает байт, в конце. Такие
+ * байты кодируются отдельными символами UTF8_RAW_SYMBOL + байт.
+ */
+static void utf8Edges(const unsigned char* data, size_t size, size_t* begin, size_t* end) {
+    size_t start = 0;
+    while (start < size && start < 3 && (data[start] & 0xC0) == 0x80) {
+        start++;
+    }
+    size_t stop = size;
+    for (size_t k = 1; k <= 3 && k <= size - start; k++) {
+        unsigned char byte = data[size - k];
+        if ((byte & 0xC0) == 0x80) {
+            continue;                                // Продолжение: ищем первый байт дальше
+        }
+        if ((size_t)utf8SequenceLength(byte) > k) {
+            stop = size - k;                         // Последовательность обрезана концом блока
+        }
+        break;
+    }
+    *begin = start;
+    *end = stop;
+}
+
+/**
+ * Функция utf8Find - номер символа в алфавите блока
+ * @param alphabet - алфавит
+ * @param symbol - символ
+ * @param insert - 1 - добавить символ, если его еще нет
+ * @return номер символа или UINT32_MAX, если его нет (или алфавит уже
+ *         содержит alphabet->limit символов)
+ *
+ * Кодовые точки до UTF8_DIRECT_SYMBOLS ищутся в плоском массиве, остальные -
+ * в хеш-таблице с открытой адресацией, которая удваивается при заполнении
+ * наполовину. Место под наибольшую таблицу уже выделено, поэтому
+ * удвоение - только перестановка занятых ячеек.
+ */
+static uint32_t utf8Find(Utf8Alphabet* alphabet, uint32_t symbol, int insert) {
+    if (symbol < UTF8_DIRECT_SYMBOLS && alphabet->direct[symbol] != 0) {
+        return alphabet->direct[symbol] - 1;
+    }
+    uint32_t mask = (1u << alphabet->hash_bits) - 1;
+    uint32_t slot = (symbol * 0x9E3779B1u) >> (32 - alphabet->hash_bits);
+    if (symbol >= UTF8_DIRECT_SYMBOLS) {
+        while (alphabet->keys[slot] != 0) {
+            if (alphabet->keys[slot] == symbol + 1) {
+                return alphabet->slots[slot];
+            }
+            slot = (slot + 1) & mask;
+        }
+    }
+    if (!insert || alphabet->count == alphabet->limit) {
+        return UINT32_MAX;
+    }
+
+    uint32_t index = alphabet->count++;
+    alphabet->symbols[index] = symbol;
+    alphabet->counts[index] = 0;
+    if (symbol < UTF8_DIRECT_SYMBOLS) {
+        alphabet->direct[symbol] = index + 1;
+        return index;
+    }
+    alphabet->keys[slot] = symbol + 1;
+    alphabet->slots[slot] = index;
+    if (++alphabet->hashed * 2 > mask + 1 && alphabet->hash_bits < UTF8_HASH_MAX_BITS) {
+        memset(alphabet->keys, 0, (mask + 1) * sizeof(uint32_t));  // Заполнена наполовину: удваиваем таблицу
+        alphabet->hash_bits++;
+        mask = (1u << alphabet->hash_bits) - 1;
+        for (uint32_t k = 0; k < alphabet->count; k++) {
+            uint32_t key = alphabet->symbols[k];
+            if (key < UTF8_DIRECT_SYMBOLS) {
+                continue;
+            }
+            uint32_t s = (key * 0x9E3779B1u) >> (32 - alphabet->hash_bits);
+            while (alphabet->keys[s] != 0) {
+                s = (s + 1) & mask;
+            }
+            alphabet->keys[s] = key + 1;
+            alphabet->slots[s] = k;
+        }
+    }
+    return index;
+}
+
+/**
+ * Функция resetUtf8Alphabet - очищает алфавит для следующего блока
+ * @param alphabet - алфавит (выделенный calloc или уже очищенный)
+ *
+ * Очищаются только занятые элементы: прямой массив - по символам блока,
+ * хеш-таблица - в пределах текущей разрядности.
+ */
+static void resetUtf8Alphabet(Utf8Alphabet* alphabet) {
+    for (uint32_t k = 0; k < alphabet->count; k++) {
+        if (alphabet->symbols[k] < UTF8_DIRECT_SYMBOLS) {
+            alphabet->direct[alphabet->symbols[k]] = 0;
+        }
+    }
+    if (alphabet->hashed > 0) {
+        memset(alphabet->keys, 0, ((size_t)1 << alphabet->hash_bits) * sizeof(uint32_t));
+    }
+    alphabet->hash_bits = UTF8_HASH_MIN_BITS;
+    alphabet->hashed = 0;
+    alphabet->count = 0;
+}
+
+/**
+ * Функция compareKeys - сравнивает 64-битные ключи сортировки (для qsort)
+ *
+ * Ключ содержит и то, по чему сортируется символ, и его номер в младших
+ * битах, поэтому сравнение не обращается к общему состоянию и безопасно
+ * в нескольких потоках сжатия.
+ */
+static int compareKeys(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+/**
+ * Функция sortUtf8Symbols - номера символов алфавита по возрастанию ключа
+ * @param alphabet - алфавит (не больше UTF8_MAX_SYMBOLS символов; ключи - в sort_keys)
+ * @param by_count - 1 - по частоте, затем по значению; 0 - по значению
+ * @param order - сюда записываются номера символов
+ */
+static void sortUtf8Symbols(Utf8Alphabet* alphabet, int by_count, uint32_t order[]) {
+    uint32_t n = alphabet->count;
+    uint64_t* keys = alphabet->sort_keys;
+    for (uint32_t i = 0; i < n; i++) {               // Частота до 2^26, символ до 2^21, номер до 2^15
+        uint64_t count = by_count ? alphabet->counts[i] : 0;
+        keys[i] = (count << 36) | ((uint64_t)alphabet->symbols[i] << 15) | i;
+    }
+    qsort(keys, n, sizeof(uint64_t), compareKeys);
+    for (uint32_t i = 0; i < n; i++) {
+        order[i] = (uint32_t)(keys[i] & (UTF8_MAX_SYMBOLS - 1));
+    }
+}
+
+/**
+ * Функция minimumRedundancyLengths - длины кодов Хаффмана для отсортированных весов
+ * @param weights - веса по неубыванию (n >= 2); на выходе - длины кодов
+ * @param n - количество весов
+ *
+ * Алгоритм Моффата - Катаяйнена: дерево строится на месте в самом
+ * массиве весов (ссылки на родителей, затем глубины), без кучи и без
+ * дополнительной памяти, поэтому годится для алфавита любого размера.
+ * Длины выходят по невозрастанию: самый редкий символ - первый.
+ */
+static void minimumRedundancyLengths(uint32_t weights[], uint32_t n) {
+    uint32_t root = 0, leaf = 2;
+    weights[0] += weights[1];
+    for (uint32_t next = 1; next < n - 1; next++) {
+        if (leaf >= n || weights[root] < weights[leaf]) {   // Первый из пары - внутренний узел или лист
+            weights[next] = weights[root];
+            weights[root++] = next;
+        } else {
+            weights[next] = weights[leaf++];
+        }
+        if (leaf >= n || (root < next && weights[root] < weights[leaf])) {
+            weights[next] += weights[root];
+            weights[root++] = next;
+        } else {
+            weights[next] += weights[leaf++];
+        }
+    }
+    weights[n - 2] = 0;                              // Глубины внутренних узлов
+    for (uint32_t next = n - 2; next-- > 0;) {
+        weights[next] = weights[weights[next]] + 1;
+    }
+    int64_t internal = (int64_t)n - 2, next = (int64_t)n - 1;  // Глубины листьев
+    uint32_t available = 1, depth = 0;
+    while (available > 0) {
+        uint32_t used = 0;
+        while (internal >= 0 && weights[internal] == depth) {
+            used++;
+            internal--;
+        }
+        while (available > used) {
+            weights[next--] = depth;
+            available--;
+        }
+        available = 2 * used;
+        depth++;
+    }
+}
+
+/**
+ * Функция utf8CodeLengths - длины кодов алфавита блока UTF-8
+ * @param alphabet - алфавит с частотами; заполняются lengths
+ * @param max_length - наибольшая длина кода (2^max_length >= количества символов)
+ *
+ * Сначала строятся оптимальные длины (minimumRedundancyLengths). Если
+ * дерево глубже max_length, длины обрезаются, а неравенство Крафта
+ * восстанавливается переносом листьев на уровень глубже, как в zlib:
+ * сжатие почти не страдает, а работа не зависит от размера алфавита.
+ */
+static void utf8CodeLengths(Utf8Alphabet* alphabet, int max_length) {
+    uint32_t n = alphabet->count;
+    uint32_t* order = alphabet->order;
+    uint32_t* weights = alphabet->weights;
+    if (n == 1) {
+        alphabet->lengths[0] = 1;                    // Единственный символ: код из одного бита
+        return;
+    }
+    sortUtf8Symbols(alphabet, 1, order);
+    for (uint32_t i = 0; i < n; i++) {
+        weights[i] = alphabet->counts[order[i]];
+    }
+    minimumRedundancyLengths(weights, n);
+
+    uint32_t level_count[MAX_CODE_LENGTH + 1] = {0};  // Листьев на каждой глубине
+    for (uint32_t i = 0; i < n; i++) {
+        level_count[weights[i] < (uint32_t)max_length ? weights[i] : (uint32_t)max_length]++;
+    }
+    uint64_t kraft = 0;
+    for (int length = 1; length <= max_length; length++) {
+        kraft += (uint64_t)level_count[length] << (max_length - length);
+    }
+    while (kraft > (1ull << max_length)) {           // Лист с нижнего уровня поднимается на место соседа
+        level_count[max_length]--;
+        for (int length = max_length - 1; length > 0; length--) {
+            if (level_count[length] > 0) {
+                level_count[length]--;
+                level_count[length + 1] += 2;
+                break;
+            }
+        }
+        kraft--;
+    }
+    uint32_t i = 0;                                  // Самые редкие символы получают самые длинные коды
+    for (int length = max_length; length > 0; length--) {
+        for (uint32_t k = 0; k < level_count[length]; k++) {
+            alphabet->lengths[order[i++]] = (unsigned char)length;
+        }
+    }
+}
+
+/**
+ * Функция storeVarint - записывает число в LEB128
+ * @param p - куда записать (до 5 байт)
+ * @param value - число
+ * @return количество записанных байт
+ */
+static size_t storeVarint(unsigned char* p, uint32_t value) {
+    size_t pos = 0;
+    while (value >= 0x80) {
+        p[pos++] = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    p[pos++] = (unsigned char)value;
+    return pos;
+}
+
+/**
+ * Функция varintSize - размер числа в LEB128
+ * @param value - число
+ * @return количество байт (1-5)
+ */
+static size_t varintSize(uint32_t value) {
+    size_t size = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        size++;
+    }
+    return size;
+}
+
+/**
+ * Функция loadVarint - читает число в LEB128
+ * @param p - данные
+ * @param size - размер данных
+ * @param pos - позиция числа (сдвигается за него)
+ * @param value - сюда записывается число
+ * @return 1 при успехе, 0 если число обрезано или длиннее 32 бит
+ */
+static int loadVarint(const unsigned char* p, size_t size, size_t* pos, uint32_t* value) {
+    uint64_t result = 0;
+    for (int shift = 0; shift <= 28; shift += 7) {
+        if (*pos >= size) {
+            return 0;
+        }
+        unsigned char byte = p[(*pos)++];
+        result |= (uint64_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            *value = (uint32_t)result;
+            return result <= UINT32_MAX;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Функция encodeUtf8 - сжимает блок кодами кодовых точек UTF-8 (BLOCK_MODE_UTF8)
+ * @param data - исходные данные блока (не пустые)
+ * @param size - размер блока
+ * @param options - ограничение длины кода (не больше UTF8_MAX_CODE_LENGTH)
+ * @param limit - размер блока в байтовом режиме; блок UTF-8 должен быть короче
+ * @param alphabet - рабочая память алфавита (пустая; очищается перед возвратом)
+ * @param block - буфер для результата (не меньше blockBound(size) байт)
+ * @return 1 если блок записан, 0 если в нем недопустимый UTF-8, символов больше,
+ *         чем кодов длины options->max_code_length, или байтовый код выгоднее
+ *
+ * Каждая кодовая точка - один символ, поэтому буква кириллицы кодируется
+ * одним кодом, а не двумя кодами зависимых байтов. Частоты считаются
+ * в алфавите переменного размера (см. Utf8Alphabet), таблица в потоке
+ * блока перечисляет только встретившиеся символы (формат - у BlockHeader).
+ * Размер потока известен до кодирования, поэтому невыгодный блок не
+ * кодируется.
+ */
+static int encodeUtf8(const unsigned char* data, size_t size, const CodecOptions* options,
+                      uint64_t limit, Utf8Alphabet* alphabet, EncodedBlock* block) {
+    int max_length = options->max_code_length < UTF8_MAX_CODE_LENGTH ?
+                     options->max_code_length : UTF8_MAX_CODE_LENGTH;
+    alphabet->limit = 1u << max_length;              // Больше символов в max_length бит не помещается
+
+    ProfileSample sample;
+    PROFILE_BEGIN(sample);                           // Разбор UTF-8 и частоты кодовых точек
+    size_t begin, end;
+    utf8Edges(data, size, &begin, &end);
+    int valid = 1;
+    for (size_t i = 0; valid && i < begin; i++) {
+        uint32_t index = utf8Find(alphabet, UTF8_RAW_SYMBOL + data[i], 1);
+        valid = index != UINT32_MAX;
+        if (valid) {
+            alphabet->counts[index]++;
+        }
+    }
+    for (size_t i = begin; valid && i < end;) {
+        uint32_t symbol;
+        int length = utf8Decode(data + i, end - i, &symbol);
+        uint32_t index = length > 0 ? utf8Find(alphabet, symbol, 1) : UINT32_MAX;
+        valid = index != UINT32_MAX;                 // Недопустимый UTF-8 или слишком много символов
+        if (valid) {
+            alphabet->counts[index]++;
+            i += (size_t)length;
+        }
+    }
+    for (size_t i = end; valid && i < size; i++) {
+        uint32_t index = utf8Find(alphabet, UTF8_RAW_SYMBOL + data[i], 1);
+        valid = index != UINT32_MAX;
+        if (valid) {
+            alphabet->counts[index]++;
+        }
+    }
+    PROFILE_END(PROFILE_COUNT, sample, size, 0);
+    if (!valid) {
+        resetUtf8Alphabet(alphabet);                 // Блок кодируется байтами
+        return 0;
+    }
+    uint32_t n = alphabet->count;
+
+    PROFILE_BEGIN(sample);
+    utf8CodeLengths(alphabet, max_length);
+    uint32_t* sorted = alphabet->sorted;             // Номера символов по возрастанию значения
+    uint64_t* aligned = alphabet->aligned;
+    sortUtf8Symbols(alphabet, 0, sorted);
+
+    // Канонические коды: по длине, при равной длине - по значению символа
+    uint32_t level_count[UTF8_MAX_CODE_LENGTH + 1] = {0};
+    uint64_t next_code[UTF8_MAX_CODE_LENGTH + 1];
+    uint64_t bit_count = 0;
+    size_t table_size = varintSize(n) + (n + 1) / 2;
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t s = sorted[i];
+        level_count[alphabet->lengths[s]]++;
+        bit_count += (uint64_t)alphabet->counts[s] * alphabet->lengths[s];
+        uint32_t gap = i == 0 ? alphabet->symbols[s] : alphabet->symbols[s] - alphabet->symbols[sorted[i - 1]] - 1;
+        table_size += varintSize(gap);
+    }
+    uint64_t code = 0;
+    for (int length = 1; length <= UTF8_MAX_CODE_LENGTH; length++) {
+        code = (code + level_count[length - 1]) << 1;
+        next_code[length] = code;
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t s = sorted[i];
+        int length = alphabet->lengths[s];
+        aligned[s] = next_code[length]++ << (64 - length);
+    }
+    PROFILE_END(PROFILE_BUILD, sample, size, 0);
+
+    uint64_t block_size = BLOCK_PREFIX_SIZE + table_size + (bit_count + 7) / 8;
+    if (block_size >= limit) {
+        resetUtf8Alphabet(alphabet);                 // Байтовый код с таблицей не длиннее
+        return 0;
+    }
+    unsigned char* table = block->data + BLOCK_PREFIX_SIZE;
+    size_t pos = storeVarint(table, n);
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t s = sorted[i];
+        pos += storeVarint(table + pos, i == 0 ? alphabet->symbols[s] :
+                           alphabet->symbols[s] - alphabet->symbols[sorted[i - 1]] - 1);
+    }
+    for (uint32_t i = 0; i < n; i += 2) {
+        unsigned char high = i + 1 < n ? alphabet->lengths[sorted[i + 1]] : 0;
+        table[pos++] = (unsigned char)(alphabet->lengths[sorted[i]] | (high << 4));
+    }
+
+    PROFILE_BEGIN(sample);
+    BitWriter writer = {table + table_size, 0, 0, 0};
+    int pending = 0;                                 // 7 + 3 * 15 <= 64: три кода на сброс
+    for (size_t i = 0; i < size;) {
+        uint32_t symbol = UTF8_RAW_SYMBOL + data[i];  // Байт вне [begin, end) - сам по себе
+        int length = 1;
+        if (i >= begin && i < end) {
+            if (data[i] < 0x80) {
+                symbol = data[i];
+            } else {
+                length = utf8Decode(data + i, end - i, &symbol);
+                if (length == 0) {
+                    // Подсчет уже проверил [begin, end), но без кодовой точки
+                    // байт кодируется как есть, а не мусорным символом
+                    symbol = UTF8_RAW_SYMBOL + data[i];
+                    length = 1;
+                }
+            }
+        }
+        uint32_t s = utf8Find(alphabet, symbol, 0);
+        putBits(&writer, aligned[s], alphabet->lengths[s]);
+        if (++pending == 3) {
+            flushBits(&writer);
+            pending = 0;
+        }
+        i += (size_t)length;
+    }
+    flushBits(&writer);
+    if (writer.count > 0) {
+        writer.buffer[writer.pos++] = (unsigned char)(writer.bits >> 56);
+    }
+    PROFILE_END(PROFILE_ENCODE, sample, size, writer.pos);
+    storeBlockPrefix(block->data, data, size, (uint64_t)table_size * BYTE_SIZE + bit_count, BLOCK_MODE_UTF8);
+    block->size = BLOCK_PREFIX_SIZE + table_size + writer.pos;
+    resetUtf8Alphabet(alphabet);
+    return 1;
+}
+
+/**
+ * Функция decodeUtf8 - восстанавливает блок BLOCK_MODE_UTF8
+ * @param header - заголовок блока
+ * @param payload - поток блока (таблица символов и битовый поток)
+ * @param payload_size - размер потока в байтах
+ * @param output - буфер на header->raw_size байт
+ * @param decoder - таблицы восстановления (переиспользуются между блоками)
+ * @return HUFFMAN_OK, если восстановлено ровно raw_size байт и поток исчерпан,
+ *         иначе HUFFMAN_ERROR_CORRUPT
+ *
+ * Коды до DECODE_TABLE_BITS бит разрешаются одним обращением к таблице
+ * (номер символа и длина кода), более длинные - сравнением с первым
+ * каноническим кодом каждой длины. Байты символа (до 4) заранее
+ * сложены в слово и копируются в вывод одной записью.
+ */
+static int decodeUtf8(const BlockHeader* header, const unsigned char* payload, size_t payload_size,
+                      unsigned char* output, Utf8Decoder* decoder) {
+    size_t bytes = (size_t)((header->bit_count + 7) / 8);
+    uint32_t n;
+    size_t pos = 0;
+    if (bytes > payload_size || !loadVarint(payload, bytes, &pos, &n) || n == 0 ||
+        n > UTF8_MAX_SYMBOLS) {
+        return HUFFMAN_ERROR_CORRUPT;
+    }
+    unsigned char (*symbol_bytes)[4] = decoder->symbol_bytes;
+    unsigned char* symbol_length = decoder->symbol_length;
+    unsigned char* lengths = decoder->lengths;
+    uint32_t* canonical = decoder->canonical;
+    uint16_t* fast = decoder->fast;
+    memset(decoder->fast, 0, sizeof(decoder->fast));
+
+    int ok = 1;
+    uint32_t symbol = 0;
+    for (uint32_t i = 0; ok && i < n; i++) {
+        uint32_t gap;
+        ok = loadVarint(payload, bytes, &pos, &gap) &&
+             (uint64_t)symbol + gap + (i > 0) < UTF8_RAW_SYMBOL + ASCII_SIZE;
+        if (ok) {
+            symbol += gap + (i > 0);
+            symbol_length[i] = (unsigned char)utf8Encode(symbol, symbol_bytes[i]);
+        }
+    }
+    uint32_t level_count[UTF8_MAX_CODE_LENGTH + 1] = {0};
+    ok = ok && pos + (n + 1) / 2 <= bytes;
+    for (uint32_t i = 0; ok && i < n; i++) {
+        lengths[i] = (payload[pos + i / 2] >> (4 * (i & 1))) & 0x0F;
+        ok = lengths[i] > 0;
+        level_count[lengths[i]]++;
+    }
+    pos += (n + 1) / 2;
+    uint64_t kraft = 0;
+    for (int length = 1; length <= UTF8_MAX_CODE_LENGTH; length++) {
+        kraft += (uint64_t)level_count[length] << (UTF8_MAX_CODE_LENGTH - length);
+    }
+    ok = ok && kraft <= (1u << UTF8_MAX_CODE_LENGTH) && (uint64_t)pos * BYTE_SIZE <= header->bit_count;
+
+    // Первый код и первый номер в canonical для каждой длины
+    uint32_t first_code[UTF8_MAX_CODE_LENGTH + 2], first_index[UTF8_MAX_CODE_LENGTH + 2];
+    int max_length = 0;
+    if (ok) {
+        uint32_t code = 0, index = 0;
+        for (int length = 1; length <= UTF8_MAX_CODE_LENGTH; length++) {
+            code = (code + level_count[length - 1]) << 1;
+            first_code[length] = code;
+            first_index[length] = index;
+            index += level_count[length];
+            if (level_count[length] > 0) {
+                max_length = length;
+            }
+        }
+        uint32_t next[UTF8_MAX_CODE_LENGTH + 1];
+        memcpy(next, first_index, sizeof(next));
+        for (uint32_t i = 0; i < n; i++) {
+            canonical[next[lengths[i]]++] = i;
+        }
+        for (int length = 1; length <= DECODE_TABLE_BITS && length <= max_length; length++) {
+            for (uint32_t k = 0; k < level_count[length]; k++) {
+                uint32_t start = (first_code[length] + k) << (DECODE_TABLE_BITS - length);
+                uint32_t index_k = first_index[length] + k;  // Не больше 2^11: помещается в 12 бит
+                for (uint32_t e = 0; e < (1u << (DECODE_TABLE_BITS - length)); e++) {
+                    fast[start + e] = (uint16_t)((index_k << 4) | (uint32_t)length);
+                }
+            }
+        }
+    }
+
+    BitReader reader = {payload + pos, 0, bytes - pos, 0, 0};
+    uint64_t remaining = ok ? header->bit_count - (uint64_t)pos * BYTE_SIZE : 0;
+    size_t produced = 0;
+    while (ok && produced < header->raw_size) {
+        if (reader.count < UTF8_MAX_CODE_LENGTH) {
+            refillBitReader(&reader);
+        }
+        uint32_t entry = fast[reader.bits >> (64 - DECODE_TABLE_BITS)];
+        int used = (int)(entry & 0x0F);
+        uint32_t index = entry >> 4;
+        if (used == 0) {                             // Код длиннее DECODE_TABLE_BITS
+            for (int length = DECODE_TABLE_BITS + 1; length <= max_length; length++) {
+                uint32_t value = (uint32_t)(reader.bits >> (64 - length));
+                if (value - first_code[length] < level_count[length]) {
+                    used = length;
+                    index = first_index[length] + (value - first_code[length]);
+                    break;
+                }
+            }
+        }
+        if (used == 0 || used > reader.count || (uint64_t)used > remaining) {
+            ok = 0;                                  // Недопустимый код или поток закончился раньше
+            break;
+        }
+        reader.bits <<= used;
+        reader.count -= used;
+        remaining -= used;
+        uint32_t s = canonical[index];
+        if (symbol_length[s] > header->raw_size - produced) {
+            ok = 0;
+            break;
+        }
+        if (produced + 4 <= header->raw_size) {
+            memcpy(output + produced, symbol_bytes[s], 4);  // Лишние байты перепишет следующий символ
+        } else {
+            memcpy(output + produced, symbol_bytes[s], symbol_length[s]);
+        }
+        produced += symbol_length[s];
+    }
+    return ok && remaining == 0 ? HUFFMAN_OK : HUFFMAN_ERROR_CORRUPT;
+}
+
+/**
+ * Функция prepareWorkspace - выделяет рабочую память режима при первом блоке
+ * @param work - рабочая память контекста
+ * @param mode - режим блоков BLOCK_MODE_*
+ * @param decode - 1 - память декодера, 0 - кодировщика
+ * @return 1 при успехе, 0 - не хватило памяти
+ */
+static int prepareWorkspace(Workspace* work, int mode, int decode) {
+    if (mode == BLOCK_MODE_ORDER1 && !decode && work->order1 == NULL) {
+        work->order1 = (Order1Model*)malloc(sizeof(Order1Model));
+        return work->order1 != NULL;
+    }
+    if (mode == BLOCK_MODE_UTF8 && !decode && work->alphabet == NULL) {
+        work->alphabet = (Utf8Alphabet*)calloc(1, sizeof(Utf8Alphabet));
+        if (work->alphabet == NULL) {
+            return 0;
+        }
+        work->alphabet->hash_bits = UTF8_HASH_MIN_BITS;
+    }
+    if (mode == BLOCK_MODE_UTF8 && decode && work->utf8 == NULL) {
+        work->utf8 = (Utf8Decoder*)malloc(sizeof(Utf8Decoder));
+        return work->utf8 != NULL;
+    }
+    return 1;
+}
+
+/**
+ * Функция freeWorkspace - освобождает рабочую память контекста
+ * @param work - рабочая память
+ */
+static void freeWorkspace(Workspace* work) {
+    for (int t = 0; t < ORDER1_MAX_TABLES; t++) {
+        freeDecodeTable(&work->tables[t]);
+    }
+    free(work->order1);
+    free(work->alphabet);
+    free(work->utf8);
+    work->order1 = NULL;
+    work->alphabet = NULL;
+    work->utf8 = NULL;
+}
+
+/**
+ * Функция encodeBlockWith - сжимает один блок данных
+ * @param data - исходные данные блока
+ * @param size - размер блока в байтах (не больше MAX_BLOCK_SIZE)
+ * @param options - режим блока и ограничение длины кода
+ * @param work - рабочая память кодировщиков (переиспользуется между блоками)
+ * @param cache - кэш таблиц (NULL - у каждого статического блока своя таблица)
+ * @param index - номер блока в кадре (важен только с кэшем)
+ * @param block - буфер для результата (растет до blockBound(size) байт)
+ * @return HUFFMAN_OK или HUFFMAN_ERROR_MEMORY
+ *
+ * В режиме BLOCK_MODE_STATIC для блока строятся своя гистограмма, дерево
+ * и канонические коды не длиннее options->max_code_length (два прохода
+ * по данным блока), в режиме
+ * BLOCK_MODE_ADAPTIVE блок кодируется за один проход (см. encodeAdaptive),
+ * в режиме BLOCK_MODE_ORDER1 таблица кодов выбирается по предыдущему байту
+ * (см. encodeOrder1), в режиме BLOCK_MODE_DICTIONARY коды берутся из
+ * options->dictionary (см. encodeDictionary), в режиме BLOCK_MODE_UTF8
+ * символами служат кодовые точки UTF-8 (см. encodeUtf8; блок с
+ * недопустимым UTF-8 кодируется байтами статически).
+ * Блоки сжимаются независимо друг от друга и могут обрабатываться
+ * параллельно. Результат (заголовок блока и битовый поток) готов к записи
+ * целиком и зависит только от данных блока (и сегмента, если есть кэш).
+ *
+ * С кэшем перед построением дерева статического блока в кэше ищется
+ * таблица, с которой блок сжимается почти так же хорошо (см.
+ * tableCacheLookup). Тогда дерево не строится, а вместо 256 байт таблицы
+ * в заголовок пишется ссылка BLOCK_MODE_REUSE. Блоки одного сегмента
+ * должны сжиматься с одним кэшем по порядку номеров, поэтому результат
+ * зависит только от данных сегмента.
+ *
+ * Перед кодированием по энтропии блока решается, нужен ли код Хаффмана
+ * вообще: несжимаемый блок хранится как есть, а блок из длинных серий
+ * одинаковых байт кодируется сериями (см. encodeSimpleBlock).
+ *
+ * Поток блока никогда не длиннее его исходных данных: размер статического,
+ * словарного потока и потока order-1 известен до упаковки битов, и блок,
+ * которому код с таблицей не выгоден, хранится как есть, а адаптивный
+ * блок, переросший данные (новые символы передаются через NYT), сжимается
+ * статически. Поэтому буфер блока выделяется один раз до кодирования
+ * (blockBound), и кодировщики его не перевыделяют.
+ */
+static int encodeBlockWith(const unsigned char* data, size_t size, const CodecOptions* options,
+                           Workspace* work, TableCache* cache, uint32_t index, EncodedBlock* block) {
+    if (!reserveBlock(block, blockBound(size)) || !prepareWorkspace(work, options->mode, 0)) {
+        return HUFFMAN_ERROR_MEMORY;
+    }
+    ProfileSample sample;
+    unsigned int frequencies[ASCII_SIZE];
+    PROFILE_BEGIN(sample);
+    countFrequenciesBuffer(data, size, frequencies);
+    PROFILE_END(PROFILE_COUNT, sample, size, 0);
+
+    uint64_t entropy_bits;
+    uint32_t signature = histogramSignature(frequencies, size, &entropy_bits);
+    if (encodeSimpleBlock(data, size, options, frequencies, cache != NULL, entropy_bits, block)) {
+        return HUFFMAN_OK;                           // Несжимаемые данные, длинные серии или малый алфавит
+    }
+
+    if (options->mode == BLOCK_MODE_ADAPTIVE) {
+        PROFILE_BEGIN(sample);
+        uint64_t bit_count = encodeAdaptive(data, size, block, BLOCK_PREFIX_SIZE);
+        PROFILE_END(PROFILE_ENCODE, sample, size, (bit_count + 7) / 8);
+        if (bit_count <= (uint64_t)size * BYTE_SIZE) {
+            storeBlockPrefix(block->data, data, size, bit_count, BLOCK_MODE_ADAPTIVE);
+            block->size = BLOCK_PREFIX_SIZE + (size_t)((bit_count + 7) / 8);
+            return HUFFMAN_OK;
+        }
+        // Адаптивный поток длиннее исходных данных - кодируем блок статически
+    }
+    if (options->mode == BLOCK_MODE_DICTIONARY && options->dictionary != NULL) {
+        uint64_t bit_count = encodeDictionary(data, size, frequencies, options->dictionary, block);
+        if (bit_count <= (uint64_t)size * BYTE_SIZE) {
+            storeBlockPrefix(block->data, data, size, bit_count, BLOCK_MODE_DICTIONARY);
+            return HUFFMAN_OK;
+        }
+        // Данные не похожи на образцы словаря - кодируем блок статически
+    }
+    if (options->mode == BLOCK_MODE_ORDER1 && size > 0) {
+        if (encodeOrder1(data, size, options, work->order1, block)) {
+            return HUFFMAN_OK;
+        }
+        // С таблицами контекстов блок не короче данных - кодируем статически
+    }
+    HuffmanArena arena;                              // Дерево строится без обращений к куче
+    Code built[ASCII_SIZE];
+    const Code* codes = built;
+    const TableCacheEntry* cached = NULL;
+    PROFILE_BEGIN(sample);
+    if (cache != NULL) {
+        cached = tableCacheLookup(cache, index, frequencies, size, signature, entropy_bits);
+    }
+    // Ссылка на таблицу кодируется так же, как блок, в котором таблица записана
+    int streams = streamCount(size, options->streams);
+    unsigned char mode = streams > 1 ? BLOCK_MODE_INTERLEAVED : BLOCK_MODE_STATIC;
+    if (cached != NULL) {
+        codes = cached->codes;
+        mode = cached->mode;
+    } else {
+        buildCodeLengths(&arena, frequencies, options->max_code_length, built);
+        assignCanonicalCodes(built);
+    }
+    PROFILE_END(PROFILE_BUILD, sample, 0, 0);
+
+    // Точный размер потока известен заранее: сумма частот, умноженных на длины кодов
+    uint64_t aligned[ASCII_SIZE];
+    int lengths[ASCII_SIZE];
+    int max_length = 0;
+    uint64_t bit_count = encodedBitCount(frequencies, codes);
+    for (int i = 0; i < ASCII_SIZE; i++) {
+        lengths[i] = codes[i].length;
+        aligned[i] = codes[i].length > 0 ? codes[i].value << (64 - codes[i].length) : 0;
+        if (codes[i].length > max_length) {
+            max_length = codes[i].length;
+        }
+    }
+
+    // У нескольких потоков к потоку добавляются таблица переходов и дополнение каждого потока
+    unsigned char stored_mode = cached != NULL ? BLOCK_MODE_REUSE : mode;
+    size_t header_size = BLOCK_PREFIX_SIZE + blockTableSize(stored_mode, 0);
+    size_t reserve = mode == BLOCK_MODE_INTERLEAVED ? 1 + 4 * (size_t)streams + (size_t)streams : 0;
+    uint64_t huffman_size = header_size + (bit_count + 7) / 8 + reserve;
+    uint64_t packed_size = packedBlockSize(frequencies, size);
+    if (options->mode == BLOCK_MODE_UTF8) {
+        uint64_t limit = BLOCK_PREFIX_SIZE + (uint64_t)size;  // Блок UTF-8 должен быть короче всех остальных
+        limit = huffman_size < limit ? huffman_size : limit;
+        if (packed_size != UINT64_MAX && BLOCK_PREFIX_SIZE + packed_size < limit) {
+            limit = BLOCK_PREFIX_SIZE + packed_size;
+        }
+        if (encodeUtf8(data, size, options, limit, work->alphabet, block)) {
+            return HUFFMAN_OK;
+        }
+        // Недопустимый UTF-8 или кодовые точки не выгоднее байтов - кодируем байты
+    }
+    if (huffman_size >= BLOCK_PREFIX_SIZE + (uint64_t)size) {
+        storeRawBlock(data, size, block);            // Выигрыш не окупает таблицу
+        return HUFFMAN_OK;
+    }
+    if (packed_size != UINT64_MAX && BLOCK_PREFIX_SIZE + packed_size <= huffman_size) {
+        encodePacked(data, size, frequencies, block);  // Малый алфавит: номера не длиннее кодов
+        return HUFFMAN_OK;
+    }
+    if (cached == NULL && cache != NULL) {
+        tableCacheInsert(cache, index, signature, mode, built);
+    }
+    // Заголовок блока
+    if (cached != NULL) {
+        block->data[BLOCK_PREFIX_SIZE] = (unsigned char)(index - cached->block);
+    } else {
+        for (int i = 0; i < ASCII_SIZE; i++) {
+            block->data[BLOCK_PREFIX_SIZE + i] = (unsigned char)codes[i].length;
+        }
+    }
+
+    // Битовый поток
+    PROFILE_BEGIN(sample);
+    size_t payload_size;
+    if (mode == BLOCK_MODE_INTERLEAVED) {
+        bit_count = encodeStreams(block->data + header_size, data, size, streams, aligned, lengths, max_length);
+        payload_size = (size_t)((bit_count + 7) / 8);
+    } else {
+        BitWriter writer = {block->data + header_size, 0, 0, 0};
+        encodeBuffer(&writer, data, size, aligned, lengths, max_length);
+        if (writer.count > 0) {
+            writer.buffer[writer.pos++] = (unsigned char)(writer.bits >> 56);
+        }
+        payload_size = writer.pos;
+    }
+    PROFILE_END(PROFILE_ENCODE, sample, size, payload_size);
+    storeBlockPrefix(block->data, data, size, bit_count, stored_mode);
+    block->size = header_size + payload_size;
+    return HUFFMAN_OK;
+}
+
+/**
+ * Функция decodeFourStreams - основной цикл декодирования четырех потоков одновременно
+ * @param readers - состояния чтения четырех потоков
+ * @param left - значимые биты каждого потока (уменьшаются)
+ * @param outs - начало части каждого потока в выходном буфере
+ * @param out_pos - заполненность каждой части (растет)
+ * @param capacity - размер каждой части
+ * @param table - таблица декодирования
+ * @param steps - шагов каждого потока на одно пополнение буферов
+ * @return 1 при успехе (или если потоки уже подошли к концу), 0 если поток поврежден
+ *
+ * Состояния четырех потоков держатся в отдельных локальных переменных,
+ * чтобы компилятор разместил их в регистрах: так четыре цепочки шагов
+ * не зависят друг от друга даже через память. Цикл останавливается,
+ * как только одному из потоков не хватает битов, места или байтов для
+ * быстрого пополнения; остальное доделывает decodeStreams.
+ */
+static int decodeFourStreams(BitReader readers[], uint64_t left[], unsigned char* outs[], size_t out_pos[],
+                             const size_t capacity[], const DecodeTable* table, int steps) {
+    int max_step = 56 / steps;
+    uint64_t need = (uint64_t)steps * max_step;
+    BitReader r0 = readers[0], r1 = readers[1], r2 = readers[2], r3 = readers[3];
+    uint64_t l0 = left[0], l1 = left[1], l2 = left[2], l3 = left[3];
+    size_t p0 = out_pos[0], p1 = out_pos[1], p2 = out_pos[2], p3 = out_pos[3];
+    int ok = 1;
+
+    while (l0 >= need && l1 >= need && l2 >= need && l3 >= need &&
+           p0 + DECODE_OUT_SLACK <= capacity[0] && p1 + DECODE_OUT_SLACK <= capacity[1] &&
+           p2 + DECODE_OUT_SLACK <= capacity[2] && p3 + DECODE_OUT_SLACK <= capacity[3] &&
+           r0.end - r0.pos >= 8 && r1.end - r1.pos >= 8 && r2.end - r2.pos >= 8 && r3.end - r3.pos >= 8) {
+        refillBitReader(&r0);
+        refillBitReader(&r1);
+        refillBitReader(&r2);
+        refillBitReader(&r3);
+        for (int step = 0; step < steps; step++) {
+            int n0 = 0, n1 = 0, n2 = 0, n3 = 0;      // Символов за шаг в каждом потоке
+            int u0 = decodeSymbols(table, r0.bits, outs[0] + p0, &n0);
+            int u1 = decodeSymbols(table, r1.bits, outs[1] + p1, &n1);
+            int u2 = decodeSymbols(table, r2.bits, outs[2] + p2, &n2);
+            int u3 = decodeSymbols(table, r3.bits, outs[3] + p3, &n3);
+            if ((u0 == 0) | (u1 == 0) | (u2 == 0) | (u3 == 0)) {
+                ok = 0;                              // Поврежденный поток
+                goto done;
+            }
+            p0 += n0; p1 += n1; p2 += n2; p3 += n3;
+            r0.bits <<= u0; r1.bits <<= u1; r2.bits <<= u2; r3.bits <<= u3;
+            r0.count -= u0; r1.count -= u1; r2.count -= u2; r3.count -= u3;
+            l0 -= u0; l1 -= u1; l2 -= u2; l3 -= u3;
+        }
+    }
+
+done:
+    readers[0] = r0; readers[1] = r1; readers[2] = r2; readers[3] = r3;
+    left[0] = l0; left[1] = l1; left[2] = l2; left[3] = l3;
+    out_pos[0] = p0; out_pos[1] = p1; out_pos[2] = p2; out_pos[3] = p3;
+    return ok;
+}
+
+/**
+ * Функция decodeStreams - восстанавливает блок BLOCK_MODE_INTERLEAVED
+ * @param header - заголовок блока
+ * @param payload - поток блока (таблица переходов и потоки частей)
+ * @param payload_size - размер потока в байтах
+ * @param output - буфер на header->raw_size байт
+ * @param table - таблица декодирования блока
+ * @return 1 если все части восстановлены и каждый поток разобран ровно до конца, иначе 0
+ *
+ * В обычном блоке каждый следующий код можно найти, только разобрав
+ * предыдущий, и процессор ждет загрузки из таблицы на каждом шаге. Здесь
+ * основной цикл делает шаг по очереди в каждом потоке: шаги разных
+ * потоков независимы, поэтому их загрузки и сдвиги выполняются
+ * одновременно. Потоки обрабатываются четверками (decodeFourStreams),
+ * оставшиеся - общим циклом. Шагов на одно пополнение буферов - столько,
+ * сколько гарантированно помещается в 56 битов; хвосты потоков
+ * дочитывает decodeBits.
+ */
+static int decodeStreams(const BlockHeader* header, const unsigned char* payload, size_t payload_size,
+                         unsigned char* output, const DecodeTable* table) {
+    int streams = payload_size > 0 ? payload[0] : 0;
+    size_t jump = 1 + 4 * (size_t)(streams - 1);
+    if (streams < 1 || streams > INTERLEAVED_MAX_STREAMS || (uint64_t)jump * BYTE_SIZE > header->bit_count ||
+        jump > payload_size) {
+        return 0;
+    }
+
+    BitReader readers[INTERLEAVED_MAX_STREAMS];
+    uint64_t left[INTERLEAVED_MAX_STREAMS];          // Значимые биты каждого потока
+    unsigned char* outs[INTERLEAVED_MAX_STREAMS];    // Начало части каждого потока в output
+    size_t out_pos[INTERLEAVED_MAX_STREAMS];
+    size_t capacity[INTERLEAVED_MAX_STREAMS];
+    size_t part = ((size_t)header->raw_size + streams - 1) / streams;
+    uint64_t rest = header->bit_count - (uint64_t)jump * BYTE_SIZE;  // Биты потоков (с дополнением)
+    size_t pos = jump;
+    for (int k = 0; k < streams; k++) {
+        uint64_t bits = k + 1 < streams ? loadLittleEndian(payload + 1 + 4 * k, 4) : rest;
+        uint64_t bytes = (bits + 7) / 8;
+        if (k + 1 < streams) {
+            if (bytes * BYTE_SIZE > rest) {
+                return 0;                            // Таблица переходов повреждена
+            }
+            rest -= bytes * BYTE_SIZE;
+        }
+        if (bytes > payload_size - pos) {
+            return 0;                                // Поток блока короче заявленного
+        }
+        // Конец буфера - конец всего потока блока: быстрое пополнение не упирается в границы частей
+        BitReader reader = {payload + pos, 0, payload_size - pos, 0, 0};
+        readers[k] = reader;
+        left[k] = bits;
+        size_t start = (size_t)k * part < header->raw_size ? (size_t)k * part : header->raw_size;
+        outs[k] = output + start;
+        out_pos[k] = 0;
+        capacity[k] = header->raw_size - start < part ? header->raw_size - start : part;
+        pos += (size_t)bytes;
+    }
+
+    int max_step = table->max_length > DECODE_TABLE_BITS ? table->max_length : DECODE_TABLE_BITS;
+    int steps = 56 / max_step;                       // Шагов каждого потока на одно пополнение
+    uint64_t need = (uint64_t)steps * max_step;
+    int grouped = streams - streams % 4;             // Потоки, обрабатываемые четверками
+    for (int k = 0; k < grouped; k += 4) {
+        if (!decodeFourStreams(readers + k, left + k, outs + k, out_pos + k, capacity + k, table, steps)) {
+            return 0;
+        }
+    }
+    for (;;) {
+        int k = grouped;
+        while (k < streams && left[k] >= need && out_pos[k] + DECODE_OUT_SLACK <= capacity[k] &&
+               readers[k].end - readers[k].pos >= 8) {
+            k++;
+        }
+        if (k < streams || grouped == streams) {
+            break;                                   // Один из потоков подошел к концу
+        }
+        for (k = grouped; k < streams; k++) {
+            refillBitReader(&readers[k]);
+        }
+        for (int step = 0; step < steps; step++) {
+            for (k = grouped; k < streams; k++) {
+                int produced;
+                int used = decodeSymbols(table, readers[k].bits, outs[k] + out_pos[k], &produced);
+                if (used == 0) {
+                    return 0;                        // Поврежденный поток
+                }
+                out_pos[k] += produced;
+                readers[k].bits <<= used;
+                readers[k].count -= used;
+                left[k] -= used;
+            }
+        }
+    }
+
+    for (int k = 0; k < streams; k++) {
+        size_t produced = decodeBits(&readers[k], table, &left[k], outs[k] + out_pos[k],
+                                     capacity[k] - out_pos[k]);
+        if (out_pos[k] + produced != capacity[k] || left[k] != 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * Функция decodeBlockWith - восстанавливает блок, переиспользуя таблицы декодирования
+ * @param header - заголовок блока
+ * @param payload - битовый поток блока
+ * @param payload_size - размер потока в байтах
+ * @param output - буфер на header->raw_size байт
+ * @param work - рабочая память декодеров (таблицы остаются от прошлых блоков)
+ * @param dictionary - словарь для блока BLOCK_MODE_DICTIONARY (NULL - нет)
+ * @return HUFFMAN_OK, если блок восстановлен и контрольная сумма совпала,
+ *         HUFFMAN_ERROR_DICTIONARY, если нет словаря блока, HUFFMAN_ERROR_MEMORY
+ *         или HUFFMAN_ERROR_CORRUPT
+ *
+ * Таблицы перестраиваются функцией rebuildDecodeTable, поэтому при
+ * восстановлении многих блоков их память выделяется один раз.
+ * Словарный блок декодируется готовой таблицей словаря, если
+ * идентификаторы совпадают. Блок BLOCK_MODE_REUSE должен быть заранее
+ * разрешен findSegmentTable.
+ */
+static int decodeBlockWith(const BlockHeader* header, const unsigned char* payload, size_t payload_size,
+                           unsigned char* output, Workspace* work, const Dictionary* dictionary) {
+    DecodeTable* tables = work->tables;
+    ProfileSample sample;
+    int ok;
+    if (header->mode == BLOCK_MODE_REUSE) {
+        return HUFFMAN_ERROR_TABLE;                  // Таблицу подставляет findSegmentTable
+    }
+    if (!prepareWorkspace(work, header->mode, 1)) {
+        return HUFFMAN_ERROR_MEMORY;
+    }
+    if (header->mode == BLOCK_MODE_DICTIONARY) {
+        if (dictionary == NULL || dictionary->id != header->dictionary_id) {
+            return HUFFMAN_ERROR_DICTIONARY;
+        }
+        PROFILE_BEGIN(sample);
+        BitReader reader = {payload, 0, payload_size, 0, 0};
+        uint64_t remaining = header->bit_count;
+        size_t produced = decodeBits(&reader, &dictionary->table, &remaining, output, header->raw_size);
+        PROFILE_END(PROFILE_DECODE, sample, payload_size, produced);
+        ok = produced == header->raw_size && remaining == 0;
+    } else if (header->mode == BLOCK_MODE_STORED) {
+        PROFILE_BEGIN(sample);
+        ok = header->bit_count == (uint64_t)header->raw_size * BYTE_SIZE && payload_size >= header->raw_size;
+        if (ok) {
+            memcpy(output, payload, header->raw_size);
+        }
+        PROFILE_END(PROFILE_DECODE, sample, payload_size, header->raw_size);
+    } else if (header->mode == BLOCK_MODE_RUNS || header->mode == BLOCK_MODE_PACKED) {
+        PROFILE_BEGIN(sample);
+        ok = header->mode == BLOCK_MODE_RUNS ? decodeRuns(header, payload, payload_size, output) :
+             decodePacked(header, payload, payload_size, output);
+        PROFILE_END(PROFILE_DECODE, sample, payload_size, header->raw_size);
+    } else if (header->mode == BLOCK_MODE_ADAPTIVE || header->mode == BLOCK_MODE_ORDER1 ||
+               header->mode == BLOCK_MODE_UTF8) {
+        PROFILE_BEGIN(sample);                       // Таблицы (или дерево) строятся внутри декодера
+        int status = HUFFMAN_OK;
+        if (header->mode == BLOCK_MODE_ADAPTIVE) {
+            ok = decodeAdaptive(payload, payload_size, header->bit_count, output, header->raw_size);
+        } else if (header->mode == BLOCK_MODE_ORDER1) {
+            status = decodeOrder1(header, payload, payload_size, output, tables);
+            ok = status == HUFFMAN_OK;
+        } else {
+            status = decodeUtf8(header, payload, payload_size, output, work->utf8);
+            ok = status == HUFFMAN_OK;
+        }
+        PROFILE_END(PROFILE_DECODE, sample, payload_size, header->raw_size);
+        if (status == HUFFMAN_ERROR_MEMORY) {
+            return status;
+        }
+    } else {
+        PROFILE_BEGIN(sample);
+        Code codes[ASCII_SIZE];
+        for (int i = 0; i < ASCII_SIZE; i++) {
+            codes[i].value = 0;
+            codes[i].length = header->lengths[i];
+        }
+        assignCanonicalCodes(codes);
+        int built = rebuildDecodeTable(&tables[0], codes);
+        PROFILE_END(PROFILE_BUILD, sample, 0, 0);
+        if (!built) {
+            return HUFFMAN_ERROR_MEMORY;
+        }
+
+        PROFILE_BEGIN(sample);
+        if (header->mode == BLOCK_MODE_INTERLEAVED) {
+            ok = decodeStreams(header, payload, payload_size, output, &tables[0]);
+        } else {
+            BitReader reader = {payload, 0, payload_size, 0, 0};
+            uint64_t remaining = header->bit_count;
+            size_t produced = decodeBits(&reader, &tables[0], &remaining, output, header->raw_size);
+            ok = produced == header->raw_size && remaining == 0;
+        }
+        PROFILE_END(PROFILE_DECODE, sample, payload_size, ok ? header->raw_size : 0);
+    }
+    if (!ok) {
+        return HUFFMAN_ERROR_CORRUPT;
+    }
+
+    PROFILE_BEGIN(sample);
+    uint32_t checksum = crc32Update(0, output, header->raw_size);
+    PROFILE_END(PROFILE_CHECK, sample, header->raw_size, 0);
+    return checksum == header->checksum ? HUFFMAN_OK : HUFFMAN_ERROR_CORRUPT;
+}
+
+/**
+ * Функция storeIndexEntry - заполняет элемент индекса для блока с номером index
+ * @param entry - INDEX_ENTRY_SIZE байт для заполнения
+ * @param offset - смещение блока от начала кадра
+ * @param header - заголовок кадра (размеры блоков)
+ * @param index - номер блока
+ */
+static void storeIndexEntry(unsigned char* entry, uint64_t offset, const ContainerHeader* header,
+                            uint32_t index) {
+    uint64_t start = (uint64_t)index * header->block_size;
+    uint64_t raw_size = header->original_size - start < header->block_size ?
+                        header->original_size - start : header->block_size;
+    storeLittleEndian(entry, offset, 8);
+    storeLittleEndian(entry + 8, raw_size, 4);
+}
+
+/**
+ * Функция storeIndexTrailer - заполняет окончание индекса
+ * @param trailer - INDEX_TRAILER_SIZE байт для заполнения
+ * @param index_offset - смещение, с которого начинается индекс
+ */
+static void storeIndexTrailer(unsigned char* trailer, uint64_t index_offset) {
+    storeLittleEndian(trailer, index_offset, 8);
+    memcpy(trailer + 8, INDEX_MAGIC, 4);
+}
+
+/**
+ * Функция storeBlockIndex - записывает индекс блоков в память
+ * @param buffer - куда записать (block_count * INDEX_ENTRY_SIZE + INDEX_TRAILER_SIZE байт)
+ * @param offsets - смещения блоков от начала сжатых данных
+ * @param header - заголовок (размеры блоков)
+ * @param index_offset - смещение, с которого начинается индекс
+ * @return количество записанных байт
+ */
+static uint64_t storeBlockIndex(unsigned char* buffer, const uint64_t offsets[], const ContainerHeader* header,
+                         uint64_t index_offset) {
+    for (uint32_t i = 0; i < header->block_count; i++) {
+        storeIndexEntry(buffer + (size_t)i * INDEX_ENTRY_SIZE, offsets[i], header, i);
+    }
+    storeIndexTrailer(buffer + (size_t)header->block_count * INDEX_ENTRY_SIZE, index_offset);
+    return (uint64_t)header->block_count * INDEX_ENTRY_SIZE + INDEX_TRAILER_SIZE;
+}
+
+/**
+ * Функция findSegmentTable - запоминает таблицу статического блока или подставляет таблицу в блок BLOCK_MODE_REUSE
+ * @param segment - таблицы статических блоков, восстановленных раньше
+ * @param index - номер блока
+ * @param header - заголовок блока (блок BLOCK_MODE_REUSE при успехе получает режим и таблицу того блока)
+ * @return 1 при успехе, 0 если блок ссылается на таблицу, которой в segment нет
+ *
+ * Таблица блока i хранится в ячейке i % TABLE_CACHE_SEGMENT, пока ее не
+ * вытеснит блок следующего сегмента. При восстановлении блоков по порядку
+ * таблица, на которую ссылается блок, всегда уже в segment.
+ */
+static int findSegmentTable(SegmentTables* segment, uint32_t index, BlockHeader* header) {
+    if (header->mode == BLOCK_MODE_STATIC || header->mode == BLOCK_MODE_INTERLEAVED) {
+        segment->block[index % TABLE_CACHE_SEGMENT] = index + 1;
+        segment->mode[index % TABLE_CACHE_SEGMENT] = header->mode;
+        memcpy(segment->lengths[index % TABLE_CACHE_SEGMENT], header->lengths, ASCII_SIZE);
+        return 1;
+    }
+    if (header->mode != BLOCK_MODE_REUSE) {
+        return 1;
+    }
+    uint32_t source = index - header->distance;
+    if (header->distance > index % TABLE_CACHE_SEGMENT ||  // Ссылка за начало сегмента
+        segment->block[source % TABLE_CACHE_SEGMENT] != source + 1) {
+        return 0;
+    }
+    memcpy(header->lengths, segment->lengths[source % TABLE_CACHE_SEGMENT], ASCII_SIZE);
+    header->mode = segment->mode[source % TABLE_CACHE_SEGMENT];
+    return 1;
+}
+
+// ========== ИНТЕРФЕЙС БИБЛИОТЕКИ (huffman.h) ==========
+
+/**
+ * Функция toContainerHeader - переводит заголовок кадра из интерфейса во внутренний
+ * @param frame - заголовок кадра
+ * @param header - структура для заполнения
+ */
+static void toContainerHeader(const HuffmanFrameHeader* frame, ContainerHeader* header) {
+    header->flags = (unsigned char)frame->flags;
+    header->original_size = frame->original_size;
+    header->block_size = frame->block_size;
+    header->block_count = frame->block_count;
+}
+
+/**
+ * Функция toFrameHeader - переводит внутренний заголовок в заголовок кадра интерфейса
+ * @param header - заголовок
+ * @param frame - структура для заполнения
+ */
+static void toFrameHeader(const ContainerHeader* header, HuffmanFrameHeader* frame) {
+    frame->flags = header->flags;
+    frame->original_size = header->original_size;
+    frame->block_size = header->block_size;
+    frame->block_count = header->block_count;
+}
+
+// ---------- Контекст ----------
+
+/**
+ * Функция huffmanDefaultParams - параметры сжатия по умолчанию
+ * @param params - структура для заполнения
+ */
+void huffmanDefaultParams(HuffmanParams* params) {
+    params->block_size = DEFAULT_BLOCK_SIZE;
+    params->mode = HUFFMAN_MODE_STATIC;
+    params->max_code_length = DEFAULT_CODE_LENGTH_LIMIT;
+    params->table_cache = -1;
+    params->streams = 1;
+}
+
+/**
+ * Функция huffmanCreateContext - создает контекст сжатия и восстановления
+ * @param params - параметры сжатия (NULL - параметры по умолчанию)
+ * @return контекст или NULL, если параметры недопустимы или не хватило памяти
+ *
+ * Ограничения параметров те же, что у ключей командной строки.
+ * Буферы и рабочая память режима выделяются при первом блоке.
+ */
+HuffmanContext* huffmanCreateContext(const HuffmanParams* params) {
+    HuffmanParams defaults;
+    if (params == NULL) {
+        huffmanDefaultParams(&defaults);
+        params = &defaults;
+    }
+    if (params->block_size == 0 || params->block_size > MAX_BLOCK_SIZE ||
+        params->mode < 0 ||
+        (params->mode >= BLOCK_MODE_DICTIONARY && params->mode != BLOCK_MODE_UTF8) ||  // Словарь задает huffmanSetDictionary
+        params->max_code_length < MIN_CODE_LENGTH_LIMIT ||
+        params->max_code_length > DECODE_MAX_CODE_LENGTH || params->table_cache > 100 ||
+        params->streams < 1 || params->streams > INTERLEAVED_MAX_STREAMS) {
+        return NULL;
+    }
+
+    // calloc: пустые буферы и таблицы (entries == NULL, capacity == 0)
+    HuffmanContext* context = (HuffmanContext*)calloc(1, sizeof(HuffmanContext));
+    if (context == NULL) {
+        return NULL;
+    }
+    context->options.block_size = params->block_size;
+    context->options.mode = params->mode;
+    context->options.max_code_length = params->max_code_length;
+    context->options.dictionary = NULL;
+    context->options.table_cache = params->table_cache;
+    context->options.streams = params->streams;
+    initTableCache(&context->cache, params->table_cache);
+    return context;
+}
+
+/**
+ * Функция huffmanFreeContext - освобождает контекст и все его буферы
+ * @param context - контекст (NULL допускается)
+ */
+void huffmanFreeContext(HuffmanContext* context) {
+    if (context == NULL) {
+        return;
+    }
+    freeWorkspace(&context->work);
+    if (context->dictionary != NULL) {
+        freeDictionary(context->dictionary);
+        free(context->dictionary);
+    }
+    free(context->block.data);
+    free(context->offsets);
+    free(context->scratch);
+    free(context);
+}
+
+/**
+ * Функция huffmanSetDictionary - задает контексту обученный словарь
+ * @param context - контекст
+ * @param dictionary - содержимое файла словаря, созданного командой train
+ * @param size - размер содержимого
+ * @return HUFFMAN_OK, HUFFMAN_ERROR_PARAMS или HUFFMAN_ERROR_MEMORY
+ *
+ * Контекст хранит свою копию словаря, режим контекста становится
+ * словарным. Таблица декодирования словаря строится здесь один раз.
+ */
+int huffmanSetDictionary(HuffmanContext* context, const void* dictionary, size_t size) {
+    Dictionary* loaded = (Dictionary*)calloc(1, sizeof(Dictionary));
+    if (loaded == NULL) {
+        return HUFFMAN_ERROR_MEMORY;
+    }
+    int status = parseDictionary((const unsigned char*)dictionary, size, loaded);
+    if (status != HUFFMAN_OK) {
+        free(loaded);
+        return status;
+    }
+    if (context->dictionary != NULL) {
+        freeDictionary(context->dictionary);
+        free(context->dictionary);
+    }
+    context->dictionary = loaded;
+    context->options.dictionary = loaded;
+    context->options.mode = BLOCK_MODE_DICTIONARY;
+    return HUFFMAN_OK;
+}
+
+/**
+ * Функция huffmanSetProfiler - задает обработчики замеров стадий кодека
+ * @param handlers - обработчики (NULL - замеры выключены)
+ */
+void huffmanSetProfiler(const HuffmanProfiler* handlers) {
+    if (handlers != NULL) {
+        profiler = *handlers;
+    }
+    profiling = handlers != NULL;
+}
+
+// ---------- Кадр по частям ----------
+
+/**
+ * Функция huffmanBeginFrame - начинает сжатие нового кадра
+ * @param context - контекст
+ * @param size - размер исходных данных (HUFFMAN_UNKNOWN_SIZE - потоковый кадр)
+ * @param header - сюда записывается заголовок кадра
+ * @return HUFFMAN_OK или HUFFMAN_ERROR_PARAMS, если блоков больше 2^32 - 1
+ */
+int huffmanBeginFrame(HuffmanContext* context, unsigned long long size, HuffmanFrameHeader* header) {
+    uint32_t block_size = context->options.block_size;
+    header->block_size = block_size;
+    if (size == HUFFMAN_UNKNOWN_SIZE) {
+        header->flags = CONTAINER_FLAG_STREAM;       // Размеры станут известны только в конце
+        header->original_size = 0;
+        header->block_count = 0;
+    } else {
+        uint64_t block_count = size / block_size + (size % block_size != 0);
+        if (block_count > UINT32_MAX) {
+            return HUFFMAN_ERROR_PARAMS;
+        }
+        header->flags = compactContainer(size, &context->options) ? CONTAINER_FLAG_COMPACT : CONTAINER_FLAG_INDEX;
+        header->original_size = size;
+        header->block_count = (unsigned int)block_count;
+    }
+    context->cache.count = 0;
+    return HUFFMAN_OK;
+}
+
+/**
+ * Функция huffmanFrameHeaderSize - размер заголовка кадра
+ * @param prefix - первые HUFFMAN_FRAME_PREFIX_SIZE байт кадра
+ * @return размер заголовка или 0, если это не сжатые данные
+ */
+size_t huffmanFrameHeaderSize(const void* prefix) {
+    const unsigned char* p = (const unsigned char*)prefix;
+    if (memcmp(p, CONTAINER_MAGIC, 4) != 0 || p[4] != CONTAINER_VERSION) {
+        return 0;
+    }
+    return containerHeaderSize(p[5]);
+}
+
+/**
+ * Функция huffmanStoreFrameHeader - записывает заголовок кадра
+ * @param header - заголовок из huffmanBeginFrame
+ * @param dst - куда записать
+ * @return количество записанных байт
+ */
+size_t huffmanStoreFrameHeader(const HuffmanFrameHeader* header, void* dst) {
+    ContainerHeader container;
+    toContainerHeader(header, &container);
+    storeContainerHeader((unsigned char*)dst, &container);
+    return containerHeaderSize(container.flags);
+}
+
+/**
+ * Функция huffmanParseFrameHeader - разбирает и проверяет заголовок кадра
+ * @param context - контекст, который будет восстанавливать блоки кадра (NULL допускается)
+ * @param src - заголовок
+ * @param size - сколько байт доступно
+ * @param header - структура для заполнения
+ * @return HUFFMAN_OK или HUFFMAN_ERROR_CORRUPT
+ */
+int huffmanParseFrameHeader(HuffmanContext* context, const void* src, size_t size,
+                            HuffmanFrameHeader* header) {
+    const unsigned char* input = (const unsigned char*)src;
+    ContainerHeader container;
+    if (size < HUFFMAN_FRAME_PREFIX_SIZE || size < containerHeaderSize(input[5]) ||
+        !parseContainerHeader(input, &container)) {
+        return HUFFMAN_ERROR_CORRUPT;
+    }
+    if (context != NULL) {
+        memset(context->segment.block, 0, sizeof(context->segment.block));
+    }
+    toFrameHeader(&container, header);
+    return HUFFMAN_OK;
+}
+
+/**
+ * Функция huffmanBlockBound - наибольший размер сжатого блока
+ * @param size - размер исходных данных блока
+ * @return размер буфера для huffmanCompressBlock
+ */
+size_t huffmanBlockBound(size_t size) {
+    return blockBound(size);
+}
+
+/**
+ * Функция huffmanCompressBlock - сжимает один блок кадра
+ * @param context - контекст
+ * @param src - исходные данные блока
+ * @param size - размер блока
+ * @param index - номер блока в кадре
+ * @param dst - выходной буфер
+ * @param dst_capacity - размер выходного буфера
+ * @param dst_size - сюда записывается размер сжатого блока
+ * @return HUFFMAN_OK или код ошибки HUFFMAN_ERROR_*
+ *
+ * Если dst вмещает huffmanBlockBound(size) байт, блок кодируется прямо
+ * в него, иначе - в буфер контекста, и копируется, если поместился.
+ */
+int huffmanCompressBlock(HuffmanContext* context, const void* src, size_t size, unsigned int index,
+                         void* dst, size_t dst_capacity, size_t* dst_size) {
+    if (size > context->options.block_size) {
+        return HUFFMAN_ERROR_PARAMS;
+    }
+    TableCache* cache = context->options.table_cache >= 0 ? &context->cache : NULL;
+    EncodedBlock direct = {(unsigned char*)dst, 0, dst_capacity};  // Буфер вызывающего: reserveBlock его не трогает
+    EncodedBlock* block = dst_capacity >= blockBound(size) ? &direct : &context->block;
+    int status = encodeBlockWith((const unsigned char*)src, size, &context->options, &context->work,
+                                 cache, index, block);
+    if (status != HUFFMAN_OK) {
+        return status;
+    }
+    if (block == &context->block) {
+        if (block->size > dst_capacity) {
+            return HUFFMAN_ERROR_DST_TOO_SMALL;
+        }
+        memcpy(dst, block->data, block->size);
+    }
+    *dst_size = block->size;
+    return HUFFMAN_OK;
+}
+
+/**
+ * Функция huffmanBlockHeaderSize - сколько байт блока нужно для huffmanBlockInfo
+ * @param src - начало блока
+ * @param available - сколько байт доступно
+ * @return размер заголовка блока или 0, если заголовок поврежден
+ *
+ * Признак конца потока распознается уже по 4 байтам нулевого размера,
+ * поэтому файл может заканчиваться раньше общей части заголовка.
+ */
+size_t huffmanBlockHeaderSize(const void* src, size_t available) {
+    const unsigned char* p = (const unsigned char*)src;
+    if (available >= 4 && loadLittleEndian(p, 4) == 0) {
+        return STREAM_END_SIZE;
+    }
+    if (available < BLOCK_PREFIX_SIZE + 1) {
+        return BLOCK_PREFIX_SIZE + 1;                // За общей частью всегда есть байт таблицы или потока
+    }
+    if (p[12] >= BLOCK_MODE_COUNT) {
+        return 0;
+    }
+    return BLOCK_PREFIX_SIZE + blockTableSize(p[12], p[BLOCK_PREFIX_SIZE]);
+}
+
+/**
+ * Функция huffmanBlockInfo - разбирает и проверяет заголовок блока
+ * @param src - начало блока
+ * @param available - сколько байт доступно
+ * @param info - структура для заполнения
+ * @return HUFFMAN_OK или HUFFMAN_ERROR_CORRUPT
+ */
+int huffmanBlockInfo(const void* src, size_t available, HuffmanBlockInfo* info) {
+    const unsigned char* p = (const unsigned char*)src;
+    memset(info, 0, sizeof(*info));
+    if (available < 4) {
+        return HUFFMAN_ERROR_CORRUPT;
+    }
+    uint32_t raw_size = (uint32_t)loadLittleEndian(p, 4);
+    if (raw_size == 0) {
+        if (available < STREAM_END_SIZE) {
+            return HUFFMAN_ERROR_CORRUPT;
+        }
+        info->header_size = info->record_size = STREAM_END_SIZE;
+        info->stream_total = loadLittleEndian(p + 4, 8);
+        return HUFFMAN_OK;
+    }
+    BlockHeader header;
+    if (raw_size > MAX_BLOCK_SIZE || !parseBlockHeader(p, available, &header, raw_size)) {
+        return HUFFMAN_ERROR_CORRUPT;
+    }
+    info->raw_size = raw_size;
+    info->header_size = header.size;
+    info->record_size = header.size + ((size_t)header.bit_count + 7) / 8;
+    info->mode = header.mode;
+    info->distance = header.mode == BLOCK_MODE_REUSE ? header.distance : 0;
+    info->dictionary_id = header.mode == BLOCK_MODE_DICTIONARY ? header.dictionary_id : 0;
+    return HUFFMAN_OK;
+}
+
+/**
+ * Функция huffmanDecompressBlock - восстанавливает один блок
+ * @param context - контекст
+ * @param src - блок целиком
+ * @param size - размер блока
+ * @param index - номер блока в кадре
+ * @param dst - буфер на expected байт
+ * @param expected - размер исходных данных блока по заголовку кадра
+ * @return HUFFMAN_OK или код ошибки HUFFMAN_ERROR_*
+ */
+int huffmanDecompressBlock(HuffmanContext* context, const void* src, size_t size, unsigned int index,
+                           void* dst, size_t expected) {
+    const unsigned char* input = (const unsigned char*)src;
+    BlockHeader header;
+    if (expected > MAX_BLOCK_SIZE || !parseBlockHeader(input, size, &header, (uint32_t)expected)) {
+        return HUFFMAN_ERROR_CORRUPT;
+    }
+    size_t payload_size = ((size_t)header.bit_count + 7) / 8;
+    if (payload_size > size - header.size) {
+        return HUFFMAN_ERROR_CORRUPT;
+    }
+    if (!findSegmentTable(&context->segment, index, &header)) {
+        return HUFFMAN_ERROR_TABLE;
+    }
+    return decodeBlockWith(&header, input + header.size, payload_size, (unsigned char*)dst,
+                           &context->work, context->dictionary);
+}
+
+/**
+ * Функция huffmanLoadBlockTable - запоминает таблицу кодов блока, не восстанавливая его
+ * @param context - контекст
+ * @param src - заголовок блока
+ * @param size - сколько байт доступно
+ * @param index - номер этого блока в кадре
+ * @return HUFFMAN_OK или HUFFMAN_ERROR_CORRUPT
+ *
+ * Ссылка BLOCK_MODE_REUSE всегда ведет на блок со своей таблицей, поэтому
+ * блок другого режима здесь означает поврежденные данные.
+ */
+int huffmanLoadBlockTable(HuffmanContext* context, const void* src, size_t size, unsigned int index) {
+    const unsigned char* input = (const unsigned char*)src;
+    BlockHeader header;
+    if (size < 4 || !parseBlockHeader(input, size, &header, (uint32_t)loadLittleEndian(input, 4)) ||
+        (header.mode != BLOCK_MODE_STATIC && header.mode != BLOCK_MODE_INTERLEAVED)) {
+        return HUFFMAN_ERROR_CORRUPT;
+    }
+    findSegmentTable(&context->segment, index, &header);
+    return HUFFMAN_OK;
+}
+
+/**
+ * Функция huffmanStoreStreamEnd - записывает признак конца потокового кадра
+ * @param total - общий размер исходных данных
+ * @param dst - куда записать (STREAM_END_SIZE байт)
+ */
+void huffmanStoreStreamEnd(unsigned long long total, void* dst) {
+    unsigned char* p = (unsigned char*)dst;
+    storeLittleEndian(p, 0, 4);                      // Нулевой размер блока
+    storeLittleEndian(p + 4, total, 8);
+}
+
+/**
+ * Функция huffmanIndexSize - размер индекса блоков кадра
+ * @param header - заголовок кадра
+ * @return количество байт индекса (0 - у кадра нет индекса)
+ */
+size_t huffmanIndexSize(const HuffmanFrameHeader* header) {
+    if (!(header->flags & CONTAINER_FLAG_INDEX)) {
+        return 0;
+    }
+    return (size_t)header->block_count * INDEX_ENTRY_SIZE + INDEX_TRAILER_SIZE;
+}
+
+/**
+ * Функция huffmanStoreIndex - записывает индекс блоков в конец кадра
+ * @param header - заголовок кадра
+ * @param offsets - смещения блоков от начала кадра
+ * @param index_offset - смещение, с которого начинается индекс
+ * @param dst - куда записать
+ */
+void huffmanStoreIndex(const HuffmanFrameHeader* header, const unsigned long long offsets[],
+                       unsigned long long index_offset, void* dst) {
+    unsigned char* buffer = (unsigned char*)dst;
+    ContainerHeader container;
+    toContainerHeader(header, &container);
+    for (uint32_t i = 0; i < container.block_count; i++) {
+        storeIndexEntry(buffer + (size_t)i * INDEX_ENTRY_SIZE, offsets[i], &container, i);
+    }
+    storeIndexTrailer(buffer + (size_t)container.block_count * INDEX_ENTRY_SIZE, index_offset);
+}
+
+/**
+ * Функция huffmanParseIndex - разбирает и проверяет индекс блоков
+ * @param header - заголовок кадра
+ * @param src - индекс
+ * @param frame_size - размер кадра
+ * @param offsets - сюда записываются смещения блоков
+ * @return HUFFMAN_OK или HUFFMAN_ERROR_CORRUPT
+ *
+ * Смещения должны идти по возрастанию, начинаться сразу за заголовком кадра
+ * и заканчиваться до начала индекса, а размеры - совпадать с размерами блоков.
+ */
+int huffmanParseIndex(const HuffmanFrameHeader* header, const void* src, unsigned long long frame_size,
+                      unsigned long long offsets[]) {
+    const unsigned char* index = (const unsigned char*)src;
+    uint64_t index_size = huffmanIndexSize(header);
+    if (index_size == 0 || frame_size < CONTAINER_HEADER_SIZE + index_size) {
+        return HUFFMAN_ERROR_CORRUPT;
+    }
+    uint64_t index_offset = frame_size - index_size;
+    const unsigned char* trailer = index + (size_t)index_size - INDEX_TRAILER_SIZE;
+    if (memcmp(trailer + 8, INDEX_MAGIC, 4) != 0 || loadLittleEndian(trailer, 8) != index_offset) {
+        return HUFFMAN_ERROR_CORRUPT;
+    }
+
+    uint64_t previous = 0;
+    for (uint32_t i = 0; i < header->block_count; i++) {
+        const unsigned char* entry = index + (size_t)i * INDEX_ENTRY_SIZE;
+        uint64_t start = (uint64_t)i * header->block_size;
+        uint64_t raw_size = header->original_size - start < header->block_size ?
+                            header->original_size - start : header->block_size;
+        offsets[i] = loadLittleEndian(entry, 8);
+        if ((i == 0 ? offsets[i] != CONTAINER_HEADER_SIZE : offsets[i] <= previous) ||
+            offsets[i] + BLOCK_PREFIX_SIZE > index_offset ||
+            loadLittleEndian(entry + 8, 4) != raw_size) {
+            return HUFFMAN_ERROR_CORRUPT;
+        }
+        previous = offsets[i];
+    }
+    return HUFFMAN_OK;
+}
+
+// ---------- Буферы целиком ----------
+
+/**
+ * Функция huffmanCompressBound - наибольший размер результата huffmanCompress
+ * @param context - контекст с параметрами сжатия (NULL - параметры по умолчанию)
+ * @param size - размер исходных данных
+ * @return размер выходного буфера, которого всегда достаточно
+ *
+ * Поток блока не длиннее его данных (см. encodeBlockWith), поэтому к исходному
+ * размеру добавляются только заголовки: кадра, блоков (по наибольшему
+ * размеру) и индекса.
+ */
+size_t huffmanCompressBound(const HuffmanContext* context, size_t size) {
+    size_t block_size = context != NULL ? context->options.block_size : DEFAULT_BLOCK_SIZE;
+    size_t block_count = size / block_size + (size % block_size != 0);
+    return CONTAINER_HEADER_SIZE + size +
+           block_count * (BLOCK_HEADER_MAX_SIZE + INDEX_ENTRY_SIZE) + INDEX_TRAILER_SIZE;
+}
+
+/**
+ * Функция huffmanCompress - сжимает буфер
+ * @param context - контекст
+ * @param src - исходные данные
+ * @param src_size - размер исходных данных
+ * @param dst - выходной буфер
+ * @param dst_capacity - размер выходного буфера
+ * @param dst_size - сюда записывается размер результата
+ * @return HUFFMAN_OK или код ошибки HUFFMAN_ERROR_*
+ *
+ * Кадр собирается теми же функциями, которыми программа пишет сжатый файл
+ * (huffmanBeginFrame, huffmanCompressBlock, huffmanStoreIndex), поэтому
+ * результат совпадает с файлом команды compress с теми же параметрами.
+ * С кэшем таблиц его счетчики накапливаются между вызовами, см.
+ * huffmanTableCacheStats.
+ */
+int huffmanCompress(HuffmanContext* context, const void* src, size_t src_size,
+                    void* dst, size_t dst_capacity, size_t* dst_size) {
+    const unsigned char* input = (const unsigned char*)src;
+    unsigned char* output = (unsigned char*)dst;
+    HuffmanFrameHeader header;
+    int status = huffmanBeginFrame(context, src_size, &header);
+    if (status != HUFFMAN_OK) {
+        return status;
+    }
+    if (dst_capacity < CONTAINER_HEADER_SIZE) {
+        return HUFFMAN_ERROR_DST_TOO_SMALL;
+    }
+    if (header.block_count > context->offsets_capacity) {
+        uint64_t* offsets = (uint64_t*)realloc(context->offsets, (size_t)header.block_count * sizeof(uint64_t));
+        if (offsets == NULL) {
+            return HUFFMAN_ERROR_MEMORY;
+        }
+        context->offsets = offsets;
+        context->offsets_capacity = header.block_count;
+    }
+
+    size_t position = huffmanStoreFrameHeader(&header, output);
+    for (uint32_t i = 0; i < header.block_count; i++) {
+        size_t start = (size_t)i * header.block_size;
+        size_t size = src_size - start < header.block_size ? src_size - start : header.block_size;
+        size_t block_size;
+        status = huffmanCompressBlock(context, input + start, size, i, output + position,
+                                      dst_capacity - position, &block_size);
+        if (status != HUFFMAN_OK) {
+            return status;
+        }
+        context->offsets[i] = position;
+        position += block_size;
+    }
+
+    size_t index_size = huffmanIndexSize(&header);
+    if (index_size > dst_capacity - position) {
+        return HUFFMAN_ERROR_DST_TOO_SMALL;
+    }
+    if (index_size > 0) {
+        ContainerHeader container;
+        toContainerHeader(&header, &container);
+        storeBlockIndex(output + position, context->offsets, &container, position);
+        position += index_size;
+    }
+    *dst_size = position;
+    return HUFFMAN_OK;
+}
+
+/**
+ * Функция huffmanTableCacheStats - счетчики кэша таблиц кодов контекста
+ * @param context - контекст
+ * @param stats - структура для заполнения
+ */
+void huffmanTableCacheStats(const HuffmanContext* context, HuffmanCacheStats* stats) {
+    stats->lookups = context->cache.lookups;
+    stats->hits = context->cache.hits;
+    stats->signature_hits = context->cache.signature_hits;
+    stats->saved_bytes = context->cache.saved_bytes;
+}
+
+/**
+ * Функция findIndexedBlock - находит смещение блока по индексу в конце сжатого буфера
+ * @param input - сжатые данные
+ * @param input_size - размер сжатых данных
+ * @param header - разобранный заголовок (с флагом CONTAINER_FLAG_INDEX)
+ * @param index - номер блока
+ * @param offset - сюда записывается смещение блока от начала данных
+ * @return 1 при успехе, 0 если индекс отсутствует или элемент поврежден
+ *
+ * Читается только окончание индекса и один его элемент, поэтому блок
+ * находится за постоянное время при любой длине данных (ср. huffmanParseIndex).
+ */
+static int findIndexedBlock(const unsigned char* input, size_t input_size, const ContainerHeader* header,
+                            uint32_t index, uint64_t* offset) {
+    uint64_t index_size = (uint64_t)header->block_count * INDEX_ENTRY_SIZE + INDEX_TRAILER_SIZE;
+    if (index >= header->block_count || input_size < CONTAINER_HEADER_SIZE + index_size) {
+        return 0;
+    }
+    uint64_t index_offset = input_size - index_size;
+    const unsigned char* trailer = input + input_size - INDEX_TRAILER_SIZE;
+    const unsigned char* entry = input + index_offset + (size_t)index * INDEX_ENTRY_SIZE;
+    uint64_t start = (uint64_t)index * header->block_size;
+    uint64_t raw_size = header->original_size - start < header->block_size ?
+                        header->original_size - start : header->block_size;
+    *offset = loadLittleEndian(entry, 8);
+    return memcmp(trailer + 8, INDEX_MAGIC, 4) == 0 && loadLittleEndian(trailer, 8) == index_offset &&
+           *offset >= CONTAINER_HEADER_SIZE && *offset + BLOCK_PREFIX_SIZE <= index_offset &&
+           loadLittleEndian(entry + 8, 4) == raw_size;
+}
+
+/**
+ * Функция decompressBuffer - проходит блоки сжатого буфера и восстанавливает байты из диапазона
+ * @param context - контекст с рабочей памятью и словарем (NULL - только проверить границы блоков)
+ * @param input - сжатые данные
+ * @param input_size - размер сжатых данных
+ * @param start - смещение первого нужного байта исходных данных
+ * @param end - смещение за последним нужным байтом (UINT64_MAX - до конца)
+ * @param output - выходной буфер для байтов [start, end) (не используется при context == NULL)
+ * @param capacity - размер выходного буфера
+ * @param written - сюда записывается количество байтов диапазона (без context - тоже)
+ * @return HUFFMAN_OK или код ошибки HUFFMAN_ERROR_*
+ *
+ * Понимает оба формата: с размерами в заголовке и потоковый
+ * (CONTAINER_FLAG_STREAM), где блоки идут до признака конца. Перед
+ * декодированием каждого блока проверяется, что его заголовок и поток
+ * целиком лежат во входе.
+ *
+ * Декодируются только блоки, пересекающие диапазон: у остальных
+ * разбирается заголовок, чтобы найти следующий блок и запомнить таблицу
+ * кодов для блоков BLOCK_MODE_REUSE. Если в конце есть индекс блоков,
+ * проход начинается сразу с сегмента кэша таблиц, в котором лежит первый
+ * нужный блок. Блок, который диапазон задевает не целиком, декодируется
+ * в буфер контекста, и в выход копируется только нужная часть.
+ */
+static int decompressBuffer(HuffmanContext* context, const unsigned char* input, size_t input_size,
+                            uint64_t start, uint64_t end, unsigned char* output, size_t capacity,
+                            uint64_t* written) {
+    ContainerHeader header;
+    *written = 0;
+    if (input_size < HUFFMAN_FRAME_PREFIX_SIZE || input_size < containerHeaderSize(input[5]) ||
+        !parseContainerHeader(input, &header)) {
+        return HUFFMAN_ERROR_CORRUPT;
+    }
+    int stream = (header.flags & CONTAINER_FLAG_STREAM) != 0;
+    if (!stream) {
+        end = end < header.original_size ? end : header.original_size;
+        start = start < end ? start : end;
+        if (context != NULL && end - start > capacity) {
+            return HUFFMAN_ERROR_DST_TOO_SMALL;
+        }
+    }
+    SegmentTables segment;                           // Таблицы для блоков BLOCK_MODE_REUSE
+    memset(segment.block, 0, sizeof(segment.block));
+
+    uint32_t first = 0;                              // Блок, с которого начинается проход
+    uint64_t position = containerHeaderSize(header.flags);
+    uint64_t offset = 0;                             // Смещение исходных данных блока first
+    if (!stream && (header.flags & CONTAINER_FLAG_INDEX) && start < end) {
+        uint32_t segment_start = (uint32_t)(start / header.block_size);
+        segment_start -= segment_start % TABLE_CACHE_SEGMENT;
+        if (findIndexedBlock(input, input_size, &header, segment_start, &position)) {
+            first = segment_start;
+            offset = (uint64_t)segment_start * header.block_size;
+        } else {
+            position = CONTAINER_HEADER_SIZE;        // Индекс поврежден: блоки ищутся по заголовкам
+        }
+    }
+
+    for (uint32_t i = first;; i++) {
+        uint32_t expected;
+        if (stream) {
+            if (input_size - position < 4) {
+                return HUFFMAN_ERROR_CORRUPT;        // Поток обрезан: нет признака конца
+            }
+            expected = (uint32_t)loadLittleEndian(input + position, 4);
+            if (expected == 0) {
+                // Признак конца: общий размер должен совпасть с восстановленным
+                if (input_size - position < STREAM_END_SIZE ||
+                    loadLittleEndian(input + position + 4, 8) != offset) {
+                    return HUFFMAN_ERROR_CORRUPT;
+                }
+                return HUFFMAN_OK;
+            }
+            if (expected > header.block_size) {
+                return HUFFMAN_ERROR_CORRUPT;
+            }
+        } else {
+            if (i == header.block_count) {
+                return HUFFMAN_OK;
+            }
+            expected = (uint32_t)(header.original_size - offset < header.block_size ?
+                                  header.original_size - offset : header.block_size);
+        }
+        if (offset >= end) {
+            return HUFFMAN_OK;                       // Диапазон восстановлен, дальше блоки не нужны
+        }
+
+        BlockHeader block;
+        if (!parseBlockHeader(input + position, input_size - position, &block, expected)) {
+            return HUFFMAN_ERROR_CORRUPT;
+        }
+        size_t payload_size = ((size_t)block.bit_count + 7) / 8;
+        if (payload_size > input_size - position - block.size) {
+            return HUFFMAN_ERROR_CORRUPT;            // Данные обрезаны
+        }
+        uint64_t from = start > offset ? start : offset;
+        uint64_t to = end < offset + expected ? end : offset + expected;
+        if (context != NULL) {
+            if (!findSegmentTable(&segment, i, &block)) {
+                return HUFFMAN_ERROR_CORRUPT;        // Ссылка на таблицу, которой в сегменте нет
+            }
+            if (from < to && to - from > capacity - *written) {
+                return HUFFMAN_ERROR_DST_TOO_SMALL;
+            }
+            int whole = from == offset && to == offset + expected;
+            if (from < to && !whole && expected > context->scratch_capacity) {
+                unsigned char* scratch = (unsigned char*)realloc(context->scratch, header.block_size);
+                if (scratch == NULL) {
+                    return HUFFMAN_ERROR_MEMORY;
+                }
+                context->scratch = scratch;
+                context->scratch_capacity = header.block_size;
+            }
+            if (from < to) {
+                int status = decodeBlockWith(&block, input + position + block.size, payload_size,
+                                             whole ? output + *written : context->scratch,
+                                             &context->work, context->dictionary);
+                if (status != HUFFMAN_OK) {
+                    return status;
+                }
+                if (!whole) {
+                    memcpy(output + *written, context->scratch + (from - offset), (size_t)(to - from));
+                }
+            }
+        }
+        if (from < to) {
+            *written += to - from;
+        }
+        position += block.size + payload_size;
+        offset += expected;
+    }
+}
+
+/**
+ * Функция huffmanDecompressedSize - размер исходных данных сжатого буфера
+ * @param src - сжатые данные
+ * @param src_size - размер сжатых данных
+ * @param size - сюда записывается размер исходных данных
+ * @return HUFFMAN_OK или HUFFMAN_ERROR_CORRUPT
+ *
+ * Обычно размер берется из заголовка; в потоковом формате он известен
+ * только из признака конца, поэтому проходятся заголовки всех блоков.
+ */
+int huffmanDecompressedSize(const void* src, size_t src_size, unsigned long long* size) {
+    const unsigned char* input = (const unsigned char*)src;
+    ContainerHeader header;
+    if (src_size < HUFFMAN_FRAME_PREFIX_SIZE || src_size < containerHeaderSize(input[5]) ||
+        !parseContainerHeader(input, &header)) {
+        return HUFFMAN_ERROR_CORRUPT;
+    }
+    uint64_t total = header.original_size;
+    if (header.flags & CONTAINER_FLAG_STREAM) {
+        int status = decompressBuffer(NULL, input, src_size, 0, UINT64_MAX, NULL, 0, &total);
+        if (status != HUFFMAN_OK) {
+            return status;
+        }
+    }
+    *size = total;
+    return HUFFMAN_OK;
+}
+
+/**
+ * Функция huffmanDecompress - восстанавливает сжатый буфер
+ * @param context - контекст (параметры сжатия не важны)
+ * @param src - сжатые данные
+ * @param src_size - размер сжатых данных
+ * @param dst - выходной буфер
+ * @param dst_capacity - размер выходного буфера
+ * @param dst_size - сюда записывается размер восстановленных данных
+ * @return HUFFMAN_OK или код ошибки HUFFMAN_ERROR_*
+ *
+ * Блоки декодируются прямо в dst; таблицы декодирования берутся из
+ * контекста и перестраиваются для каждого блока без выделения памяти.
+ */
+int huffmanDecompress(HuffmanContext* context, const void* src, size_t src_size,
+                      void* dst, size_t dst_capacity, size_t* dst_size) {
+    uint64_t written = 0;
+    int status = decompressBuffer(context, (const unsigned char*)src, src_size, 0, UINT64_MAX,
+                                  (unsigned char*)dst, dst_capacity, &written);
+    *dst_size = (size_t)written;
+    return status;
+}
+
+/**
+ * Функция huffmanDecompressRange - восстанавливает часть исходных данных сжатого буфера
+ * @param context - контекст (параметры сжатия не важны)
+ * @param src - сжатые данные
+ * @param src_size - размер сжатых данных
+ * @param offset - смещение первого нужного байта исходных данных
+ * @param length - количество нужных байтов
+ * @param dst - выходной буфер
+ * @param dst_capacity - размер выходного буфера
+ * @param dst_size - сюда записывается размер восстановленной части
+ * @return HUFFMAN_OK или код ошибки HUFFMAN_ERROR_*
+ *
+ * Блок с байтом offset - это блок номер offset / размер блока, а его
+ * место в src берется из индекса блоков, поэтому декодируются только
+ * блоки, пересекающие диапазон (см. decompressBuffer).
+ */
+int huffmanDecompressRange(HuffmanContext* context, const void* src, size_t src_size,
+                           unsigned long long offset, size_t length,
+                           void* dst, size_t dst_capacity, size_t* dst_size) {
+    uint64_t written = 0;
+    uint64_t end = (uint64_t)length > UINT64_MAX - offset ? UINT64_MAX : offset + length;
+    int status = decompressBuffer(context, (const unsigned char*)src, src_size, offset, end,
+                                  (unsigned char*)dst, dst_capacity, &written);
+    *dst_size = (size_t)written;
+    return status;
+}
+
+/**
+ * Функция huffmanErrorString - описание кода результата
+ * @param code - код HUFFMAN_OK или HUFFMAN_ERROR_*
+ * @return строка с описанием
+ */
+const char* huffmanErrorString(int code) {
+    switch (code) {
+        case HUFFMAN_OK:                  return "успех";
+        case HUFFMAN_ERROR_DST_TOO_SMALL: return "выходной буфер слишком мал";
+        case HUFFMAN_ERROR_CORRUPT:       return "данные повреждены или не являются сжатыми";
+        case HUFFMAN_ERROR_PARAMS:        return "недопустимые параметры";
+        case HUFFMAN_ERROR_MEMORY:        return "не хватило памяти";
+        case HUFFMAN_ERROR_DICTIONARY:    return "блок сжат со словарем, которого нет";
+        case HUFFMAN_ERROR_TABLE:         return "блок ссылается на недоступную таблицу кодов";
+        default:                          return "неизвестная ошибка";
+    }
+}
+
+// ---------- Словари ----------
+
+/**
+ * Функция huffmanTrainDictionary - строит словарь по частотам байтов образцов
+ * @param frequencies - суммарные частоты байтов всех образцов
+ * @param max_code_length - ограничение длины кода словаря
+ * @param dst - куда записать словарь
+ * @param dst_capacity - размер буфера
+ * @param stats - сюда записываются сведения о словаре (NULL - не нужны)
+ * @return HUFFMAN_OK или код ошибки HUFFMAN_ERROR_*
+ */
+int huffmanTrainDictionary(const unsigned long long frequencies[256], int max_code_length,
+                           void* dst, size_t dst_capacity, HuffmanDictionaryStats* stats) {
+    if (max_code_length < MIN_CODE_LENGTH_LIMIT || max_code_length > DECODE_MAX_CODE_LENGTH) {
+        return HUFFMAN_ERROR_PARAMS;
+    }
+    if (dst_capacity < DICTIONARY_FILE_SIZE) {
+        return HUFFMAN_ERROR_DST_TOO_SMALL;
+    }
+    uint64_t totals[ASCII_SIZE];
+    for (int s = 0; s < ASCII_SIZE; s++) {
+        totals[s] = frequencies[s];
+    }
+    return trainDictionary(totals, max_code_length, (unsigned char*)dst, stats);
+}
+
+/**
+ * Функция huffmanDictionaryId - проверяет словарь и вычисляет его идентификатор
+ * @param dictionary - содержимое файла словаря
+ * @param size - размер содержимого
+ * @param id - сюда записывается идентификатор
+ * @return HUFFMAN_OK, HUFFMAN_ERROR_PARAMS или HUFFMAN_ERROR_MEMORY
+ */
+int huffmanDictionaryId(const void* dictionary, size_t size, unsigned int* id) {
+    Dictionary parsed;
+    int status = parseDictionary((const unsigned char*)dictionary, size, &parsed);
+    if (status == HUFFMAN_OK) {
+        *id = parsed.id;
+        freeDictionary(&parsed);
+    }
+    return status;
+}
+
+// ---------- Коды одного буфера ----------
+
+/**
+ * Функция huffmanCountFrequencies - частоты байтов буфера
+ * @param src - данные
+ * @param size - размер данных
+ * @param frequencies - массив для сохранения частот (индекс = байт)
+ */
+void huffmanCountFrequencies(const void* src, size_t size, unsigned int frequencies[256]) {
+    countFrequenciesBuffer((const unsigned char*)src, size, frequencies);
+}
+
+/**
+ * Функция huffmanBuildCodes - канонические коды Хаффмана по частотам
+ * @param frequencies - частоты байтов
+ * @param max_length - наибольшая длина кода (от 8 до 56; 0 - без ограничения)
+ * @param codes - сюда записываются коды
+ * @return HUFFMAN_OK или HUFFMAN_ERROR_PARAMS
+ */
+int huffmanBuildCodes(const unsigned int frequencies[256], int max_length, HuffmanCode codes[256]) {
+    if (max_length != 0 && (max_length < MIN_CODE_LENGTH_LIMIT || max_length > DECODE_MAX_CODE_LENGTH)) {
+        return HUFFMAN_ERROR_PARAMS;
+    }
+    HuffmanArena arena;
+    buildCodeLengths(&arena, frequencies, max_length, codes);
+    assignCanonicalCodes(codes);
+    return HUFFMAN_OK;
+}
+
+/**
+ * Функция huffmanCanonicalCodes - заменяет коды каноническими кодами той же длины
+ * @param codes - коды; используются только длины
+ */
+void huffmanCanonicalCodes(HuffmanCode codes[256]) {
+    assignCanonicalCodes(codes);
+}
+
+/**
+ * Функция huffmanEncodeBound - наибольший размер результата huffmanEncodeBits
+ * @param codes - коды
+ * @param size - размер исходных данных
+ * @return размер выходного буфера (с запасом на запись аккумулятора словом)
+ */
+size_t huffmanEncodeBound(const HuffmanCode codes[256], size_t size) {
+    int max_length = 0;
+    for (int i = 0; i < ASCII_SIZE; i++) {
+        if (codes[i].length > max_length) {
+            max_length = codes[i].length;
+        }
+    }
+    return (size * (size_t)max_length + 7) / 8 + BLOCK_SLACK;
+}
+
+/**
+ * Функция huffmanEncodeBits - кодирует буфер готовыми кодами в битовый поток
+ * @param codes - коды (у каждого байта данных ненулевая длина)
+ * @param src - исходные данные
+ * @param size - размер данных
+ * @param dst - выходной буфер
+ * @param dst_capacity - размер выходного буфера
+ * @param bit_count - сюда записывается количество значимых битов потока
+ * @return HUFFMAN_OK, HUFFMAN_ERROR_DST_TOO_SMALL или HUFFMAN_ERROR_PARAMS (код длиннее 56 бит)
+ */
+int huffmanEncodeBits(const HuffmanCode codes[256], const void* src, size_t size,
+                      void* dst, size_t dst_capacity, unsigned long long* bit_count) {
+    uint64_t aligned[ASCII_SIZE];
+    int lengths[ASCII_SIZE];
+    int max_length = 0;
+    for (int i = 0; i < ASCII_SIZE; i++) {
+        lengths[i] = codes[i].length;
+        aligned[i] = codes[i].length > 0 ? codes[i].value << (64 - codes[i].length) : 0;
+        if (codes[i].length > max_length) {
+            max_length = codes[i].length;
+        }
+    }
+    if (max_length > DECODE_MAX_CODE_LENGTH) {
+        return HUFFMAN_ERROR_PARAMS;                 // Код с остатком аккумулятора не помещается в 64 бита
+    }
+    if (dst_capacity < huffmanEncodeBound(codes, size)) {
+        return HUFFMAN_ERROR_DST_TOO_SMALL;
+    }
+
+    ProfileSample sample;
+    PROFILE_BEGIN(sample);
+    BitWriter writer = {(unsigned char*)dst, 0, 0, 0};
+    encodeBuffer(&writer, (const unsigned char*)src, size, aligned, lengths, max_length);
+    *bit_count = (uint64_t)writer.pos * BYTE_SIZE + (uint64_t)writer.count;
+    if (writer.count > 0) {
+        writer.buffer[writer.pos++] = (unsigned char)(writer.bits >> 56);
+    }
+    PROFILE_END(PROFILE_ENCODE, sample, size, writer.pos);
+    return HUFFMAN_OK;
+}
+
+/**
+ * Функция huffmanCreateDecodeTable - строит таблицу быстрого декодирования кодов
+ * @param codes - префиксные коды (не длиннее 56 бит)
+ * @return таблица или NULL, если коды недопустимы или не хватило памяти
+ */
+HuffmanDecodeTable* huffmanCreateDecodeTable(const HuffmanCode codes[256]) {
+    unsigned char lengths[ASCII_SIZE];
+    for (int i = 0; i < ASCII_SIZE; i++) {
+        if (codes[i].length < 0 || codes[i].length > DECODE_MAX_CODE_LENGTH) {
+            return NULL;
+        }
+        lengths[i] = (unsigned char)codes[i].length;
+    }
+    if (!validateCodeLengths(lengths)) {
+        return NULL;
+    }
+    HuffmanDecodeTable* table = (HuffmanDecodeTable*)malloc(sizeof(HuffmanDecodeTable));
+    if (table == NULL) {
+        return NULL;
+    }
+    ProfileSample sample;
+    PROFILE_BEGIN(sample);
+    int built = buildDecodeTable(&table->table, codes);
+    PROFILE_END(PROFILE_BUILD, sample, 0, 0);
+    if (!built) {
+        freeDecodeTable(&table->table);
+        free(table);
+        return NULL;
+    }
+    return table;
+}
+
+/**
+ * Функция huffmanDecodeBits - декодирует битовый поток huffmanEncodeBits
+ * @param table - таблица декодирования
+ * @param src - поток
+ * @param src_size - размер потока в байтах
+ * @param bit_count - количество значимых битов потока
+ * @param dst - выходной буфер
+ * @param dst_size - ожидаемое количество символов
+ * @return HUFFMAN_OK или HUFFMAN_ERROR_CORRUPT
+ */
+int huffmanDecodeBits(const HuffmanDecodeTable* table, const void* src, size_t src_size,
+                      unsigned long long bit_count, void* dst, size_t dst_size) {
+    if (bit_count > (uint64_t)src_size * BYTE_SIZE) {
+        return HUFFMAN_ERROR_CORRUPT;
+    }
+    ProfileSample sample;
+    PROFILE_BEGIN(sample);
+    BitReader reader = {(const unsigned char*)src, 0, src_size, 0, 0};
+    uint64_t remaining = bit_count;
+    size_t produced = decodeBits(&reader, &table->table, &remaining, (unsigned char*)dst, dst_size);
+    PROFILE_END(PROFILE_DECODE, sample, src_size, produced);
+    return produced == dst_size && remaining == 0 ? HUFFMAN_OK : HUFFMAN_ERROR_CORRUPT;
+}
+
+/**
+ * Функция huffmanFreeDecodeTable - освобождает таблицу декодирования
+ * @param table - таблица (NULL допускается)
+ */
+void huffmanFreeDecodeTable(HuffmanDecodeTable* table) {
+    if (table == NULL) {
+        return;
+    }
+    freeDecodeTable(&table->table);
+    free(table);
+}
+
+/**
+ * Функция huffmanCrc32 - обновляет контрольную сумму CRC-32 блоком данных
+ * @param crc - текущее значение (0 для начала вычисления)
+ * @param data - данные
+ * @param size - размер данных
+ * @return новое значение
+ */
+unsigned int huffmanCrc32(unsigned int crc, const void* data, size_t size) {
+    ProfileSample sample;
+    PROFILE_BEGIN(sample);
+    uint32_t result = crc32Update(crc, (const unsigned char*)data, size);
+    PROFILE_END(PROFILE_CHECK, sample, size, 0);
+    return result;
+}
@@ -0,0 +1,561 @@
+/*
+ * Библиотека libhuffman: сжатие и восстановление данных кодами Хаффмана
+ *
+ * Формат результата тот же, что у сжатого файла программы (контейнер
+ * "HUFF" с блоками и индексом), поэтому данные, сжатые библиотекой,
+ * восстанавливаются командой decompress, и наоборот. Сама программа
+ * (main.c) работает с форматом только через эти функции.
+ *
+ * Пример:
+ *   HuffmanContext* context = huffmanCreateContext(NULL);
+ *   size_t capacity = huffmanCompressBound(context, size);
+ *   unsigned char* packed = malloc(capacity);
+ *   size_t packed_size;
+ *   if (huffmanCompress(context, data, size, packed, capacity, &packed_size) != HUFFMAN_OK) { ... }
+ *   ...
+ *   huffmanFreeContext(context);
+ *
+ * Функции трех уровней:
+ *   - буферы целиком: huffmanCompress, huffmanDecompress, huffmanDecompressRange;
+ *   - кадр по частям: заголовок (huffmanBeginFrame, huffmanStoreFrameHeader,
+ *     huffmanParseFrameHeader), блоки (huffmanCompressBlock,
+ *     huffmanDecompressBlock) и индекс блоков - для файлов и потоков,
+ *     которые не помещаются в память целиком, и для сжатия блоков
+ *     несколькими потоками;
+ *   - коды Хаффмана одного буфера без формата (huffmanBuildCodes,
+ *     huffmanEncodeBits, huffmanDecodeBits) - для замеров и сравнения.
+ *
+ * Контекст хранит буферы, таблицы декодирования и рабочую память
+ * кодировщиков между вызовами, поэтому после первых блоков повторные
+ * вызовы с тем же контекстом не выделяют память. Один контекст нельзя
+ * использовать из нескольких потоков одновременно; разные контексты
+ * независимы. Библиотека не завершает процесс и ничего не выводит:
+ * нехватка памяти и поврежденные данные возвращаются кодами HUFFMAN_ERROR_*.
+ */
+
+#ifndef HUFFMAN_H
+#define HUFFMAN_H
+
+#include <stddef.h>     // size_t
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Коды результата функций библиотеки
+#define HUFFMAN_OK 0                    // Успех
+#define HUFFMAN_ERROR_DST_TOO_SMALL -1  // Результат не помещается в выходной буфер
+#define HUFFMAN_ERROR_CORRUPT -2        // Входные данные не являются корректным сжатым буфером
+#define HUFFMAN_ERROR_PARAMS -3         // Недопустимые параметры или слишком большой вход
+#define HUFFMAN_ERROR_MEMORY -4         // Не хватило памяти
+#define HUFFMAN_ERROR_DICTIONARY -5     // Блок сжат со словарем, которого нет у контекста
+#define HUFFMAN_ERROR_TABLE -6          // Блок ссылается на таблицу кодов, которой нет у контекста
+
+// Режимы блоков (params.mode - STATIC, ADAPTIVE, ORDER1 или UTF8; остальные выбирает кодировщик)
+#define HUFFMAN_MODE_STATIC 0           // Своя таблица канонических кодов на блок
+#define HUFFMAN_MODE_ADAPTIVE 1         // Адаптивный код Хаффмана (без таблицы)
+#define HUFFMAN_MODE_ORDER1 2           // Таблица кодов выбирается по предыдущему байту
+#define HUFFMAN_MODE_DICTIONARY 3       // Коды из обученного словаря (см. huffmanSetDictionary)
+#define HUFFMAN_MODE_REUSE 4            // Таблица кодов одного из предыдущих блоков (params.table_cache)
+#define HUFFMAN_MODE_INTERLEAVED 5      // Своя таблица, блок разбит на независимые потоки (params.streams)
+#define HUFFMAN_MODE_STORED 6           // Данные без сжатия
+#define HUFFMAN_MODE_RUNS 7             // Серии одинаковых байт
+#define HUFFMAN_MODE_PACKED 8           // Номера символов малого алфавита фиксированной ширины
+#define HUFFMAN_MODE_UTF8 9             // Символы - кодовые точки UTF-8 (недопустимый UTF-8 - байты)
+#define HUFFMAN_MODE_COUNT 10           // Количество режимов блоков
+
+// Флаги заголовка кадра (сжатых данных)
+#define HUFFMAN_FRAME_INDEX 0x01        // В конце кадра есть индекс блоков
+#define HUFFMAN_FRAME_STREAM 0x02       // Потоковый кадр: размеры неизвестны, блоки идут до признака конца
+#define HUFFMAN_FRAME_COMPACT 0x04      // Короткий заголовок: одна запись, сжатая со словарем, без индекса
+
+#define HUFFMAN_FRAME_PREFIX_SIZE 6         // Столько байт заголовка нужно huffmanFrameHeaderSize
+#define HUFFMAN_FRAME_HEADER_MAX_SIZE 22    // Наибольший размер заголовка кадра
+#define HUFFMAN_BLOCK_PREFIX_SIZE 13        // Общая часть заголовка блока: по ней huffmanBlockHeaderSize
+#define HUFFMAN_STREAM_END_SIZE 12          // Размер признака конца потокового кадра
+#define HUFFMAN_UNKNOWN_SIZE (~0ULL)        // Размер данных потокового кадра (huffmanBeginFrame)
+#define HUFFMAN_DICTIONARY_SIZE 263         // Размер обученного словаря в байтах
+
+/*
+ * Структура HuffmanParams - параметры сжатия
+ */
+typedef struct HuffmanParams {
+    unsigned int block_size;    // Размер блока в байтах (от 1 до 64 MiB)
+    int mode;                   // Режим блоков HUFFMAN_MODE_*
+    int max_code_length;        // Ограничение длины кода в битах (от 8 до 56)
+    int table_cache;            // Кэш таблиц: допустимая потеря сжатия в процентах (от 0 до 100, -1 - выключен)
+    int streams;                // Независимых битовых потоков в блоке (от 1 до 16; 4 - быстрее восстановление)
+} HuffmanParams;
+
+/*
+ * Структура HuffmanFrameHeader - заголовок кадра (сжатых данных)
+ */
+typedef struct HuffmanFrameHeader {
+    int flags;                          // Флаги HUFFMAN_FRAME_*
+    unsigned long long original_size;   // Размер исходных данных (у потокового кадра - 0)
+    unsigned int block_size;            // Размер блока
+    unsigned int block_count;           // Количество блоков (у потокового кадра - 0)
+} HuffmanFrameHeader;
+
+/*
+ * Структура HuffmanBlockInfo - сведения о сжатом блоке из его заголовка
+ */
+typedef struct HuffmanBlockInfo {
+    unsigned int raw_size;          // Размер исходных данных блока (0 - признак конца потокового кадра)
+    size_t header_size;             // Размер заголовка блока
+    size_t record_size;             // Размер блока целиком: заголовок и поток
+    int mode;                       // Режим блока HUFFMAN_MODE_*
+    int distance;                   // HUFFMAN_MODE_REUSE: на сколько блоков назад лежит таблица
+    unsigned int dictionary_id;     // HUFFMAN_MODE_DICTIONARY: идентификатор словаря
+    unsigned long long stream_total; // Признак конца потокового кадра: общий размер данных
+} HuffmanBlockInfo;
+
+/*
+ * Структура HuffmanCacheStats - счетчики кэша таблиц кодов (params.table_cache >= 0)
+ */
+typedef struct HuffmanCacheStats {
+    unsigned long long lookups;         // Статических блоков, для которых искалась таблица
+    unsigned long long hits;            // Из них сжато таблицей предыдущего блока
+    unsigned long long signature_hits;  // Из них найдено по совпадению сигнатуры гистограммы
+    unsigned long long saved_bytes;     // Сэкономлено байт заголовков блоков
+} HuffmanCacheStats;
+
+/*
+ * Структура HuffmanDictionaryStats - сведения об обученном словаре
+ */
+typedef struct HuffmanDictionaryStats {
+    unsigned int id;                // Идентификатор словаря (записывается в блоки)
+    int escape;                     // Escape-символ (-1 - в образцах встречались все байты)
+    int distinct;                   // Различных байтов в образцах
+    double bits_per_byte;           // Средняя длина кода словаря на образцах
+} HuffmanDictionaryStats;
+
+/*
+ * Структура HuffmanCode - код символа: младшие length битов value, первым идет старший
+ */
+typedef struct HuffmanCode {
+    unsigned long long value;       // Двоичный код, упакованный в целое число
+    int length;                     // Длина кода в битах (0 - символ не встречается)
+} HuffmanCode;
+
+/*
+ * Структура HuffmanProfileSample - показания в начале замеряемого участка (см. HuffmanProfiler)
+ */
+typedef struct HuffmanProfileSample {
+    double start;                       // Время начала
+    unsigned long long counters[4];     // Аппаратные счетчики в начале
+} HuffmanProfileSample;
+
+// Стадии, которые кодек сообщает профилировщику
+#define HUFFMAN_STAGE_HISTOGRAM 1       // Подсчет частот
+#define HUFFMAN_STAGE_BUILD 2           // Построение кодов и таблиц декодирования
+#define HUFFMAN_STAGE_ENCODE 3          // Кодирование
+#define HUFFMAN_STAGE_DECODE 4          // Декодирование
+#define HUFFMAN_STAGE_CHECK 5           // Контрольная сумма CRC-32
+
+/*
+ * Структура HuffmanProfiler - обработчики замеров стадий кодека
+ * begin заполняет показания в начале участка, end добавляет участок
+ * к стадии HUFFMAN_STAGE_* вместе с количеством байт на входе и выходе.
+ */
+typedef struct HuffmanProfiler {
+    void (*begin)(HuffmanProfileSample* sample);
+    void (*end)(int stage, const HuffmanProfileSample* sample,
+                unsigned long long bytes_in, unsigned long long bytes_out);
+} HuffmanProfiler;
+
+// Непрозрачный контекст: буферы и таблицы, переиспользуемые между вызовами
+typedef struct HuffmanContext HuffmanContext;
+
+// Непрозрачная таблица декодирования кодов одного буфера (huffmanDecodeBits)
+typedef struct HuffmanDecodeTable HuffmanDecodeTable;
+
+// ---------- Контекст ----------
+
+/**
+ * Функция huffmanDefaultParams - параметры сжатия по умолчанию
+ * @param params - структура для заполнения (блок 1 MiB, статический режим, коды до 15 бит, без кэша таблиц, один поток)
+ */
+void huffmanDefaultParams(HuffmanParams* params);
+
+/**
+ * Функция huffmanCreateContext - создает контекст сжатия и восстановления
+ * @param params - параметры сжатия (NULL - параметры по умолчанию)
+ * @return контекст или NULL, если параметры недопустимы или не хватило памяти
+ */
+HuffmanContext* huffmanCreateContext(const HuffmanParams* params);
+
+/**
+ * Функция huffmanFreeContext - освобождает контекст и все его буферы
+ * @param context - контекст (NULL допускается)
+ */
+void huffmanFreeContext(HuffmanContext* context);
+
+/**
+ * Функция huffmanSetDictionary - задает контексту обученный словарь
+ * @param context - контекст
+ * @param dictionary - содержимое файла словаря, созданного командой train
+ * @param size - размер содержимого
+ * @return HUFFMAN_OK, HUFFMAN_ERROR_PARAMS, если данные не являются словарем, или HUFFMAN_ERROR_MEMORY
+ *
+ * После этого блоки сжимаются кодами словаря без таблицы в блоке
+ * (выгодно для записей в сотни байт), а блоки, сжатые с этим словарем,
+ * восстанавливаются. Запись, помещающаяся в один блок, получает короткий
+ * заголовок без индекса (27 служебных байт вместо 63).
+ */
+int huffmanSetDictionary(HuffmanContext* context, const void* dictionary, size_t size);
+
+/**
+ * Функция huffmanSetProfiler - задает обработчики замеров стадий кодека
+ * @param handlers - обработчики (NULL - замеры выключены)
+ *
+ * Действует на все контексты процесса; задается до запуска потоков,
+ * которые сжимают или восстанавливают данные.
+ */
+void huffmanSetProfiler(const HuffmanProfiler* handlers);
+
+// ---------- Буферы целиком ----------
+
+/**
+ * Функция huffmanCompressBound - наибольший размер результата huffmanCompress
+ * @param context - контекст с параметрами сжатия (NULL - параметры по умолчанию)
+ * @param size - размер исходных данных
+ * @return размер выходного буфера, которого всегда достаточно
+ */
+size_t huffmanCompressBound(const HuffmanContext* context, size_t size);
+
+/**
+ * Функция huffmanCompress - сжимает буфер
+ * @param context - контекст
+ * @param src - исходные данные
+ * @param src_size - размер исходных данных
+ * @param dst - выходной буфер
+ * @param dst_capacity - размер выходного буфера
+ * @param dst_size - сюда записывается размер результата
+ * @return HUFFMAN_OK или код ошибки HUFFMAN_ERROR_*
+ */
+int huffmanCompress(HuffmanContext* context, const void* src, size_t src_size,
+                    void* dst, size_t dst_capacity, size_t* dst_size);
+
+/**
+ * Функция huffmanDecompressedSize - размер исходных данных сжатого буфера
+ * @param src - сжатые данные
+ * @param src_size - размер сжатых данных
+ * @param size - сюда записывается размер исходных данных
+ * @return HUFFMAN_OK или HUFFMAN_ERROR_CORRUPT
+ */
+int huffmanDecompressedSize(const void* src, size_t src_size, unsigned long long* size);
+
+/**
+ * Функция huffmanDecompress - восстанавливает сжатый буфер
+ * @param context - контекст (параметры сжатия не важны)
+ * @param src - сжатые данные
+ * @param src_size - размер сжатых данных
+ * @param dst - выходной буфер
+ * @param dst_capacity - размер выходного буфера
+ * @param dst_size - сюда записывается размер восстановленных данных
+ * @return HUFFMAN_OK или код ошибки HUFFMAN_ERROR_*
+ *
+ * Проверяются границы всех блоков и контрольная сумма каждого блока.
+ */
+int huffmanDecompress(HuffmanContext* context, const void* src, size_t src_size,
+                      void* dst, size_t dst_capacity, size_t* dst_size);
+
+/**
+ * Функция huffmanDecompressRange - восстанавливает часть исходных данных сжатого буфера
+ * @param context - контекст (параметры сжатия не важны)
+ * @param src - сжатые данные
+ * @param src_size - размер сжатых данных
+ * @param offset - смещение первого нужного байта исходных данных
+ * @param length - количество нужных байтов
+ * @param dst - выходной буфер (не меньше length байт)
+ * @param dst_capacity - размер выходного буфера
+ * @param dst_size - сюда записывается размер восстановленной части
+ * @return HUFFMAN_OK или код ошибки HUFFMAN_ERROR_*
+ *
+ * Декодируются только блоки, пересекающие диапазон; нужный блок
+ * находится по индексу в конце буфера. Диапазон за концом данных
+ * обрезается, тогда *dst_size меньше length.
+ */
+int huffmanDecompressRange(HuffmanContext* context, const void* src, size_t src_size,
+                           unsigned long long offset, size_t length,
+                           void* dst, size_t dst_capacity, size_t* dst_size);
+
+/**
+ * Функция huffmanTableCacheStats - счетчики кэша таблиц кодов
+ * @param context - контекст
+ * @param stats - структура для заполнения
+ *
+ * Счетчики накапливаются всеми блоками, сжатыми этим контекстом.
+ */
+void huffmanTableCacheStats(const HuffmanContext* context, HuffmanCacheStats* stats);
+
+/**
+ * Функция huffmanErrorString - описание кода результата
+ * @param code - код HUFFMAN_OK или HUFFMAN_ERROR_*
+ * @return строка с описанием
+ */
+const char* huffmanErrorString(int code);
+
+// ---------- Кадр по частям ----------
+
+/**
+ * Функция huffmanBeginFrame - начинает сжатие нового кадра
+ * @param context - контекст
+ * @param size - размер исходных данных (HUFFMAN_UNKNOWN_SIZE - потоковый кадр)
+ * @param header - сюда записывается заголовок кадра
+ * @return HUFFMAN_OK или HUFFMAN_ERROR_PARAMS, если блоков больше 2^32 - 1
+ *
+ * Кадр из одного блока со словарем получает короткий заголовок, иначе
+ * у кадра известного размера есть индекс. Кэш таблиц контекста очищается.
+ */
+int huffmanBeginFrame(HuffmanContext* context, unsigned long long size, HuffmanFrameHeader* header);
+
+/**
+ * Функция huffmanFrameHeaderSize - размер заголовка кадра
+ * @param prefix - первые HUFFMAN_FRAME_PREFIX_SIZE байт кадра
+ * @return размер заголовка или 0, если это не сжатые данные (сигнатура или версия)
+ */
+size_t huffmanFrameHeaderSize(const void* prefix);
+
+/**
+ * Функция huffmanStoreFrameHeader - записывает заголовок кадра
+ * @param header - заголовок из huffmanBeginFrame
+ * @param dst - куда записать (HUFFMAN_FRAME_HEADER_MAX_SIZE байт достаточно)
+ * @return количество записанных байт; с этого смещения идет первый блок
+ */
+size_t huffmanStoreFrameHeader(const HuffmanFrameHeader* header, void* dst);
+
+/**
+ * Функция huffmanParseFrameHeader - разбирает и проверяет заголовок кадра
+ * @param context - контекст, который будет восстанавливать блоки кадра (NULL допускается)
+ * @param src - заголовок (huffmanFrameHeaderSize байт)
+ * @param size - сколько байт доступно
+ * @param header - структура для заполнения
+ * @return HUFFMAN_OK или HUFFMAN_ERROR_CORRUPT
+ *
+ * Таблицы кодов блоков прошлого кадра контекст забывает.
+ */
+int huffmanParseFrameHeader(HuffmanContext* context, const void* src, size_t size,
+                            HuffmanFrameHeader* header);
+
+/**
+ * Функция huffmanBlockBound - наибольший размер сжатого блока
+ * @param size - размер исходных данных блока
+ * @return размер буфера для huffmanCompressBlock
+ */
+size_t huffmanBlockBound(size_t size);
+
+/**
+ * Функция huffmanCompressBlock - сжимает один блок кадра
+ * @param context - контекст
+ * @param src - исходные данные блока
+ * @param size - размер блока (не больше params.block_size)
+ * @param index - номер блока в кадре
+ * @param dst - выходной буфер (не меньше huffmanBlockBound(size) байт)
+ * @param dst_capacity - размер выходного буфера
+ * @param dst_size - сюда записывается размер сжатого блока
+ * @return HUFFMAN_OK или код ошибки HUFFMAN_ERROR_*
+ *
+ * Блоки сжимаются независимо и могут сжиматься разными контекстами
+ * параллельно. С кэшем таблиц блок может сослаться на таблицу одного
+ * из предыдущих блоков своей группы из 8 (номера 8k ... 8k + 7): такие
+ * группы один контекст сжимает по порядку номеров, кэш очищается, когда
+ * номер начинает новую группу или не растет.
+ */
+int huffmanCompressBlock(HuffmanContext* context, const void* src, size_t size, unsigned int index,
+                         void* dst, size_t dst_capacity, size_t* dst_size);
+
+/**
+ * Функция huffmanBlockHeaderSize - сколько байт блока нужно для huffmanBlockInfo
+ * @param src - начало блока
+ * @param available - сколько байт доступно (от HUFFMAN_BLOCK_PREFIX_SIZE)
+ * @return размер заголовка блока, который нужно иметь целиком (больше available - дочитать
+ *         и вызвать снова), или 0, если заголовок поврежден
+ *
+ * У признака конца потокового кадра заголовок - HUFFMAN_STREAM_END_SIZE байт.
+ */
+size_t huffmanBlockHeaderSize(const void* src, size_t available);
+
+/**
+ * Функция huffmanBlockInfo - разбирает и проверяет заголовок блока
+ * @param src - начало блока (заголовок целиком, см. huffmanBlockHeaderSize)
+ * @param available - сколько байт доступно
+ * @param info - структура для заполнения
+ * @return HUFFMAN_OK или HUFFMAN_ERROR_CORRUPT
+ */
+int huffmanBlockInfo(const void* src, size_t available, HuffmanBlockInfo* info);
+
+/**
+ * Функция huffmanDecompressBlock - восстанавливает один блок
+ * @param context - контекст
+ * @param src - блок целиком (info.record_size байт)
+ * @param size - размер блока
+ * @param index - номер блока в кадре
+ * @param dst - буфер на expected байт
+ * @param expected - размер исходных данных блока по заголовку кадра
+ * @return HUFFMAN_OK или код ошибки HUFFMAN_ERROR_*
+ *
+ * Блок HUFFMAN_MODE_REUSE декодируется таблицей блока index - distance,
+ * которую контекст запомнил, восстанавливая блоки по порядку. Если ее нет
+ * (блоки восстанавливаются не по порядку), возвращается HUFFMAN_ERROR_TABLE:
+ * тогда таблицу передает huffmanLoadBlockTable, и вызов повторяется.
+ */
+int huffmanDecompressBlock(HuffmanContext* context, const void* src, size_t size, unsigned int index,
+                           void* dst, size_t expected);
+
+/**
+ * Функция huffmanLoadBlockTable - запоминает таблицу кодов блока, не восстанавливая его
+ * @param context - контекст
+ * @param src - заголовок блока (см. huffmanBlockHeaderSize)
+ * @param size - сколько байт доступно
+ * @param index - номер этого блока в кадре
+ * @return HUFFMAN_OK или HUFFMAN_ERROR_CORRUPT
+ */
+int huffmanLoadBlockTable(HuffmanContext* context, const void* src, size_t size, unsigned int index);
+
+/**
+ * Функция huffmanStoreStreamEnd - записывает признак конца потокового кадра
+ * @param total - общий размер исходных данных
+ * @param dst - куда записать (HUFFMAN_STREAM_END_SIZE байт)
+ */
+void huffmanStoreStreamEnd(unsigned long long total, void* dst);
+
+/**
+ * Функция huffmanIndexSize - размер индекса блоков кадра
+ * @param header - заголовок кадра
+ * @return количество байт индекса (0 - у кадра нет индекса)
+ */
+size_t huffmanIndexSize(const HuffmanFrameHeader* header);
+
+/**
+ * Функция huffmanStoreIndex - записывает индекс блоков в конец кадра
+ * @param header - заголовок кадра
+ * @param offsets - смещения блоков от начала кадра
+ * @param index_offset - смещение, с которого начинается индекс
+ * @param dst - куда записать (huffmanIndexSize байт)
+ */
+void huffmanStoreIndex(const HuffmanFrameHeader* header, const unsigned long long offsets[],
+                       unsigned long long index_offset, void* dst);
+
+/**
+ * Функция huffmanParseIndex - разбирает и проверяет индекс блоков
+ * @param header - заголовок кадра
+ * @param src - индекс (huffmanIndexSize байт с конца кадра)
+ * @param frame_size - размер кадра
+ * @param offsets - сюда записываются смещения блоков (block_count элементов)
+ * @return HUFFMAN_OK или HUFFMAN_ERROR_CORRUPT
+ */
+int huffmanParseIndex(const HuffmanFrameHeader* header, const void* src, unsigned long long frame_size,
+                      unsigned long long offsets[]);
+
+// ---------- Словари ----------
+
+/**
+ * Функция huffmanTrainDictionary - строит словарь по частотам байтов образцов
+ * @param frequencies - суммарные частоты байтов всех образцов
+ * @param max_code_length - ограничение длины кода словаря
+ * @param dst - куда записать словарь (HUFFMAN_DICTIONARY_SIZE байт)
+ * @param dst_capacity - размер буфера
+ * @param stats - сюда записываются сведения о словаре (NULL - не нужны)
+ * @return HUFFMAN_OK или код ошибки HUFFMAN_ERROR_* (PARAMS - образцы пусты)
+ */
+int huffmanTrainDictionary(const unsigned long long frequencies[256], int max_code_length,
+                           void* dst, size_t dst_capacity, HuffmanDictionaryStats* stats);
+
+/**
+ * Функция huffmanDictionaryId - проверяет словарь и вычисляет его идентификатор
+ * @param dictionary - содержимое файла словаря
+ * @param size - размер содержимого
+ * @param id - сюда записывается идентификатор
+ * @return HUFFMAN_OK, HUFFMAN_ERROR_PARAMS, если данные не являются словарем, или HUFFMAN_ERROR_MEMORY
+ */
+int huffmanDictionaryId(const void* dictionary, size_t size, unsigned int* id);
+
+// ---------- Коды одного буфера ----------
+
+/**
+ * Функция huffmanCountFrequencies - частоты байтов буфера
+ * @param src - данные
+ * @param size - размер данных
+ * @param frequencies - массив для сохранения частот (индекс = байт)
+ */
+void huffmanCountFrequencies(const void* src, size_t size, unsigned int frequencies[256]);
+
+/**
+ * Функция huffmanBuildCodes - канонические коды Хаффмана по частотам
+ * @param frequencies - частоты байтов
+ * @param max_length - наибольшая длина кода (от 8 до 56; 0 - без ограничения)
+ * @param codes - сюда записываются коды
+ * @return HUFFMAN_OK или HUFFMAN_ERROR_PARAMS
+ */
+int huffmanBuildCodes(const unsigned int frequencies[256], int max_length, HuffmanCode codes[256]);
+
+/**
+ * Функция huffmanCanonicalCodes - заменяет коды каноническими кодами той же длины
+ * @param codes - коды; используются только длины
+ */
+void huffmanCanonicalCodes(HuffmanCode codes[256]);
+
+/**
+ * Функция huffmanEncodeBound - наибольший размер результата huffmanEncodeBits
+ * @param codes - коды
+ * @param size - размер исходных данных
+ * @return размер выходного буфера
+ */
+size_t huffmanEncodeBound(const HuffmanCode codes[256], size_t size);
+
+/**
+ * Функция huffmanEncodeBits - кодирует буфер готовыми кодами в битовый поток
+ * @param codes - коды (у каждого байта данных ненулевая длина)
+ * @param src - исходные данные
+ * @param size - размер данных
+ * @param dst - выходной буфер
+ * @param dst_capacity - размер выходного буфера (не меньше huffmanEncodeBound)
+ * @param bit_count - сюда записывается количество значимых битов потока
+ * @return HUFFMAN_OK, HUFFMAN_ERROR_PARAMS (код длиннее 56 бит) или HUFFMAN_ERROR_DST_TOO_SMALL
+ */
+int huffmanEncodeBits(const HuffmanCode codes[256], const void* src, size_t size,
+                      void* dst, size_t dst_capacity, unsigned long long* bit_count);
+
+/**
+ * Функция huffmanCreateDecodeTable - строит таблицу быстрого декодирования кодов
+ * @param codes - префиксные коды (не длиннее 56 бит)
+ * @return таблица или NULL, если коды недопустимы или не хватило памяти
+ */
+HuffmanDecodeTable* huffmanCreateDecodeTable(const HuffmanCode codes[256]);
+
+/**
+ * Функция huffmanDecodeBits - декодирует битовый поток huffmanEncodeBits
+ * @param table - таблица декодирования
+ * @param src - поток
+ * @param src_size - размер потока в байтах
+ * @param bit_count - количество значимых битов потока
+ * @param dst - выходной буфер
+ * @param dst_size - ожидаемое количество символов
+ * @return HUFFMAN_OK, если декодировано ровно dst_size символов и поток исчерпан,
+ *         иначе HUFFMAN_ERROR_CORRUPT
+ */
+int huffmanDecodeBits(const HuffmanDecodeTable* table, const void* src, size_t src_size,
+                      unsigned long long bit_count, void* dst, size_t dst_size);
+
+/**
+ * Функция huffmanFreeDecodeTable - освобождает таблицу декодирования
+ * @param table - таблица (NULL допускается)
+ */
+void huffmanFreeDecodeTable(HuffmanDecodeTable* table);
+
+/**
+ * Функция huffmanCrc32 - обновляет контрольную сумму CRC-32 блоком данных
+ * @param crc - текущее значение (0 для начала вычисления)
+ * @param data - данные
+ * @param size - размер данных
+ * @return новое значение (та же сумма, что в заголовках блоков)
+ */
+unsigned int huffmanCrc32(unsigned int crc, const void* data, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HUFFMAN_H
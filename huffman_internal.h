@@ -0,0 +1,105 @@
+/*
+ * Общие внутренние определения библиотеки (huffman.c) и программы (main.c)
+ *
+ * Не часть интерфейса libhuffman: здесь пределы формата, которые программа
+ * проверяет при разборе параметров, и мелкие помощники, нужные обеим
+ * сторонам. Определения собраны в одном месте, чтобы копии в библиотеке
+ * и программе не расходились. Функции статические встраиваемые: каждая
+ * единица трансляции получает свою копию, внешних символов заголовок не
+ * добавляет.
+ */
+
+#ifndef HUFFMAN_INTERNAL_H
+#define HUFFMAN_INTERNAL_H
+
+#include <stdlib.h>     // realloc
+#include <stdint.h>     // uint64_t
+#include "huffman.h"    // HuffmanCode
+
+#define BYTE_SIZE 8               // Количество бит в одном байте
+#define ASCII_SIZE 256            // Количество возможных ASCII символов (0-255)
+#define MAX_CODE_LENGTH 64        // Максимальная длина кода, помещающаяся в упакованное значение
+#define DECODE_MAX_CODE_LENGTH 56 // Максимальная длина кода для табличного декодера (гарантированный запас битового буфера)
+#define DEFAULT_CODE_LENGTH_LIMIT 15 // Ограничение длины кода при сжатии по умолчанию
+#define MIN_CODE_LENGTH_LIMIT 8   // Наименьшее ограничение: 2^8 кодов вмещают все 256 символов
+#define INTERLEAVED_MAX_STREAMS 16 // Наибольшее количество потоков в блоке (--streams)
+#define TABLE_CACHE_SEGMENT 8     // Блоков в сегменте кэша таблиц: ссылки на таблицы не выходят за сегмент
+#define DEFAULT_BLOCK_SIZE (1u << 20) // Размер блока по умолчанию (1 MiB)
+#define MAX_BLOCK_SIZE (1u << 26)     // Наибольший размер блока (64 MiB)
+
+/*
+ * Тип Code - код Хаффмана символа (HuffmanCode из huffman.h)
+ * Код хранится упакованным в целое число: младшие length битов value,
+ * первым в поток идет старший из них (код "101" хранится как value = 5, length = 3).
+ * Индекс в массиве кодов - сам символ.
+ */
+typedef HuffmanCode Code;
+
+/*
+ * Структура Node - узел дерева Хаффмана
+ * Программа строит из таких узлов дерево по частотам (эталон для сравнения),
+ * библиотека - адаптивное дерево; parent и number нужны только ему.
+ */
+typedef struct Node {
+    unsigned char symbol;   // Символ (хранится только в листьях дерева)
+    unsigned int freq;      // Частота появления символа (вес узла)
+    struct Node *left;      // Указатель на левого потомка (соответствует биту 0)
+    struct Node *right;     // Указатель на правого потомка (соответствует биту 1)
+    struct Node *parent;    // Указатель на родителя
+    int number;             // Номер узла в адаптивном дереве (порядок по неубыванию веса)
+} Node;
+
+/*
+ * Структура EncodedBlock - сжатый блок в памяти (заголовок блока и поток)
+ */
+typedef struct EncodedBlock {
+    unsigned char* data;        // Готовые к записи байты блока
+    size_t size;                // Количество байт блока
+    size_t capacity;            // Размер выделенного буфера
+} EncodedBlock;
+
+/**
+ * Функция reserveBlock - обеспечивает буферу сжатого блока нужную емкость
+ * @param block - буфер блока (уже записанные байты сохраняются)
+ * @param needed - требуемый размер в байтах
+ * @return 1 при успехе, 0 - не хватило памяти (прежний буфер остается за блоком)
+ */
+static inline int reserveBlock(EncodedBlock* block, size_t needed) {
+    if (block->capacity < needed) {
+        unsigned char* data = (unsigned char*)realloc(block->data, needed);
+        if (data == NULL) {
+            return 0;
+        }
+        block->data = data;
+        block->capacity = needed;
+    }
+    return 1;
+}
+
+/**
+ * Функция storeLittleEndian - записывает число в bytes байт (младший байт первым)
+ * @param p - куда записать
+ * @param value - записываемое значение
+ * @param bytes - количество байт (4 или 8)
+ */
+static inline void storeLittleEndian(unsigned char* p, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        p[i] = (unsigned char)(value >> (8 * i));
+    }
+}
+
+/**
+ * Функция encodedBitCount - вычисляет размер закодированных данных
+ * @param frequencies - частоты символов
+ * @param codes - коды символов
+ * @return сумма частот, умноженных на длины кодов (в битах)
+ */
+static inline uint64_t encodedBitCount(const unsigned int frequencies[], const Code codes[]) {
+    uint64_t bit_count = 0;
+    for (int i = 0; i < ASCII_SIZE; i++) {
+        bit_count += (uint64_t)frequencies[i] * codes[i].length;
+    }
+    return bit_count;
+}
+
+#endif // HUFFMAN_INTERNAL_H
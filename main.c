@@ -12,42 +12,131 @@
  */
 
 // Подключаем необходимые библиотеки
+#ifndef _WIN32
+#define _GNU_SOURCE             // fseeko/ftello, sysconf на POSIX-системах
+#endif
 #include <stdio.h>      // Для работы с файлами и вводом/выводом
 #include <stdlib.h>     // Для динамического выделения памяти, exit()
 #include <string.h>     // Для работы со строками (strcpy, memcmp)
 #include <locale.h>     // Для установки локали (поддержка кириллицы)
-#include <time.h>       // Для замера времени выполнения (clock())
-#include <windows.h>    // Windows-specific: SetConsoleOutputCP, SetConsoleCP
+#include <time.h>       // Для замера времени выполнения (clock(), timespec_get())
+#include <stdint.h>     // Целые типы фиксированной ширины (uint32_t, uint64_t)
+#include <errno.h>      // errno: различение ошибок записи
+#include "huffman.h"    // Библиотека libhuffman: формат сжатого файла, сжатие и восстановление
+#include "huffman_internal.h" // Пределы формата, Code, Node и EncodedBlock - общие с библиотекой
+#ifdef _WIN32
+#include <windows.h>    // Windows-specific: SetConsoleOutputCP, SetConsoleCP, потоки
 #include <direct.h>     // Для создания директорий (_mkdir)
+#include <io.h>         // _setmode: двоичный режим stdin/stdout
+#include <fcntl.h>      // _O_BINARY
+#define setBinaryMode(file) _setmode(_fileno(file), _O_BINARY)
+#else
+#include <pthread.h>    // Потоки POSIX для параллельного сжатия
+#include <sys/stat.h>   // Для создания директорий (mkdir)
+#include <unistd.h>     // sysconf: количество процессоров
+#include <dirent.h>     // opendir/readdir: файлы папки в пакетном режиме
+#define _mkdir(path) mkdir(path, 0755)
+#define setBinaryMode(file) ((void)0)   // На POSIX потоки всегда двоичные
+#endif
+
+// Ввод-вывод через отображение файлов в память (можно отключить: -DUSE_MMAP=0)
+#ifndef USE_MMAP
+#ifdef _WIN32
+#define USE_MMAP 0
+#else
+#define USE_MMAP 1
+#endif
+#endif
+#if USE_MMAP
+#include <fcntl.h>      // open, posix_fallocate
+#include <sys/mman.h>   // mmap, madvise
+#include <sys/uio.h>    // writev
+#endif
+
+// Асинхронный ввод-вывод через io_uring (Linux; можно отключить: -DUSE_IO_URING=0)
+#if !defined(USE_IO_URING) && defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define USE_IO_URING 1
+#endif
+#endif
+#ifndef USE_IO_URING
+#define USE_IO_URING 0
+#endif
+#if USE_IO_URING
+#include <linux/io_uring.h> // Кольца запросов и завершений
+#include <sys/syscall.h>    // syscall(): у io_uring_setup и io_uring_enter нет оберток в libc
+#include <sys/mman.h>       // mmap колец
+#include <sys/stat.h>       // fstat: обычный файл или канал
+#include <sys/uio.h>        // struct iovec для IORING_OP_READV/WRITEV
+#include <fcntl.h>          // fcntl: выход, открытый с O_APPEND
+#endif
+
+// Замеры стадий (--profile): при USE_PROFILE=0 они не компилируются вовсе
+#ifndef USE_PROFILE
+#define USE_PROFILE 1
+#endif
+#if USE_PROFILE && defined(__linux__)
+#include <linux/perf_event.h> // perf_event_open: аппаратные счетчики
+#include <sys/syscall.h>        // syscall(): у perf_event_open нет обертки в libc
+#define USE_PERF_COUNTERS 1
+#else
+#define USE_PERF_COUNTERS 0
+#endif
 
 // ========== КОНСТАНТЫ И СТРУКТУРЫ ==========
 
-// Макросы для задания констант программы
-#define BYTE_SIZE 8               // Количество бит в одном байте
-#define ASCII_SIZE 256            // Количество возможных ASCII символов (0-255)
-#define MAX_TREE_HT 100           // Максимальная высота дерева Хаффмана (ограничение для кодов)
+// Макросы для задания констант программы (общие с библиотекой - в huffman_internal.h)
+#define MAX_TREE_HT 100           // Максимальная высота дерева Хаффмана (размер буфера для текстового вида кода)
 #define BUFFER_SIZE 4096          // Размер буфера для чтения/записи файлов (4KB)
-
-/*
- * Структура Node - узел бинарного дерева Хаффмана
- * Используется для построения дерева кодирования
- */
-typedef struct Node {
-    unsigned char symbol;   // Символ (хранится только в листьях дерева)
-    unsigned int freq;      // Частота появления символа (вес узла)
-    struct Node *left;      // Указатель на левого потомка (соответствует биту 0)
-    struct Node *right;     // Указатель на правого потомка (соответствует биту 1)
-} Node;
-
-/*
- * Структура Code - для хранения сгенерированного кода Хаффмана для символа
- * Используется для быстрого доступа к кодам при кодировании
- */
-typedef struct Code {
-    unsigned char symbol;   // Символ, которому соответствует код
-    char bits[MAX_TREE_HT]; // Строковое представление двоичного кода (например, "101")
-    int length;             // Длина кода в битах
-} Code;
+#define IO_BUFFER_SIZE (1 << 16)  // Размер буфера для потокового чтения файлов (64KB)
+#define BENCH_RUNS 5              // Количество повторов каждого замера в бенчмарке
+#define SUITE_MAX_SIZES 16        // Наибольшее количество размеров корпуса в наборе замеров
+#define SUITE_MAX_RUNS 100        // Наибольшее количество повторов в наборе замеров
+#define SUITE_BUILD_REPEATS 1000  // Построений кодов в одном замере (одно слишком быстрое для часов)
+#define SUITE_VOCABULARY 512      // Количество слов в словаре текстового корпуса
+#define SUITE_RECORD_SIZE 16      // Размер записи двоичного корпуса
+#define CORPUS_UNIFORM 0          // Корпус: равномерно случайные байты (8 бит/байт)
+#define CORPUS_SKEWED 1           // Корпус: независимые байты с перекосом (около 4.3 бит/байт)
+#define CORPUS_TEXT 2             // Корпус: текст из слов со степенным распределением
+#define CORPUS_BINARY 3           // Корпус: двоичные записи с медленно меняющимися полями
+#define CORPUS_COUNT 4            // Количество видов корпуса
+#define HISTOGRAM_MIN_PART (1 << 20) // Наименьшая часть данных на один поток подсчета частот (1 MiB)
+
+// Параметры сжатого файла (сам формат - в библиотеке, см. huffman.h)
+#define INTERLEAVED_STREAMS 4     // Рекомендуемое количество потоков (--streams 4, бенчмарк)
+#define STDIO_NAME "-"            // Имя файла, означающее stdin (вход) или stdout (выход)
+#define WRITE_BATCH_MAX 64        // Наибольшее количество блоков в одном вызове writev
+#define IO_QUEUE_DEPTH 4          // Буферов конвейера ввода-вывода: блок N сжимается, пока N+1 читается, а N-1 пишется
+#define IO_URING_ENTRIES 16       // Размер колец io_uring: вмещает чтения и записи всех буферов конвейера
+#define IO_ENGINE_SYNC 0          // Конвейер: чтение и запись в потоке сжатия (потоки не запустились)
+#define IO_ENGINE_THREADS 1       // Конвейер: поток чтения и поток записи с блокирующими вызовами
+#define IO_ENGINE_URING 2         // Конвейер: запросы io_uring из потока сжатия, без дополнительных потоков
+#define IO_SLOT_FREE 0            // Буфер конвейера свободен
+#define IO_SLOT_READING 1         // В буфер читается блок
+#define IO_SLOT_READ 2            // Блок прочитан и ждет сжатия
+#define IO_SLOT_ENCODING 3        // Блок сжимается
+#define IO_SLOT_ENCODED 4         // Блок сжат и ждет записи
+#define IO_SLOT_WRITING 5         // Сжатый блок пишется
+#define BATCH_CHUNK_BLOCKS TABLE_CACHE_SEGMENT // Блоков в одной задаче пакетного режима: файлы крупнее делятся на части
+#define BATCH_OPEN_TASK 0         // Задача пакетного режима: открыть файл и разбить на части
+#define BATCH_CHUNK_TASK 1        // Задача пакетного режима: сжать первую еще не взятую часть файла
+#define BATCH_EXTENSION ".huf"    // Расширение сжатых файлов в пакетном режиме
+#define PROFILE_READ 0            // Стадия замеров: чтение исходных или сжатых данных
+#define PROFILE_COUNT HUFFMAN_STAGE_HISTOGRAM // Стадия замеров: подсчет частот
+#define PROFILE_BUILD HUFFMAN_STAGE_BUILD     // Стадия замеров: построение кодов и таблиц декодирования
+#define PROFILE_ENCODE HUFFMAN_STAGE_ENCODE   // Стадия замеров: кодирование
+#define PROFILE_DECODE HUFFMAN_STAGE_DECODE   // Стадия замеров: декодирование
+#define PROFILE_CHECK HUFFMAN_STAGE_CHECK     // Стадия замеров: контрольная сумма CRC-32
+#define PROFILE_WRITE 6           // Стадия замеров: запись результата
+#define PROFILE_STAGE_COUNT 7     // Количество стадий замеров
+#define PROFILE_COUNTERS 4        // Аппаратные счетчики: такты, инструкции, промахи ветвлений и кэша
+
+// Нулевое устройство: вывод бенчмарка не должен упираться в запись на диск
+#ifdef _WIN32
+#define NULL_DEVICE "NUL"
+#else
+#define NULL_DEVICE "/dev/null"
+#endif
 
 /*
  * Структура MinHeap - минимальная куча (min-heap)
@@ -60,9 +149,402 @@ typedef struct MinHeap {
     Node** array;           // Массив указателей на узлы дерева Хаффмана
 } MinHeap;
 
+/*
+ * Структура MappedFile - файл, отображенный в память
+ */
+typedef struct MappedFile {
+    unsigned char* data;        // Начало отображения (NULL - файл не отображен)
+    uint64_t size;              // Размер отображения в байтах
+} MappedFile;
+
+/*
+ * Структура CompressOptions - параметры сжатия из командной строки
+ */
+typedef struct CompressOptions {
+    uint32_t block_size;        // Размер блока в байтах
+    int threads;                // Количество рабочих потоков
+    int mode;                   // Режим блоков HUFFMAN_MODE_*
+    int max_code_length;        // Ограничение длины кода в битах (статический режим)
+    const char* profile;        // Файл отчета замеров по стадиям в JSON (NULL - без замеров)
+    const char* dictionary_file; // Файл словаря из --dict (NULL - без словаря)
+    const unsigned char* dictionary; // Содержимое словаря (HUFFMAN_DICTIONARY_SIZE байт, см. loadDictionary)
+    int table_cache;            // Допустимая потеря сжатия при повторе таблицы из кэша, % (-1 - без кэша)
+    int streams;                // Потоков в статическом блоке (1 - один поток, см. HUFFMAN_MODE_INTERLEAVED)
+} CompressOptions;
+
+/*
+ * Структура CompressResult - итоги сжатия файла для статистики полного цикла
+ */
+typedef struct CompressResult {
+    uint64_t original_size;              // Размер исходного файла
+    uint64_t compressed_size;            // Размер сжатого файла
+    unsigned int frequencies[ASCII_SIZE]; // Частоты байтов всего файла (сумма по блокам)
+} CompressResult;
+
+/*
+ * Структура SuiteOptions - параметры набора замеров (цель huffman_bench)
+ */
+typedef struct SuiteOptions {
+    uint64_t sizes[SUITE_MAX_SIZES];     // Размеры корпусов в байтах
+    int size_count;                      // Количество размеров
+    int corpora[CORPUS_COUNT];           // 1 - корпус этого вида участвует в замерах
+    int runs;                            // Количество учитываемых повторов
+    int warmup;                          // Количество разогревочных повторов (не учитываются)
+    uint64_t seed;                       // Начальное значение генератора корпусов
+    int json;                            // 1 - отчет в JSON, 0 - в CSV
+    const char* output;                  // Файл отчета (NULL - stdout)
+    const char* save_dir;                // Папка для сохранения корпусов (NULL - не сохранять)
+    int help;                            // 1 - запрошена справка (--help, -h), замеров нет
+} SuiteOptions;
+
+// ========== ПОТОКИ ==========
+
+/*
+ * Тонкая обертка над потоками Windows и POSIX: создание и ожидание потока,
+ * мьютекс и условная переменная. Больше программе ничего не нужно.
+ */
+#ifdef _WIN32
+typedef HANDLE ThreadHandle;
+typedef CRITICAL_SECTION Mutex;
+typedef CONDITION_VARIABLE CondVar;
+#define THREAD_FUNC DWORD WINAPI
+#define THREAD_RETURN 0
+typedef LPTHREAD_START_ROUTINE ThreadFunc;
+
+static int threadStart(ThreadHandle* thread, ThreadFunc func, void* arg) {
+    *thread = CreateThread(NULL, 0, func, arg, 0, NULL);
+    return *thread != NULL;
+}
+static void threadJoin(ThreadHandle thread) {
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+}
+static void mutexInit(Mutex* mutex) { InitializeCriticalSection(mutex); }
+static void mutexDestroy(Mutex* mutex) { DeleteCriticalSection(mutex); }
+static void mutexLock(Mutex* mutex) { EnterCriticalSection(mutex); }
+static void mutexUnlock(Mutex* mutex) { LeaveCriticalSection(mutex); }
+static void condInit(CondVar* cond) { InitializeConditionVariable(cond); }
+static void condDestroy(CondVar* cond) { (void)cond; }
+static void condWait(CondVar* cond, Mutex* mutex) { SleepConditionVariableCS(cond, mutex, INFINITE); }
+static void condBroadcast(CondVar* cond) { WakeAllConditionVariable(cond); }
+#else
+typedef pthread_t ThreadHandle;
+typedef pthread_mutex_t Mutex;
+typedef pthread_cond_t CondVar;
+#define THREAD_FUNC void*
+#define THREAD_RETURN NULL
+typedef void* (*ThreadFunc)(void*);
+
+static int threadStart(ThreadHandle* thread, ThreadFunc func, void* arg) {
+    return pthread_create(thread, NULL, func, arg) == 0;
+}
+static void threadJoin(ThreadHandle thread) { pthread_join(thread, NULL); }
+static void mutexInit(Mutex* mutex) { pthread_mutex_init(mutex, NULL); }
+static void mutexDestroy(Mutex* mutex) { pthread_mutex_destroy(mutex); }
+static void mutexLock(Mutex* mutex) { pthread_mutex_lock(mutex); }
+static void mutexUnlock(Mutex* mutex) { pthread_mutex_unlock(mutex); }
+static void condInit(CondVar* cond) { pthread_cond_init(cond, NULL); }
+static void condDestroy(CondVar* cond) { pthread_cond_destroy(cond); }
+static void condWait(CondVar* cond, Mutex* mutex) { pthread_cond_wait(cond, mutex); }
+static void condBroadcast(CondVar* cond) { pthread_cond_broadcast(cond); }
+#endif
+
+/*
+ * Структура BlockSlot - ячейка окна параллельного сжатия
+ * Блок с номером i обрабатывается в ячейке i % window.
+ */
+typedef struct BlockSlot {
+    unsigned char* raw;         // Исходные данные блока
+    EncodedBlock encoded;       // Сжатый блок
+    int ready;                  // 1 - блок сжат и ждет записи
+} BlockSlot;
+
+/*
+ * Структура CompressJob - общее состояние параллельного сжатия
+ * Поля после mutex изменяются только под мьютексом.
+ */
+typedef struct CompressJob {
+    const char* input_filename; // Исходный файл (каждый поток открывает его сам)
+    MappedFile input;           // Отображение исходного файла (data == NULL - читаем через stdio)
+    uint64_t original_size;     // Размер исходного файла
+    uint32_t block_size;        // Размер блока
+    uint32_t block_count;       // Количество блоков
+    CompressOptions options;    // Режим блоков и ограничение длины кода
+    BlockSlot* slots;           // Окно ячеек
+    int window;                 // Количество ячеек в окне
+    Mutex mutex;                // Защищает поля ниже и флаги ready
+    CondVar cond;               // Сигнал об изменении состояния
+    uint32_t next_block;        // Следующий блок, который еще никто не взял
+    uint32_t written_blocks;    // Количество уже записанных блоков
+    int failed;                 // 1 - произошла ошибка, работа прекращается
+    HuffmanCacheStats cache;    // Сумма счетчиков кэша таблиц всех потоков
+    unsigned int* frequencies;  // Сумма частот байтов всех блоков (NULL - не считать)
+} CompressJob;
+
+/*
+ * Структура IoSlot - буфер конвейера ввода-вывода
+ * Блок с номером i проходит чтение, сжатие и запись в буфере i % IO_QUEUE_DEPTH.
+ */
+typedef struct IoSlot {
+    unsigned char* raw;         // Исходные данные блока (NULL - вход отображен в память)
+    size_t size;                // Размер прочитанных данных
+    size_t wanted;              // Сколько байт нужно прочитать в буфер
+    size_t done;                // Сколько байт уже прочитано или записано (при частичных операциях)
+    EncodedBlock encoded;       // Сжатый блок
+    int state;                  // Состояние IO_SLOT_*
+#if USE_IO_URING
+    struct iovec vector;        // Остаток буфера для текущего запроса io_uring
+    uint64_t offset;            // Смещение в файле, с которого начинается буфер
+    double issued;              // Время отправки первого запроса чтения или записи (для замеров)
+#endif
+} IoSlot;
+
+#if USE_IO_URING
+/*
+ * Структура IoUring - кольца io_uring, отображенные из ядра
+ * Указатели ведут в общую с ядром память; голову очереди запросов и хвост
+ * очереди завершений двигает ядро.
+ */
+typedef struct IoUring {
+    int fd;                         // Дескриптор экземпляра io_uring
+    unsigned* sq_head;              // Голова очереди запросов (двигает ядро)
+    unsigned* sq_tail;              // Хвост очереди запросов
+    unsigned* sq_mask;              // Маска номеров очереди запросов
+    unsigned* sq_array;             // Номера заполненных элементов sqes
+    struct io_uring_sqe* sqes;      // Элементы запросов
+    unsigned* cq_head;              // Голова очереди завершений
+    unsigned* cq_tail;              // Хвост очереди завершений (двигает ядро)
+    unsigned* cq_mask;              // Маска номеров очереди завершений
+    struct io_uring_cqe* cqes;      // Элементы завершений
+    void* sq_ring;                  // Отображение кольца запросов
+    size_t sq_ring_size;
+    void* cq_ring;                  // Отображение кольца завершений (может совпадать с sq_ring)
+    size_t cq_ring_size;
+    size_t sqes_size;               // Размер отображения sqes
+    unsigned queued;                // Запросов добавлено, но еще не передано ядру
+} IoUring;
+#endif
+
+/*
+ * Структура IoPipeline - конвейер ввода-вывода последовательного сжатия
+ * Поля после mutex изменяются только под мьютексом (кроме IO_ENGINE_URING,
+ * где все происходит в одном потоке).
+ */
+typedef struct IoPipeline {
+    FILE* input;                // Исходные данные (NULL - вход отображен, конвейер только пишет)
+    FILE* output;               // Сжатый файл
+    uint32_t block_size;        // Размер блока и буферов
+    uint64_t input_size;        // Сколько байт прочитать (UINT64_MAX - до конца входа)
+    int engine;                 // IO_ENGINE_*
+    IoSlot slots[IO_QUEUE_DEPTH]; // Буферы блоков
+    uint64_t next_encode;       // Номер блока, который сжимается следующим
+    Mutex mutex;                // Защищает поля ниже и состояния буферов
+    CondVar cond;               // Сигнал об изменении состояния
+    ThreadHandle reader;        // Поток чтения (IO_ENGINE_THREADS)
+    ThreadHandle writer;        // Поток записи (IO_ENGINE_THREADS)
+    uint64_t next_read;         // Номер блока, который читается следующим
+    uint64_t read_blocks;       // Количество блоков во входе (известно после конца входа)
+    uint64_t next_write;        // Номер блока, который пишется следующим
+    uint64_t submitted;         // Количество блоков, отданных на запись
+    int input_done;             // 1 - вход прочитан до конца (read_blocks известно)
+    int finishing;              // 1 - новых блоков не будет, конвейер дописывает отданные
+    int failed;                 // 1 - ошибка чтения или записи
+#if USE_IO_URING
+    IoUring ring;               // Кольца io_uring (IO_ENGINE_URING)
+    int input_fd;               // Дескриптор входа
+    int output_fd;              // Дескриптор выхода
+    int input_seekable;         // 1 - вход - обычный файл: чтения идут по смещениям, несколько сразу
+    int output_seekable;        // 1 - выход - обычный файл: записи идут по смещениям, несколько сразу
+    uint64_t input_offset;      // Смещение входа, с которого начинаются данные
+    uint64_t output_offset;     // Смещение выхода для следующей записи
+    unsigned reads_in_flight;   // Запросов чтения у ядра
+    unsigned writes_in_flight;  // Запросов записи у ядра
+#endif
+} IoPipeline;
+
+/*
+ * Структура DecompressJob - общее состояние параллельного восстановления
+ */
+typedef struct DecompressJob {
+    const char* input_filename;  // Сжатый файл (каждый поток открывает его сам)
+    const char* output_filename; // Выходной файл (каждый поток пишет через свой дескриптор)
+    MappedFile input;            // Отображение сжатого файла (data == NULL - через stdio)
+    MappedFile output;           // Отображение выходного файла
+    HuffmanFrameHeader header;   // Заголовок сжатого файла
+    size_t header_size;          // Размер заголовка (смещение первого блока)
+    unsigned long long* offsets; // Смещения блоков (при отображении - еще и конец последнего)
+    const unsigned char* dictionary; // Словарь для блоков HUFFMAN_MODE_DICTIONARY (NULL - нет)
+    Mutex mutex;                 // Защищает поля ниже
+    uint32_t next_block;         // Следующий блок, который еще никто не взял
+    int failed;                  // 1 - произошла ошибка, работа прекращается
+} DecompressJob;
+
+/*
+ * Структура DecodeBuffers - контекст и буферы восстановления блоков одного потока
+ */
+typedef struct DecodeBuffers {
+    HuffmanContext* context;    // Контекст библиотеки (таблицы блоков, на которые ссылаются следующие)
+    EncodedBlock record;        // Прочитанный блок
+    EncodedBlock origin;        // Заголовок блока с таблицей для блока HUFFMAN_MODE_REUSE
+    unsigned char* output;      // Восстановленные данные блока
+    const unsigned long long* offsets; // Смещения блоков (NULL - блоки идут по порядку)
+} DecodeBuffers;
+
+/*
+ * Структура BatchChunk - часть файла в пакетном режиме (до BATCH_CHUNK_BLOCKS блоков подряд)
+ */
+typedef struct BatchChunk {
+    EncodedBlock* blocks;       // Сжатые блоки части (освобождаются после записи)
+    uint32_t count;             // Количество блоков части
+    int ready;                  // 1 - часть сжата и ждет записи
+} BatchChunk;
+
+/*
+ * Структура BatchFile - состояние одного файла в пакетном режиме
+ * Части файла сжимаются любыми потоками в любом порядке, а в сжатый файл
+ * попадают строго по порядку: поток, сжавший часть, дописывает все готовые
+ * подряд части, начиная с next_chunk. Поля после mutex изменяются под ним.
+ */
+typedef struct BatchFile {
+    const char* input_filename; // Исходный файл
+    char* output_filename;      // Сжатый файл
+    MappedFile input;           // Отображение исходного файла (data == NULL - через stdio)
+    FILE* output;               // Сжатый файл, открытый для записи
+    HuffmanFrameHeader header;  // Заголовок сжатого файла
+    unsigned long long* offsets; // Смещения блоков для индекса
+    BatchChunk* chunks;         // Части файла
+    uint32_t chunk_count;       // Количество частей
+    double start;               // Время начала обработки файла
+    double seconds;             // Время от начала обработки до записи индекса
+    Mutex mutex;                // Защищает поля ниже и флаги ready
+    CondVar cond;               // Сигнал о записи частей (его ждут потоки, упершиеся в предел)
+    uint64_t compressed_size;   // Размер уже записанной части сжатого файла
+    uint32_t next_claim;        // Следующая часть, которую возьмет задача сжатия
+    uint32_t next_chunk;        // Следующая часть для записи
+    int writing;                // 1 - один из потоков сейчас записывает части
+    int failed;                 // 1 - ошибка чтения или записи
+} BatchFile;
+
+/*
+ * Структура BatchTask - задача пула: открыть файл или сжать одну его часть
+ * Задачи сжатия одного файла взаимозаменяемы: часть выбирается при
+ * выполнении (batchClaimChunk), поэтому любая задача, своя или
+ * перехваченная, берет часть с наименьшим номером.
+ */
+typedef struct BatchTask {
+    BatchFile* file;            // Файл задачи
+    int kind;                   // BATCH_OPEN_TASK или BATCH_CHUNK_TASK
+} BatchTask;
+
+/*
+ * Структура BatchDeque - очередь задач одного потока пула
+ * Владелец берет задачи с конца (последнюю добавленную - ее данные еще
+ * в кэше), остальные потоки перехватывают задачи с начала (самые старые).
+ */
+typedef struct BatchDeque {
+    BatchTask* tasks;           // Задачи с номерами от top до bottom - 1
+    int top;                    // Первая задача (отсюда перехватывают)
+    int bottom;                 // За последней задачей (здесь добавляет и берет владелец)
+    int capacity;               // Емкость массива tasks
+    Mutex mutex;                // Защищает очередь
+} BatchDeque;
+
+/*
+ * Структура BatchJob - общее состояние пакетного сжатия
+ * Поля после mutex изменяются только под мьютексом.
+ */
+typedef struct BatchJob {
+    CompressOptions options;    // Параметры сжатия всех файлов
+    BatchDeque* deques;         // Очереди потоков
+    int threads;                // Количество потоков пула
+    Mutex mutex;                // Защищает поля ниже
+    CondVar cond;               // Сигнал о новых задачах или о завершении всех задач
+    uint64_t pending;           // Задачи, добавленные и еще не выполненные
+    uint64_t version;           // Счетчик добавлений (бездействующий поток ждет его изменения)
+    uint64_t steals;            // Количество перехваченных задач
+    uint64_t tasks;             // Количество выполненных задач
+} BatchJob;
+
+/*
+ * Структура BatchWorker - поток пула пакетного сжатия
+ */
+typedef struct BatchWorker {
+    BatchJob* job;              // Общее состояние
+    int id;                     // Номер потока (и его очереди)
+    unsigned char* raw;         // Буфер блока при чтении через stdio
+    ThreadHandle thread;        // Поток (у нулевого - не используется: работает основной)
+    HuffmanContext* context;    // Контекст библиотеки потока (кэш таблиц, буферы)
+} BatchWorker;
+
+/*
+ * Структура HistogramTask - часть данных для параллельного подсчета частот
+ */
+typedef struct HistogramTask {
+    const unsigned char* data;               // Начало части
+    size_t size;                             // Размер части
+    unsigned int frequencies[ASCII_SIZE];    // Гистограмма части
+    int joinable;                            // 1 - часть считает отдельный поток
+} HistogramTask;
+
+// ========== ЗАМЕРЫ ПО СТАДИЯМ ==========
+
+/*
+ * Тип ProfileSample - показания в начале замеряемого участка (HuffmanProfileSample
+ * из huffman.h: те же участки замеряет и библиотека, см. profileStart)
+ */
+typedef HuffmanProfileSample ProfileSample;
+
+/*
+ * Структура ProfileStage - накопленные замеры одной стадии
+ */
+typedef struct ProfileStage {
+    uint64_t calls;                          // Количество замеренных участков
+    double seconds;                          // Суммарное время участков (по всем потокам)
+    uint64_t bytes_in;                       // Байт получено стадией
+    uint64_t bytes_out;                      // Байт выдано стадией
+    uint64_t counters[PROFILE_COUNTERS];     // Приращения аппаратных счетчиков
+} ProfileStage;
+
+/*
+ * Структура Profile - состояние замеров всей программы
+ * Стадии изменяются только под мьютексом: участки замеряются и в рабочих потоках.
+ */
+typedef struct Profile {
+    int enabled;                             // 1 - замеры включены (--profile)
+    int counters_ok;                         // 1 - аппаратные счетчики доступны
+    double start;                            // Время включения замеров
+    Mutex mutex;                             // Защищает stages
+    ProfileStage stages[PROFILE_STAGE_COUNT];
+} Profile;
+
+static Profile profile;                      // Замеры выключены, пока не вызван profileStart
+
+/*
+ * Макросы замеров: участок между PROFILE_BEGIN и PROFILE_END добавляется
+ * к стадии. Пока замеры выключены, макрос - одна проверка флага, а размеры
+ * в PROFILE_END даже не вычисляются; при USE_PROFILE=0 макросы пусты.
+ * Асинхронный запрос (io_uring) замеряется парой PROFILE_ISSUE при
+ * отправке и PROFILE_COMPLETE при завершении.
+ */
+#if USE_PROFILE
+#define PROFILE_BEGIN(sample) do { if (profile.enabled) profileBegin(&(sample)); } while (0)
+#define PROFILE_END(stage, sample, in, out) \
+    do { if (profile.enabled) profileEnd((stage), &(sample), (in), (out)); } while (0)
+#define PROFILE_THREAD_EXIT() do { if (profile.enabled) profileThreadExit(); } while (0)
+#define PROFILE_ISSUE(issued) do { if (profile.enabled) (issued) = wallClockSeconds(); } while (0)
+#define PROFILE_COMPLETE(stage, issued, in, out) \
+    do { if (profile.enabled) profileRequest((stage), (issued), (in), (out)); } while (0)
+#else
+#define PROFILE_BEGIN(sample) ((void)(sample))
+#define PROFILE_END(stage, sample, in, out) ((void)(sample))
+#define PROFILE_THREAD_EXIT() ((void)0)
+#define PROFILE_ISSUE(issued) ((void)(issued))
+#define PROFILE_COMPLETE(stage, issued, in, out) ((void)(issued))
+#endif
+
 // ========== ПРОТОТИПЫ ФУНКЦИЙ ==========
 
-// Функции для работы с деревом Хаффмана и кучей
+// Функции для работы с деревом Хаффмана и кучей (эталон для бенчмарка и полного цикла)
 Node* createNode(unsigned char symbol, unsigned int freq);                // Создание нового узла
 MinHeap* createMinHeap(int capacity);                                     // Создание минимальной кучи
 void swapNodes(Node** a, Node** b);                                       // Обмен двух указателей на узлы
@@ -71,24 +553,105 @@ Node* extractMin(MinHeap* heap);                                          // И
 void insertMinHeap(MinHeap* heap, Node* node);                            // Вставка узла в кучу
 void buildMinHeap(MinHeap* heap);                                         // Построение кучи из массива
 Node* buildHuffmanTree(unsigned int frequencies[]);                       // Построение дерева Хаффмана
-void generateCodesRecursive(Node* root, char* code, int depth, Code codes[]); // Рекурсивная генерация кодов
+void generateCodesRecursive(Node* root, uint64_t code, int depth, Code codes[]); // Рекурсивная генерация кодов
 void generateCodes(Node* root, Code codes[]);                             // Обертка для генерации кодов
+void formatCode(const Code* code, char* text);                            // Текстовый вид кода ("101")
 void freeHuffmanTree(Node* root);                                         // Освобождение памяти дерева
 
-// Функции для работы с файлами и сжатия
+// Функции для работы с файлами
 void countFrequencies(FILE* file, unsigned int frequencies[]);            // Подсчет частот символов
-void writeEncodedFile(FILE* input, FILE* output, Code codes[], long* bit_count); // Кодирование файла
-void decodeFile(FILE* input, FILE* output, Node* root, long bit_count);   // Декодирование файла
+void addFrequencies(unsigned int frequencies[], const unsigned char* data, // Прибавление частот буфера
+                    size_t size);
+void countFrequenciesParallel(const unsigned char* data, size_t size,     // Подсчет частот несколькими потоками
+                              unsigned int frequencies[], int threads);
+void decodeFileTree(FILE* input, FILE* output, Node* root, uint64_t bit_count); // Эталонное декодирование по дереву
 int compareFiles(FILE* file1, FILE* file2);                               // Сравнение двух файлов
+uint64_t getFileSize(FILE* file);                                         // Размер файла (64 бита)
 void printStatistics(const char* filename, unsigned int frequencies[],    // Вывод статистики
                      Code codes[], long original_size, long compressed_size);
 
+// Функции работы со сжатым файлом (формат - в библиотеке, здесь чтение и запись)
+HuffmanContext* createContext(const CompressOptions* options,             // Контекст библиотеки по параметрам
+                              const unsigned char* dictionary);
+int encodeBlock(HuffmanContext* context, const unsigned char* data,       // Сжатие одного блока
+                size_t size, uint32_t index, EncodedBlock* block);
+int readFrameHeader(FILE* input, HuffmanFrameHeader* header,              // Чтение и проверка заголовка
+                    size_t* header_size);
+int readBlockHeader(FILE* input, EncodedBlock* record,                    // Чтение заголовка блока
+                    HuffmanBlockInfo* info);
+int readBlock(FILE* input, EncodedBlock* record, HuffmanBlockInfo* info); // Чтение блока целиком
+int locateBlocks(const MappedFile* input, const HuffmanFrameHeader* header, // Смещения блоков по отображению
+                 size_t header_size, unsigned long long offsets[]);
+void printTableCacheStats(FILE* report, const HuffmanCacheStats* cache); // Доля повторенных таблиц
+int loadDictionary(const char* filename,                                  // Загрузка файла словаря
+                   unsigned char dictionary[HUFFMAN_DICTIONARY_SIZE]);
+int trainDictionary(const char* const inputs[], int count,               // Обучение словаря по образцам
+                    int max_code_length, const char* dictionary_filename);
+int seekFile(FILE* file, uint64_t offset);                                // Перемещение по файлу (64 бита)
+int cpuCount(void);                                                       // Количество процессоров
+int mapInputFile(const char* filename, MappedFile* map);                  // Отображение файла для чтения
+int mapOutputFile(const char* filename, uint64_t size, MappedFile* map);  // Отображение нового файла для записи
+int unmapFile(MappedFile* map);                                           // Снятие отображения
+int sameFile(const char* first, const char* second);                      // Два пути к одному файлу
+char* beginOutputFile(const char* filename);                              // Путь записи выходного файла
+int finishOutputFile(const char* filename, char* path, int ok);           // Замена выходного файла записанным
+int writeBlocks(FILE* output, EncodedBlock* const blocks[], int count);   // Запись пачки блоков
+int compressFile(const char* input_filename, const char* output_filename, // Сжатие файла
+                 const CompressOptions* options, CompressResult* result);
+int decompressFile(const char* input_filename, const char* output_filename, // Восстановление файла
+                   int threads, const unsigned char* dictionary);
+int decompressRange(const char* input_filename, const char* output_filename, // Восстановление части файла
+                    uint64_t offset, uint64_t length, const unsigned char* dictionary);
+uint64_t writeBlockIndex(FILE* output, const HuffmanFrameHeader* header, // Запись индекса блоков
+                         const unsigned long long offsets[], uint64_t index_offset);
+int readBlockIndex(FILE* input, const HuffmanFrameHeader* header,         // Чтение индекса блоков
+                   unsigned long long offsets[]);
+void initDecodeBuffers(DecodeBuffers* buffers, uint32_t block_size,       // Контекст и буферы восстановления
+                       const unsigned char* dictionary);
+void freeDecodeBuffers(DecodeBuffers* buffers);                           // Освобождение буферов
+int readAndDecodeBlock(FILE* input, uint32_t index, uint32_t expected_size, // Чтение и восстановление блока
+                       DecodeBuffers* buffers);
+int compressStream(FILE* input, FILE* output, const CompressOptions* options, // Сжатие потока (stdin)
+                   FILE* report);
+int decompressStream(FILE* input, FILE* output, const HuffmanFrameHeader* header, // Восстановление потока
+                     uint64_t* written, const unsigned char* dictionary);
+int compressBatch(const char* const inputs[], int count,                 // Пакетное сжатие многих файлов
+                  const char* output_dir, const CompressOptions* options);
+int collectBatchInputs(const char* path, char*** inputs, int* count,      // Файлы из аргумента (файл или папка)
+                       int* capacity);
+int readBatchList(const char* list_filename, char*** inputs, int* count,  // Файлы из списка
+                  int* capacity);
+
 // Основные функции программы
 int huffman_compress_decompress(const char* input_filename,               // Полный цикл сжатия-восстановления
                                const char* encoded_filename,
                                const char* decoded_filename);
+int runBenchmark(const char* input_filename);                             // Замер скорости кодирования и декодирования
+double wallClockSeconds(void);                                            // Текущее время по настенным часам
+void profileStart(void);                                                  // Включение замеров по стадиям
+void profileBegin(ProfileSample* sample);                                 // Начало замеряемого участка
+void profileEnd(int stage, const ProfileSample* sample,                   // Конец участка: добавить к стадии
+                unsigned long long bytes_in, unsigned long long bytes_out);
+void profileRequest(int stage, double issued,                             // Асинхронный запрос: добавить к стадии
+                    uint64_t bytes_in, uint64_t bytes_out);
+void profileThreadExit(void);                                             // Счетчики завершающегося потока
+int profileFinish(const char* filename, const char* command,              // Отчет замеров в JSON
+                  const char* input, const char* output, int status);
 void createTestFiles();                                                   // Создание тестовых файлов
 void showMenu();                                                          // Отображение меню выбора
+int parseSize(const char* text, uint64_t* value);                         // Размер с суффиксом K/M/G
+int parseRange(const char* text, uint64_t* offset, uint64_t* length);     // Диапазон "смещение:длина"
+int parseCompressOptions(int argc, char* argv[], int* index,              // Параметры сжатия
+                         CompressOptions* options);
+void defaultCompressOptions(CompressOptions* options);                    // Параметры сжатия по умолчанию
+int parseCompressOption(int argc, char* argv[], int* index,               // Один параметр сжатия
+                        CompressOptions* options);
+int loadOptionsDictionary(CompressOptions* options,                       // Словарь из --dict
+                          unsigned char dictionary[HUFFMAN_DICTIONARY_SIZE]);
+#ifdef HUFFMAN_BENCH_SUITE
+int parseSuiteOptions(int argc, char* argv[], SuiteOptions* options);     // Параметры набора замеров
+int runBenchmarkSuite(int argc, char* argv[]);                            // Набор замеров по стадиям
+#endif
 
 // ========== РЕАЛИЗАЦИЯ ФУНКЦИЙ ==========
 
@@ -112,6 +675,8 @@ Node* createNode(unsigned char symbol, unsigned int freq) {
     node->symbol = symbol;                     // Устанавливаем символ
     node->freq = freq;                         // Устанавливаем частоту
     node->left = node->right = NULL;           // Инициализируем указатели на потомков как NULL
+    node->parent = NULL;                       // Родитель и номер нужны только адаптивному дереву библиотеки
+    node->number = 0;
     return node;                               // Возвращаем указатель на созданный узел
 }
 
@@ -313,36 +878,37 @@ Node* buildHuffmanTree(unsigned int frequencies[]) {
 /**
  * Функция generateCodesRecursive - рекурсивно генерирует коды Хаффмана для символов
  * @param root - текущий узел дерева
- * @param code - массив символов, представляющий текущий код (заполняется по мере обхода)
+ * @param code - текущий код, упакованный в целое число (младшие depth битов)
  * @param depth - текущая глубина в дереве (длина текущего кода)
  * @param codes - массив структур Code для сохранения сгенерированных кодов
  *
  * Обходит дерево Хаффмана в глубину (DFS) и генерирует двоичные коды:
- * - При переходе в левого потомка добавляется '0'
- * - При переходе в правого потомка добавляется '1'
+ * - При переходе в левого потомка к коду дописывается бит 0
+ * - При переходе в правого потомка к коду дописывается бит 1
  * - При достижении листа сохраняется сгенерированный код
  */
-void generateCodesRecursive(Node* root, char* code, int depth, Code codes[]) {
+void generateCodesRecursive(Node* root, uint64_t code, int depth, Code codes[]) {
     if (root == NULL) {                              // Базовый случай рекурсии: достигнут NULL
         return;
     }
 
     // Если текущий узел - лист (не имеет потомков)
     if (root->left == NULL && root->right == NULL) {
-        code[depth] = '\0';                          // Добавляем завершающий нуль-символ для строки
-        codes[root->symbol].symbol = root->symbol;   // Сохраняем символ
-        strcpy(codes[root->symbol].bits, code);      // Копируем сгенерированный код в структуру
+        codes[root->symbol].value = code;            // Сохраняем упакованный код
         codes[root->symbol].length = depth;          // Сохраняем длину кода
         return;
     }
 
-    // Рекурсивно обходим левое поддерево
-    code[depth] = '0';                               // Добавляем '0' при переходе влево
-    generateCodesRecursive(root->left, code, depth + 1, codes);
+    if (depth >= MAX_CODE_LENGTH) {                  // Код не помещается в 64-битное значение
+        fprintf(stderr, "Ошибка: длина кода Хаффмана превышает %d бит\n", MAX_CODE_LENGTH);
+        exit(EXIT_FAILURE);
+    }
 
-    // Рекурсивно обходим правое поддерево
-    code[depth] = '1';                               // Добавляем '1' при переходе вправо
-    generateCodesRecursive(root->right, code, depth + 1, codes);
+    // Рекурсивно обходим левое поддерево (дописываем бит 0)
+    generateCodesRecursive(root->left, code << 1, depth + 1, codes);
+
+    // Рекурсивно обходим правое поддерево (дописываем бит 1)
+    generateCodesRecursive(root->right, (code << 1) | 1, depth + 1, codes);
 }
 
 /**
@@ -351,15 +917,33 @@ void generateCodesRecursive(Node* root, char* code, int depth, Code codes[]) {
  * @param codes - массив структур Code для сохранения кодов
  *
  * Инициализирует массив кодов и запускает рекурсивную генерацию.
+ * Если в дереве единственный лист, символу назначается код "0" длиной 1 бит:
+ * код нулевой длины нельзя ни записать в поток, ни восстановить по заголовку.
  */
 void generateCodes(Node* root, Code codes[]) {
-    char code[MAX_TREE_HT];                          // Временный массив для построения кода
-    // Инициализируем все коды нулевой длиной и пустой строкой
+    // Инициализируем все коды нулевой длиной
     for (int i = 0; i < ASCII_SIZE; i++) {
+        codes[i].value = 0;
         codes[i].length = 0;
-        codes[i].bits[0] = '\0';
     }
-    generateCodesRecursive(root, code, 0, codes);    // Начинаем рекурсивную генерацию с корня
+    if (root != NULL && root->left == NULL && root->right == NULL) {
+        codes[root->symbol].length = 1;              // Единственный символ: код из одного бита
+        return;
+    }
+    generateCodesRecursive(root, 0, 0, codes);       // Начинаем рекурсивную генерацию с корня
+}
+
+/**
+ * Функция formatCode - формирует текстовое представление кода для вывода
+ * @param code - код символа
+ * @param text - буфер не меньше MAX_TREE_HT байт для строки вида "101"
+ */
+void formatCode(const Code* code, char* text) {
+    for (int i = 0; i < code->length; i++) {
+        // Первым выводится старший бит кода
+        text[i] = ((code->value >> (code->length - 1 - i)) & 1) ? '1' : '0';
+    }
+    text[code->length] = '\0';
 }
 
 /**
@@ -379,90 +963,117 @@ void freeHuffmanTree(Node* root) {
 }
 
 /**
- * Функция countFrequencies - подсчитывает частоту появления каждого символа в файле
- * @param file - указатель на открытый файл
+ * Функция histogramWorker - рабочий поток параллельного подсчета частот
+ * @param arg - указатель на HistogramTask со своей частью данных
+ */
+static THREAD_FUNC histogramWorker(void* arg) {
+    HistogramTask* task = (HistogramTask*)arg;
+    huffmanCountFrequencies(task->data, task->size, task->frequencies);
+    PROFILE_THREAD_EXIT();
+    return THREAD_RETURN;
+}
+
+/**
+ * Функция countFrequenciesParallel - подсчитывает частоты символов несколькими потоками
+ * @param data - данные
+ * @param size - размер данных в байтах
  * @param frequencies - массив для сохранения частот (индекс = код символа)
+ * @param threads - наибольшее количество потоков
  *
- * Считывает файл блоками для эффективности и подсчитывает,
- * сколько раз встречается каждый символ (0-255).
+ * Данные делятся на равные части, каждый поток считает свою гистограмму,
+ * затем гистограммы складываются. На каждую часть приходится не меньше
+ * HISTOGRAM_MIN_PART байт, иначе создание потоков дороже самого подсчета.
  */
-void countFrequencies(FILE* file, unsigned int frequencies[]) {
-    // Инициализируем массив частот нулями
-    for (int i = 0; i < ASCII_SIZE; i++) {
-        frequencies[i] = 0;
+void countFrequenciesParallel(const unsigned char* data, size_t size, unsigned int frequencies[],
+                              int threads) {
+    if ((size_t)threads > size / HISTOGRAM_MIN_PART) {
+        threads = (int)(size / HISTOGRAM_MIN_PART);
+    }
+    if (threads <= 1) {
+        huffmanCountFrequencies(data, size, frequencies);
+        return;
     }
 
-    unsigned char buffer[BUFFER_SIZE];               // Буфер для чтения файла
-    size_t bytes_read;                               // Количество прочитанных байт
+    HistogramTask* tasks = (HistogramTask*)malloc(threads * sizeof(HistogramTask));
+    ThreadHandle* workers = (ThreadHandle*)malloc(threads * sizeof(ThreadHandle));
+    if (tasks == NULL || workers == NULL) {
+        fprintf(stderr, "Ошибка выделения памяти для потоков\n");
+        exit(EXIT_FAILURE);
+    }
 
-    rewind(file);                                    // Перемещаем указатель файла в начало
+    size_t part = size / threads;
+    for (int t = 0; t < threads; t++) {
+        tasks[t].data = data + (size_t)t * part;
+        tasks[t].size = t == threads - 1 ? size - (size_t)t * part : part;
+        tasks[t].joinable = t > 0 && threadStart(&workers[t], histogramWorker, &tasks[t]);
+        if (t > 0 && !tasks[t].joinable) {
+            histogramWorker(&tasks[t]);              // Поток не создался - считаем сами
+        }
+    }
+    huffmanCountFrequencies(tasks[0].data, tasks[0].size, tasks[0].frequencies);  // Первая часть - в текущем потоке
 
-    // Читаем файл блоками по BUFFER_SIZE байт
-    while ((bytes_read = fread(buffer, 1, BUFFER_SIZE, file)) > 0) {
-        // Обрабатываем каждый прочитанный байт
-        for (size_t i = 0; i < bytes_read; i++) {
-            frequencies[buffer[i]]++;                // Увеличиваем счетчик для соответствующего символа
+    for (int i = 0; i < ASCII_SIZE; i++) {
+        frequencies[i] = tasks[0].frequencies[i];
+    }
+    for (int t = 1; t < threads; t++) {
+        if (tasks[t].joinable) {
+            threadJoin(workers[t]);
+        }
+        for (int i = 0; i < ASCII_SIZE; i++) {
+            frequencies[i] += tasks[t].frequencies[i];
         }
     }
+
+    free(workers);
+    free(tasks);
 }
 
 /**
- * Функция writeEncodedFile - кодирует исходный файл и записывает результат в бинарный файл
- * @param input - входной файл (исходные данные)
- * @param output - выходной файл (закодированные данные)
- * @param codes - массив кодов Хаффмана для каждого символа
- * @param bit_count - указатель на переменную для подсчета общего количества записанных битов
+ * Функция countFrequencies - подсчитывает частоту появления каждого символа в файле
+ * @param file - указатель на открытый файл
+ * @param frequencies - массив для сохранения частот (индекс = код символа)
  *
- * Алгоритм кодирования:
- * 1. Для каждого символа из входного файла берем его код Хаффмана
- * 2. Записываем каждый бит кода в битовый буфер
- * 3. Когда буфер заполняется (8 бит), записываем его как один байт в выходной файл
- * 4. В конце дописываем неполный байт, если остались биты
+ * Считывает файл блоками по IO_BUFFER_SIZE байт и складывает частоты
+ * каждого блока (см. addFrequencies).
  */
-void writeEncodedFile(FILE* input, FILE* output, Code codes[], long* bit_count) {
-    unsigned char buffer = 0;                        // Байтовый буфер для накопления битов
-    int bit_pos = 0;                                 // Позиция текущего бита в буфере (0-7)
-    *bit_count = 0;                                  // Инициализируем счетчик битов
+void countFrequencies(FILE* file, unsigned int frequencies[]) {
+    // Инициализируем массив частот нулями
+    for (int i = 0; i < ASCII_SIZE; i++) {
+        frequencies[i] = 0;
+    }
 
-    unsigned char read_buffer[BUFFER_SIZE];          // Буфер для чтения исходного файла
+    unsigned char* buffer = (unsigned char*)malloc(IO_BUFFER_SIZE);  // Буфер для чтения файла
+    if (buffer == NULL) {
+        fprintf(stderr, "Ошибка выделения памяти для буфера чтения\n");
+        exit(EXIT_FAILURE);
+    }
     size_t bytes_read;                               // Количество прочитанных байт
 
-    rewind(input);                                   // Перемещаем указатель входного файла в начало
-
-    // Читаем исходный файл блоками
-    while ((bytes_read = fread(read_buffer, 1, BUFFER_SIZE, input)) > 0) {
-        // Обрабатываем каждый прочитанный символ
-        for (size_t i = 0; i < bytes_read; i++) {
-            unsigned char ch = read_buffer[i];       // Текущий символ
-            Code* code = &codes[ch];                 // Получаем код Хаффмана для этого символа
-
-            // Обрабатываем каждый бит кода
-            for (int j = 0; j < code->length; j++) {
-                if (code->bits[j] == '1') {          // Если текущий бит равен '1'
-                    buffer |= (1 << (7 - bit_pos));  // Устанавливаем соответствующий бит в буфере
-                }
-
-                bit_pos++;                           // Переходим к следующей позиции в буфере
-                (*bit_count)++;                      // Увеличиваем общий счетчик битов
+    rewind(file);                                    // Перемещаем указатель файла в начало
 
-                // Если буфер заполнен (8 бит)
-                if (bit_pos == 8) {
-                    fputc(buffer, output);           // Записываем байт в выходной файл
-                    buffer = 0;                      // Сбрасываем буфер
-                    bit_pos = 0;                     // Сбрасываем позицию бита
-                }
-            }
-        }
+    // Читаем файл блоками по IO_BUFFER_SIZE байт
+    while ((bytes_read = fread(buffer, 1, IO_BUFFER_SIZE, file)) > 0) {
+        addFrequencies(frequencies, buffer, bytes_read);
     }
+    free(buffer);
+}
 
-    // Если после обработки всех символов остались незаписанные биты
-    if (bit_pos > 0) {
-        fputc(buffer, output);                       // Записываем последний неполный байт
+/**
+ * Функция addFrequencies - прибавляет частоты символов буфера к накопленным
+ * @param frequencies - накопленные частоты (индекс = код символа)
+ * @param data - данные
+ * @param size - размер данных в байтах
+ */
+void addFrequencies(unsigned int frequencies[], const unsigned char* data, size_t size) {
+    unsigned int part[ASCII_SIZE];                   // Частоты одного буфера
+    huffmanCountFrequencies(data, size, part);
+    for (int i = 0; i < ASCII_SIZE; i++) {
+        frequencies[i] += part[i];
     }
 }
 
 /**
- * Функция decodeFile - декодирует бинарный файл с использованием дерева Хаффмана
+ * Функция decodeFileTree - эталонное декодирование бинарного файла обходом дерева Хаффмана
  * @param input - закодированный бинарный файл
  * @param output - выходной файл для декодированных данных
  * @param root - корень дерева Хаффмана
@@ -475,13 +1086,15 @@ void writeEncodedFile(FILE* input, FILE* output, Code codes[], long* bit_count)
  *    - Если бит равен 1, переходим к правому потомку
  * 3. При достижении листа записываем соответствующий символ в выходной файл
  * 4. Возвращаемся к корню и повторяем для следующего символа
+ *
+ * Обрабатывает по одному биту за шаг и поэтому медленнее табличного декодера
+ * (huffmanDecodeBits); сохранена как эталон для проверки и сравнения скорости в бенчмарке.
+ * Поток читается с текущей позиции файла.
  */
-void decodeFile(FILE* input, FILE* output, Node* root, long bit_count) {
+void decodeFileTree(FILE* input, FILE* output, Node* root, uint64_t bit_count) {
     Node* current = root;                            // Текущий узел в дереве (начинаем с корня)
     unsigned char byte;                              // Текущий прочитанный байт
-    long bits_processed = 0;                         // Счетчик обработанных битов
-
-    rewind(input);                                   // Перемещаем указатель файла в начало
+    uint64_t bits_processed = 0;                     // Счетчик обработанных битов
 
     // Читаем файл побайтово, пока не обработаем все значимые биты
     while (bits_processed < bit_count && fread(&byte, 1, 1, input) == 1) {
@@ -490,7 +1103,9 @@ void decodeFile(FILE* input, FILE* output, Node* root, long bit_count) {
             int bit = (byte >> i) & 1;               // Извлекаем i-й бит из байта
 
             // Переходим по дереву в зависимости от значения бита
-            if (bit == 0) {
+            if (root->left == NULL && root->right == NULL) {
+                current = root;                      // Дерево из одного листа: каждый бит - один символ
+            } else if (bit == 0) {
                 current = current->left;             // Бит 0 -> идем влево
             } else {
                 current = current->right;            // Бит 1 -> идем вправо
@@ -543,6 +1158,27 @@ int compareFiles(FILE* file1, FILE* file2) {
     return 1;                                        // Все проверки пройдены, файлы идентичны
 }
 
+/**
+ * Функция getFileSize - определяет размер открытого файла
+ * @param file - указатель на открытый файл
+ * @return размер файла в байтах
+ *
+ * Использует 64-битные смещения, поэтому работает и с файлами больше 2 ГБ
+ * (ftell на Windows возвращает 32-битный long). Указатель файла
+ * возвращается в начало.
+ */
+uint64_t getFileSize(FILE* file) {
+#ifdef _WIN32
+    _fseeki64(file, 0, SEEK_END);
+    long long size = _ftelli64(file);
+#else
+    fseeko(file, 0, SEEK_END);
+    long long size = (long long)ftello(file);
+#endif
+    rewind(file);
+    return size > 0 ? (uint64_t)size : 0;
+}
+
 /**
  * Функция printStatistics - выводит статистику сжатия в консоль
  * @param filename - имя исходного файла
@@ -605,6 +1241,8 @@ void printStatistics(const char* filename, unsigned int frequencies[],
             // Выводим информацию о первых 20 символах (чтобы не перегружать вывод)
             if (total_symbols <= 20) {
                 char symbol_str[10];                  // Строковое представление символа
+                char code_str[MAX_TREE_HT];           // Строковое представление кода
+                formatCode(&codes[i], code_str);
                 // Форматируем вывод в зависимости от типа символа
                 if (i == '\n') {
                     strcpy(symbol_str, "'\\n'");      // Символ новой строки
@@ -621,7 +1259,7 @@ void printStatistics(const char* filename, unsigned int frequencies[],
                 printf("%-10s %-10u %-20s %d\n",      // Вывод строки таблицы
                        symbol_str,
                        frequencies[i],
-                       codes[i].bits,
+                       code_str,
                        codes[i].length);
             }
         }
@@ -676,142 +1314,4290 @@ void printStatistics(const char* filename, unsigned int frequencies[],
 }
 
 /**
- * Функция huffman_compress_decompress - выполняет полный цикл сжатия и восстановления файла
- * @param input_filename - путь к исходному файлу
- * @param encoded_filename - путь для сохранения сжатого файла
- * @param decoded_filename - путь для сохранения восстановленного файла
- * @return EXIT_SUCCESS при успехе, EXIT_FAILURE при ошибке
- *
- * Выполняет все 6 шагов алгоритма Хаффмана:
- * 1. Подсчет частот символов
- * 2. Построение дерева Хаффмана
- * 3. Генерация кодов
- * 4. Кодирование файла
- * 5. Декодирование файла
- * 6. Проверка корректности
+ * Функция seekFile - перемещает указатель файла на 64-битное смещение от начала
+ * @param file - указатель на открытый файл
+ * @param offset - смещение в байтах
+ * @return 0 при успехе, иначе ненулевое значение
  */
-int huffman_compress_decompress(const char* input_filename,
-                               const char* encoded_filename,
-                               const char* decoded_filename) {
+int seekFile(FILE* file, uint64_t offset) {
+#ifdef _WIN32
+    return _fseeki64(file, (long long)offset, SEEK_SET);
+#else
+    return fseeko(file, (off_t)offset, SEEK_SET);
+#endif
+}
 
-    printf("\n==============================================\n");
-    printf("Обработка файла: %s\n", input_filename);
-    printf("==============================================\n");
+/**
+ * Функция cpuCount - возвращает количество логических процессоров
+ * @return количество процессоров (не меньше 1)
+ */
+int cpuCount(void) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int)count : 1;
+#endif
+}
 
-    // Шаг 0: Открываем исходный файл
-    FILE* input_file = fopen(input_filename, "rb");   // Открываем в бинарном режиме для чтения
-    if (input_file == NULL) {                         // Проверяем успешность открытия
-        fprintf(stderr, "Ошибка: не удалось открыть файл '%s'\n", input_filename);
-        return EXIT_FAILURE;                          // Возвращаем код ошибки
+/**
+ * Функция mapInputFile - отображает файл в память только для чтения
+ * @param filename - путь к файлу
+ * @param map - структура для заполнения
+ * @return 1 при успехе, 0 если отображение недоступно (тогда используется stdio)
+ *
+ * Отображение делается один раз и используется всеми этапами и потоками:
+ * данные блоков читаются прямо из страниц кэша файла без копирования.
+ * Подсказка MADV_SEQUENTIAL включает агрессивное упреждающее чтение.
+ * Пустые файлы не отображаются.
+ */
+int mapInputFile(const char* filename, MappedFile* map) {
+    map->data = NULL;
+    map->size = 0;
+#if USE_MMAP
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return 0;
     }
-
-    clock_t start_time = clock();                     // Запоминаем время начала выполнения
-
-    // Шаг 1: Подсчет частот символов
-    printf("[1/6] Подсчет частот символов...\n");
-    unsigned int frequencies[ASCII_SIZE];
-    countFrequencies(input_file, frequencies);
-
-    // Определяем размер исходного файла
-    fseek(input_file, 0, SEEK_END);                   // Перемещаем указатель в конец файла
-    long original_size = ftell(input_file);           // Получаем текущую позицию (это и есть размер)
-    rewind(input_file);                               // Возвращаем указатель в начало файла
-
-    printf("   Размер исходного файла: %ld байт\n", original_size);
-
-    // Проверяем, не пустой ли файл
-    if (original_size == 0) {
-        fprintf(stderr, "Ошибка: файл '%s' пустой\n", input_filename);
-        fclose(input_file);
-        return EXIT_FAILURE;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size <= 0 ||
+        (uint64_t)info.st_size > (uint64_t)SIZE_MAX) {
+        close(fd);
+        return 0;
     }
-
-    // Шаг 2: Построение дерева Хаффмана
-    printf("[2/6] Построение дерева Хаффмана...\n");
-    Node* root = buildHuffmanTree(frequencies);
-    printf("   Дерево построено успешно\n");
-
-    // Шаг 3: Генерация кодов
-    printf("[3/6] Генерация кодов символов...\n");
-    Code codes[ASCII_SIZE];
-    generateCodes(root, codes);
-    printf("   Коды сгенерированы успешно\n");
-
-    // Шаг 4: Кодирование файла
-    printf("[4/6] Кодирование исходного файла...\n");
-    FILE* encoded_file = fopen(encoded_filename, "wb");  // Открываем файл для записи в бинарном режиме
-    if (encoded_file == NULL) {
-        fprintf(stderr, "Ошибка: не удалось создать файл '%s'\n", encoded_filename);
-        fclose(input_file);
-        freeHuffmanTree(root);
-        return EXIT_FAILURE;
+    void* data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);                                       // Отображение остается действительным
+    if (data == MAP_FAILED) {
+        return 0;
     }
+    madvise(data, (size_t)info.st_size, MADV_SEQUENTIAL);
+    map->data = (unsigned char*)data;
+    map->size = (uint64_t)info.st_size;
+    return 1;
+#else
+    (void)filename;
+    return 0;
+#endif
+}
 
-    long bit_count = 0;                               // Переменная для хранения количества битов
-    writeEncodedFile(input_file, encoded_file, codes, &bit_count);
-    fclose(encoded_file);
-
-    // Определяем размер сжатого файла
-    encoded_file = fopen(encoded_filename, "rb");
-    fseek(encoded_file, 0, SEEK_END);
-    long compressed_size = ftell(encoded_file);
-    fclose(encoded_file);
-
-    printf("   Закодированные данные сохранены в '%s'\n", encoded_filename);
-    printf("   Использовано бит: %ld (%.2f байт)\n", bit_count, (double)bit_count / 8);
-
-    // Шаг 5: Декодирование файла
-    printf("[5/6] Декодирование сжатого файла...\n");
-    encoded_file = fopen(encoded_filename, "rb");
-    FILE* decoded_file = fopen(decoded_filename, "wb");
-
-    if (encoded_file == NULL || decoded_file == NULL) {
-        fprintf(stderr, "Ошибка при открытии файлов для декодирования\n");
-        if (encoded_file) fclose(encoded_file);
-        if (decoded_file) fclose(decoded_file);
-        fclose(input_file);
-        freeHuffmanTree(root);
-        return EXIT_FAILURE;
+/**
+ * Функция mapOutputFile - создает файл заданного размера и отображает его в память
+ * @param filename - путь к файлу (создается заново)
+ * @param size - размер файла в байтах (больше 0)
+ * @param map - структура для заполнения
+ * @return 1 при успехе, 0 если отображение недоступно (тогда используется stdio)
+ *
+ * Место на диске резервируется заранее (posix_fallocate), чтобы нехватка
+ * места обнаружилась здесь, а не сигналом SIGBUS при записи в отображение.
+ */
+int mapOutputFile(const char* filename, uint64_t size, MappedFile* map) {
+    map->data = NULL;
+    map->size = 0;
+#if USE_MMAP
+    if (size == 0 || size > (uint64_t)SIZE_MAX) {
+        return 0;
     }
+    int fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return 0;
+    }
+    if (posix_fallocate(fd, 0, (off_t)size) != 0) {
+        close(fd);
+        return 0;
+    }
+    void* data = mmap(NULL, (size_t)size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return 0;
+    }
+    map->data = (unsigned char*)data;
+    map->size = size;
+    return 1;
+#else
+    (void)filename;
+    (void)size;
+    return 0;
+#endif
+}
 
-    decodeFile(encoded_file, decoded_file, root, bit_count);
-
-    fclose(encoded_file);
-    fclose(decoded_file);
-
-    printf("   Декодированные данные сохранены в '%s'\n", decoded_filename);
+/**
+ * Функция unmapFile - снимает отображение файла
+ * @param map - отображение (после вызова пустое)
+ * @return 1 при успехе, 0 если не удалось сбросить изменения на диск
+ */
+int unmapFile(MappedFile* map) {
+    int ok = 1;
+#if USE_MMAP
+    if (map->data != NULL) {
+        ok = munmap(map->data, (size_t)map->size) == 0;
+    }
+#endif
+    map->data = NULL;
+    map->size = 0;
+    return ok;
+}
 
-    // Шаг 6: Проверка корректности восстановления
-    printf("[6/6] Проверка корректности восстановления...\n");
-    decoded_file = fopen(decoded_filename, "rb");
+/**
+ * Функция sameFile - проверяет, что два пути ведут к одному и тому же файлу
+ * @param first - первый путь
+ * @param second - второй путь
+ * @return 1 если оба файла существуют и это один файл, иначе 0
+ *
+ * Сравниваются устройство и номер файла, а не строки путей, поэтому
+ * совпадение находится и через "./", и через жесткие или символические ссылки.
+ */
+int sameFile(const char* first, const char* second) {
+#ifdef _WIN32
+    BY_HANDLE_FILE_INFORMATION info[2];
+    const char* paths[2] = {first, second};
+    for (int i = 0; i < 2; i++) {
+        HANDLE handle = CreateFileA(paths[i], 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                    NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, NULL);
+        if (handle == INVALID_HANDLE_VALUE) {
+            return 0;
+        }
+        BOOL ok = GetFileInformationByHandle(handle, &info[i]);
+        CloseHandle(handle);
+        if (!ok) {
+            return 0;
+        }
+    }
+    return info[0].dwVolumeSerialNumber == info[1].dwVolumeSerialNumber &&
+           info[0].nFileIndexHigh == info[1].nFileIndexHigh && info[0].nFileIndexLow == info[1].nFileIndexLow;
+#else
+    struct stat a, b;
+    return stat(first, &a) == 0 && stat(second, &b) == 0 && a.st_dev == b.st_dev && a.st_ino == b.st_ino;
+#endif
+}
 
-    if (compareFiles(input_file, decoded_file)) {
-        printf("   Восстановление успешно! Файлы идентичны.\n");
+/**
+ * Функция beginOutputFile - выбирает, куда писать выходной файл
+ * @param filename - путь к выходному файлу
+ * @return путь для записи (освобождается в finishOutputFile)
+ *
+ * Обычный или еще не созданный файл пишется во временный файл рядом
+ * с ним (в той же папке, чтобы переименование не копировало данные).
+ * Он заменяет выходной файл только после успешного завершения, поэтому
+ * при ошибке прежнее содержимое остается нетронутым. Устройства, каналы
+ * и символические ссылки пишутся напрямую.
+ */
+char* beginOutputFile(const char* filename) {
+    int direct = 0;
+#ifdef _WIN32
+    unsigned long id = (unsigned long)GetCurrentProcessId();
+    DWORD attributes = GetFileAttributesA(filename);
+    direct = attributes != INVALID_FILE_ATTRIBUTES &&
+             (attributes & (FILE_ATTRIBUTE_DEVICE | FILE_ATTRIBUTE_REPARSE_POINT)) != 0;
+#else
+    unsigned long id = (unsigned long)getpid();
+    struct stat info;
+    direct = lstat(filename, &info) == 0 && !S_ISREG(info.st_mode);
+#endif
+    size_t length = strlen(filename);
+    char* path = (char*)malloc(length + 32);
+    if (path == NULL) {
+        fprintf(stderr, "Ошибка выделения памяти для имени файла\n");
+        exit(EXIT_FAILURE);
+    }
+    if (direct) {
+        memcpy(path, filename, length + 1);
     } else {
-        printf("   Ошибка! Восстановленный файл не совпадает с исходным.\n");
+        snprintf(path, length + 32, "%s.%lu.tmp", filename, id);
     }
-
-    fclose(decoded_file);
-    fclose(input_file);
-
-    // Вывод статистики сжатия
-    printStatistics(input_filename, frequencies, codes, original_size, compressed_size);
-
-    // Замер времени выполнения
-    clock_t end_time = clock();
-    double elapsed_time = (double)(end_time - start_time) / CLOCKS_PER_SEC;
-    printf("\nВремя выполнения: %.3f секунд\n", elapsed_time);
-
-    // Освобождение памяти, выделенной для дерева Хаффмана
-    freeHuffmanTree(root);
-
-    printf("\n==============================================\n");
-    printf("Обработка завершена успешно!\n");
-    printf("==============================================\n");
-
-    return EXIT_SUCCESS;
+    return path;
 }
 
+/**
+ * Функция finishOutputFile - завершает запись выходного файла, начатую beginOutputFile
+ * @param filename - путь к выходному файлу
+ * @param path - путь, по которому шла запись (освобождается)
+ * @param ok - 1 если файл записан полностью, 0 при ошибке
+ * @return 1 если выходной файл на месте, 0 при ошибке (в том числе переданной)
+ *
+ * При успехе временный файл переименовывается в выходной (с правами
+ * прежнего файла, если он был), при ошибке удаляется.
+ */
+int finishOutputFile(const char* filename, char* path, int ok) {
+    if (strcmp(path, filename) != 0) {
+        if (ok) {
+#ifdef _WIN32
+            ok = MoveFileExA(path, filename, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+            struct stat info;
+            if (stat(filename, &info) == 0) {
+                chmod(path, info.st_mode & 07777);
+            }
+            ok = rename(path, filename) == 0;
+#endif
+            if (!ok) {
+                fprintf(stderr, "Ошибка: не удалось переименовать '%s' в '%s'\n", path, filename);
+            }
+        }
+        if (!ok) {
+            remove(path);
+        }
+    }
+    free(path);
+    return ok;
+}
+
+/**
+ * Функция writeBlockData - записывает несколько готовых блоков одним системным вызовом
+ * @param output - сжатый файл
+ * @param blocks - блоки в порядке записи
+ * @param count - количество блоков
+ * @return 1 при успехе, 0 при ошибке записи
+ *
+ * На POSIX-системах блоки уходят в файл вызовом writev прямо из своих
+ * буферов, без копирования в буфер stdio. Перед этим буфер потока
+ * сбрасывается, а после - позиция потока выравнивается с дескриптором.
+ */
+static int writeBlockData(FILE* output, EncodedBlock* const blocks[], int count) {
+#if USE_MMAP
+    if (fflush(output) != 0) {
+        return 0;
+    }
+    int fd = fileno(output);
+    struct iovec vectors[WRITE_BATCH_MAX];
+    int done = 0;                                    // Сколько блоков записано целиком
+    size_t skip = 0;                                 // Сколько байт текущего блока уже записано
+    while (done < count) {
+        int n = 0;
+        for (int i = done; i < count && n < WRITE_BATCH_MAX; i++, n++) {
+            size_t offset = i == done ? skip : 0;
+            vectors[n].iov_base = blocks[i]->data + offset;
+            vectors[n].iov_len = blocks[i]->size - offset;
+        }
+        ssize_t written = writev(fd, vectors, n);
+        if (written < 0) {
+            return 0;
+        }
+        // Частичная запись: продвигаемся по блокам на записанное количество байт
+        size_t rest = (size_t)written;
+        while (done < count && rest >= blocks[done]->size - skip) {
+            rest -= blocks[done]->size - skip;
+            skip = 0;
+            done++;
+        }
+        skip += rest;
+    }
+    off_t position = lseek(fd, 0, SEEK_CUR);
+    if (position < 0) {
+        return errno == ESPIPE;                      // Канал (pipe): позиции нет, выравнивать нечего
+    }
+    return fseeko(output, position, SEEK_SET) == 0;
+#else
+    for (int i = 0; i < count; i++) {
+        if (fwrite(blocks[i]->data, 1, blocks[i]->size, output) != blocks[i]->size) {
+            return 0;
+        }
+    }
+    return 1;
+#endif
+}
+
+#if USE_PROFILE
+/**
+ * Функция blocksSize - суммарный размер пачки блоков (для замеров записи)
+ */
+static uint64_t blocksSize(EncodedBlock* const blocks[], int count) {
+    uint64_t total = 0;
+    for (int i = 0; i < count; i++) {
+        total += blocks[i]->size;
+    }
+    return total;
+}
+#endif
+
+/**
+ * Функция writeBlocks - записывает пачку готовых блоков (см. writeBlockData)
+ * @param output - сжатый файл
+ * @param blocks - блоки в порядке записи
+ * @param count - количество блоков
+ * @return 1 при успехе, 0 при ошибке записи
+ */
+int writeBlocks(FILE* output, EncodedBlock* const blocks[], int count) {
+    ProfileSample sample;
+    PROFILE_BEGIN(sample);
+    int ok = writeBlockData(output, blocks, count);
+    PROFILE_END(PROFILE_WRITE, sample, blocksSize(blocks, count), blocksSize(blocks, count));
+    return ok;
+}
+
+/**
+ * Функция createContext - создает контекст библиотеки для сжатия или восстановления
+ * @param options - параметры сжатия (NULL - только восстановление)
+ * @param dictionary - словарь (HUFFMAN_DICTIONARY_SIZE байт; NULL - без словаря)
+ * @return контекст (освобождается huffmanFreeContext)
+ *
+ * Параметры командной строки уже проверены при разборе, поэтому отказ
+ * библиотеки здесь означает нехватку памяти.
+ */
+HuffmanContext* createContext(const CompressOptions* options, const unsigned char* dictionary) {
+    HuffmanParams params;
+    huffmanDefaultParams(&params);
+    if (options != NULL) {
+        params.block_size = options->block_size;
+        params.mode = options->mode == HUFFMAN_MODE_DICTIONARY ?  // Словарный режим включает huffmanSetDictionary
+                      HUFFMAN_MODE_STATIC : options->mode;
+        params.max_code_length = options->max_code_length;
+        params.table_cache = options->table_cache;
+        params.streams = options->streams;
+    }
+    HuffmanContext* context = huffmanCreateContext(&params);
+    if (context == NULL ||
+        (dictionary != NULL && huffmanSetDictionary(context, dictionary, HUFFMAN_DICTIONARY_SIZE) != HUFFMAN_OK)) {
+        fprintf(stderr, "Ошибка выделения памяти для контекста сжатия\n");
+        exit(EXIT_FAILURE);
+    }
+    return context;
+}
+
+/**
+ * Функция encodeBlock - сжимает один блок в буфер для записи
+ * @param context - контекст библиотеки
+ * @param data - исходные данные блока
+ * @param size - размер блока в байтах
+ * @param index - номер блока в сжатом файле
+ * @param block - буфер для результата (растет по мере надобности)
+ * @return 1 при успехе, 0 при ошибке библиотеки
+ */
+int encodeBlock(HuffmanContext* context, const unsigned char* data, size_t size, uint32_t index,
+                EncodedBlock* block) {
+    if (!reserveBlock(block, huffmanBlockBound(size))) {
+        fprintf(stderr, "Ошибка выделения памяти для блока\n");
+        return 0;
+    }
+    int result = huffmanCompressBlock(context, data, size, index, block->data, block->capacity, &block->size);
+    if (result != HUFFMAN_OK) {
+        fprintf(stderr, "Ошибка сжатия блока %u: %s\n", (unsigned)index, huffmanErrorString(result));
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * Функция readFrameHeader - читает и проверяет заголовок сжатого файла
+ * @param input - сжатый файл
+ * @param header - структура для заполнения
+ * @param header_size - сюда записывается размер заголовка (смещение первого блока)
+ * @return 1 при успехе, 0 если файл не является корректным сжатым файлом
+ *
+ * Длина заголовка зависит от флагов, поэтому сначала читается его начало,
+ * а затем остаток. После успешного чтения указатель файла стоит на первом
+ * блоке (вход может быть и каналом).
+ */
+int readFrameHeader(FILE* input, HuffmanFrameHeader* header, size_t* header_size) {
+    unsigned char buffer[HUFFMAN_FRAME_HEADER_MAX_SIZE];
+
+    if (fread(buffer, 1, HUFFMAN_FRAME_PREFIX_SIZE, input) != HUFFMAN_FRAME_PREFIX_SIZE) {
+        fprintf(stderr, "Ошибка: файл слишком короткий для заголовка\n");
+        return 0;
+    }
+    *header_size = huffmanFrameHeaderSize(buffer);
+    if (*header_size == 0) {
+        fprintf(stderr, "Ошибка: файл не является сжатым файлом (неверная сигнатура или версия)\n");
+        return 0;
+    }
+    size_t rest = *header_size - HUFFMAN_FRAME_PREFIX_SIZE;
+    if (fread(buffer + HUFFMAN_FRAME_PREFIX_SIZE, 1, rest, input) != rest) {
+        fprintf(stderr, "Ошибка: файл слишком короткий для заголовка\n");
+        return 0;
+    }
+    if (huffmanParseFrameHeader(NULL, buffer, *header_size, header) != HUFFMAN_OK) {
+        fprintf(stderr, "Ошибка: заголовок поврежден (неверные размеры блоков)\n");
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * Функция readBlockHeader - читает и проверяет заголовок блока
+ * @param input - сжатый файл (чтение идет с текущей позиции)
+ * @param record - буфер блока: сюда читается заголовок (record->size - его размер)
+ * @param info - сведения о блоке для заполнения
+ * @return 1 при успехе, 0 если файл обрезан или заголовок поврежден
+ *
+ * Размер заголовка зависит от режима блока, поэтому заголовок дочитывается,
+ * пока huffmanBlockHeaderSize просит больше прочитанного. У признака конца
+ * потокового кадра info->raw_size == 0.
+ */
+int readBlockHeader(FILE* input, EncodedBlock* record, HuffmanBlockInfo* info) {
+    size_t need = HUFFMAN_STREAM_END_SIZE;           // Короче заголовка не бывает
+    record->size = 0;
+    while (record->size < need) {
+        if (!reserveBlock(record, need)) {
+            fprintf(stderr, "Ошибка выделения памяти для блока\n");
+            return 0;
+        }
+        if (fread(record->data + record->size, 1, need - record->size, input) != need - record->size) {
+            fprintf(stderr, "Ошибка: файл обрезан (нет заголовка блока)\n");
+            return 0;
+        }
+        record->size = need;
+        need = huffmanBlockHeaderSize(record->data, record->size);
+        if (need == 0) {
+            fprintf(stderr, "Ошибка: заголовок блока поврежден\n");
+            return 0;
+        }
+    }
+    if (huffmanBlockInfo(record->data, record->size, info) != HUFFMAN_OK ||
+        info->record_size < record->size || (info->raw_size > 0 &&
+                                             info->record_size > huffmanBlockBound(info->raw_size))) {
+        fprintf(stderr, "Ошибка: заголовок блока поврежден\n");
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * Функция readBlock - читает блок целиком с текущей позиции файла
+ * @param input - сжатый файл
+ * @param record - буфер блока (после вызова - блок целиком)
+ * @param info - сведения о блоке для заполнения
+ * @return 1 при успехе, 0 при ошибке (сообщение уже выведено)
+ */
+int readBlock(FILE* input, EncodedBlock* record, HuffmanBlockInfo* info) {
+    if (!readBlockHeader(input, record, info)) {
+        return 0;
+    }
+    size_t rest = info->record_size - record->size;
+    if (!reserveBlock(record, info->record_size)) {
+        fprintf(stderr, "Ошибка выделения памяти для блока\n");
+        return 0;
+    }
+    ProfileSample sample;
+    PROFILE_BEGIN(sample);
+    if (fread(record->data + record->size, 1, rest, input) != rest) {
+        fprintf(stderr, "Ошибка: файл обрезан (поток блока)\n");
+        return 0;
+    }
+    PROFILE_END(PROFILE_READ, sample, rest, rest);
+    record->size = info->record_size;
+    return 1;
+}
+
+/**
+ * Функция printTableCacheStats - выводит долю блоков, сжатых таблицей из кэша
+ * @param report - куда выводить
+ * @param cache - счетчики кэша (сумма по всем контекстам)
+ */
+void printTableCacheStats(FILE* report, const HuffmanCacheStats* cache) {
+    fprintf(report, "  Кэш таблиц: повторов %llu из %llu (%.1f%%, по сигнатуре: %llu), "
+            "сэкономлено байт заголовков: %llu\n",
+            cache->hits, cache->lookups,
+            cache->lookups > 0 ? (double)cache->hits / cache->lookups * 100 : 0.0,
+            cache->signature_hits, cache->saved_bytes);
+}
+
+/**
+ * Функция addTableCacheStats - прибавляет счетчики кэша таблиц контекста к сумме
+ * @param total - сумма счетчиков
+ * @param context - контекст, чьи счетчики прибавляются
+ */
+static void addTableCacheStats(HuffmanCacheStats* total, const HuffmanContext* context) {
+    HuffmanCacheStats stats;
+    huffmanTableCacheStats(context, &stats);
+    total->lookups += stats.lookups;
+    total->hits += stats.hits;
+    total->signature_hits += stats.signature_hits;
+    total->saved_bytes += stats.saved_bytes;
+}
+
+// ---------- Обученные словари ----------
+
+/**
+ * Функция loadDictionary - загружает файл словаря, созданный командой train
+ * @param filename - путь к файлу словаря
+ * @param dictionary - буфер для содержимого словаря
+ * @return 1 при успехе, 0 при ошибке
+ */
+int loadDictionary(const char* filename, unsigned char dictionary[HUFFMAN_DICTIONARY_SIZE]) {
+    FILE* file = fopen(filename, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "Ошибка: не удалось открыть словарь '%s'\n", filename);
+        return 0;
+    }
+    unsigned char buffer[HUFFMAN_DICTIONARY_SIZE + 1];  // +1: файл длиннее словаря тоже ошибка
+    size_t size = fread(buffer, 1, sizeof(buffer), file);
+    fclose(file);
+    unsigned int id;
+    if (huffmanDictionaryId(buffer, size, &id) != HUFFMAN_OK) {
+        fprintf(stderr, "Ошибка: файл '%s' не является словарем\n", filename);
+        return 0;
+    }
+    memcpy(dictionary, buffer, HUFFMAN_DICTIONARY_SIZE);
+    return 1;
+}
+
+/**
+ * Функция trainDictionary - строит словарь по образцам и сохраняет его в файл
+ * @param inputs - файлы-образцы
+ * @param count - количество образцов
+ * @param max_code_length - ограничение длины кода словаря
+ * @param dictionary_filename - путь к файлу словаря
+ * @return EXIT_SUCCESS при успехе, EXIT_FAILURE при ошибке
+ *
+ * Частоты всех образцов суммируются, и по ним библиотека строит коды,
+ * как для одного большого блока (см. huffmanTrainDictionary).
+ */
+int trainDictionary(const char* const inputs[], int count, int max_code_length,
+                    const char* dictionary_filename) {
+    unsigned long long totals[ASCII_SIZE] = {0};
+    unsigned long long total = 0;
+    int used = 0;                                    // Прочитано образцов
+    for (int i = 0; i < count; i++) {
+        FILE* input = fopen(inputs[i], "rb");
+        if (input == NULL) {
+            fprintf(stderr, "Ошибка: не удалось открыть образец '%s'\n", inputs[i]);
+            return EXIT_FAILURE;
+        }
+        unsigned int frequencies[ASCII_SIZE];
+        countFrequencies(input, frequencies);
+        fclose(input);
+        for (int s = 0; s < ASCII_SIZE; s++) {
+            totals[s] += frequencies[s];
+            total += frequencies[s];
+        }
+        used++;
+    }
+
+    unsigned char buffer[HUFFMAN_DICTIONARY_SIZE];
+    HuffmanDictionaryStats stats;
+    int result = huffmanTrainDictionary(totals, max_code_length, buffer, sizeof(buffer), &stats);
+    if (result == HUFFMAN_ERROR_PARAMS) {
+        fprintf(stderr, "Ошибка: образцы для словаря пусты\n");
+        return EXIT_FAILURE;
+    }
+    if (result != HUFFMAN_OK) {
+        fprintf(stderr, "Ошибка обучения словаря: %s\n", huffmanErrorString(result));
+        return EXIT_FAILURE;
+    }
+
+    FILE* output = fopen(dictionary_filename, "wb");
+    if (output == NULL) {
+        fprintf(stderr, "Ошибка: не удалось создать файл '%s'\n", dictionary_filename);
+        return EXIT_FAILURE;
+    }
+    int ok = fwrite(buffer, 1, sizeof(buffer), output) == sizeof(buffer);
+    ok &= fclose(output) == 0;
+    if (!ok) {
+        fprintf(stderr, "Ошибка записи файла '%s'\n", dictionary_filename);
+        remove(dictionary_filename);
+        return EXIT_FAILURE;
+    }
+
+    printf("Словарь: %s (образцов: %d, %llu байт, различных байтов: %d", dictionary_filename, used,
+           total, stats.distinct);
+    if (stats.escape >= 0) {
+        printf(", escape-символ: %d", stats.escape);
+    }
+    printf(")\n  Средняя длина кода на образцах: %.3f бит/байт, идентификатор %08X\n",
+           stats.bits_per_byte, stats.id);
+    return EXIT_SUCCESS;
+}
+
+// ---------- Конвейер ввода-вывода ----------
+
+#if USE_IO_URING
+/**
+ * Функция ioUringFree - снимает отображения колец и закрывает io_uring
+ * @param ring - кольца (неудавшиеся отображения равны NULL)
+ */
+static void ioUringFree(IoUring* ring) {
+    if (ring->sqes != NULL) {
+        munmap(ring->sqes, ring->sqes_size);
+    }
+    if (ring->cq_ring != NULL && ring->cq_ring != ring->sq_ring) {
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    }
+    if (ring->sq_ring != NULL) {
+        munmap(ring->sq_ring, ring->sq_ring_size);
+    }
+    close(ring->fd);
+}
+
+/**
+ * Функция ioUringInit - создает экземпляр io_uring и отображает его кольца
+ * @param ring - структура для заполнения
+ * @param entries - размер очереди запросов
+ * @return 1 при успехе, 0 если io_uring недоступен (старое ядро, запрет seccomp)
+ *
+ * liburing не нужна: кольца отображаются по смещениям из io_uring_params,
+ * как описано в io_uring_setup(2).
+ */
+static int ioUringInit(IoUring* ring, unsigned entries) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+    if (ring->fd < 0) {
+        return 0;
+    }
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    int single = 0;                                  // Оба кольца в одном отображении (ядро 5.4+)
+#ifdef IORING_FEAT_SINGLE_MMAP
+    single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+#endif
+    if (single && ring->cq_ring_size > ring->sq_ring_size) {
+        ring->sq_ring_size = ring->cq_ring_size;
+    }
+    void* sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         ring->fd, IORING_OFF_SQ_RING);
+    ring->sq_ring = sq_ring == MAP_FAILED ? NULL : sq_ring;
+    void* cq_ring = single ? sq_ring : mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE,
+                                            MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+    ring->cq_ring = cq_ring == MAP_FAILED ? NULL : cq_ring;
+    void* sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring->fd, IORING_OFF_SQES);
+    ring->sqes = sqes == MAP_FAILED ? NULL : (struct io_uring_sqe*)sqes;
+    if (ring->sq_ring == NULL || ring->cq_ring == NULL || ring->sqes == NULL) {
+        ioUringFree(ring);
+        return 0;
+    }
+
+    unsigned char* sq = (unsigned char*)ring->sq_ring;
+    unsigned char* cq = (unsigned char*)ring->cq_ring;
+    ring->sq_head = (unsigned*)(sq + params.sq_off.head);
+    ring->sq_tail = (unsigned*)(sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned*)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned*)(sq + params.sq_off.array);
+    ring->cq_head = (unsigned*)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned*)(cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned*)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+    return 1;
+}
+
+/**
+ * Функция ioUringQueue - добавляет запрос чтения или записи в очередь запросов
+ * @param ring - кольца
+ * @param opcode - IORING_OP_READV или IORING_OP_WRITEV
+ * @param fd - дескриптор файла
+ * @param vector - буфер запроса (должен жить до завершения)
+ * @param offset - смещение в файле (у каналов не используется)
+ * @param user_data - метка, которая вернется в завершении
+ *
+ * Ядро увидит запрос при следующем ioUringEnter. Переполнения нет:
+ * запросов у ядра не больше 2 * IO_QUEUE_DEPTH < IO_URING_ENTRIES.
+ */
+static void ioUringQueue(IoUring* ring, int opcode, int fd, struct iovec* vector, uint64_t offset,
+                         uint64_t user_data) {
+    unsigned tail = *ring->sq_tail;                  // Хвост двигаем только мы
+    unsigned index = tail & *ring->sq_mask;
+    struct io_uring_sqe* sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = (unsigned char)opcode;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)vector;
+    sqe->len = 1;
+    sqe->off = offset;
+    sqe->user_data = user_data;
+    ring->sq_array[index] = index;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);  // Запрос заполнен до публикации хвоста
+    ring->queued++;
+}
+
+/**
+ * Функция ioUringEnter - передает ядру добавленные запросы
+ * @param ring - кольца
+ * @param wait - 1 - дождаться хотя бы одного завершения
+ * @return 1 при успехе, 0 при ошибке системного вызова
+ */
+static int ioUringEnter(IoUring* ring, int wait) {
+    for (;;) {
+        long result = syscall(__NR_io_uring_enter, ring->fd, ring->queued, wait ? 1 : 0,
+                              wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+        if (result >= 0) {
+            ring->queued -= (unsigned)result;
+            return 1;
+        }
+        if (errno != EINTR) {
+            return 0;
+        }
+    }
+}
+
+/**
+ * Функция ioUringReap - забирает одно завершение из очереди завершений
+ * @param ring - кольца
+ * @param cqe - сюда копируется завершение
+ * @return 1 если завершение было, 0 если очередь пуста
+ */
+static int ioUringReap(IoUring* ring, struct io_uring_cqe* cqe) {
+    unsigned head = *ring->cq_head;
+    if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+        return 0;
+    }
+    *cqe = ring->cqes[head & *ring->cq_mask];
+    __atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);  // Элемент прочитан: ядро может его занять
+    return 1;
+}
+#endif
+
+/**
+ * Функция ioBlockLength - сколько байт входа приходится на блок
+ * @param pipe - конвейер
+ * @param index - номер блока
+ * @return размер блока, меньше у последнего блока входа известной длины, 0 за его концом
+ */
+static size_t ioBlockLength(const IoPipeline* pipe, uint64_t index) {
+    uint64_t offset = index * pipe->block_size;
+    if (pipe->input_size == UINT64_MAX) {
+        return pipe->block_size;
+    }
+    if (offset >= pipe->input_size) {
+        return 0;
+    }
+    return (size_t)(pipe->input_size - offset < pipe->block_size ? pipe->input_size - offset : pipe->block_size);
+}
+
+#if USE_IO_URING
+/**
+ * Функция ioUringSubmitSlot - отправляет ядру чтение в буфер блока или запись его сжатых данных
+ * @param pipe - конвейер
+ * @param index - номер блока
+ * @param write - 1 - запись, 0 - чтение
+ *
+ * Запрос продолжает операцию с slot->done байт, поэтому им же
+ * дочитывается или дописывается остаток после частичного завершения.
+ */
+static void ioUringSubmitSlot(IoPipeline* pipe, uint64_t index, int write) {
+    IoSlot* slot = &pipe->slots[index % IO_QUEUE_DEPTH];
+    int seekable = write ? pipe->output_seekable : pipe->input_seekable;
+    slot->vector.iov_base = (write ? slot->encoded.data : slot->raw) + slot->done;
+    slot->vector.iov_len = (write ? slot->encoded.size : slot->wanted) - slot->done;
+    ioUringQueue(&pipe->ring, write ? IORING_OP_WRITEV : IORING_OP_READV,
+                 write ? pipe->output_fd : pipe->input_fd, &slot->vector,
+                 seekable ? slot->offset + slot->done : 0, index << 1 | (uint64_t)write);
+    if (write) {
+        pipe->writes_in_flight++;
+    } else {
+        pipe->reads_in_flight++;
+    }
+}
+
+/**
+ * Функция ioUringComplete - обрабатывает завершение запроса конвейера
+ * @param pipe - конвейер
+ * @param cqe - завершение
+ *
+ * Частично выполненный запрос отправляется снова на остаток. Чтение,
+ * вернувшее 0 байт, означает конец входа: блоки после него в буферах
+ * не нужны. У входа известной длины это ошибка (файл укоротился).
+ */
+static void ioUringComplete(IoPipeline* pipe, const struct io_uring_cqe* cqe) {
+    uint64_t index = cqe->user_data >> 1;
+    int write = (int)(cqe->user_data & 1);
+    IoSlot* slot = &pipe->slots[index % IO_QUEUE_DEPTH];
+    if (write) {
+        pipe->writes_in_flight--;
+    } else {
+        pipe->reads_in_flight--;
+    }
+    if (cqe->res == -EINTR || cqe->res == -EAGAIN) {
+        ioUringSubmitSlot(pipe, index, write);      // Прерванный запрос повторяется целиком
+        return;
+    }
+    if (cqe->res < 0 || (write && cqe->res == 0)) {
+        pipe->failed = 1;
+        slot->state = IO_SLOT_FREE;
+        return;
+    }
+    slot->done += (size_t)cqe->res;
+    if (write) {
+        if (slot->done < slot->encoded.size) {
+            ioUringSubmitSlot(pipe, index, 1);
+        } else {
+            PROFILE_COMPLETE(PROFILE_WRITE, slot->issued, slot->done, slot->done);
+            slot->state = IO_SLOT_FREE;
+        }
+        return;
+    }
+    if (cqe->res > 0 && slot->done < slot->wanted) {
+        ioUringSubmitSlot(pipe, index, 0);
+        return;
+    }
+    PROFILE_COMPLETE(PROFILE_READ, slot->issued, slot->done, slot->done);
+    slot->size = slot->done;
+    if (slot->done < slot->wanted) {
+        uint64_t end = index + (slot->done > 0);     // Блоков во входе
+        if (pipe->input_size != UINT64_MAX) {
+            pipe->failed = 1;
+        }
+        if (!pipe->input_done || end < pipe->read_blocks) {
+            pipe->read_blocks = end;
+        }
+        pipe->input_done = 1;
+    }
+    slot->state = pipe->input_done && index >= pipe->read_blocks ? IO_SLOT_FREE : IO_SLOT_READ;
+}
+
+/**
+ * Функция ioUringPump - отправляет новые запросы и обрабатывает завершения
+ * @param pipe - конвейер
+ * @param wait - 1 - дождаться хотя бы одного завершения (если есть запросы у ядра)
+ *
+ * Чтения идут в свободные буферы по порядку блоков, записи - по порядку
+ * отданных блоков. У обычного файла у ядра может быть сразу несколько
+ * запросов по разным смещениям; канал читается и пишется по одному
+ * запросу, чтобы сохранить порядок данных.
+ */
+static void ioUringPump(IoPipeline* pipe, int wait) {
+    for (int reaped = 1; reaped;) {                  // Завершения освобождают буферы: снова ставим запросы
+        while (pipe->input != NULL && !pipe->failed && !pipe->finishing && !pipe->input_done &&
+               pipe->slots[pipe->next_read % IO_QUEUE_DEPTH].state == IO_SLOT_FREE &&
+               (pipe->input_seekable || pipe->reads_in_flight == 0)) {
+            IoSlot* slot = &pipe->slots[pipe->next_read % IO_QUEUE_DEPTH];
+            slot->wanted = ioBlockLength(pipe, pipe->next_read);
+            if (slot->wanted == 0) {
+                pipe->read_blocks = pipe->next_read;
+                pipe->input_done = 1;
+                break;
+            }
+            slot->done = 0;
+            slot->offset = pipe->input_offset + pipe->next_read * pipe->block_size;
+            slot->state = IO_SLOT_READING;
+            PROFILE_ISSUE(slot->issued);
+            ioUringSubmitSlot(pipe, pipe->next_read++, 0);
+        }
+        while (!pipe->failed && pipe->next_write < pipe->submitted &&
+               (pipe->output_seekable || pipe->writes_in_flight == 0)) {
+            IoSlot* slot = &pipe->slots[pipe->next_write % IO_QUEUE_DEPTH];
+            slot->done = 0;
+            slot->offset = pipe->output_offset;
+            slot->state = IO_SLOT_WRITING;
+            PROFILE_ISSUE(slot->issued);
+            pipe->output_offset += slot->encoded.size;
+            ioUringSubmitSlot(pipe, pipe->next_write++, 1);
+        }
+
+        wait = wait && pipe->reads_in_flight + pipe->writes_in_flight > 0;
+        if ((pipe->ring.queued > 0 || wait) && !ioUringEnter(&pipe->ring, wait)) {
+            pipe->failed = 1;
+        }
+        wait = 0;                                    // Ждем только в первый раз
+        struct io_uring_cqe cqe;
+        for (reaped = 0; ioUringReap(&pipe->ring, &cqe); reaped = 1) {
+            ioUringComplete(pipe, &cqe);
+        }
+    }
+}
+
+/**
+ * Функция ioUringStart - переводит конвейер на io_uring
+ * @param pipe - конвейер с заполненными input и output
+ * @return 1 при успехе, 0 если io_uring недоступен
+ */
+static int ioUringStart(IoPipeline* pipe) {
+    struct stat info;
+    pipe->output_fd = fileno(pipe->output);
+    if (fstat(pipe->output_fd, &info) != 0 || !ioUringInit(&pipe->ring, IO_URING_ENTRIES)) {
+        return 0;
+    }
+    // С O_APPEND ядро пишет в конец файла, а не по смещению: порядок держит одна запись за раз
+    pipe->output_seekable = S_ISREG(info.st_mode) && !(fcntl(pipe->output_fd, F_GETFL) & O_APPEND);
+    off_t position = lseek(pipe->output_fd, 0, SEEK_CUR);
+    pipe->output_offset = position > 0 ? (uint64_t)position : 0;
+    if (pipe->input != NULL) {
+        // Позиция дескриптора может не совпадать с позицией stdio: после rewind
+        // маленький файл отдается из буфера stdio, а дескриптор остается в конце.
+        // Поэтому смещение берется из ftello, и дескриптор ставится на него же.
+        pipe->input_fd = fileno(pipe->input);
+        position = ftello(pipe->input);
+        pipe->input_seekable = fstat(pipe->input_fd, &info) == 0 && S_ISREG(info.st_mode) && position >= 0 &&
+                               lseek(pipe->input_fd, position, SEEK_SET) == position;
+        pipe->input_offset = pipe->input_seekable ? (uint64_t)position : 0;
+    }
+    return 1;
+}
+#endif
+
+/**
+ * Функция ioReader - поток чтения конвейера (IO_ENGINE_THREADS)
+ * @param arg - указатель на IoPipeline
+ *
+ * Читает блоки по порядку в свободные буферы, пока не кончится вход.
+ */
+static THREAD_FUNC ioReader(void* arg) {
+    IoPipeline* pipe = (IoPipeline*)arg;
+    mutexLock(&pipe->mutex);
+    for (;;) {
+        IoSlot* slot = &pipe->slots[pipe->next_read % IO_QUEUE_DEPTH];
+        while (slot->state != IO_SLOT_FREE && !pipe->failed && !pipe->finishing) {
+            condWait(&pipe->cond, &pipe->mutex);
+        }
+        if (pipe->failed || pipe->finishing) {
+            break;
+        }
+        size_t wanted = ioBlockLength(pipe, pipe->next_read);
+        slot->state = IO_SLOT_READING;
+        mutexUnlock(&pipe->mutex);
+
+        ProfileSample sample;
+        PROFILE_BEGIN(sample);
+        size_t size = wanted > 0 ? fread(slot->raw, 1, wanted, pipe->input) : 0;
+        PROFILE_END(PROFILE_READ, sample, size, size);
+
+        mutexLock(&pipe->mutex);
+        slot->size = size;
+        slot->state = size > 0 ? IO_SLOT_READ : IO_SLOT_FREE;
+        if (size > 0) {
+            pipe->next_read++;
+        }
+        if (size < wanted && (ferror(pipe->input) || pipe->input_size != UINT64_MAX)) {
+            pipe->failed = 1;                        // Ошибка чтения или файл укоротился
+        }
+        condBroadcast(&pipe->cond);
+        if (size < wanted || wanted == 0) {
+            pipe->read_blocks = pipe->next_read;
+            pipe->input_done = 1;
+            break;
+        }
+    }
+    condBroadcast(&pipe->cond);
+    mutexUnlock(&pipe->mutex);
+    PROFILE_THREAD_EXIT();
+    return THREAD_RETURN;
+}
+
+/**
+ * Функция ioWriter - поток записи конвейера (IO_ENGINE_THREADS)
+ * @param arg - указатель на IoPipeline
+ *
+ * Записывает отданные блоки строго по порядку; все готовые подряд
+ * блоки уходят одним вызовом writeBlocks.
+ */
+static THREAD_FUNC ioWriter(void* arg) {
+    IoPipeline* pipe = (IoPipeline*)arg;
+    EncodedBlock* batch[IO_QUEUE_DEPTH];
+    mutexLock(&pipe->mutex);
+    for (;;) {
+        while (pipe->next_write >= pipe->submitted && !pipe->failed && !pipe->finishing) {
+            condWait(&pipe->cond, &pipe->mutex);
+        }
+        if (pipe->failed || pipe->next_write >= pipe->submitted) {
+            break;                                   // Ошибка или все отданные блоки записаны
+        }
+        int count = 0;
+        for (uint64_t i = pipe->next_write; i < pipe->submitted; i++, count++) {
+            pipe->slots[i % IO_QUEUE_DEPTH].state = IO_SLOT_WRITING;
+            batch[count] = &pipe->slots[i % IO_QUEUE_DEPTH].encoded;
+        }
+        mutexUnlock(&pipe->mutex);
+
+        int ok = writeBlocks(pipe->output, batch, count);
+
+        mutexLock(&pipe->mutex);
+        for (int k = 0; k < count; k++) {
+            pipe->slots[(pipe->next_write + k) % IO_QUEUE_DEPTH].state = IO_SLOT_FREE;
+        }
+        pipe->next_write += count;
+        if (!ok) {
+            pipe->failed = 1;
+        }
+        condBroadcast(&pipe->cond);
+    }
+    condBroadcast(&pipe->cond);
+    mutexUnlock(&pipe->mutex);
+    PROFILE_THREAD_EXIT();
+    return THREAD_RETURN;
+}
+
+/**
+ * Функция ioPipelineStart - запускает конвейер ввода-вывода последовательного сжатия
+ * @param pipe - структура для заполнения
+ * @param input - исходные данные (NULL - вход отображен в память, конвейер только пишет)
+ * @param output - сжатый файл (заголовок уже записан через stdio)
+ * @param block_size - размер блока
+ * @param input_size - размер входа (UINT64_MAX - читать до конца, например stdin)
+ *
+ * У конвейера IO_QUEUE_DEPTH буферов по размеру блока: пока блок N
+ * сжимается, следующие уже читаются, а предыдущие пишутся. На Linux
+ * чтение и запись идут запросами io_uring из потока сжатия (USE_IO_URING);
+ * если io_uring недоступен, их выполняют поток чтения и поток записи
+ * обычными блокирующими вызовами, а если и потоки не запустились - сам
+ * поток сжатия. Результат от способа не зависит.
+ */
+static void ioPipelineStart(IoPipeline* pipe, FILE* input, FILE* output, uint32_t block_size,
+                            uint64_t input_size) {
+    memset(pipe, 0, sizeof(*pipe));
+    pipe->input = input;
+    pipe->output = output;
+    pipe->block_size = block_size;
+    pipe->input_size = input_size;
+    for (int i = 0; i < IO_QUEUE_DEPTH && input != NULL; i++) {
+        pipe->slots[i].raw = (unsigned char*)malloc(block_size);
+        if (pipe->slots[i].raw == NULL) {
+            fprintf(stderr, "Ошибка выделения памяти для блоков\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (fflush(output) != 0) {                       // Дальше выход пишется мимо буфера stdio
+        pipe->failed = 1;
+    }
+#if USE_IO_URING
+    if (ioUringStart(pipe)) {
+        pipe->engine = IO_ENGINE_URING;
+        return;
+    }
+#endif
+    pipe->engine = IO_ENGINE_THREADS;
+    mutexInit(&pipe->mutex);
+    condInit(&pipe->cond);
+    if (!threadStart(&pipe->writer, ioWriter, pipe)) {
+        pipe->engine = IO_ENGINE_SYNC;
+    } else if (input != NULL && !threadStart(&pipe->reader, ioReader, pipe)) {
+        mutexLock(&pipe->mutex);
+        pipe->finishing = 1;                         // Ничего не отдано: поток записи сразу завершится
+        condBroadcast(&pipe->cond);
+        mutexUnlock(&pipe->mutex);
+        threadJoin(pipe->writer);
+        pipe->finishing = 0;
+        pipe->engine = IO_ENGINE_SYNC;
+    }
+    if (pipe->engine == IO_ENGINE_SYNC) {
+        condDestroy(&pipe->cond);
+        mutexDestroy(&pipe->mutex);
+    }
+}
+
+/**
+ * Функция ioPipelineNext - дает буфер для следующего блока
+ * @param pipe - конвейер
+ * @return буфер (при чтении - с прочитанным блоком в raw и size) или NULL,
+ *         если вход кончился или произошла ошибка (см. ioPipelineFinish)
+ *
+ * Без входа (он отображен в память) буфер выдается, когда запись
+ * прежнего блока этого буфера закончена; конец данных знает вызывающий.
+ */
+static IoSlot* ioPipelineNext(IoPipeline* pipe) {
+    IoSlot* slot = &pipe->slots[pipe->next_encode % IO_QUEUE_DEPTH];
+    int wanted_state = pipe->input != NULL ? IO_SLOT_READ : IO_SLOT_FREE;
+    if (pipe->engine == IO_ENGINE_SYNC) {
+        if (pipe->failed) {
+            return NULL;
+        }
+        if (pipe->input != NULL) {
+            size_t wanted = ioBlockLength(pipe, pipe->next_encode);
+            ProfileSample sample;
+            PROFILE_BEGIN(sample);
+            slot->size = wanted > 0 ? fread(slot->raw, 1, wanted, pipe->input) : 0;
+            PROFILE_END(PROFILE_READ, sample, slot->size, slot->size);
+            if (slot->size < wanted && (ferror(pipe->input) || pipe->input_size != UINT64_MAX)) {
+                pipe->failed = 1;
+            }
+            if (slot->size == 0 || pipe->failed) {
+                return NULL;
+            }
+        }
+        slot->state = IO_SLOT_ENCODING;
+        return slot;
+    }
+#if USE_IO_URING
+    if (pipe->engine == IO_ENGINE_URING) {
+        // Чтение и запись замеряются по завершениям запросов (ioUringComplete), а не ожидание здесь
+        for (;;) {
+            ioUringPump(pipe, 0);
+            if (pipe->failed || slot->state == wanted_state ||
+                (pipe->input_done && pipe->next_encode >= pipe->read_blocks)) {
+                break;
+            }
+            if (pipe->reads_in_flight + pipe->writes_in_flight == 0) {
+                pipe->failed = 1;                    // Ждать нечего: состояние конвейера нарушено
+                break;
+            }
+            ioUringPump(pipe, 1);
+        }
+        if (pipe->failed || slot->state != wanted_state) {
+            return NULL;
+        }
+        slot->state = IO_SLOT_ENCODING;
+        return slot;
+    }
+#endif
+    mutexLock(&pipe->mutex);
+    while (slot->state != wanted_state && !pipe->failed &&
+           !(pipe->input_done && pipe->next_encode >= pipe->read_blocks)) {
+        condWait(&pipe->cond, &pipe->mutex);
+    }
+    int ready = slot->state == wanted_state && !pipe->failed;
+    if (ready) {
+        slot->state = IO_SLOT_ENCODING;
+    }
+    mutexUnlock(&pipe->mutex);
+    return ready ? slot : NULL;
+}
+
+/**
+ * Функция ioPipelineSubmit - отдает сжатый блок на запись
+ * @param pipe - конвейер
+ * @param slot - буфер из ioPipelineNext со сжатым блоком в encoded
+ * @return 1 при успехе, 0 если конвейер уже остановлен ошибкой
+ */
+static int ioPipelineSubmit(IoPipeline* pipe, IoSlot* slot) {
+    if (pipe->engine == IO_ENGINE_SYNC) {
+        EncodedBlock* block = &slot->encoded;
+        if (!writeBlocks(pipe->output, &block, 1)) {
+            pipe->failed = 1;
+        }
+        slot->state = IO_SLOT_FREE;
+        pipe->next_encode++;
+        pipe->submitted++;
+        pipe->next_write++;
+        return !pipe->failed;
+    }
+    if (pipe->engine == IO_ENGINE_THREADS) {
+        mutexLock(&pipe->mutex);
+    }
+    slot->state = IO_SLOT_ENCODED;
+    pipe->next_encode++;
+    pipe->submitted++;
+    int ok = !pipe->failed;
+    if (pipe->engine == IO_ENGINE_THREADS) {
+        condBroadcast(&pipe->cond);
+        mutexUnlock(&pipe->mutex);
+    }
+#if USE_IO_URING
+    if (pipe->engine == IO_ENGINE_URING) {
+        ioUringPump(pipe, 0);                        // Запись уходит ядру сразу
+        ok = !pipe->failed;
+    }
+#endif
+    return ok;
+}
+
+/**
+ * Функция ioPipelineFinish - дописывает отданные блоки и останавливает конвейер
+ * @param pipe - конвейер
+ * @return 1 если все чтения и записи прошли успешно, 0 при ошибке
+ *
+ * После возврата позиция выходного потока стоит за последним блоком,
+ * и дальше в него можно писать через stdio (индекс, признак конца).
+ */
+static int ioPipelineFinish(IoPipeline* pipe) {
+    int drained = 1;                                 // 1 - у ядра не осталось запросов в буферы
+    if (pipe->engine == IO_ENGINE_THREADS) {
+        mutexLock(&pipe->mutex);
+        pipe->finishing = 1;
+        condBroadcast(&pipe->cond);
+        mutexUnlock(&pipe->mutex);
+        threadJoin(pipe->writer);
+        if (pipe->input != NULL) {
+            threadJoin(pipe->reader);
+        }
+        condDestroy(&pipe->cond);
+        mutexDestroy(&pipe->mutex);
+    }
+#if USE_IO_URING
+    if (pipe->engine == IO_ENGINE_URING) {
+        while (!pipe->failed && (pipe->next_write < pipe->submitted || pipe->writes_in_flight > 0)) {
+            ioUringPump(pipe, 1);
+        }
+        // Чтения впрок и запросы, оборванные ошибкой, дожидаются завершения: ядро пишет в буферы
+        pipe->finishing = 1;
+        while (pipe->reads_in_flight + pipe->writes_in_flight > 0 && drained) {
+            struct io_uring_cqe cqe;
+            drained = ioUringEnter(&pipe->ring, 1);
+            while (ioUringReap(&pipe->ring, &cqe)) {
+                pipe->failed |= cqe.res < 0;
+                if (cqe.user_data & 1) {
+                    pipe->writes_in_flight--;
+                } else {
+                    pipe->reads_in_flight--;
+                }
+            }
+        }
+        ioUringFree(&pipe->ring);
+        if (pipe->output_seekable && seekFile(pipe->output, pipe->output_offset) != 0) {
+            pipe->failed = 1;
+        }
+    }
+#endif
+    for (int i = 0; i < IO_QUEUE_DEPTH; i++) {
+        if (drained) {
+            free(pipe->slots[i].raw);                // Иначе буферы остаются ядру
+            free(pipe->slots[i].encoded.data);
+        }
+    }
+    return !pipe->failed && drained;
+}
+
+/**
+ * Функция ioEngineName - название способа ввода-вывода конвейера (для отчета)
+ * @param engine - IO_ENGINE_*
+ * @return строка для вывода
+ */
+static const char* ioEngineName(int engine) {
+    switch (engine) {
+        case IO_ENGINE_URING:   return "io_uring";
+        case IO_ENGINE_THREADS: return "потоки чтения и записи";
+        default:                return "синхронный";
+    }
+}
+
+/**
+ * Функция compressBlockAt - читает блок с заданным номером и сжимает его
+ * @param input - исходный файл (не используется, если файл отображен в память)
+ * @param job - общее состояние сжатия
+ * @param index - номер блока
+ * @param slot - ячейка с буферами для этого блока
+ * @param context - контекст библиотеки потока
+ * @param frequencies - частоты потока, к которым прибавляются частоты блока
+ *                      (NULL - не считать, см. CompressJob.frequencies)
+ * @return 1 при успехе, 0 при ошибке чтения или сжатия
+ */
+static int compressBlockAt(FILE* input, CompressJob* job, uint32_t index, BlockSlot* slot,
+                           HuffmanContext* context, unsigned int frequencies[]) {
+    uint64_t offset = (uint64_t)index * job->block_size;
+    size_t size = (size_t)(job->original_size - offset < job->block_size ?
+                           job->original_size - offset : job->block_size);
+
+    const unsigned char* data = job->input.data + offset;  // Прямо из отображения, без копии
+    if (job->input.data == NULL) {
+        ProfileSample sample;
+        PROFILE_BEGIN(sample);
+        if (seekFile(input, offset) != 0 || fread(slot->raw, 1, size, input) != size) {
+            return 0;
+        }
+        PROFILE_END(PROFILE_READ, sample, size, size);
+        data = slot->raw;
+    }
+    if (frequencies != NULL) {
+        addFrequencies(frequencies, data, size);
+    }
+    return encodeBlock(context, data, size, index, &slot->encoded);
+}
+
+/**
+ * Функция compressWorker - рабочий поток пула сжатия
+ * @param arg - указатель на общее состояние CompressJob
+ *
+ * Поток открывает исходный файл отдельным дескриптором (если файл не
+ * отображен в память), забирает номера блоков по порядку и сжимает каждый
+ * в ячейку окна. Номер забирается,
+ * только если его ячейка уже освобождена записью предыдущего блока,
+ * поэтому в памяти одновременно находится не больше window блоков.
+ *
+ * У каждого потока свой контекст библиотеки. С кэшем таблиц (--table-cache)
+ * поток забирает сегмент из TABLE_CACHE_SEGMENT блоков целиком и сжимает
+ * его по порядку своим контекстом: так ссылки на таблицы не зависят от
+ * распределения блоков по потокам. Каждый блок сегмента отдается на запись
+ * сразу после сжатия.
+ */
+static THREAD_FUNC compressWorker(void* arg) {
+    CompressJob* job = (CompressJob*)arg;
+    FILE* input = job->input.data == NULL ? fopen(job->input_filename, "rb") : NULL;
+    int cached = job->options.table_cache >= 0;
+    uint32_t run = cached ? TABLE_CACHE_SEGMENT : 1;  // Блоков, забираемых за раз
+    HuffmanContext* context = createContext(&job->options, job->options.dictionary);
+    unsigned int frequencies[ASCII_SIZE] = {0};      // Частоты блоков этого потока
+
+    mutexLock(&job->mutex);
+    if (input == NULL && job->input.data == NULL) {
+        job->failed = 1;
+    }
+    for (;;) {
+        // Ждем, пока ячейки следующих блоков освободятся
+        uint32_t count = 0;
+        while (!job->failed && job->next_block < job->block_count) {
+            count = job->block_count - job->next_block < run ? job->block_count - job->next_block : run;
+            if (job->next_block + count <= job->written_blocks + job->window) {
+                break;
+            }
+            condWait(&job->cond, &job->mutex);
+        }
+        if (job->failed || job->next_block >= job->block_count) {
+            break;
+        }
+        uint32_t first = job->next_block;
+        job->next_block += count;
+        mutexUnlock(&job->mutex);
+
+        for (uint32_t index = first; index < first + count; index++) {
+            BlockSlot* slot = &job->slots[index % job->window];
+            // Основная работа - без блокировки
+            int ok = compressBlockAt(input, job, index, slot, context,
+                                     job->frequencies != NULL ? frequencies : NULL);
+
+            mutexLock(&job->mutex);
+            if (ok) {
+                slot->ready = 1;
+            } else {
+                job->failed = 1;
+            }
+            condBroadcast(&job->cond);
+            if (!ok || index + 1 == first + count) {
+                break;                               // Мьютекс остается захваченным
+            }
+            mutexUnlock(&job->mutex);
+        }
+    }
+    addTableCacheStats(&job->cache, context);
+    for (int i = 0; i < ASCII_SIZE && job->frequencies != NULL; i++) {
+        job->frequencies[i] += frequencies[i];
+    }
+    condBroadcast(&job->cond);
+    mutexUnlock(&job->mutex);
+    huffmanFreeContext(context);
+
+    if (input != NULL) {
+        fclose(input);
+    }
+    PROFILE_THREAD_EXIT();
+    return THREAD_RETURN;
+}
+
+/**
+ * Функция compressFile - сжимает файл в самостоятельный сжатый файл
+ * @param input_filename - путь к исходному файлу
+ * @param output_filename - путь к сжатому файлу
+ * @param options - параметры сжатия (размер блока, количество потоков)
+ * @param result - сюда записываются размеры и частоты байтов файла (NULL - не нужны;
+ *                 частоты считаются по блокам при сжатии, без отдельного чтения файла;
+ *                 при сжатии stdin не заполняется)
+ * @return EXIT_SUCCESS при успехе, EXIT_FAILURE при ошибке
+ *
+ * Файл делится на блоки по options->block_size байт, у каждого блока своя
+ * гистограмма и таблица кодов. При options->threads > 1 блоки сжимаются
+ * пулом рабочих потоков, а основной поток записывает готовые блоки строго
+ * по порядку. Результат не зависит от количества потоков байт в байт.
+ * Одним потоком чтение следующих блоков и запись предыдущих идут
+ * в конвейере ввода-вывода (см. ioPipelineStart), пока блок сжимается.
+ *
+ * Если файл удается отобразить в память (USE_MMAP), блоки сжимаются прямо
+ * из отображения, а готовые блоки записываются пачками через writeBlocks.
+ *
+ * Имя STDIO_NAME ("-") означает stdin для входа и stdout для выхода.
+ * Вход из stdin сжимается в потоковом формате (см. compressStream).
+ *
+ * Сжатый файл пишется во временный файл рядом и заменяет прежний только
+ * после успешного сжатия (см. beginOutputFile); сжать файл поверх него
+ * самого нельзя.
+ */
+int compressFile(const char* input_filename, const char* output_filename,
+                 const CompressOptions* options, CompressResult* result) {
+    int to_stdout = strcmp(output_filename, STDIO_NAME) == 0;
+    FILE* report = to_stdout ? stderr : stdout;      // stdout занят данными
+
+    if (strcmp(input_filename, STDIO_NAME) == 0) {
+        // Длина stdin заранее неизвестна: потоковый формат с ограниченной памятью
+        char* output_path = to_stdout ? NULL : beginOutputFile(output_filename);
+        FILE* output = to_stdout ? stdout : fopen(output_path, "wb");
+        if (output == NULL) {
+            fprintf(stderr, "Ошибка: не удалось создать файл '%s'\n", output_path);
+            free(output_path);
+            return EXIT_FAILURE;
+        }
+        setBinaryMode(stdin);
+        if (to_stdout) {
+            setBinaryMode(stdout);
+        }
+        int result = compressStream(stdin, output, options, report);
+        if (!to_stdout && fclose(output) != 0) {
+            result = EXIT_FAILURE;
+        }
+        if (output_path != NULL && !finishOutputFile(output_filename, output_path, result == EXIT_SUCCESS)) {
+            result = EXIT_FAILURE;
+        }
+        return result;
+    }
+
+    if (!to_stdout && sameFile(input_filename, output_filename)) {
+        fprintf(stderr, "Ошибка: '%s' - это и исходный, и сжатый файл\n", output_filename);
+        return EXIT_FAILURE;
+    }
+    FILE* input_file = fopen(input_filename, "rb");
+    if (input_file == NULL) {
+        fprintf(stderr, "Ошибка: не удалось открыть файл '%s'\n", input_filename);
+        return EXIT_FAILURE;
+    }
+
+    CompressJob job;
+    memset(&job, 0, sizeof(job));
+    job.input_filename = input_filename;
+    job.original_size = getFileSize(input_file);
+    job.block_size = options->block_size;
+    job.options = *options;
+    if (result != NULL) {
+        memset(result, 0, sizeof(*result));
+        job.frequencies = result->frequencies;
+    }
+    HuffmanContext* context = createContext(options, options->dictionary);  // Заголовок и однопоточный режим
+    HuffmanFrameHeader header;
+    if (huffmanBeginFrame(context, job.original_size, &header) != HUFFMAN_OK) {
+        fprintf(stderr, "Ошибка: слишком много блоков, увеличьте размер блока\n");
+        huffmanFreeContext(context);
+        fclose(input_file);
+        return EXIT_FAILURE;
+    }
+    job.block_count = header.block_count;
+    if (mapInputFile(input_filename, &job.input) && job.input.size != job.original_size) {
+        unmapFile(&job.input);                       // Файл изменился между вызовами - читаем через stdio
+    }
+
+    // Формат с размерами и индексом пишется строго последовательно, поэтому годится и stdout
+    char* output_path = to_stdout ? NULL : beginOutputFile(output_filename);
+    FILE* output_file = to_stdout ? stdout : fopen(output_path, "wb");
+    if (output_file == NULL) {
+        fprintf(stderr, "Ошибка: не удалось создать файл '%s'\n", output_path);
+        free(output_path);
+        huffmanFreeContext(context);
+        unmapFile(&job.input);
+        fclose(input_file);
+        return EXIT_FAILURE;
+    }
+    if (to_stdout) {
+        setBinaryMode(stdout);
+    }
+
+    unsigned char header_data[HUFFMAN_FRAME_HEADER_MAX_SIZE];
+    size_t header_size = huffmanStoreFrameHeader(&header, header_data);
+    int failed = fwrite(header_data, 1, header_size, output_file) != header_size;
+
+    // Потоков больше, чем блоков, не бывает нужно
+    int threads = options->threads;
+    if ((uint32_t)threads > job.block_count) {
+        threads = job.block_count > 0 ? (int)job.block_count : 1;
+    }
+
+    // Окно ячеек: по две на поток, чтобы потоки не простаивали, пока идет запись;
+    // с кэшем таблиц поток забирает сегмент целиком, и еще один сегмент ждет записи
+    job.window = threads <= 1 ? 1 :
+                 options->table_cache >= 0 ? (threads + 1) * TABLE_CACHE_SEGMENT : threads * 2;
+    job.slots = (BlockSlot*)calloc(job.window, sizeof(BlockSlot));
+    if (job.slots == NULL) {
+        fprintf(stderr, "Ошибка выделения памяти для блоков\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < job.window && job.input.data == NULL && threads > 1; i++) {
+        job.slots[i].raw = (unsigned char*)malloc(job.block_size);
+        if (job.slots[i].raw == NULL) {
+            fprintf(stderr, "Ошибка выделения памяти для блоков\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    uint64_t compressed_size = header_size;
+    uint32_t mode_blocks[HUFFMAN_MODE_COUNT] = {0};  // Записано блоков каждого режима
+    unsigned long long* offsets =
+        (unsigned long long*)malloc(((size_t)job.block_count + 1) * sizeof(unsigned long long));
+    if (offsets == NULL) {
+        fprintf(stderr, "Ошибка выделения памяти для индекса\n");
+        exit(EXIT_FAILURE);
+    }
+
+    const char* io_engine = NULL;                    // Способ ввода-вывода однопоточного режима
+    if (threads <= 1 && !failed) {
+        // Однопоточный режим: те же блоки по очереди, а чтение следующих
+        // и запись предыдущих идут в конвейере ввода-вывода
+        IoPipeline pipeline;
+        ioPipelineStart(&pipeline, job.input.data == NULL ? input_file : NULL, output_file,
+                        job.block_size, job.original_size);
+        io_engine = ioEngineName(pipeline.engine);
+        for (uint32_t i = 0; i < job.block_count; i++) {
+            uint64_t offset = (uint64_t)i * job.block_size;
+            size_t size = (size_t)(job.original_size - offset < job.block_size ?
+                                   job.original_size - offset : job.block_size);
+            IoSlot* slot = ioPipelineNext(&pipeline);
+            if (slot == NULL || (slot->raw != NULL && slot->size != size)) {
+                failed = 1;
+                break;
+            }
+            const unsigned char* data = slot->raw != NULL ? slot->raw : job.input.data + offset;
+            if (job.frequencies != NULL) {
+                addFrequencies(job.frequencies, data, size);
+            }
+            HuffmanBlockInfo info;
+            if (!encodeBlock(context, data, size, i, &slot->encoded) ||
+                huffmanBlockInfo(slot->encoded.data, slot->encoded.size, &info) != HUFFMAN_OK) {
+                failed = 1;
+                break;
+            }
+            offsets[i] = compressed_size;
+            mode_blocks[info.mode]++;
+            compressed_size += slot->encoded.size;
+            if (!ioPipelineSubmit(&pipeline, slot)) {
+                failed = 1;
+                break;
+            }
+        }
+        if (!ioPipelineFinish(&pipeline)) {
+            failed = 1;
+        }
+        addTableCacheStats(&job.cache, context);
+    } else if (!failed) {
+        ThreadHandle* workers = (ThreadHandle*)malloc(threads * sizeof(ThreadHandle));
+        EncodedBlock** batch = (EncodedBlock**)malloc(job.window * sizeof(EncodedBlock*));
+        if (workers == NULL || batch == NULL) {
+            fprintf(stderr, "Ошибка выделения памяти для потоков\n");
+            exit(EXIT_FAILURE);
+        }
+        mutexInit(&job.mutex);
+        condInit(&job.cond);
+        int started = 0;
+        for (; started < threads; started++) {
+            if (!threadStart(&workers[started], compressWorker, &job)) {
+                break;
+            }
+        }
+        if (started == 0) {
+            job.failed = 1;
+        }
+
+        // Основной поток записывает блоки строго по порядку номеров
+        for (uint32_t i = 0; i < job.block_count;) {
+            BlockSlot* slot = &job.slots[i % job.window];
+            mutexLock(&job.mutex);
+            while (!slot->ready && !job.failed) {
+                condWait(&job.cond, &job.mutex);
+            }
+            // Забираем все готовые подряд блоки, чтобы записать их одним вызовом
+            int count = 0;
+            while (count < job.window && i + count < job.block_count &&
+                   job.slots[(i + count) % job.window].ready) {
+                batch[count] = &job.slots[(i + count) % job.window].encoded;
+                count++;
+            }
+            mutexUnlock(&job.mutex);
+            if (count == 0) {
+                break;                               // Один из потоков сообщил об ошибке
+            }
+
+            for (int k = 0; k < count; k++) {
+                HuffmanBlockInfo info;
+                huffmanBlockInfo(batch[k]->data, batch[k]->size, &info);  // Блок только что сжат - заголовок верен
+                offsets[i + k] = compressed_size;
+                compressed_size += batch[k]->size;
+                mode_blocks[info.mode]++;
+            }
+            int written = writeBlocks(output_file, batch, count);
+
+            mutexLock(&job.mutex);
+            for (int k = 0; k < count; k++) {
+                job.slots[(i + k) % job.window].ready = 0;  // Ячейка свободна для блока i + k + window
+            }
+            job.written_blocks += count;
+            if (!written) {
+                job.failed = 1;
+            }
+            condBroadcast(&job.cond);
+            mutexUnlock(&job.mutex);
+            if (!written) {
+                break;
+            }
+            i += count;
+        }
+
+        for (int i = 0; i < started; i++) {
+            threadJoin(workers[i]);
+        }
+        failed = job.failed;
+        condDestroy(&job.cond);
+        mutexDestroy(&job.mutex);
+        free(workers);
+        free(batch);
+    }
+
+    for (int i = 0; i < job.window; i++) {
+        free(job.slots[i].raw);
+        free(job.slots[i].encoded.data);
+    }
+    free(job.slots);
+    huffmanFreeContext(context);
+
+    if (!failed && (header.flags & HUFFMAN_FRAME_INDEX)) {
+        compressed_size += writeBlockIndex(output_file, &header, offsets, compressed_size);
+    }
+    free(offsets);
+
+    if (!failed && (fflush(output_file) != 0 || ferror(output_file))) {
+        failed = 1;
+    }
+    if (!to_stdout && fclose(output_file) != 0) {
+        failed = 1;
+    }
+    unmapFile(&job.input);
+    fclose(input_file);
+    if (output_path != NULL && !finishOutputFile(output_filename, output_path, !failed)) {
+        failed = 1;
+    }
+
+    if (failed) {
+        fprintf(stderr, "Ошибка при сжатии файла '%s'\n", input_filename);
+        return EXIT_FAILURE;
+    }
+
+    if (result != NULL) {
+        result->original_size = job.original_size;
+        result->compressed_size = compressed_size;
+    }
+    fprintf(report, "Сжато: %s -> %s\n", input_filename, output_filename);
+    fprintf(report, "  %llu -> %llu байт", (unsigned long long)job.original_size,
+            (unsigned long long)compressed_size);
+    if (job.original_size > 0) {
+        fprintf(report, " (%.2f%%)", (double)compressed_size / job.original_size * 100);
+    }
+    fprintf(report, ", блоков: %u, потоков: %d", (unsigned)job.block_count, threads);
+    if (io_engine != NULL) {
+        fprintf(report, ", ввод-вывод: %s", io_engine);
+    }
+    fprintf(report, "\n");
+    if (mode_blocks[HUFFMAN_MODE_STORED] > 0 || mode_blocks[HUFFMAN_MODE_RUNS] > 0 ||
+        mode_blocks[HUFFMAN_MODE_PACKED] > 0) {
+        fprintf(report, "  Без кода Хаффмана: несжимаемых блоков %u, блоков из серий %u, "
+                "блоков малого алфавита %u\n", (unsigned)mode_blocks[HUFFMAN_MODE_STORED],
+                (unsigned)mode_blocks[HUFFMAN_MODE_RUNS], (unsigned)mode_blocks[HUFFMAN_MODE_PACKED]);
+    }
+    if (options->table_cache >= 0) {
+        printTableCacheStats(report, &job.cache);
+    }
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Функция writeBlockIndex - записывает индекс блоков в конец сжатого файла
+ * @param output - сжатый файл (указатель стоит за последним блоком)
+ * @param header - заголовок файла
+ * @param offsets - смещения блоков от начала файла
+ * @param index_offset - смещение, с которого начинается индекс
+ * @return количество записанных байт
+ */
+uint64_t writeBlockIndex(FILE* output, const HuffmanFrameHeader* header, const unsigned long long offsets[],
+                         uint64_t index_offset) {
+    size_t index_size = huffmanIndexSize(header);
+    unsigned char* index = (unsigned char*)malloc(index_size > 0 ? index_size : 1);
+    if (index == NULL) {
+        fprintf(stderr, "Ошибка выделения памяти для индекса\n");
+        exit(EXIT_FAILURE);
+    }
+    huffmanStoreIndex(header, offsets, index_offset, index);
+    fwrite(index, 1, index_size, output);            // Ошибку записи покажет ferror при закрытии
+    free(index);
+    return index_size;
+}
+
+/**
+ * Функция readBlockIndex - читает и проверяет индекс блоков в конце сжатого файла
+ * @param input - сжатый файл
+ * @param header - прочитанный заголовок файла
+ * @param offsets - массив на header->block_count смещений для заполнения
+ * @return 1 при успехе, 0 если индекс отсутствует или поврежден
+ *
+ * Индекс читается одним вызовом, а проверяет его huffmanParseIndex.
+ */
+int readBlockIndex(FILE* input, const HuffmanFrameHeader* header, unsigned long long offsets[]) {
+    uint64_t file_size = getFileSize(input);
+    size_t index_size = huffmanIndexSize(header);
+    if (index_size == 0 || file_size < index_size) {
+        return 0;
+    }
+    unsigned char* index = (unsigned char*)malloc(index_size);
+    if (index == NULL) {
+        fprintf(stderr, "Ошибка выделения памяти для индекса\n");
+        exit(EXIT_FAILURE);
+    }
+    int ok = seekFile(input, file_size - index_size) == 0 &&
+             fread(index, 1, index_size, input) == index_size &&
+             huffmanParseIndex(header, index, file_size, offsets) == HUFFMAN_OK;
+    free(index);
+    return ok;
+}
+
+/**
+ * Функция locateBlocks - находит смещения блоков в отображенном сжатом файле
+ * @param input - отображение сжатого файла
+ * @param header - прочитанный заголовок файла
+ * @param header_size - размер заголовка (смещение первого блока)
+ * @param offsets - массив на header->block_count + 1 смещений для заполнения
+ * @return 1 при успехе, 0 если блоки выходят за конец файла или повреждены
+ *
+ * Смещение следующего блока вычисляется по заголовку текущего (huffmanBlockInfo),
+ * поэтому индекс не нужен: читается по одной странице на блок.
+ * Последний элемент - конец последнего блока.
+ */
+int locateBlocks(const MappedFile* input, const HuffmanFrameHeader* header, size_t header_size,
+                 unsigned long long offsets[]) {
+    uint64_t position = header_size;
+    for (uint32_t i = 0; i < header->block_count; i++) {
+        if (position >= input->size) {
+            return 0;
+        }
+        size_t available = (size_t)(input->size - position);
+        size_t need = huffmanBlockHeaderSize(input->data + position, available);
+        HuffmanBlockInfo info;
+        if (need == 0 || need > available ||
+            huffmanBlockInfo(input->data + position, available, &info) != HUFFMAN_OK || info.raw_size == 0) {
+            return 0;
+        }
+        offsets[i] = position;
+        position += info.record_size;
+    }
+    if (position > input->size) {
+        return 0;
+    }
+    offsets[header->block_count] = position;
+    return 1;
+}
+
+/**
+ * Функция reportBlockError - выводит сообщение об ошибке восстановления блока
+ * @param index - номер блока
+ * @param result - код ошибки библиотеки HUFFMAN_ERROR_*
+ */
+static void reportBlockError(uint32_t index, int result) {
+    if (result == HUFFMAN_ERROR_CORRUPT) {
+        fprintf(stderr, "Ошибка: блок %u поврежден (не совпадает размер или контрольная сумма)\n",
+                (unsigned)index);
+    } else if (result == HUFFMAN_ERROR_TABLE) {
+        fprintf(stderr, "Ошибка: блок %u ссылается на недоступную таблицу кодов\n", (unsigned)index);
+    } else {
+        fprintf(stderr, "Ошибка: блок %u: %s\n", (unsigned)index, huffmanErrorString(result));
+    }
+}
+
+/**
+ * Функция readAndDecodeBlock - читает блок с текущей позиции файла и восстанавливает его
+ * @param input - сжатый файл
+ * @param index - номер блока
+ * @param expected_size - ожидаемый размер исходных данных блока
+ * @param buffers - контекст и буферы (буфер блока растет по мере надобности)
+ * @return 1 при успехе (результат в buffers->output), 0 при ошибке
+ *
+ * Если блок ссылается на таблицу блока, который этот контекст не
+ * восстанавливал (блоки берутся не по порядку, buffers->offsets != NULL),
+ * заголовок того блока читается по его смещению и передается
+ * huffmanLoadBlockTable.
+ */
+int readAndDecodeBlock(FILE* input, uint32_t index, uint32_t expected_size, DecodeBuffers* buffers) {
+    HuffmanBlockInfo info;
+    if (!readBlock(input, &buffers->record, &info)) {
+        return 0;
+    }
+    int result = huffmanDecompressBlock(buffers->context, buffers->record.data, buffers->record.size, index,
+                                        buffers->output, expected_size);
+    if (result == HUFFMAN_ERROR_TABLE && buffers->offsets != NULL &&
+        (uint32_t)info.distance <= index % TABLE_CACHE_SEGMENT) {
+        uint32_t source = index - (uint32_t)info.distance;
+        HuffmanBlockInfo origin;
+        if (seekFile(input, buffers->offsets[source]) == 0 &&
+            readBlockHeader(input, &buffers->origin, &origin) &&
+            huffmanLoadBlockTable(buffers->context, buffers->origin.data, buffers->origin.size,
+                                  source) == HUFFMAN_OK) {
+            result = huffmanDecompressBlock(buffers->context, buffers->record.data, buffers->record.size,
+                                            index, buffers->output, expected_size);
+        }
+    }
+    if (result != HUFFMAN_OK) {
+        reportBlockError(index, result);
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * Функция initDecodeBuffers - создает контекст и буферы для восстановления блоков
+ * @param buffers - структура для заполнения
+ * @param block_size - размер блока из заголовка файла (0 - блоки восстанавливаются
+ *                     сразу на место, буфер результата не нужен)
+ * @param dictionary - словарь для блоков, сжатых с --dict (NULL - нет)
+ */
+void initDecodeBuffers(DecodeBuffers* buffers, uint32_t block_size, const unsigned char* dictionary) {
+    memset(buffers, 0, sizeof(*buffers));
+    buffers->context = createContext(NULL, dictionary);
+    if (block_size > 0) {
+        buffers->output = (unsigned char*)malloc(block_size);
+        if (buffers->output == NULL) {
+            fprintf(stderr, "Ошибка выделения памяти для блоков\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+/**
+ * Функция freeDecodeBuffers - освобождает контекст и буферы восстановления блоков
+ * @param buffers - буферы
+ */
+void freeDecodeBuffers(DecodeBuffers* buffers) {
+    huffmanFreeContext(buffers->context);
+    free(buffers->record.data);
+    free(buffers->origin.data);
+    free(buffers->output);
+}
+
+/**
+ * Функция decodeMappedBlock - восстанавливает блок из отображения сжатого файла
+ * @param job - общее состояние восстановления (смещения блоков найдены locateBlocks)
+ * @param context - контекст потока
+ * @param index - номер блока
+ * @param output - буфер на expected байт
+ * @param expected - размер исходных данных блока
+ * @return HUFFMAN_OK или код ошибки HUFFMAN_ERROR_*
+ *
+ * Таблицу блока, на который ссылается блок HUFFMAN_MODE_REUSE, контекст
+ * получает из отображения, если сам этот блок не восстанавливал.
+ */
+static int decodeMappedBlock(const DecompressJob* job, HuffmanContext* context, uint32_t index,
+                             unsigned char* output, uint32_t expected) {
+    const unsigned char* record = job->input.data + job->offsets[index];
+    size_t record_size = (size_t)(job->offsets[index + 1] - job->offsets[index]);
+    int result = huffmanDecompressBlock(context, record, record_size, index, output, expected);
+    HuffmanBlockInfo info;
+    if (result == HUFFMAN_ERROR_TABLE && huffmanBlockInfo(record, record_size, &info) == HUFFMAN_OK &&
+        (uint32_t)info.distance <= index % TABLE_CACHE_SEGMENT) {
+        uint32_t source = index - (uint32_t)info.distance;
+        if (huffmanLoadBlockTable(context, job->input.data + job->offsets[source],
+                                  (size_t)(job->offsets[source + 1] - job->offsets[source]),
+                                  source) == HUFFMAN_OK) {
+            result = huffmanDecompressBlock(context, record, record_size, index, output, expected);
+        }
+    }
+    return result;
+}
+
+/**
+ * Функция decompressWorker - рабочий поток параллельного восстановления
+ * @param arg - указатель на общее состояние DecompressJob
+ *
+ * Поток забирает номера блоков по порядку, находит блок по смещению,
+ * восстанавливает его и записывает сразу на его место в выходном файле
+ * (номер блока * размер блока). Если оба файла отображены в память, блок
+ * декодируется прямо из отображения сжатого файла в отображение выходного.
+ * Иначе поток открывает оба файла отдельными дескрипторами. При проверке
+ * (output_filename == NULL) блок декодируется в буфер потока, проверяется
+ * его контрольная сумма, и результат нигде не сохраняется. У каждого
+ * потока свой контекст библиотеки.
+ */
+static THREAD_FUNC decompressWorker(void* arg) {
+    DecompressJob* job = (DecompressJob*)arg;
+    const HuffmanFrameHeader* header = &job->header;
+    int mapped = job->input.data != NULL;
+    int verify = job->output_filename == NULL;       // Только проверка: результат никуда не пишется
+    FILE* input = mapped ? NULL : fopen(job->input_filename, "rb");
+    FILE* output = mapped || verify ? NULL : fopen(job->output_filename, "r+b");
+    int scratch = !mapped || job->output.data == NULL;  // Блок декодируется в свой буфер
+    DecodeBuffers buffers;
+    initDecodeBuffers(&buffers, scratch ? header->block_size : 0, job->dictionary);
+    buffers.offsets = job->offsets;                  // Блоки берутся не по порядку
+
+    mutexLock(&job->mutex);
+    if (!mapped && (input == NULL || (output == NULL && !verify))) {
+        job->failed = 1;
+    }
+    while (!job->failed && job->next_block < header->block_count) {
+        uint32_t index = job->next_block++;
+        mutexUnlock(&job->mutex);
+
+        uint64_t start = (uint64_t)index * header->block_size;
+        uint32_t expected = (uint32_t)(header->original_size - start < header->block_size ?
+                                       header->original_size - start : header->block_size);
+        int ok;
+        if (mapped) {
+            // Границы блоков уже проверены locateBlocks
+            int result = decodeMappedBlock(job, buffers.context, index,
+                                           scratch ? buffers.output : job->output.data + start, expected);
+            ok = result == HUFFMAN_OK;
+            if (!ok) {
+                reportBlockError(index, result);
+            }
+        } else {
+            ok = seekFile(input, job->offsets[index]) == 0 &&
+                 readAndDecodeBlock(input, index, expected, &buffers);
+            ProfileSample sample;
+            PROFILE_BEGIN(sample);
+            ok = ok && (verify || (seekFile(output, start) == 0 &&
+                               fwrite(buffers.output, 1, expected, output) == expected));
+            PROFILE_END(PROFILE_WRITE, sample, expected, expected);
+        }
+
+        mutexLock(&job->mutex);
+        if (!ok) {
+            job->failed = 1;
+        }
+    }
+    mutexUnlock(&job->mutex);
+
+    if (output != NULL && (fflush(output) != 0 || ferror(output))) {
+        mutexLock(&job->mutex);
+        job->failed = 1;
+        mutexUnlock(&job->mutex);
+    }
+    freeDecodeBuffers(&buffers);
+    if (output != NULL) {
+        fclose(output);
+    }
+    if (input != NULL) {
+        fclose(input);
+    }
+    PROFILE_THREAD_EXIT();
+    return THREAD_RETURN;
+}
+
+/**
+ * Функция compressStream - сжимает поток неизвестной длины (например, stdin)
+ * @param input - входной поток (читается строго последовательно)
+ * @param output - выходной поток
+ * @param options - параметры сжатия
+ * @param report - куда выводить итоговое сообщение
+ * @return EXIT_SUCCESS при успехе, EXIT_FAILURE при ошибке
+ *
+ * Вход читается окнами по options->block_size байт; каждое окно сразу
+ * сжимается в блок и записывается. Чтение следующих окон и запись
+ * предыдущих блоков идут в конвейере ввода-вывода (см. ioPipelineStart),
+ * поэтому в памяти находятся IO_QUEUE_DEPTH окон и сжатых блоков, и расход
+ * памяти не зависит от длины потока. Кадр без размеров заканчивается
+ * признаком конца (huffmanStoreStreamEnd).
+ */
+int compressStream(FILE* input, FILE* output, const CompressOptions* options, FILE* report) {
+    HuffmanContext* context = createContext(options, options->dictionary);
+    HuffmanFrameHeader header;
+    huffmanBeginFrame(context, HUFFMAN_UNKNOWN_SIZE, &header);  // Размеры заранее неизвестны
+    unsigned char buffer[HUFFMAN_FRAME_HEADER_MAX_SIZE];
+    size_t header_size = huffmanStoreFrameHeader(&header, buffer);
+    int failed = fwrite(buffer, 1, header_size, output) != header_size;
+
+    uint64_t original_size = 0;
+    uint64_t compressed_size = header_size + HUFFMAN_STREAM_END_SIZE;
+    uint32_t block_count = 0;
+
+    IoPipeline pipeline;
+    ioPipelineStart(&pipeline, input, output, options->block_size, UINT64_MAX);
+    while (!failed) {
+        IoSlot* slot = ioPipelineNext(&pipeline);
+        if (slot == NULL) {
+            break;                                   // Конец входа или ошибка
+        }
+        if (!encodeBlock(context, slot->raw, slot->size, block_count, &slot->encoded)) {
+            failed = 1;
+            break;
+        }
+        original_size += slot->size;
+        compressed_size += slot->encoded.size;
+        block_count++;
+        if (!ioPipelineSubmit(&pipeline, slot)) {
+            break;
+        }
+    }
+    int engine = pipeline.engine;
+    if (!ioPipelineFinish(&pipeline)) {
+        failed = 1;
+    }
+    if (ferror(input)) {
+        fprintf(stderr, "Ошибка чтения входного потока\n");
+        failed = 1;
+    }
+
+    // Признак конца потока: нулевой размер блока и общий размер исходных данных
+    unsigned char end[HUFFMAN_STREAM_END_SIZE];
+    huffmanStoreStreamEnd(original_size, end);
+    if (!failed && (fwrite(end, 1, HUFFMAN_STREAM_END_SIZE, output) != HUFFMAN_STREAM_END_SIZE ||
+                    fflush(output) != 0)) {
+        failed = 1;
+    }
+    HuffmanCacheStats cache = {0};
+    addTableCacheStats(&cache, context);
+    huffmanFreeContext(context);
+
+    if (failed) {
+        fprintf(stderr, "Ошибка при сжатии потока\n");
+        return EXIT_FAILURE;
+    }
+    fprintf(report, "Сжато (поток): %llu -> %llu байт, блоков: %u, ввод-вывод: %s\n",
+            (unsigned long long)original_size, (unsigned long long)compressed_size,
+            (unsigned)block_count, ioEngineName(engine));
+    if (options->table_cache >= 0) {
+        printTableCacheStats(report, &cache);
+    }
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Функция decompressStream - восстанавливает данные, сжатые compressStream
+ * @param input - сжатый поток (указатель стоит сразу за заголовком файла)
+ * @param output - выходной поток (NULL - только проверить контрольные суммы)
+ * @param header - прочитанный заголовок файла
+ * @param written - сюда записывается количество восстановленных байт
+ * @param dictionary - словарь для блоков HUFFMAN_MODE_DICTIONARY (NULL - нет)
+ * @return 1 при успехе, 0 при ошибке
+ *
+ * Блоки читаются строго последовательно до признака конца потока,
+ * поэтому вход может быть каналом (pipe) или stdin. В памяти находится
+ * только один блок.
+ */
+int decompressStream(FILE* input, FILE* output, const HuffmanFrameHeader* header, uint64_t* written,
+                     const unsigned char* dictionary) {
+    DecodeBuffers buffers;
+    initDecodeBuffers(&buffers, header->block_size, dictionary);
+    int ok = 0;
+    *written = 0;
+
+    for (uint32_t i = 0;; i++) {
+        HuffmanBlockInfo info;
+        if (!readBlock(input, &buffers.record, &info)) {
+            fprintf(stderr, "Ошибка: поток обрезан (нет признака конца)\n");
+            break;
+        }
+        if (info.raw_size == 0) {
+            // Признак конца: общий размер должен совпасть с восстановленным
+            if (info.stream_total != *written) {
+                fprintf(stderr, "Ошибка: поток поврежден (не совпадает общий размер)\n");
+                break;
+            }
+            ok = 1;
+            break;
+        }
+
+        int result = info.raw_size > header->block_size ? HUFFMAN_ERROR_CORRUPT :
+                     huffmanDecompressBlock(buffers.context, buffers.record.data, buffers.record.size, i,
+                                            buffers.output, info.raw_size);
+        if (result != HUFFMAN_OK) {
+            fprintf(stderr, "Ошибка: блок %u потока поврежден или обрезан\n", (unsigned)i);
+            break;
+        }
+        ProfileSample sample;
+        PROFILE_BEGIN(sample);
+        size_t stored = output != NULL ? fwrite(buffers.output, 1, info.raw_size, output) : info.raw_size;
+        PROFILE_END(PROFILE_WRITE, sample, info.raw_size, stored);
+        if (stored != info.raw_size) {
+            fprintf(stderr, "Ошибка записи восстановленных данных\n");
+            break;
+        }
+        *written += info.raw_size;
+    }
+
+    freeDecodeBuffers(&buffers);
+    return ok;
+}
+
+/**
+ * Функция decompressFile - восстанавливает файл по сжатому файлу
+ * @param input_filename - путь к сжатому файлу
+ * @param output_filename - путь к восстановленному файлу (NULL - только проверка)
+ * @param threads - количество рабочих потоков
+ * @param dictionary - словарь для блоков, сжатых с --dict (NULL - нет)
+ * @return EXIT_SUCCESS при успехе, EXIT_FAILURE при ошибке
+ *
+ * Таблица декодирования каждого блока строится только по длинам кодов
+ * из заголовка блока, без подсчета частот и без исходного файла.
+ * Для каждого блока проверяются размер и контрольная сумма.
+ *
+ * Имя STDIO_NAME ("-") означает stdin для входа и stdout для выхода;
+ * тогда блоки читаются и пишутся последовательно.
+ *
+ * Без выходного файла (проверка) блоки восстанавливаются в память по одному
+ * на поток и сверяются с контрольными суммами, записанными при сжатии:
+ * диск не читается повторно и не пишется.
+ *
+ * Выходной файл пишется во временный файл рядом и заменяет прежний только
+ * после успешного восстановления (см. beginOutputFile); восстановить сжатый
+ * файл поверх него самого нельзя.
+ *
+ * Если оба файла удается отобразить в память (USE_MMAP), блоки
+ * декодируются из отображения в отображение без промежуточных копий:
+ * одним потоком - функцией huffmanDecompress, несколькими - по смещениям,
+ * найденным по заголовкам блоков. Иначе, если в файле есть
+ * индекс блоков и threads > 1, блоки восстанавливаются параллельно, каждый
+ * сразу на свое место в выходном файле. Иначе блоки читаются
+ * и восстанавливаются по очереди.
+ */
+int decompressFile(const char* input_filename, const char* output_filename, int threads,
+                   const unsigned char* dictionary) {
+    int verify = output_filename == NULL;
+    int from_stdin = strcmp(input_filename, STDIO_NAME) == 0;
+    int to_stdout = !verify && strcmp(output_filename, STDIO_NAME) == 0;
+    FILE* report = to_stdout ? stderr : stdout;      // stdout занят данными
+    if (!verify && !to_stdout && !from_stdin && sameFile(input_filename, output_filename)) {
+        fprintf(stderr, "Ошибка: '%s' - это и сжатый, и выходной файл\n", output_filename);
+        return EXIT_FAILURE;
+    }
+    FILE* input_file = from_stdin ? stdin : fopen(input_filename, "rb");
+    if (input_file == NULL) {
+        fprintf(stderr, "Ошибка: не удалось открыть файл '%s'\n", input_filename);
+        return EXIT_FAILURE;
+    }
+    if (from_stdin) {
+        setBinaryMode(stdin);
+    }
+
+    DecompressJob job;
+    memset(&job, 0, sizeof(job));
+    job.input_filename = input_filename;
+    job.dictionary = dictionary;
+    if (!readFrameHeader(input_file, &job.header, &job.header_size)) {
+        if (!from_stdin) {
+            fclose(input_file);
+        }
+        return EXIT_FAILURE;
+    }
+    const HuffmanFrameHeader* header = &job.header;
+    char* output_path = verify || to_stdout ? NULL : beginOutputFile(output_filename);
+    job.output_filename = output_path;
+
+    // Каналы читаются и пишутся только последовательно
+    if ((uint32_t)threads > header->block_count || from_stdin || to_stdout) {
+        threads = header->block_count > 0 && !from_stdin && !to_stdout ? (int)header->block_count : 1;
+    }
+    int mapped = header->block_count > 0 && !from_stdin && !to_stdout &&
+                 mapInputFile(input_filename, &job.input);
+    if (mapped && !verify && !mapOutputFile(output_path, header->original_size, &job.output)) {
+        unmapFile(&job.input);
+        mapped = 0;
+    }
+
+    // Без отображения параллельное восстановление возможно только при наличии индекса
+    if (mapped ? threads > 1 || verify : threads > 1 && (header->flags & HUFFMAN_FRAME_INDEX)) {
+        job.offsets = (unsigned long long*)malloc(((size_t)header->block_count + 1) * sizeof(unsigned long long));
+        if (job.offsets == NULL) {
+            fprintf(stderr, "Ошибка выделения памяти для индекса\n");
+            exit(EXIT_FAILURE);
+        }
+        int located = mapped ? locateBlocks(&job.input, header, job.header_size, job.offsets)
+                             : readBlockIndex(input_file, header, job.offsets);
+        if (!located) {
+            fprintf(stderr, mapped ? "Ошибка: файл обрезан или поврежден\n"
+                                   : "Ошибка: индекс блоков поврежден\n");
+            free(job.offsets);
+            unmapFile(&job.output);
+            unmapFile(&job.input);
+            fclose(input_file);
+            if (output_path != NULL) {
+                finishOutputFile(output_filename, output_path, 0);
+            }
+            return EXIT_FAILURE;
+        }
+    } else {
+        threads = 1;
+    }
+
+    FILE* output_file = NULL;
+    if (to_stdout) {
+        output_file = stdout;
+        setBinaryMode(stdout);
+    } else if (!mapped && !verify) {
+        output_file = fopen(output_path, "wb");
+        if (output_file == NULL) {
+            fprintf(stderr, "Ошибка: не удалось создать файл '%s'\n", output_path);
+            free(job.offsets);
+            free(output_path);
+            if (!from_stdin) {
+                fclose(input_file);
+            }
+            return EXIT_FAILURE;
+        }
+    }
+
+    int failed = 0;
+    uint64_t written = 0;
+    if (header->flags & HUFFMAN_FRAME_STREAM) {
+        // Потоковый формат: блоки до признака конца
+        failed = !decompressStream(input_file, output_file, header, &written, dictionary);
+        if (!failed && output_file != NULL && (fflush(output_file) != 0 || ferror(output_file))) {
+            fprintf(stderr, "Ошибка записи файла '%s'\n", output_filename);
+            failed = 1;
+        }
+        if (output_file != NULL && !to_stdout) {
+            fclose(output_file);
+        }
+    } else if (threads == 1 && !mapped) {
+        DecodeBuffers buffers;
+        initDecodeBuffers(&buffers, header->block_size, dictionary);
+        for (uint32_t i = 0; i < header->block_count; i++) {
+            uint32_t expected = (uint32_t)(header->original_size - written < header->block_size ?
+                                           header->original_size - written : header->block_size);
+            if (!readAndDecodeBlock(input_file, i, expected, &buffers)) {
+                failed = 1;
+                break;
+            }
+            if (output_file != NULL) {
+                ProfileSample sample;
+                PROFILE_BEGIN(sample);
+                fwrite(buffers.output, 1, expected, output_file);
+                PROFILE_END(PROFILE_WRITE, sample, expected, expected);
+            }
+            written += expected;
+        }
+        freeDecodeBuffers(&buffers);
+        if (!failed && output_file != NULL && (fflush(output_file) != 0 || ferror(output_file))) {
+            fprintf(stderr, "Ошибка записи файла '%s'\n", output_filename);
+            failed = 1;
+        }
+        if (output_file != NULL && !to_stdout) {
+            fclose(output_file);
+        }
+    } else if (threads == 1 && !verify) {
+        // Один поток: файл целиком восстанавливается из отображения в отображение
+        HuffmanContext* context = createContext(NULL, dictionary);
+        size_t restored = 0;
+        failed = huffmanDecompress(context, job.input.data, (size_t)job.input.size, job.output.data,
+                                   (size_t)header->original_size, &restored) != HUFFMAN_OK;
+        huffmanFreeContext(context);
+        if (!unmapFile(&job.output)) {
+            failed = 1;
+        }
+        if (failed) {
+            fprintf(stderr, "Ошибка при восстановлении файла '%s'\n", output_filename);
+        }
+        written = restored;
+    } else {
+        if (output_file != NULL) {
+            fclose(output_file);                     // Потоки пишут через свои дескрипторы
+        }
+
+        ThreadHandle* workers = (ThreadHandle*)malloc(threads * sizeof(ThreadHandle));
+        if (workers == NULL) {
+            fprintf(stderr, "Ошибка выделения памяти для потоков\n");
+            exit(EXIT_FAILURE);
+        }
+        mutexInit(&job.mutex);
+        int started = 0;
+        if (threads == 1) {
+            decompressWorker(&job);                  // Проверка одним потоком - в текущем
+            started = 1;
+        } else {
+            for (; started < threads; started++) {
+                if (!threadStart(&workers[started], decompressWorker, &job)) {
+                    break;
+                }
+            }
+            for (int i = 0; i < started; i++) {
+                threadJoin(workers[i]);
+            }
+        }
+        failed = job.failed || started == 0;
+        mutexDestroy(&job.mutex);
+        free(workers);
+        if (!unmapFile(&job.output)) {
+            failed = 1;
+        }
+        if (failed) {
+            fprintf(stderr, verify ? "Ошибка: файл '%s' поврежден\n" : "Ошибка при восстановлении файла '%s'\n",
+                    verify ? input_filename : output_filename);
+        }
+        written = header->original_size;
+    }
+
+    free(job.offsets);
+    unmapFile(&job.input);
+    if (!from_stdin) {
+        fclose(input_file);
+    }
+    if (output_path != NULL && !finishOutputFile(output_filename, output_path, !failed)) {
+        failed = 1;
+    }
+
+    if (failed) {
+        return EXIT_FAILURE;
+    }
+    if (verify) {
+        fprintf(report, "Проверено: %s (%llu байт, блоков: %u, потоков: %d), контрольные суммы совпали\n",
+                input_filename, (unsigned long long)written, (unsigned)header->block_count, threads);
+        return EXIT_SUCCESS;
+    }
+    fprintf(report, "Восстановлено: %s -> %s (%llu байт, блоков: %u, потоков: %d)\n",
+            input_filename, output_filename, (unsigned long long)written,
+            (unsigned)header->block_count, threads);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Функция readWholeInput - читает вход до конца в память
+ * @param input - файл или поток (например, stdin)
+ * @param size - сюда записывается количество прочитанных байт
+ * @return буфер с данными (освобождается free) или NULL при ошибке чтения
+ */
+static unsigned char* readWholeInput(FILE* input, size_t* size) {
+    size_t capacity = 1 << 20;
+    unsigned char* data = (unsigned char*)malloc(capacity);
+    *size = 0;
+    for (;;) {
+        if (data == NULL) {
+            fprintf(stderr, "Ошибка выделения памяти для сжатых данных\n");
+            exit(EXIT_FAILURE);
+        }
+        *size += fread(data + *size, 1, capacity - *size, input);
+        if (*size < capacity) {
+            break;
+        }
+        capacity *= 2;
+        data = (unsigned char*)realloc(data, capacity);
+    }
+    if (ferror(input)) {
+        free(data);
+        return NULL;
+    }
+    return data;
+}
+
+/**
+ * Функция decompressRange - восстанавливает часть исходного файла по сжатому файлу
+ * @param input_filename - путь к сжатому файлу ("-" - stdin)
+ * @param output_filename - путь к файлу для восстановленной части ("-" - stdout)
+ * @param offset - смещение первого нужного байта исходного файла
+ * @param length - количество нужных байтов (диапазон за концом файла обрезается)
+ * @param dictionary - словарь для блоков, сжатых с --dict (NULL - нет)
+ * @return EXIT_SUCCESS при успехе, EXIT_FAILURE при ошибке
+ *
+ * Блок с байтом offset - это блок номер offset / размер блока, поэтому
+ * декодируются только блоки, пересекающие диапазон. Отображенный в
+ * память файл восстанавливается функцией huffmanDecompressRange: она
+ * читает окончание индекса, один его элемент и нужные блоки. Без
+ * отображения смещения блоков берутся из индекса (readBlockIndex), и
+ * нужные блоки читаются по ним. Вход без индекса (stdin, потоковый
+ * формат) читается в память целиком, но декодируются все равно только
+ * блоки из диапазона.
+ */
+int decompressRange(const char* input_filename, const char* output_filename, uint64_t offset,
+                    uint64_t length, const unsigned char* dictionary) {
+    int from_stdin = strcmp(input_filename, STDIO_NAME) == 0;
+    int to_stdout = strcmp(output_filename, STDIO_NAME) == 0;
+    FILE* report = to_stdout ? stderr : stdout;      // stdout занят данными
+    if (!to_stdout && !from_stdin && sameFile(input_filename, output_filename)) {
+        fprintf(stderr, "Ошибка: '%s' - это и сжатый, и выходной файл\n", output_filename);
+        return EXIT_FAILURE;
+    }
+    MappedFile map;
+    map.data = NULL;
+    FILE* input_file = NULL;
+    unsigned char* data = NULL;                      // Сжатые данные, прочитанные в память
+    size_t data_size = 0;
+    HuffmanFrameHeader header;
+    size_t header_size;
+    unsigned long long* offsets = NULL;              // Смещения блоков из индекса (чтение без отображения)
+
+    int mapped = !from_stdin && mapInputFile(input_filename, &map);
+    if (from_stdin) {
+        setBinaryMode(stdin);
+        data = readWholeInput(stdin, &data_size);
+        if (data == NULL) {
+            fprintf(stderr, "Ошибка чтения сжатых данных из stdin\n");
+            return EXIT_FAILURE;
+        }
+    } else if (!mapped) {
+        input_file = fopen(input_filename, "rb");
+        if (input_file == NULL) {
+            fprintf(stderr, "Ошибка: не удалось открыть файл '%s'\n", input_filename);
+            return EXIT_FAILURE;
+        }
+        if (!readFrameHeader(input_file, &header, &header_size)) {
+            fclose(input_file);
+            return EXIT_FAILURE;
+        }
+        if ((header.flags & HUFFMAN_FRAME_STREAM) || !(header.flags & HUFFMAN_FRAME_INDEX)) {
+            data = seekFile(input_file, 0) == 0 ? readWholeInput(input_file, &data_size) : NULL;
+            fclose(input_file);
+            input_file = NULL;
+            if (data == NULL) {
+                fprintf(stderr, "Ошибка чтения файла '%s'\n", input_filename);
+                return EXIT_FAILURE;
+            }
+        } else {
+            offsets = (unsigned long long*)malloc(((size_t)header.block_count + 1) * sizeof(unsigned long long));
+            if (offsets == NULL) {
+                fprintf(stderr, "Ошибка выделения памяти для индекса\n");
+                exit(EXIT_FAILURE);
+            }
+            if (!readBlockIndex(input_file, &header, offsets)) {
+                fprintf(stderr, "Ошибка: индекс блоков поврежден\n");
+                free(offsets);
+                fclose(input_file);
+                return EXIT_FAILURE;
+            }
+        }
+    } else {
+        data = map.data;
+        data_size = (size_t)map.size;
+    }
+
+    char* output_path = to_stdout ? NULL : beginOutputFile(output_filename);
+    FILE* output_file = to_stdout ? stdout : fopen(output_path, "wb");
+    if (output_file == NULL) {
+        fprintf(stderr, "Ошибка: не удалось создать файл '%s'\n", output_filename);
+    } else if (to_stdout) {
+        setBinaryMode(stdout);
+    }
+
+    int failed = output_file == NULL;
+    uint64_t start = offset;
+    uint64_t end = length > UINT64_MAX - offset ? UINT64_MAX : offset + length;
+    if (!failed && input_file != NULL) {
+        // Нужные блоки читаются по смещениям из индекса
+        end = end < header.original_size ? end : header.original_size;
+        start = start < end ? start : end;
+        DecodeBuffers buffers;
+        initDecodeBuffers(&buffers, header.block_size, dictionary);
+        buffers.offsets = offsets;                   // Таблицы блоков HUFFMAN_MODE_REUSE ищутся по смещениям
+        for (uint64_t block_start = start - start % header.block_size; !failed && block_start < end;
+             block_start += header.block_size) {
+            uint32_t index = (uint32_t)(block_start / header.block_size);
+            uint32_t expected = (uint32_t)(header.original_size - block_start < header.block_size ?
+                                           header.original_size - block_start : header.block_size);
+            uint64_t from = start > block_start ? start : block_start;
+            uint64_t to = end < block_start + expected ? end : block_start + expected;
+            failed = seekFile(input_file, offsets[index]) != 0 ||
+                     !readAndDecodeBlock(input_file, index, expected, &buffers) ||
+                     fwrite(buffers.output + (from - block_start), 1, (size_t)(to - from), output_file) !=
+                     (size_t)(to - from);
+        }
+        freeDecodeBuffers(&buffers);
+    } else if (!failed) {
+        // Весь сжатый файл в памяти: диапазон восстанавливает библиотека
+        unsigned long long total = 0;
+        failed = huffmanDecompressedSize(data, data_size, &total) != HUFFMAN_OK;
+        end = end < total ? end : total;
+        start = start < end ? start : end;
+        unsigned char* slice = (unsigned char*)malloc(end > start ? (size_t)(end - start) : 1);
+        if (slice == NULL) {
+            fprintf(stderr, "Ошибка выделения памяти для восстановленных данных\n");
+            exit(EXIT_FAILURE);
+        }
+        HuffmanContext* context = createContext(NULL, dictionary);
+        size_t restored = 0;
+        failed = failed ||
+                 huffmanDecompressRange(context, data, data_size, start, (size_t)(end - start), slice,
+                                        (size_t)(end - start), &restored) != HUFFMAN_OK ||
+                 fwrite(slice, 1, restored, output_file) != restored;
+        huffmanFreeContext(context);
+        free(slice);
+    }
+    if (output_file != NULL && (fflush(output_file) != 0 || ferror(output_file))) {
+        failed = 1;
+    }
+    if (output_file != NULL && !to_stdout && fclose(output_file) != 0) {
+        failed = 1;
+    }
+    if (output_path != NULL && output_file == NULL) {
+        free(output_path);                           // Файл не создан: заменять нечего
+    } else if (output_path != NULL && !finishOutputFile(output_filename, output_path, !failed)) {
+        failed = 1;
+    }
+
+    free(offsets);
+    if (input_file != NULL) {
+        fclose(input_file);
+    }
+    if (mapped) {
+        unmapFile(&map);
+    } else {
+        free(data);
+    }
+
+    if (failed) {
+        if (output_file != NULL) {
+            fprintf(stderr, "Ошибка при восстановлении диапазона из файла '%s'\n", input_filename);
+        }
+        return EXIT_FAILURE;
+    }
+    fprintf(report, "Восстановлено: %s -> %s (байты %llu-%llu, %llu байт)\n",
+            input_filename, output_filename, (unsigned long long)start, (unsigned long long)end,
+            (unsigned long long)(end - start));
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Функция batchPush - добавляет задачу в конец очереди потока
+ * @param job - общее состояние пакетного сжатия
+ * @param id - номер очереди
+ * @param task - задача
+ *
+ * Счетчик pending увеличивается до того, как задачу можно перехватить,
+ * а version - после: бездействующий поток, проснувшийся по version,
+ * уже видит задачу в очереди.
+ */
+static void batchPush(BatchJob* job, int id, BatchTask task) {
+    mutexLock(&job->mutex);
+    job->pending++;
+    mutexUnlock(&job->mutex);
+
+    BatchDeque* deque = &job->deques[id];
+    mutexLock(&deque->mutex);
+    if (deque->bottom == deque->capacity) {
+        int count = deque->bottom - deque->top;
+        if (deque->top > 0) {
+            // Место в начале освободили перехваты - сдвигаем задачи к началу
+            memmove(deque->tasks, deque->tasks + deque->top, count * sizeof(BatchTask));
+        } else {
+            int capacity = deque->capacity > 0 ? deque->capacity * 2 : 64;
+            BatchTask* tasks = (BatchTask*)realloc(deque->tasks, capacity * sizeof(BatchTask));
+            if (tasks == NULL) {
+                fprintf(stderr, "Ошибка выделения памяти для очереди задач\n");
+                exit(EXIT_FAILURE);
+            }
+            deque->tasks = tasks;
+            deque->capacity = capacity;
+        }
+        deque->top = 0;
+        deque->bottom = count;
+    }
+    deque->tasks[deque->bottom++] = task;
+    mutexUnlock(&deque->mutex);
+
+    mutexLock(&job->mutex);
+    job->version++;
+    condBroadcast(&job->cond);
+    mutexUnlock(&job->mutex);
+}
+
+/**
+ * Функция batchTake - берет задачу для потока: свою или перехваченную у другого
+ * @param job - общее состояние пакетного сжатия
+ * @param id - номер потока
+ * @param task - сюда записывается задача
+ * @return 0 - задач нет ни в одной очереди, 1 - задача из своей очереди, 2 - перехваченная
+ *
+ * Из своей очереди задача берется с конца, из чужих - с начала,
+ * обход чужих очередей начинается с соседней.
+ */
+static int batchTake(BatchJob* job, int id, BatchTask* task) {
+    for (int k = 0; k < job->threads; k++) {
+        BatchDeque* deque = &job->deques[(id + k) % job->threads];
+        mutexLock(&deque->mutex);
+        int found = deque->top < deque->bottom;
+        if (found) {
+            *task = k == 0 ? deque->tasks[--deque->bottom] : deque->tasks[deque->top++];
+            if (deque->top == deque->bottom) {
+                deque->top = deque->bottom = 0;
+            }
+        }
+        mutexUnlock(&deque->mutex);
+        if (found) {
+            return k == 0 ? 1 : 2;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Функция batchFinishFile - дописывает индекс, закрывает сжатый файл и освобождает буферы
+ * @param file - файл, все части которого записаны
+ *
+ * Сжатый файл с ошибкой удаляется, чтобы не оставлять обрезанных файлов.
+ */
+static void batchFinishFile(BatchFile* file) {
+    int ok = !file->failed;
+    if (ok && (file->header.flags & HUFFMAN_FRAME_INDEX)) {
+        file->compressed_size += writeBlockIndex(file->output, &file->header, file->offsets,
+                                                 file->compressed_size);
+    }
+    if (fflush(file->output) != 0 || ferror(file->output)) {
+        ok = 0;
+    }
+    fclose(file->output);
+    file->output = NULL;
+    if (!ok) {
+        remove(file->output_filename);
+        fprintf(stderr, "Ошибка при сжатии файла '%s'\n", file->input_filename);
+        file->failed = 1;
+    }
+    unmapFile(&file->input);
+    free(file->offsets);
+    free(file->chunks);
+    file->offsets = NULL;
+    file->chunks = NULL;
+    file->seconds = wallClockSeconds() - file->start;
+}
+
+/**
+ * Функция batchChunkDone - отмечает часть сжатой и записывает готовые части по порядку
+ * @param file - файл
+ * @param chunk - номер сжатой части
+ * @param ok - 0, если часть не удалось прочитать
+ *
+ * Записывает тот поток, который застал очередную часть готовой; пока он
+ * пишет вне мьютекса, другие потоки только отмечают свои части и уходят
+ * за новыми задачами. Поток, записавший последнюю часть, завершает файл.
+ */
+static void batchChunkDone(BatchFile* file, uint32_t chunk, int ok) {
+    mutexLock(&file->mutex);
+    file->chunks[chunk].ready = 1;
+    if (!ok) {
+        file->failed = 1;
+    }
+    if (file->writing) {
+        mutexUnlock(&file->mutex);
+        return;                                      // Эту часть запишет поток, который уже пишет
+    }
+    file->writing = 1;
+    while (file->next_chunk < file->chunk_count && file->chunks[file->next_chunk].ready) {
+        BatchChunk* part = &file->chunks[file->next_chunk];
+        uint32_t first = file->next_chunk * BATCH_CHUNK_BLOCKS;
+        int skip = file->failed;
+        uint64_t position = file->compressed_size;
+        mutexUnlock(&file->mutex);
+
+        EncodedBlock* blocks[BATCH_CHUNK_BLOCKS];
+        for (uint32_t b = 0; b < part->count; b++) {
+            file->offsets[first + b] = position;
+            position += part->blocks[b].size;
+            blocks[b] = &part->blocks[b];
+        }
+        int written = skip || (part->count > 0 && writeBlocks(file->output, blocks, (int)part->count));
+        for (uint32_t b = 0; b < part->count; b++) {
+            free(part->blocks[b].data);
+        }
+        free(part->blocks);
+        part->blocks = NULL;
+
+        mutexLock(&file->mutex);
+        file->compressed_size = position;
+        if (!written) {
+            file->failed = 1;
+        }
+        file->next_chunk++;
+        condBroadcast(&file->cond);                  // Место под несписанные части освободилось
+    }
+    file->writing = 0;
+    int finished = file->next_chunk == file->chunk_count;
+    mutexUnlock(&file->mutex);
+
+    if (finished) {
+        batchFinishFile(file);
+    }
+}
+
+/**
+ * Функция batchClaimChunk - выбирает часть файла для задачи сжатия
+ * @param job - общее состояние пакетного сжатия
+ * @param file - файл
+ * @return номер первой еще не взятой части
+ *
+ * Части берутся строго по порядку, поэтому сжатые части почти сразу
+ * записываются. Если впереди записанных уже job->threads взятых частей
+ * (одна медленная часть задерживает запись следующих), поток ждет
+ * записи: так в памяти держится не больше job->threads сжатых частей
+ * файла, а не весь файл. Ожидающий поток не держит ни одной взятой
+ * части, а первую из них сжимает работающий поток, поэтому ожидание
+ * всегда заканчивается.
+ */
+static uint32_t batchClaimChunk(BatchJob* job, BatchFile* file) {
+    mutexLock(&file->mutex);
+    while (file->next_claim - file->next_chunk >= (uint32_t)job->threads) {
+        condWait(&file->cond, &file->mutex);
+    }
+    uint32_t chunk = file->next_claim++;
+    mutexUnlock(&file->mutex);
+    return chunk;
+}
+
+/**
+ * Функция batchCompressChunk - сжимает одну часть файла (до BATCH_CHUNK_BLOCKS блоков)
+ * @param job - общее состояние пакетного сжатия
+ * @param worker - поток, выполняющий задачу (его контекст и буфер чтения)
+ * @param file - файл
+ * @param chunk - номер части
+ *
+ * Блоки берутся из отображения файла или читаются через отдельный
+ * дескриптор, как в compressBlockAt. После ошибки в файле его
+ * оставшиеся части не сжимаются. Часть - это ровно один сегмент кэша
+ * таблиц, поэтому с --table-cache результат совпадает с compressFile.
+ */
+static void batchCompressChunk(BatchJob* job, BatchWorker* worker, BatchFile* file, uint32_t chunk) {
+    const HuffmanFrameHeader* header = &file->header;
+    BatchChunk* part = &file->chunks[chunk];
+    uint32_t first = chunk * BATCH_CHUNK_BLOCKS;
+    part->count = header->block_count - first < BATCH_CHUNK_BLOCKS ? header->block_count - first
+                                                                 : BATCH_CHUNK_BLOCKS;
+
+    mutexLock(&file->mutex);
+    int ok = !file->failed;
+    mutexUnlock(&file->mutex);
+
+    FILE* input = NULL;
+    if (ok && file->input.data == NULL) {
+        input = fopen(file->input_filename, "rb");
+        if (worker->raw == NULL) {
+            worker->raw = (unsigned char*)malloc(job->options.block_size);
+        }
+        if (input == NULL || worker->raw == NULL) {
+            ok = 0;
+        }
+    }
+    part->blocks = (EncodedBlock*)calloc(part->count, sizeof(EncodedBlock));
+    if (part->blocks == NULL) {
+        fprintf(stderr, "Ошибка выделения памяти для блоков\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (uint32_t b = 0; b < part->count && ok; b++) {
+        uint64_t offset = (uint64_t)(first + b) * header->block_size;
+        size_t size = (size_t)(header->original_size - offset < header->block_size ?
+                               header->original_size - offset : header->block_size);
+        if (file->input.data != NULL) {
+            ok = encodeBlock(worker->context, file->input.data + offset, size, first + b, &part->blocks[b]);
+            continue;
+        }
+        ProfileSample sample;
+        PROFILE_BEGIN(sample);
+        if (seekFile(input, offset) != 0 || fread(worker->raw, 1, size, input) != size) {
+            ok = 0;
+            break;
+        }
+        PROFILE_END(PROFILE_READ, sample, size, size);
+        ok = encodeBlock(worker->context, worker->raw, size, first + b, &part->blocks[b]);
+    }
+    if (input != NULL) {
+        fclose(input);
+    }
+    batchChunkDone(file, chunk, ok);
+}
+
+/**
+ * Функция batchOpenFile - начинает сжатие файла: заголовок и разбиение на части
+ * @param job - общее состояние пакетного сжатия
+ * @param worker - поток, выполняющий задачу
+ * @param file - файл
+ *
+ * Задачи сжатия всех частей, кроме одной, кладутся в очередь потока,
+ * откуда их могут перехватить свободные потоки; первая часть сжимается
+ * сразу. Так большой файл сжимается всеми потоками и не задерживает
+ * остальные файлы пакета.
+ */
+static void batchOpenFile(BatchJob* job, BatchWorker* worker, BatchFile* file) {
+    file->start = wallClockSeconds();
+    FILE* input = fopen(file->input_filename, "rb");
+    if (input == NULL) {
+        fprintf(stderr, "Ошибка: не удалось открыть файл '%s'\n", file->input_filename);
+        file->failed = 1;
+        return;
+    }
+    uint64_t original_size = getFileSize(input);
+    fclose(input);
+
+    if (huffmanBeginFrame(worker->context, original_size, &file->header) != HUFFMAN_OK) {
+        fprintf(stderr, "Ошибка: в файле '%s' слишком много блоков, увеличьте размер блока\n",
+                file->input_filename);
+        file->failed = 1;
+        return;
+    }
+    uint32_t block_count = file->header.block_count;
+    if (mapInputFile(file->input_filename, &file->input) && file->input.size != original_size) {
+        unmapFile(&file->input);                     // Файл изменился между вызовами - читаем через stdio
+    }
+    file->output = fopen(file->output_filename, "wb");
+    if (file->output == NULL) {
+        fprintf(stderr, "Ошибка: не удалось создать файл '%s'\n", file->output_filename);
+        unmapFile(&file->input);
+        file->failed = 1;
+        return;
+    }
+
+    unsigned char header_data[HUFFMAN_FRAME_HEADER_MAX_SIZE];
+    file->compressed_size = huffmanStoreFrameHeader(&file->header, header_data);
+    fwrite(header_data, 1, (size_t)file->compressed_size, file->output);  // Ошибку покажет ferror в batchFinishFile
+
+    file->chunk_count = (uint32_t)(((uint64_t)block_count + BATCH_CHUNK_BLOCKS - 1) / BATCH_CHUNK_BLOCKS);
+    file->offsets = (unsigned long long*)malloc((size_t)(block_count > 0 ? block_count : 1) *
+                                                sizeof(unsigned long long));
+    file->chunks = (BatchChunk*)calloc(file->chunk_count > 0 ? file->chunk_count : 1, sizeof(BatchChunk));
+    if (file->offsets == NULL || file->chunks == NULL) {
+        fprintf(stderr, "Ошибка выделения памяти для индекса\n");
+        exit(EXIT_FAILURE);
+    }
+    if (file->chunk_count == 0) {
+        batchFinishFile(file);                       // Пустой файл: только заголовок и индекс
+        return;
+    }
+
+    for (uint32_t chunk = 1; chunk < file->chunk_count; chunk++) {
+        BatchTask task = {file, BATCH_CHUNK_TASK};
+        batchPush(job, worker->id, task);
+    }
+    batchCompressChunk(job, worker, file, batchClaimChunk(job, file));
+}
+
+/**
+ * Функция batchWorker - поток пула пакетного сжатия
+ * @param arg - указатель на BatchWorker
+ *
+ * Поток выполняет задачи своей очереди, а когда она пуста - перехватывает
+ * задачи других потоков. Если задач нет нигде, поток ждет, пока их
+ * добавят или пока не завершатся все задачи (pending == 0).
+ */
+static THREAD_FUNC batchWorker(void* arg) {
+    BatchWorker* worker = (BatchWorker*)arg;
+    BatchJob* job = worker->job;
+
+    for (;;) {
+        mutexLock(&job->mutex);
+        uint64_t version = job->version;             // Добавления после этого момента разбудят поток
+        mutexUnlock(&job->mutex);
+
+        BatchTask task;
+        int taken = batchTake(job, worker->id, &task);
+        if (taken) {
+            if (task.kind == BATCH_OPEN_TASK) {
+                batchOpenFile(job, worker, task.file);
+            } else {
+                batchCompressChunk(job, worker, task.file, batchClaimChunk(job, task.file));
+            }
+            mutexLock(&job->mutex);
+            job->pending--;
+            job->tasks++;
+            job->steals += taken == 2;
+            if (job->pending == 0) {
+                condBroadcast(&job->cond);           // Работа закончена - будим ждущих
+            }
+            mutexUnlock(&job->mutex);
+            continue;
+        }
+
+        mutexLock(&job->mutex);
+        while (job->pending > 0 && job->version == version) {
+            condWait(&job->cond, &job->mutex);
+        }
+        int finished = job->pending == 0;
+        mutexUnlock(&job->mutex);
+        if (finished) {
+            break;
+        }
+    }
+    PROFILE_THREAD_EXIT();
+    return THREAD_RETURN;
+}
+
+/**
+ * Функция batchOutputName - имя сжатого файла для исходного в пакетном режиме
+ * @param input_filename - исходный файл
+ * @param output_dir - папка для сжатых файлов (NULL - рядом с исходным)
+ * @return новая строка (освобождается free)
+ */
+static char* batchOutputName(const char* input_filename, const char* output_dir) {
+    const char* base = input_filename;
+    if (output_dir != NULL) {
+        for (const char* p = input_filename; *p != '\0'; p++) {
+            if (*p == '/' || *p == '\\') {
+                base = p + 1;                        // Имя файла без папки
+            }
+        }
+    }
+    size_t size = (output_dir != NULL ? strlen(output_dir) + 1 : 0) + strlen(base) +
+                  strlen(BATCH_EXTENSION) + 1;
+    char* name = (char*)malloc(size);
+    if (name == NULL) {
+        fprintf(stderr, "Ошибка выделения памяти для имени файла\n");
+        exit(EXIT_FAILURE);
+    }
+    if (output_dir != NULL) {
+        snprintf(name, size, "%s/%s%s", output_dir, base, BATCH_EXTENSION);
+    } else {
+        snprintf(name, size, "%s%s", base, BATCH_EXTENSION);
+    }
+    return name;
+}
+
+/**
+ * Функция compareBatchOutputs - сравнение файлов пакета по имени сжатого файла для qsort
+ */
+static int compareBatchOutputs(const void* a, const void* b) {
+    return strcmp((*(BatchFile* const*)a)->output_filename, (*(BatchFile* const*)b)->output_filename);
+}
+
+/**
+ * Функция batchCheckOutputs - проверяет, что сжатые файлы пакета не мешают друг другу
+ * @param files - файлы пакета с заполненными именами сжатых файлов
+ * @param count - количество файлов
+ * @return 1 если все сжатые файлы разные и не совпадают с исходными, иначе 0
+ *
+ * С --output-dir от исходного файла остается только имя, поэтому
+ * a/data.txt и b/data.txt (как и файл, указанный дважды) сжимались бы
+ * в один файл, а исходный x.huf рядом с x был бы перезаписан. Обо всех
+ * таких случаях сообщается до начала сжатия.
+ */
+static int batchCheckOutputs(BatchFile files[], int count) {
+    BatchFile** sorted = (BatchFile**)malloc((count > 0 ? count : 1) * sizeof(BatchFile*));
+    if (sorted == NULL) {
+        fprintf(stderr, "Ошибка выделения памяти для пакетного сжатия\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < count; i++) {
+        sorted[i] = &files[i];
+    }
+    qsort(sorted, count, sizeof(BatchFile*), compareBatchOutputs);
+
+    int ok = 1;
+    for (int i = 1; i < count; i++) {
+        if (strcmp(sorted[i - 1]->output_filename, sorted[i]->output_filename) == 0) {
+            fprintf(stderr, "Ошибка: '%s' и '%s' сжимаются в один файл '%s'\n",
+                    sorted[i - 1]->input_filename, sorted[i]->input_filename, sorted[i]->output_filename);
+            ok = 0;
+        }
+    }
+    for (int i = 0; i < count; i++) {
+        BatchFile key;
+        key.output_filename = (char*)files[i].input_filename;
+        BatchFile* key_pointer = &key;
+        BatchFile** found = (BatchFile**)bsearch(&key_pointer, sorted, count, sizeof(BatchFile*),
+                                                 compareBatchOutputs);
+        if (found != NULL) {
+            fprintf(stderr, "Ошибка: сжатый файл для '%s' перезаписал бы исходный файл пакета '%s'\n",
+                    (*found)->input_filename, files[i].input_filename);
+            ok = 0;
+        }
+    }
+    free(sorted);
+    return ok;
+}
+
+/**
+ * Функция compressBatch - сжимает много файлов общим пулом потоков
+ * @param inputs - исходные файлы
+ * @param count - количество файлов
+ * @param output_dir - папка для сжатых файлов (NULL - рядом с исходными)
+ * @param options - параметры сжатия (threads - размер пула)
+ * @return EXIT_SUCCESS, если сжаты все файлы, иначе EXIT_FAILURE
+ *
+ * Каждый файл сжимается в самостоятельный сжатый файл (имя + ".huf"),
+ * такой же, как у compressFile. Задачи открытия файлов раскладываются
+ * по очередям потоков по кругу; файл крупнее BATCH_CHUNK_BLOCKS блоков
+ * делится на части-задачи, и свободные потоки перехватывают их из чужих
+ * очередей (work stealing), поэтому один огромный файл не задерживает
+ * пакет, а мелкие файлы не ждут друг друга. Если два файла сжимались бы
+ * в один (batchCheckOutputs), пакет не начинается. В конце выводятся итог
+ * по каждому файлу и общая пропускная способность.
+ */
+int compressBatch(const char* const inputs[], int count, const char* output_dir,
+                  const CompressOptions* options) {
+    BatchJob job;
+    memset(&job, 0, sizeof(job));
+    job.options = *options;
+    job.threads = options->threads > 0 ? options->threads : 1;
+    if (output_dir != NULL) {
+        _mkdir(output_dir);                          // Ошибка (папка уже есть) не важна: проверит fopen
+    }
+
+    BatchFile* files = (BatchFile*)calloc(count > 0 ? count : 1, sizeof(BatchFile));
+    job.deques = (BatchDeque*)calloc(job.threads, sizeof(BatchDeque));
+    BatchWorker* workers = (BatchWorker*)calloc(job.threads, sizeof(BatchWorker));
+    if (files == NULL || job.deques == NULL || workers == NULL) {
+        fprintf(stderr, "Ошибка выделения памяти для пакетного сжатия\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < count; i++) {
+        files[i].input_filename = inputs[i];
+        files[i].output_filename = batchOutputName(inputs[i], output_dir);
+    }
+    if (!batchCheckOutputs(files, count)) {
+        for (int i = 0; i < count; i++) {
+            free(files[i].output_filename);
+        }
+        free(job.deques);
+        free(workers);
+        free(files);
+        return EXIT_FAILURE;
+    }
+    mutexInit(&job.mutex);
+    condInit(&job.cond);
+    for (int t = 0; t < job.threads; t++) {
+        mutexInit(&job.deques[t].mutex);
+        workers[t].job = &job;
+        workers[t].id = t;
+        workers[t].context = createContext(options, options->dictionary);
+    }
+    for (int i = 0; i < count; i++) {
+        mutexInit(&files[i].mutex);
+        condInit(&files[i].cond);
+        BatchTask task = {&files[i], BATCH_OPEN_TASK};
+        batchPush(&job, i % job.threads, task);      // По кругу: у каждого потока своя очередь файлов
+    }
+
+    double start = wallClockSeconds();
+    int started = 1;                                 // Нулевой поток - текущий
+    for (; started < job.threads; started++) {
+        if (!threadStart(&workers[started].thread, batchWorker, &workers[started])) {
+            break;                                   // Задачи незапущенных потоков перехватят остальные
+        }
+    }
+    batchWorker(&workers[0]);
+    for (int t = 1; t < started; t++) {
+        threadJoin(workers[t].thread);
+    }
+    double elapsed = wallClockSeconds() - start;
+
+    uint64_t total_in = 0;
+    uint64_t total_out = 0;
+    int failed = 0;
+    printf("Пакетное сжатие: файлов: %d, потоков: %d\n", count, started);
+    for (int i = 0; i < count; i++) {
+        BatchFile* file = &files[i];
+        if (file->failed) {
+            printf("  [ошибка] %s\n", file->input_filename);
+            failed++;
+            continue;
+        }
+        total_in += file->header.original_size;
+        total_out += file->compressed_size;
+        printf("  %s -> %s: %llu -> %llu байт", file->input_filename, file->output_filename,
+               (unsigned long long)file->header.original_size, (unsigned long long)file->compressed_size);
+        if (file->header.original_size > 0) {
+            printf(" (%.2f%%)", (double)file->compressed_size / file->header.original_size * 100);
+        }
+        printf(", блоков: %u, %.3f с\n", (unsigned)file->header.block_count, file->seconds);
+    }
+    printf("Итого: %llu -> %llu байт", (unsigned long long)total_in, (unsigned long long)total_out);
+    if (total_in > 0) {
+        printf(" (%.2f%%)", (double)total_out / total_in * 100);
+    }
+    printf(", сжато файлов: %d, ошибок: %d\n", count - failed, failed);
+    printf("Время: %.3f с, %.2f МБ/с, задач: %llu, перехвачено: %llu\n", elapsed,
+           elapsed > 0 ? (double)total_in / (1024.0 * 1024.0) / elapsed : 0.0,
+           (unsigned long long)job.tasks, (unsigned long long)job.steals);
+    if (options->table_cache >= 0) {
+        HuffmanCacheStats total = {0};
+        for (int t = 0; t < job.threads; t++) {
+            addTableCacheStats(&total, workers[t].context);
+        }
+        printTableCacheStats(stdout, &total);
+    }
+
+    for (int i = 0; i < count; i++) {
+        condDestroy(&files[i].cond);
+        mutexDestroy(&files[i].mutex);
+        free(files[i].output_filename);
+    }
+    for (int t = 0; t < job.threads; t++) {
+        mutexDestroy(&job.deques[t].mutex);
+        free(job.deques[t].tasks);
+        free(workers[t].raw);
+        huffmanFreeContext(workers[t].context);
+    }
+    condDestroy(&job.cond);
+    mutexDestroy(&job.mutex);
+    free(job.deques);
+    free(workers);
+    free(files);
+    return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * Функция addBatchInput - добавляет копию имени файла в список пакетного режима
+ * @param inputs - массив имен (растет по мере надобности)
+ * @param count - количество имен
+ * @param capacity - емкость массива
+ * @param name - начало имени
+ * @param length - длина имени
+ */
+static void addBatchInput(char*** inputs, int* count, int* capacity, const char* name, size_t length) {
+    if (*count == *capacity) {
+        int new_capacity = *capacity > 0 ? *capacity * 2 : 64;
+        char** grown = (char**)realloc(*inputs, new_capacity * sizeof(char*));
+        if (grown == NULL) {
+            fprintf(stderr, "Ошибка выделения памяти для списка файлов\n");
+            exit(EXIT_FAILURE);
+        }
+        *inputs = grown;
+        *capacity = new_capacity;
+    }
+    char* copy = (char*)malloc(length + 1);
+    if (copy == NULL) {
+        fprintf(stderr, "Ошибка выделения памяти для списка файлов\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(copy, name, length);
+    copy[length] = '\0';
+    (*inputs)[(*count)++] = copy;
+}
+
+/**
+ * Функция compareNames - сравнение имен файлов для qsort
+ */
+static int compareNames(const void* a, const void* b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+/**
+ * Функция collectBatchInputs - добавляет в список файл или все файлы папки
+ * @param path - файл или папка
+ * @param inputs - массив имен (растет по мере надобности, имена освобождаются free)
+ * @param count - количество имен
+ * @param capacity - емкость массива
+ * @return 1 при успехе, 0 если папку не удалось прочитать
+ *
+ * Из папки берутся только обычные файлы без вложенных папок; файлы
+ * с расширением BATCH_EXTENSION пропускаются, чтобы повторный запуск
+ * не сжимал результаты прошлого. Файлы папки идут по алфавиту.
+ */
+int collectBatchInputs(const char* path, char*** inputs, int* count, int* capacity) {
+    char name[BUFFER_SIZE];
+    int first = *count;
+#ifdef _WIN32
+    DWORD attributes = GetFileAttributesA(path);
+    if (attributes == INVALID_FILE_ATTRIBUTES || !(attributes & FILE_ATTRIBUTE_DIRECTORY)) {
+        addBatchInput(inputs, count, capacity, path, strlen(path));
+        return 1;
+    }
+    snprintf(name, sizeof(name), "%s\\*", path);
+    WIN32_FIND_DATAA entry;
+    HANDLE find = FindFirstFileA(name, &entry);
+    if (find == INVALID_HANDLE_VALUE) {
+        fprintf(stderr, "Ошибка: не удалось прочитать папку '%s'\n", path);
+        return 0;
+    }
+    do {
+        size_t length = strlen(entry.cFileName);
+        size_t extension = strlen(BATCH_EXTENSION);
+        if ((entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) ||
+            (length >= extension && strcmp(entry.cFileName + length - extension, BATCH_EXTENSION) == 0)) {
+            continue;
+        }
+        int size = snprintf(name, sizeof(name), "%s\\%s", path, entry.cFileName);
+        if (size > 0 && (size_t)size < sizeof(name)) {
+            addBatchInput(inputs, count, capacity, name, (size_t)size);
+        }
+    } while (FindNextFileA(find, &entry));
+    FindClose(find);
+#else
+    struct stat info;
+    if (stat(path, &info) != 0 || !S_ISDIR(info.st_mode)) {
+        addBatchInput(inputs, count, capacity, path, strlen(path));  // Ошибку открытия сообщит сжатие
+        return 1;
+    }
+    DIR* dir = opendir(path);
+    if (dir == NULL) {
+        fprintf(stderr, "Ошибка: не удалось прочитать папку '%s'\n", path);
+        return 0;
+    }
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        size_t length = strlen(entry->d_name);
+        size_t extension = strlen(BATCH_EXTENSION);
+        if (length >= extension && strcmp(entry->d_name + length - extension, BATCH_EXTENSION) == 0) {
+            continue;
+        }
+        int size = snprintf(name, sizeof(name), "%s/%s", path, entry->d_name);
+        if (size > 0 && (size_t)size < sizeof(name) && stat(name, &info) == 0 && S_ISREG(info.st_mode)) {
+            addBatchInput(inputs, count, capacity, name, (size_t)size);
+        }
+    }
+    closedir(dir);
+#endif
+    qsort(*inputs + first, *count - first, sizeof(char*), compareNames);
+    return 1;
+}
+
+/**
+ * Функция readBatchList - добавляет в список файлы из текстового списка
+ * @param list_filename - файл со списком: одно имя на строку, пустые строки пропускаются
+ * @param inputs - массив имен (растет по мере надобности)
+ * @param count - количество имен
+ * @param capacity - емкость массива
+ * @return 1 при успехе, 0 если список не удалось прочитать
+ */
+int readBatchList(const char* list_filename, char*** inputs, int* count, int* capacity) {
+    FILE* list = fopen(list_filename, "r");
+    if (list == NULL) {
+        fprintf(stderr, "Ошибка: не удалось открыть список файлов '%s'\n", list_filename);
+        return 0;
+    }
+    char line[BUFFER_SIZE];
+    while (fgets(line, sizeof(line), list) != NULL) {
+        size_t length = strlen(line);
+        while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r')) {
+            length--;                                // Перевод строки (и \r из файлов Windows)
+        }
+        if (length > 0) {
+            addBatchInput(inputs, count, capacity, line, length);
+        }
+    }
+    fclose(list);
+    return 1;
+}
+
+/**
+ * Функция huffman_compress_decompress - выполняет полный цикл сжатия и восстановления файла
+ * @param input_filename - путь к исходному файлу
+ * @param encoded_filename - путь для сохранения сжатого файла
+ * @param decoded_filename - путь для сохранения восстановленного файла
+ *                           (NULL - восстановленные данные не сохраняются)
+ * @return EXIT_SUCCESS при успехе, EXIT_FAILURE при ошибке
+ *
+ * Выполняет все 6 шагов алгоритма Хаффмана:
+ * 1. Кодирование файла в сжатый файл (блоками, см. compressFile) с подсчетом
+ *    частот символов по тем же блокам
+ * 2. Построение дерева Хаффмана по частотам всего файла
+ * 3. Генерация (канонических) кодов
+ * 4. Сравнение блочного сжатия с одной таблицей на весь файл
+ * 5. Декодирование сжатого файла (только по его заголовку, см. decompressFile)
+ * 6. Проверка корректности
+ *
+ * Исходный файл читается один раз - при сжатии: частоты для статистики
+ * считаются по уже прочитанным блокам. Корректность проверяется по
+ * контрольным суммам CRC-32, которые кодировщик считает для каждого блока
+ * при чтении: декодер сверяет с ними каждый восстановленный блок, поэтому
+ * восстановленный файл не перечитывается и не сравнивается с исходным
+ * побайтно, а без decoded_filename вообще не записывается на диск.
+ */
+int huffman_compress_decompress(const char* input_filename,
+                               const char* encoded_filename,
+                               const char* decoded_filename) {
+
+    printf("\n==============================================\n");
+    printf("Обработка файла: %s\n", input_filename);
+    printf("==============================================\n");
+
+    // Шаг 0: Проверяем исходный файл (только размер, данные читает сжатие)
+    FILE* input_file = fopen(input_filename, "rb");   // Открываем в бинарном режиме для чтения
+    if (input_file == NULL) {                         // Проверяем успешность открытия
+        fprintf(stderr, "Ошибка: не удалось открыть файл '%s'\n", input_filename);
+        return EXIT_FAILURE;                          // Возвращаем код ошибки
+    }
+    uint64_t input_size = getFileSize(input_file);
+    fclose(input_file);
+
+    printf("   Размер исходного файла: %llu байт\n", (unsigned long long)input_size);
+
+    // Проверяем, не пустой ли файл
+    if (input_size == 0) {
+        fprintf(stderr, "Ошибка: файл '%s' пустой\n", input_filename);
+        return EXIT_FAILURE;
+    }
+
+    clock_t start_time = clock();                     // Запоминаем время начала выполнения
+
+    // Шаг 1: Кодирование файла и подсчет частот символов за одно чтение
+    printf("[1/6] Кодирование исходного файла и подсчет частот символов...\n");
+    CompressOptions options = {DEFAULT_BLOCK_SIZE, cpuCount(), HUFFMAN_MODE_STATIC, DEFAULT_CODE_LENGTH_LIMIT, NULL, NULL, NULL, -1, 1};
+    CompressResult result;
+    if (compressFile(input_filename, encoded_filename, &options, &result) != EXIT_SUCCESS) {
+        return EXIT_FAILURE;
+    }
+    printf("   Закодированные данные сохранены в '%s'\n", encoded_filename);
+
+    // Шаг 2: Построение дерева Хаффмана
+    printf("[2/6] Построение дерева Хаффмана...\n");
+    Node* root = buildHuffmanTree(result.frequencies);
+    printf("   Дерево построено успешно\n");
+
+    // Шаг 3: Генерация кодов
+    printf("[3/6] Генерация кодов символов...\n");
+    Code codes[ASCII_SIZE];
+    generateCodes(root, codes);
+    huffmanCanonicalCodes(codes);                     // Канонические коды восстанавливаются по одним длинам
+    printf("   Коды сгенерированы успешно\n");
+
+    // Шаг 4: Количество битов при одной таблице на весь файл (для сравнения с блочным сжатием)
+    printf("[4/6] Сравнение с одной таблицей на весь файл...\n");
+    uint64_t bit_count = encodedBitCount(result.frequencies, codes);
+    Code limited[ASCII_SIZE];                         // Коды с ограничением длины
+    huffmanBuildCodes(result.frequencies, DEFAULT_CODE_LENGTH_LIMIT, limited);
+    uint64_t limited_bit_count = encodedBitCount(result.frequencies, limited);
+    printf("   Бит при одной таблице на весь файл: %llu (%.2f байт)\n",
+           (unsigned long long)bit_count, (double)bit_count / 8);
+    printf("   То же с кодами не длиннее %d бит: %llu (+%.3f%%)\n", DEFAULT_CODE_LENGTH_LIMIT,
+           (unsigned long long)limited_bit_count,
+           bit_count > 0 ? (double)(limited_bit_count - bit_count) / bit_count * 100 : 0.0);
+
+    // Шаг 5: Декодирование файла (таблицы строятся заново по заголовку сжатого файла)
+    printf("[5/6] Декодирование сжатого файла...\n");
+    int decoded = decompressFile(encoded_filename, decoded_filename, cpuCount(), NULL) == EXIT_SUCCESS;
+    if (decoded && decoded_filename != NULL) {
+        printf("   Декодированные данные сохранены в '%s'\n", decoded_filename);
+    }
+
+    // Шаг 6: Проверка корректности восстановления (по CRC-32 блоков, сверенным на шаге 5)
+    printf("[6/6] Проверка корректности восстановления...\n");
+    if (decoded) {
+        printf("   Восстановление успешно! Контрольные суммы всех блоков совпали.\n");
+    } else {
+        printf("   Ошибка! Восстановленные данные не совпадают с исходными.\n");
+        freeHuffmanTree(root);
+        return EXIT_FAILURE;
+    }
+
+    // Вывод статистики сжатия
+    printStatistics(input_filename, result.frequencies, codes, (long)result.original_size,
+                    (long)result.compressed_size);
+
+    // Замер времени выполнения
+    clock_t end_time = clock();
+    double elapsed_time = (double)(end_time - start_time) / CLOCKS_PER_SEC;
+    printf("\nВремя выполнения: %.3f секунд\n", elapsed_time);
+
+    // Освобождение памяти, выделенной для дерева Хаффмана
+    freeHuffmanTree(root);
+
+    printf("\n==============================================\n");
+    printf("Обработка завершена успешно!\n");
+    printf("==============================================\n");
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Функция wallClockSeconds - возвращает текущее время по настенным часам
+ * @return время в секундах
+ *
+ * В отличие от clock(), учитывает реальное прошедшее время, а не процессорное,
+ * поэтому подходит для расчета пропускной способности (МБ/с).
+ */
+double wallClockSeconds(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+#if USE_PERF_COUNTERS
+// Счетчики perf_event_open считают только открывший их поток, поэтому у каждого потока свои
+static _Thread_local int profile_fds[PROFILE_COUNTERS];
+static _Thread_local int profile_fds_state;  // 0 - не открывались, 1 - открыты, -1 - недоступны
+
+/**
+ * Функция openProfileCounters - открывает аппаратные счетчики текущего потока
+ * @return 1 если все счетчики открыты, иначе 0
+ *
+ * Считаются только инструкции пользовательского режима (exclude_kernel),
+ * что разрешено и при kernel.perf_event_paranoid = 2. Время в ядре
+ * (чтение и запись файлов) видно по таймерам стадий.
+ */
+static int openProfileCounters(void) {
+    static const uint64_t events[PROFILE_COUNTERS] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_HW_CACHE_MISSES
+    };
+    for (int i = 0; i < PROFILE_COUNTERS; i++) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = events[i];
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        profile_fds[i] = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+        if (profile_fds[i] < 0) {
+            while (--i >= 0) {
+                close(profile_fds[i]);
+            }
+            profile_fds_state = -1;
+            return 0;
+        }
+    }
+    profile_fds_state = 1;
+    return 1;
+}
+#endif
+
+/**
+ * Функция readProfileCounters - читает аппаратные счетчики текущего потока
+ * @param values - массив на PROFILE_COUNTERS значений (нули, если счетчики недоступны)
+ */
+static void readProfileCounters(unsigned long long values[]) {
+    memset(values, 0, PROFILE_COUNTERS * sizeof(unsigned long long));
+#if USE_PERF_COUNTERS
+    if (!profile.counters_ok || (profile_fds_state == 0 && !openProfileCounters()) ||
+        profile_fds_state < 0) {
+        return;
+    }
+    for (int i = 0; i < PROFILE_COUNTERS; i++) {
+        if (read(profile_fds[i], &values[i], sizeof(values[i])) != (ssize_t)sizeof(values[i])) {
+            values[i] = 0;
+        }
+    }
+#endif
+}
+
+/**
+ * Функция profileThreadExit - закрывает аппаратные счетчики завершающегося потока
+ */
+void profileThreadExit(void) {
+#if USE_PERF_COUNTERS
+    if (profile_fds_state == 1) {
+        for (int i = 0; i < PROFILE_COUNTERS; i++) {
+            close(profile_fds[i]);
+        }
+    }
+    profile_fds_state = 0;
+#endif
+}
+
+/**
+ * Функция profileStart - включает замеры по стадиям
+ *
+ * Вызывается до создания рабочих потоков. Если аппаратные счетчики
+ * недоступны (не Linux, нет прав или виртуальная машина без PMU),
+ * замеряются только время и объемы данных. Стадии внутри библиотеки
+ * (частоты, коды, кодирование, декодирование, CRC-32) сообщаются через
+ * huffmanSetProfiler.
+ */
+void profileStart(void) {
+    static const HuffmanProfiler handlers = {profileBegin, profileEnd};
+    memset(profile.stages, 0, sizeof(profile.stages));
+    mutexInit(&profile.mutex);
+#if USE_PERF_COUNTERS
+    profile.counters_ok = openProfileCounters();
+#else
+    profile.counters_ok = 0;
+#endif
+    profile.start = wallClockSeconds();
+    profile.enabled = 1;
+    huffmanSetProfiler(&handlers);
+}
+
+/**
+ * Функция profileBegin - запоминает показания в начале участка
+ * @param sample - куда записать показания
+ */
+void profileBegin(ProfileSample* sample) {
+    readProfileCounters(sample->counters);
+    sample->start = wallClockSeconds();              // Таймер - последним, чтобы не считать чтение счетчиков
+}
+
+/**
+ * Функция profileEnd - добавляет участок к стадии
+ * @param stage - стадия PROFILE_*
+ * @param sample - показания, снятые profileBegin в этом же потоке
+ * @param bytes_in - сколько байт стадия получила на участке
+ * @param bytes_out - сколько байт стадия выдала на участке
+ */
+void profileEnd(int stage, const ProfileSample* sample, unsigned long long bytes_in,
+                unsigned long long bytes_out) {
+    double elapsed = wallClockSeconds() - sample->start;
+    unsigned long long counters[PROFILE_COUNTERS];
+    readProfileCounters(counters);
+
+    mutexLock(&profile.mutex);
+    ProfileStage* target = &profile.stages[stage];
+    target->calls++;
+    target->seconds += elapsed;
+    target->bytes_in += bytes_in;
+    target->bytes_out += bytes_out;
+    for (int i = 0; i < PROFILE_COUNTERS; i++) {
+        target->counters[i] += counters[i] - sample->counters[i];
+    }
+    mutexUnlock(&profile.mutex);
+}
+
+/**
+ * Функция profileRequest - добавляет к стадии завершенный асинхронный запрос
+ * @param stage - стадия PROFILE_*
+ * @param issued - время отправки запроса (PROFILE_ISSUE)
+ * @param bytes_in - сколько байт стадия получила
+ * @param bytes_out - сколько байт стадия выдала
+ *
+ * Запрос выполняет ядро, пока поток занят другим, поэтому время - это
+ * задержка от отправки до завершения, а аппаратные счетчики потока
+ * к стадии не добавляются.
+ */
+void profileRequest(int stage, double issued, uint64_t bytes_in, uint64_t bytes_out) {
+    double elapsed = wallClockSeconds() - issued;
+    mutexLock(&profile.mutex);
+    ProfileStage* target = &profile.stages[stage];
+    target->calls++;
+    target->seconds += elapsed;
+    target->bytes_in += bytes_in;
+    target->bytes_out += bytes_out;
+    mutexUnlock(&profile.mutex);
+}
+
+/**
+ * Функция writeJsonString - записывает строку в кавычках JSON
+ * @param file - файл
+ * @param text - строка (кавычки, обратная косая черта и управляющие символы экранируются;
+ *               NULL записывается как null)
+ */
+static void writeJsonString(FILE* file, const char* text) {
+    if (text == NULL) {
+        fputs("null", file);
+        return;
+    }
+    fputc('"', file);
+    for (const unsigned char* p = (const unsigned char*)text; *p != '\0'; p++) {
+        if (*p == '"' || *p == '\\') {
+            fprintf(file, "\\%c", *p);
+        } else if (*p < 0x20) {
+            fprintf(file, "\\u%04x", *p);
+        } else {
+            fputc(*p, file);
+        }
+    }
+    fputc('"', file);
+}
+
+/**
+ * Функция profileFinish - выключает замеры и записывает отчет в JSON
+ * @param filename - файл отчета
+ * @param command - команда (compress или decompress)
+ * @param input - входной файл команды
+ * @param output - выходной файл команды
+ * @param status - результат команды (EXIT_SUCCESS или EXIT_FAILURE)
+ * @return 1 при успехе, 0 если отчет не удалось записать
+ *
+ * Для каждой стадии выводятся количество участков, суммарное время
+ * (в многопоточном режиме - сумма по потокам, поэтому оно может превышать
+ * общее время wall_seconds), объемы данных, МБ/с по большему из объемов
+ * и, если доступны, приращения аппаратных счетчиков (иначе null).
+ */
+int profileFinish(const char* filename, const char* command, const char* input,
+                  const char* output, int status) {
+    static const char* const stage_names[PROFILE_STAGE_COUNT] = {
+        "read", "count", "build", "encode", "decode", "check", "write"
+    };
+    static const char* const counter_names[PROFILE_COUNTERS] = {
+        "cycles", "instructions", "branch_misses", "cache_misses"
+    };
+    double wall_seconds = wallClockSeconds() - profile.start;
+    profile.enabled = 0;
+    profileThreadExit();
+    mutexDestroy(&profile.mutex);
+
+    FILE* file = fopen(filename, "w");
+    if (file == NULL) {
+        fprintf(stderr, "Ошибка: не удалось создать файл отчета '%s'\n", filename);
+        return 0;
+    }
+    fprintf(file, "{\n  \"command\": \"%s\",\n  \"input\": ", command);
+    writeJsonString(file, input);
+    fprintf(file, ",\n  \"output\": ");
+    writeJsonString(file, output);
+    fprintf(file, ",\n  \"status\": \"%s\",\n  \"wall_seconds\": %.6f,\n"
+            "  \"hardware_counters\": %s,\n  \"stages\": [\n",
+            status == EXIT_SUCCESS ? "ok" : "error", wall_seconds,
+            profile.counters_ok ? "true" : "false");
+    for (int s = 0; s < PROFILE_STAGE_COUNT; s++) {
+        const ProfileStage* stage = &profile.stages[s];
+        uint64_t bytes = stage->bytes_in > stage->bytes_out ? stage->bytes_in : stage->bytes_out;
+        fprintf(file, "    {\"stage\": \"%s\", \"calls\": %llu, \"seconds\": %.6f, "
+                "\"bytes_in\": %llu, \"bytes_out\": %llu, \"mb_s\": %.2f",
+                stage_names[s], (unsigned long long)stage->calls, stage->seconds,
+                (unsigned long long)stage->bytes_in, (unsigned long long)stage->bytes_out,
+                stage->seconds > 0 ? (double)bytes / (1024.0 * 1024.0) / stage->seconds : 0.0);
+        for (int i = 0; i < PROFILE_COUNTERS; i++) {
+            if (profile.counters_ok) {
+                fprintf(file, ", \"%s\": %llu", counter_names[i], (unsigned long long)stage->counters[i]);
+            } else {
+                fprintf(file, ", \"%s\": null", counter_names[i]);
+            }
+        }
+        fprintf(file, "}%s\n", s + 1 < PROFILE_STAGE_COUNT ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+
+    if (fclose(file) != 0) {
+        fprintf(stderr, "Ошибка записи файла отчета '%s'\n", filename);
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * Функция runBenchmark - замеряет скорость кодирования и декодирования файла
+ * @param input_filename - путь к файлу, на котором выполняется замер
+ * @return EXIT_SUCCESS при успехе, EXIT_FAILURE при ошибке
+ *
+ * Кодирует файл в памяти (huffmanEncodeBits) и во временный
+ * results/bench_encoded.bin для эталонного декодера, проверяет, что оба
+ * декодера восстанавливают исходные данные, затем BENCH_RUNS раз выполняет
+ * каждый замер и выводит лучший результат в МБ/с:
+ * - memcpy всего файла в памяти (ориентир - предельная скорость)
+ * - кодирование файла в памяти
+ * - декодирование табличным (huffmanDecodeBits) и эталонным (по дереву) декодерами
+ * - подсчет частот: побайтно, с подгистограммами и несколькими потоками (ГБ/с)
+ */
+int runBenchmark(const char* input_filename) {
+    const char* encoded_filename = "results/bench_encoded.bin";
+    const char* checked_filename = "results/bench_decoded.txt";
+
+    FILE* input_file = fopen(input_filename, "rb");
+    if (input_file == NULL) {
+        fprintf(stderr, "Ошибка: не удалось открыть файл '%s'\n", input_filename);
+        return EXIT_FAILURE;
+    }
+
+    unsigned int frequencies[ASCII_SIZE];
+    countFrequencies(input_file, frequencies);
+    fseek(input_file, 0, SEEK_END);
+    long original_size = ftell(input_file);
+    if (original_size == 0) {
+        fprintf(stderr, "Ошибка: файл '%s' пустой\n", input_filename);
+        fclose(input_file);
+        return EXIT_FAILURE;
+    }
+
+    // Копия файла в памяти для замера memcpy
+    unsigned char* source = (unsigned char*)malloc(original_size);
+    unsigned char* target = (unsigned char*)malloc(original_size);
+    if (source == NULL || target == NULL) {
+        fprintf(stderr, "Ошибка выделения памяти для бенчмарка\n");
+        exit(EXIT_FAILURE);
+    }
+    rewind(input_file);
+    if (fread(source, 1, original_size, input_file) != (size_t)original_size) {
+        fprintf(stderr, "Ошибка чтения файла '%s'\n", input_filename);
+        free(source);
+        free(target);
+        fclose(input_file);
+        return EXIT_FAILURE;
+    }
+
+    Node* root = buildHuffmanTree(frequencies);
+    Code codes[ASCII_SIZE];
+    generateCodes(root, codes);
+    int max_length = 0;                              // Наибольшая длина кода дерева
+    for (int i = 0; i < ASCII_SIZE; i++) {
+        if (codes[i].length > max_length) {
+            max_length = codes[i].length;
+        }
+    }
+    HuffmanDecodeTable* table = huffmanCreateDecodeTable(codes);
+    size_t encoded_capacity = huffmanEncodeBound(codes, original_size);
+    unsigned char* encoded = (unsigned char*)malloc(encoded_capacity);
+    if (encoded == NULL) {
+        fprintf(stderr, "Ошибка выделения памяти для бенчмарка\n");
+        exit(EXIT_FAILURE);
+    }
+    if (table == NULL) {
+        fprintf(stderr, "Ошибка: код длиннее %d бит, табличный декодер неприменим\n", DECODE_MAX_CODE_LENGTH);
+        fclose(input_file);
+        free(encoded);
+        free(source);
+        free(target);
+        freeHuffmanTree(root);
+        return EXIT_FAILURE;
+    }
+
+    _mkdir("results");
+    FILE* encoded_file = fopen(encoded_filename, "w+b");
+    FILE* checked_file = fopen(checked_filename, "w+b");
+    FILE* null_file = fopen(NULL_DEVICE, "wb");
+    if (encoded_file == NULL || checked_file == NULL || null_file == NULL) {
+        fprintf(stderr, "Ошибка при открытии файлов для бенчмарка\n");
+        if (encoded_file) fclose(encoded_file);
+        if (checked_file) fclose(checked_file);
+        if (null_file) fclose(null_file);
+        fclose(input_file);
+        free(encoded);
+        free(source);
+        free(target);
+        huffmanFreeDecodeTable(table);
+        freeHuffmanTree(root);
+        return EXIT_FAILURE;
+    }
+
+    unsigned long long bit_count = 0;
+    huffmanEncodeBits(codes, source, original_size, encoded, encoded_capacity, &bit_count);
+    size_t encoded_size = (size_t)((bit_count + BYTE_SIZE - 1) / BYTE_SIZE);
+    fwrite(encoded, 1, encoded_size, encoded_file);   // Эталонный декодер читает поток из файла
+    fflush(encoded_file);
+
+    printf("\n=== БЕНЧМАРК ===\n");
+    printf("Файл: %s (%ld байт), максимальная длина кода: %d бит\n",
+           input_filename, original_size, max_length);
+
+    // Проверка корректности обоих декодеров перед замерами
+    rewind(encoded_file);
+    decodeFileTree(encoded_file, checked_file, root, bit_count);
+    fflush(checked_file);
+    int tree_ok = compareFiles(input_file, checked_file);
+    int table_ok = huffmanDecodeBits(table, encoded, encoded_size, bit_count, target, original_size) == HUFFMAN_OK &&
+                   memcmp(target, source, original_size) == 0;
+    printf("Проверка: дерево - %s, таблица - %s\n",
+           tree_ok ? "OK" : "ОШИБКА", table_ok ? "OK" : "ОШИБКА");
+
+    // Замеры: берем лучшее из BENCH_RUNS повторов, чтобы отсечь случайные помехи
+    double best_copy = 0, best_encode = 0, best_tree = 0, best_table = 0;
+    double best_hist_simple = 0, best_hist_lanes = 0, best_hist_threads = 0;
+    unsigned int check_frequencies[ASCII_SIZE];
+    int histogram_ok = 1;
+    int threads = cpuCount();
+    unsigned long long encoded_bits = 0;
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        double start = wallClockSeconds();
+        memcpy(target, source, original_size);
+        double elapsed = wallClockSeconds() - start;
+        if (run == 0 || elapsed < best_copy) best_copy = elapsed;
+
+        start = wallClockSeconds();
+        huffmanEncodeBits(codes, source, original_size, encoded, encoded_capacity, &encoded_bits);
+        elapsed = wallClockSeconds() - start;
+        if (run == 0 || elapsed < best_encode) best_encode = elapsed;
+
+        rewind(encoded_file);
+        start = wallClockSeconds();
+        decodeFileTree(encoded_file, null_file, root, bit_count);
+        elapsed = wallClockSeconds() - start;
+        if (run == 0 || elapsed < best_tree) best_tree = elapsed;
+
+        start = wallClockSeconds();
+        huffmanDecodeBits(table, encoded, encoded_size, bit_count, target, original_size);
+        elapsed = wallClockSeconds() - start;
+        if (run == 0 || elapsed < best_table) best_table = elapsed;
+
+        // Подсчет частот: прежний побайтный цикл с одним массивом счетчиков
+        start = wallClockSeconds();
+        memset(check_frequencies, 0, sizeof(check_frequencies));
+        for (long i = 0; i < original_size; i++) {
+            check_frequencies[source[i]]++;
+        }
+        elapsed = wallClockSeconds() - start;
+        if (run == 0 || elapsed < best_hist_simple) best_hist_simple = elapsed;
+        histogram_ok &= memcmp(check_frequencies, frequencies, sizeof(check_frequencies)) == 0;
+
+        start = wallClockSeconds();
+        huffmanCountFrequencies(source, original_size, check_frequencies);
+        elapsed = wallClockSeconds() - start;
+        if (run == 0 || elapsed < best_hist_lanes) best_hist_lanes = elapsed;
+        histogram_ok &= memcmp(check_frequencies, frequencies, sizeof(check_frequencies)) == 0;
+
+        start = wallClockSeconds();
+        countFrequenciesParallel(source, original_size, check_frequencies, threads);
+        elapsed = wallClockSeconds() - start;
+        if (run == 0 || elapsed < best_hist_threads) best_hist_threads = elapsed;
+        histogram_ok &= memcmp(check_frequencies, frequencies, sizeof(check_frequencies)) == 0;
+    }
+
+    double megabytes = (double)original_size / (1024.0 * 1024.0);
+    printf("%-32s %10.3f мс %10.2f МБ/с\n", "memcpy (ориентир):",
+           best_copy * 1000, best_copy > 0 ? megabytes / best_copy : 0);
+    printf("%-32s %10.3f мс %10.2f МБ/с\n", "Кодирование (64-бит аккумулятор):",
+           best_encode * 1000, best_encode > 0 ? megabytes / best_encode : 0);
+    printf("%-32s %10.3f мс %10.2f МБ/с\n", "Декодирование: дерево (эталон):",
+           best_tree * 1000, best_tree > 0 ? megabytes / best_tree : 0);
+    printf("%-32s %10.3f мс %10.2f МБ/с\n", "Декодирование: таблица:",
+           best_table * 1000, best_table > 0 ? megabytes / best_table : 0);
+    if (best_table > 0) {
+        printf("Ускорение табличного декодера: %.2fx\n", best_tree / best_table);
+    }
+    if (best_copy > 0) {
+        printf("Кодирование медленнее memcpy в %.1f раз\n", best_encode / best_copy);
+    }
+
+    double gigabytes = (double)original_size / (1024.0 * 1024.0 * 1024.0);
+    printf("%-32s %10.3f мс %10.2f ГБ/с\n", "Частоты: побайтно:",
+           best_hist_simple * 1000, best_hist_simple > 0 ? gigabytes / best_hist_simple : 0);
+    printf("%-32s %10.3f мс %10.2f ГБ/с\n", "Частоты: 4 подгистограммы:",
+           best_hist_lanes * 1000, best_hist_lanes > 0 ? gigabytes / best_hist_lanes : 0);
+    printf("Частоты: потоков %-15d %10.3f мс %10.2f ГБ/с\n", threads,
+           best_hist_threads * 1000, best_hist_threads > 0 ? gigabytes / best_hist_threads : 0);
+    printf("Проверка частот: %s\n", histogram_ok ? "OK" : "ОШИБКА");
+
+    // Режимы блоков: двухпроходный со своей таблицей и однопроходный адаптивный
+    size_t block_count = ((size_t)original_size + DEFAULT_BLOCK_SIZE - 1) / DEFAULT_BLOCK_SIZE;
+    EncodedBlock* blocks = (EncodedBlock*)calloc(block_count, sizeof(EncodedBlock));
+    if (blocks == NULL) {
+        fprintf(stderr, "Ошибка выделения памяти для бенчмарка\n");
+        exit(EXIT_FAILURE);
+    }
+    // Статический режим сравнивается и с INTERLEAVED_STREAMS потоками в блоке
+    const char* mode_names[] = {"статический (2 прохода):", "адаптивный (1 проход):", "order-1 (контексты):",
+                                "статический, 4 потока:", "UTF-8 (кодовые точки):"};
+    const int bench_modes[] = {HUFFMAN_MODE_STATIC, HUFFMAN_MODE_ADAPTIVE, HUFFMAN_MODE_ORDER1,
+                               HUFFMAN_MODE_STATIC, HUFFMAN_MODE_UTF8};
+    const int bench_streams[] = {1, 1, 1, INTERLEAVED_STREAMS, 1};
+    CompressOptions block_options = {DEFAULT_BLOCK_SIZE, 1, HUFFMAN_MODE_STATIC, DEFAULT_CODE_LENGTH_LIMIT, NULL, NULL, NULL, -1, 1};
+    int modes_ok = 1;
+    printf("%-32s %14s %14s %16s\n", "Режим блоков по 1 MiB:", "сжатие", "восстановление", "размер");
+    for (int mode = 0; mode < (int)(sizeof(bench_modes) / sizeof(bench_modes[0])); mode++) {  // Словарному режиму нужен словарь
+        double best_block_encode = 0, best_block_decode = 0;
+        block_options.mode = bench_modes[mode];
+        block_options.streams = bench_streams[mode];
+        HuffmanContext* context = createContext(&block_options, NULL);  // Буферы режима - на все повторы
+        for (int run = 0; run < BENCH_RUNS; run++) {
+            double start = wallClockSeconds();
+            for (size_t b = 0; b < block_count; b++) {
+                size_t offset = b * DEFAULT_BLOCK_SIZE;
+                size_t size = (size_t)original_size - offset < DEFAULT_BLOCK_SIZE ?
+                              (size_t)original_size - offset : DEFAULT_BLOCK_SIZE;
+                modes_ok &= encodeBlock(context, source + offset, size, (uint32_t)b, &blocks[b]);
+            }
+            double elapsed = wallClockSeconds() - start;
+            if (run == 0 || elapsed < best_block_encode) best_block_encode = elapsed;
+
+            memset(target, 0, original_size);
+            start = wallClockSeconds();
+            for (size_t b = 0; b < block_count; b++) {
+                size_t offset = b * DEFAULT_BLOCK_SIZE;
+                size_t size = (size_t)original_size - offset < DEFAULT_BLOCK_SIZE ?
+                              (size_t)original_size - offset : DEFAULT_BLOCK_SIZE;
+                modes_ok &= huffmanDecompressBlock(context, blocks[b].data, blocks[b].size, (unsigned)b,
+                                                   target + offset, size) == HUFFMAN_OK;
+            }
+            elapsed = wallClockSeconds() - start;
+            if (run == 0 || elapsed < best_block_decode) best_block_decode = elapsed;
+            modes_ok &= memcmp(target, source, original_size) == 0;
+        }
+        huffmanFreeContext(context);
+
+        uint64_t mode_size = 0;
+        for (size_t b = 0; b < block_count; b++) {
+            mode_size += blocks[b].size;
+        }
+        printf("%-32s %9.2f МБ/с %9.2f МБ/с %10llu байт (%.2f%%)\n", mode_names[mode],
+               best_block_encode > 0 ? megabytes / best_block_encode : 0,
+               best_block_decode > 0 ? megabytes / best_block_decode : 0,
+               (unsigned long long)mode_size, (double)mode_size / original_size * 100);
+    }
+    printf("Проверка режимов блоков: %s\n", modes_ok ? "OK" : "ОШИБКА");
+
+    // Цена ограничения длины кода относительно обычного дерева Хаффмана (одна таблица на файл)
+    uint64_t unlimited_bits = encodedBitCount(frequencies, codes);
+    const int limits[] = {11, 12, 15};
+    printf("Без ограничения длины кода: %llu бит, наибольшая длина %d\n",
+           (unsigned long long)unlimited_bits, max_length);
+    for (size_t k = 0; k < sizeof(limits) / sizeof(limits[0]); k++) {
+        Code limited[ASCII_SIZE];
+        huffmanBuildCodes(frequencies, limits[k], limited);
+        uint64_t limited_bits = encodedBitCount(frequencies, limited);
+        printf("Коды не длиннее %2d бит:     %llu бит (+%.3f%%)\n", limits[k],
+               (unsigned long long)limited_bits,
+               (double)(limited_bits - unlimited_bits) / unlimited_bits * 100);
+    }
+
+    // Перестроение кодов: дерево из узлов в куче против плоской арены
+    const int rebuilds = 10000;
+    Code rebuilt[ASCII_SIZE];
+    double start = wallClockSeconds();
+    for (int k = 0; k < rebuilds; k++) {
+        Node* rebuilt_root = buildHuffmanTree(frequencies);
+        generateCodes(rebuilt_root, rebuilt);
+        freeHuffmanTree(rebuilt_root);
+    }
+    double heap_build = (wallClockSeconds() - start) / rebuilds;
+    start = wallClockSeconds();
+    for (int k = 0; k < rebuilds; k++) {
+        huffmanBuildCodes(frequencies, 0, rebuilt);
+    }
+    double arena_build = (wallClockSeconds() - start) / rebuilds;
+    int rebuild_ok = encodedBitCount(frequencies, rebuilt) == unlimited_bits;
+    printf("Построение кодов: узлы в куче %.2f мкс, арена %.2f мкс (%.1fx), проверка: %s\n",
+           heap_build * 1e6, arena_build * 1e6, arena_build > 0 ? heap_build / arena_build : 0,
+           rebuild_ok ? "OK" : "ОШИБКА");
+    for (size_t b = 0; b < block_count; b++) {
+        free(blocks[b].data);
+    }
+    free(blocks);
+
+    fclose(null_file);
+    fclose(checked_file);
+    fclose(encoded_file);
+    fclose(input_file);
+    remove(checked_filename);
+    remove(encoded_filename);
+    free(encoded);
+    free(source);
+    free(target);
+    huffmanFreeDecodeTable(table);
+    freeHuffmanTree(root);
+
+    return (tree_ok && table_ok && histogram_ok && modes_ok && rebuild_ok) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+#ifdef HUFFMAN_BENCH_SUITE
+// ---------- Набор замеров (собирается только в цель huffman_bench) ----------
+
+static const char* const corpus_names[CORPUS_COUNT] = {"uniform", "skewed", "text", "binary"};
+
+/**
+ * Функция suiteRandom - следующее число генератора xorshift64*
+ * @param state - состояние генератора (не ноль)
+ * @return 64 псевдослучайных бита
+ *
+ * Генератор задан явно, а не через rand(), чтобы корпус с одним и тем же
+ * начальным значением совпадал на всех платформах.
+ */
+static uint64_t suiteRandom(uint64_t* state) {
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+/**
+ * Функция generateCorpus - заполняет буфер синтетическими данными
+ * @param kind - вид корпуса CORPUS_*
+ * @param data - буфер
+ * @param size - размер буфера
+ * @param seed - начальное значение генератора
+ *
+ * Виды корпуса:
+ * - uniform: равномерно случайные байты, сжатию не поддаются
+ * - skewed: каждый бит байта равен 1 с вероятностью 1/8 (И трех случайных
+ *   байтов), энтропия около 4.3 бита на байт
+ * - text: слова из словаря SUITE_VOCABULARY с частыми короткими словами,
+ *   буквы - с частотами, убывающими по алфавиту "etaoin...", пробелы,
+ *   знаки препинания и переводы строк
+ * - binary: записи по SUITE_RECORD_SIZE байт: растущий счетчик, значение
+ *   с небольшими приращениями, тип из четырех значений и нулевое заполнение
+ */
+static void generateCorpus(int kind, unsigned char* data, size_t size, uint64_t seed) {
+    uint64_t state = (seed ^ ((uint64_t)(kind + 1) * 0x9E3779B97F4A7C15ULL)) | 1;
+    size_t i = 0;
+
+    if (kind == CORPUS_UNIFORM) {
+        for (; i < size; i++) {
+            data[i] = (unsigned char)(suiteRandom(&state) >> 56);
+        }
+    } else if (kind == CORPUS_SKEWED) {
+        for (; i < size; i++) {
+            uint64_t r = suiteRandom(&state);
+            data[i] = (unsigned char)(r & (r >> 8) & (r >> 16));
+        }
+    } else if (kind == CORPUS_TEXT) {
+        static const char letters[] = "etaoinshrdlcumwfgypbvkjxqz";
+        char words[SUITE_VOCABULARY][12];
+        for (int w = 0; w < SUITE_VOCABULARY; w++) {
+            int length = 1 + (int)(suiteRandom(&state) % 10);
+            for (int k = 0; k < length; k++) {
+                uint64_t r = suiteRandom(&state);
+                unsigned a = (unsigned)(r % 26), b = (unsigned)((r >> 32) % 26);
+                words[w][k] = letters[a < b ? a : b];    // Меньший из двух - частые буквы чаще
+            }
+            words[w][length] = '\0';
+        }
+        size_t line = 0;                             // Длина текущей строки
+        while (i < size) {
+            uint64_t r = suiteRandom(&state);
+            // Произведение двух равномерных номеров: короткие номера (частые слова) вероятнее
+            const char* word = words[(r % SUITE_VOCABULARY) * ((r >> 16) % SUITE_VOCABULARY) / SUITE_VOCABULARY];
+            for (const char* p = word; *p != '\0' && i < size; p++, line++) {
+                data[i++] = (unsigned char)*p;
+            }
+            unsigned punctuation = (unsigned)((r >> 40) % 16);
+            if (punctuation == 0 && i < size) data[i++] = '.';
+            else if (punctuation == 1 && i < size) data[i++] = ',';
+            if (i < size) {
+                data[i++] = line > 60 ? '\n' : ' ';
+                line = line > 60 ? 0 : line + 1;
+            }
+        }
+    } else {
+        unsigned char record[SUITE_RECORD_SIZE];
+        uint32_t counter = 0, value = 1u << 20;
+        while (i < size) {
+            uint64_t r = suiteRandom(&state);
+            counter += 1 + (uint32_t)(r & 3);
+            value += (uint32_t)((r >> 8) & 0xFF) - 128;
+            memset(record, 0, sizeof(record));
+            storeLittleEndian(record, counter, 4);
+            storeLittleEndian(record + 4, value, 4);
+            record[8] = (unsigned char)(1 << ((r >> 16) & 3));
+            record[9] = (unsigned char)((r >> 24) % 61 == 0);  // Редкий флаг
+            size_t chunk = size - i < SUITE_RECORD_SIZE ? size - i : SUITE_RECORD_SIZE;
+            memcpy(data + i, record, chunk);
+            i += chunk;
+        }
+    }
+}
+
+/**
+ * Функция compareSeconds - сравнение времен для qsort
+ */
+static int compareSeconds(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Функция reportStage - выводит одну строку отчета о стадии
+ * @param report - файл отчета
+ * @param options - параметры набора (формат, количество повторов)
+ * @param first - 1 для первой строки JSON (без запятой перед ней); сбрасывается
+ * @param corpus - вид корпуса
+ * @param size - размер корпуса
+ * @param stage - название стадии
+ * @param times - времена учитываемых повторов в секундах (сортируются)
+ * @param bits_per_byte - средняя длина кода на корпусе
+ */
+static void reportStage(FILE* report, const SuiteOptions* options, int* first, int corpus,
+                        uint64_t size, const char* stage, double times[], double bits_per_byte) {
+    int runs = options->runs;
+    qsort(times, runs, sizeof(double), compareSeconds);
+    double best = times[0];
+    double median = runs % 2 ? times[runs / 2] : (times[runs / 2 - 1] + times[runs / 2]) / 2;
+    double megabytes = (double)size / (1024.0 * 1024.0);
+
+    if (options->json) {
+        fprintf(report, "%s    {\"corpus\": \"%s\", \"size\": %llu, \"stage\": \"%s\", \"runs\": %d, "
+                "\"best_seconds\": %.9f, \"median_seconds\": %.9f, \"best_mb_s\": %.2f, "
+                "\"median_mb_s\": %.2f, \"bits_per_byte\": %.4f}",
+                *first ? "" : ",\n", corpus_names[corpus], (unsigned long long)size, stage, runs,
+                best, median, best > 0 ? megabytes / best : 0, median > 0 ? megabytes / median : 0,
+                bits_per_byte);
+    } else {
+        fprintf(report, "%s,%llu,%s,%d,%.9f,%.9f,%.2f,%.2f,%.4f\n", corpus_names[corpus],
+                (unsigned long long)size, stage, runs, best, median,
+                best > 0 ? megabytes / best : 0, median > 0 ? megabytes / median : 0, bits_per_byte);
+    }
+    *first = 0;
+}
+
+/**
+ * Функция benchmarkCorpus - замеряет стадии сжатия на одном корпусе
+ * @param kind - вид корпуса CORPUS_*
+ * @param size - размер корпуса
+ * @param options - параметры набора
+ * @param report - файл отчета
+ * @param first - признак первой строки JSON (см. reportStage)
+ * @return 1 если каждый повтор восстановил исходные данные, иначе 0
+ *
+ * Стадии замеряются по отдельности по настенным часам на данных в памяти
+ * (без файлового ввода-вывода), одна таблица кодов на весь корпус:
+ * - count: подсчет частот (huffmanCountFrequencies)
+ * - build: длины кодов (ограничение DEFAULT_CODE_LENGTH_LIMIT) и канонические
+ *   коды; время одного построения - среднее по SUITE_BUILD_REPEATS
+ * - encode: кодирование всего корпуса в буфер (huffmanEncodeBits)
+ * - decode: таблица декодирования и декодирование всего потока (huffmanDecodeBits)
+ * Сначала выполняются options->warmup разогревочных повторов, затем
+ * options->runs учитываемых; в отчет идут лучшее и медианное время.
+ */
+static int benchmarkCorpus(int kind, uint64_t size, const SuiteOptions* options, FILE* report, int* first) {
+    unsigned char* data = (unsigned char*)malloc(size);
+    unsigned char* decoded = (unsigned char*)malloc(size);
+    if (data == NULL || decoded == NULL) {
+        fprintf(stderr, "Ошибка выделения памяти для корпуса %s (%llu байт)\n",
+                corpus_names[kind], (unsigned long long)size);
+        exit(EXIT_FAILURE);
+    }
+    generateCorpus(kind, data, size, options->seed);
+
+    if (options->save_dir != NULL) {
+        char path[1024];
+        _mkdir(options->save_dir);
+        snprintf(path, sizeof(path), "%s/%s-%llu.bin", options->save_dir, corpus_names[kind],
+                 (unsigned long long)size);
+        FILE* file = fopen(path, "wb");
+        if (file == NULL || fwrite(data, 1, size, file) != size) {
+            fprintf(stderr, "Ошибка: не удалось сохранить корпус '%s'\n", path);
+        }
+        if (file != NULL) {
+            fclose(file);
+        }
+    }
+
+    double times[4][SUITE_MAX_RUNS];                 // count, build, encode, decode
+    unsigned int frequencies[ASCII_SIZE];
+    Code codes[ASCII_SIZE];
+    unsigned long long bit_count = 0;
+    int ok = 1;
+
+    // Буфер потока - по кодам корпуса, чтобы выделение не попало в замеры
+    huffmanCountFrequencies(data, size, frequencies);
+    huffmanBuildCodes(frequencies, DEFAULT_CODE_LENGTH_LIMIT, codes);
+    size_t encoded_capacity = huffmanEncodeBound(codes, size);
+    unsigned char* encoded = (unsigned char*)malloc(encoded_capacity);
+    if (encoded == NULL) {
+        fprintf(stderr, "Ошибка выделения памяти для корпуса %s (%llu байт)\n",
+                corpus_names[kind], (unsigned long long)size);
+        exit(EXIT_FAILURE);
+    }
+
+    for (int run = 0; run < options->warmup + options->runs; run++) {
+        double start = wallClockSeconds();
+        huffmanCountFrequencies(data, size, frequencies);
+        double counted = wallClockSeconds();
+
+        for (int k = 0; k < SUITE_BUILD_REPEATS; k++) {
+            huffmanBuildCodes(frequencies, DEFAULT_CODE_LENGTH_LIMIT, codes);
+        }
+        double built = wallClockSeconds();
+
+        ok &= huffmanEncodeBits(codes, data, size, encoded, encoded_capacity, &bit_count) == HUFFMAN_OK;
+        double encoded_at = wallClockSeconds();
+
+        HuffmanDecodeTable* table = huffmanCreateDecodeTable(codes);
+        ok &= table != NULL &&
+              huffmanDecodeBits(table, encoded, (size_t)((bit_count + BYTE_SIZE - 1) / BYTE_SIZE), bit_count,
+                                decoded, size) == HUFFMAN_OK;
+        huffmanFreeDecodeTable(table);
+        double decoded_at = wallClockSeconds();
+
+        ok &= memcmp(decoded, data, size) == 0;
+        if (run >= options->warmup) {
+            int index = run - options->warmup;
+            times[0][index] = counted - start;
+            times[1][index] = (built - counted) / SUITE_BUILD_REPEATS;
+            times[2][index] = encoded_at - built;
+            times[3][index] = decoded_at - encoded_at;
+        }
+    }
+
+    const char* stages[4] = {"count", "build", "encode", "decode"};
+    for (int stage = 0; stage < 4; stage++) {
+        reportStage(report, options, first, kind, size, stages[stage], times[stage],
+                    (double)bit_count / size);
+    }
+    if (!ok) {
+        fprintf(stderr, "Ошибка: корпус %s (%llu байт) восстановлен неверно\n",
+                corpus_names[kind], (unsigned long long)size);
+    }
+
+    free(data);
+    free(decoded);
+    free(encoded);
+    return ok;
+}
+
+/**
+ * Функция parseSuiteOptions - разбирает параметры набора замеров
+ * @param argc - количество аргументов
+ * @param argv - аргументы
+ * @param options - параметры (заполняются значениями по умолчанию и из аргументов)
+ * @return 1 при успехе, 0 при ошибке в параметрах
+ *
+ * Поддерживаются --sizes N[K|M|G],... (по умолчанию 64K,1M,16M),
+ * --corpus вид,... (uniform, skewed, text, binary; по умолчанию все),
+ * --runs N (по умолчанию BENCH_RUNS), --warmup N (по умолчанию 1),
+ * --seed N, --format csv|json, --output файл и --save папка (сохранить
+ * сгенерированные корпуса, чтобы замерять на них и другие программы).
+ * --help или -h в любом месте только выставляют options->help: у них нет
+ * значения, поэтому они проверяются до разбора пар "параметр значение".
+ */
+int parseSuiteOptions(int argc, char* argv[], SuiteOptions* options) {
+    options->sizes[0] = 64u << 10;
+    options->sizes[1] = 1u << 20;
+    options->sizes[2] = 16u << 20;
+    options->size_count = 3;
+    for (int kind = 0; kind < CORPUS_COUNT; kind++) {
+        options->corpora[kind] = 1;
+    }
+    options->runs = BENCH_RUNS;
+    options->warmup = 1;
+    options->seed = 20240229;
+    options->json = 0;
+    options->output = NULL;
+    options->save_dir = NULL;
+    options->help = 0;
+
+    for (int index = 1; index < argc; index++) {
+        if (strcmp(argv[index], "--help") == 0 || strcmp(argv[index], "-h") == 0) {
+            options->help = 1;
+            return 1;
+        }
+    }
+    for (int index = 1; index < argc; index += 2) {
+        const char* name = argv[index];
+        if (index + 1 >= argc) {
+            fprintf(stderr, "Ошибка: параметр %s требует значения\n", name);
+            return 0;
+        }
+        const char* text = argv[index + 1];
+        uint64_t value = 0;
+        if (strcmp(name, "--sizes") == 0 || strcmp(name, "--corpus") == 0) {
+            int is_sizes = strcmp(name, "--sizes") == 0;
+            char list[256];
+            snprintf(list, sizeof(list), "%s", text);
+            if (is_sizes) {
+                options->size_count = 0;
+            } else {
+                memset(options->corpora, 0, sizeof(options->corpora));
+            }
+            for (char* item = strtok(list, ","); item != NULL; item = strtok(NULL, ",")) {
+                if (is_sizes) {
+                    // Частоты считаются в unsigned int, поэтому корпус меньше 4 GiB
+                    if (options->size_count == SUITE_MAX_SIZES || !parseSize(item, &value) ||
+                        value == 0 || value > UINT32_MAX) {
+                        fprintf(stderr, "Ошибка: недопустимый размер '%s' (от 1 байта до 4G, не больше %d размеров)\n",
+                                item, SUITE_MAX_SIZES);
+                        return 0;
+                    }
+                    options->sizes[options->size_count++] = value;
+                    continue;
+                }
+                int kind = 0;
+                while (kind < CORPUS_COUNT && strcmp(item, corpus_names[kind]) != 0) {
+                    kind++;
+                }
+                if (kind == CORPUS_COUNT) {
+                    fprintf(stderr, "Ошибка: неизвестный вид корпуса '%s' (uniform, skewed, text, binary)\n", item);
+                    return 0;
+                }
+                options->corpora[kind] = 1;
+            }
+            if (is_sizes && options->size_count == 0) {
+                fprintf(stderr, "Ошибка: не задан ни один размер\n");
+                return 0;
+            }
+        } else if (strcmp(name, "--format") == 0) {
+            if (strcmp(text, "csv") != 0 && strcmp(text, "json") != 0) {
+                fprintf(stderr, "Ошибка: формат отчета должен быть csv или json\n");
+                return 0;
+            }
+            options->json = strcmp(text, "json") == 0;
+        } else if (strcmp(name, "--output") == 0) {
+            options->output = text;
+        } else if (strcmp(name, "--save") == 0) {
+            options->save_dir = text;
+        } else if (strcmp(name, "--runs") == 0 || strcmp(name, "--warmup") == 0 ||
+                   strcmp(name, "--seed") == 0) {
+            if (!parseSize(text, &value)) {
+                fprintf(stderr, "Ошибка: параметр %s требует числового значения\n", name);
+                return 0;
+            }
+            if (strcmp(name, "--seed") == 0) {
+                options->seed = value;
+            } else if (strcmp(name, "--warmup") == 0) {
+                options->warmup = value > SUITE_MAX_RUNS ? SUITE_MAX_RUNS : (int)value;
+            } else if (value == 0 || value > SUITE_MAX_RUNS) {
+                fprintf(stderr, "Ошибка: количество повторов должно быть от 1 до %d\n", SUITE_MAX_RUNS);
+                return 0;
+            } else {
+                options->runs = (int)value;
+            }
+        } else {
+            fprintf(stderr, "Ошибка: неизвестный параметр %s\n", name);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * Функция runBenchmarkSuite - воспроизводимый набор замеров по стадиям
+ * @param argc - количество аргументов
+ * @param argv - аргументы (см. parseSuiteOptions)
+ * @return EXIT_SUCCESS если все корпуса восстановлены верно, иначе EXIT_FAILURE
+ *
+ * Для каждого вида и размера корпуса генерирует данные с заданным начальным
+ * значением (одинаковые от запуска к запуску) и пишет отчет в CSV или JSON,
+ * чтобы сравнивать скорость стадий между версиями программы.
+ */
+int runBenchmarkSuite(int argc, char* argv[]) {
+    SuiteOptions options;
+    int parsed = parseSuiteOptions(argc, argv, &options);
+    if (!parsed || options.help) {
+        // Справка - на stdout с успешным кодом, подсказка после ошибки - на stderr
+        fprintf(parsed ? stdout : stderr,
+                "Использование: %s [--sizes 64K,1M,16M] [--corpus uniform,skewed,text,binary] "
+                "[--runs N] [--warmup N] [--seed N] [--format csv|json] [--output файл] [--save папка]\n",
+                argv[0]);
+        return parsed ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    FILE* report = options.output != NULL ? fopen(options.output, "w") : stdout;
+    if (report == NULL) {
+        fprintf(stderr, "Ошибка: не удалось создать файл '%s'\n", options.output);
+        return EXIT_FAILURE;
+    }
+    if (options.json) {
+        fprintf(report, "{\n  \"format\": 1,\n  \"seed\": %llu,\n  \"runs\": %d,\n  \"warmup\": %d,\n"
+                "  \"results\": [\n", (unsigned long long)options.seed, options.runs, options.warmup);
+    } else {
+        fprintf(report, "corpus,size,stage,runs,best_seconds,median_seconds,best_mb_s,median_mb_s,bits_per_byte\n");
+    }
+
+    int ok = 1;
+    int first = 1;
+    for (int kind = 0; kind < CORPUS_COUNT; kind++) {
+        for (int s = 0; s < options.size_count && options.corpora[kind]; s++) {
+            fprintf(stderr, "Корпус %s, %llu байт...\n", corpus_names[kind],
+                    (unsigned long long)options.sizes[s]);
+            ok &= benchmarkCorpus(kind, options.sizes[s], &options, report, &first);
+        }
+    }
+
+    if (options.json) {
+        fprintf(report, "\n  ]\n}\n");
+    }
+    if (report != stdout) {
+        fclose(report);
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+#endif
+
+
 /**
  * Функция createTestFiles - создает тестовые файлы для проверки алгоритма
  *
@@ -907,12 +5693,20 @@ void createTestFiles() {
  * 3. Создать/обновить тестовые файлы
  * 4. Выйти из программы
  *
+ * Тесты проверяют восстановление в памяти по контрольным суммам блоков и не
+ * пишут восстановленный файл; записать его можно из командной строки
+ * третьим аргументом (программа.exe входной_файл сжатый_файл декодированный_файл).
+ *
  * Использует рекурсивный вызов для возврата в меню после выполнения теста.
  */
 void showMenu() {
     int choice;                                       // Переменная для хранения выбора пользователя
 
+#ifdef _WIN32
     system("cls");                                    // Очищаем консоль (Windows)
+#else
+    system("clear");                                  // Очищаем консоль (POSIX)
+#endif
     printf("==============================================\n");
     printf("     ЛАБОРАТОРНАЯ РАБОТА: АЛГОРИТМ ХАФФМАНА\n");
     printf("==============================================\n");
@@ -944,39 +5738,38 @@ void showMenu() {
         case 1:  // Тест 1
             huffman_compress_decompress("test/test1.txt",
                                        "results/test1_encoded.bin",
-                                       "results/test1_decoded.txt");
+                                       NULL);
             break;
         case 2:  // Тест 2
             huffman_compress_decompress("test/test2.txt",
                                        "results/test2_encoded.bin",
-                                       "results/test2_decoded.txt");
+                                       NULL);
             break;
         case 3:  // Тест 3
             huffman_compress_decompress("test/test3.txt",
                                        "results/test3_encoded.bin",
-                                       "results/test3_decoded.txt");
+                                       NULL);
             break;
         case 4:  // Тест 4 (пустой файл)
             huffman_compress_decompress("test/test4.txt",
                                        "results/test4_encoded.bin",
-                                       "results/test4_decoded.txt");
+                                       NULL);
             break;
         case 5:  // Тест 5 (большой файл)
             huffman_compress_decompress("test/test5.txt",
                                        "results/test5_encoded.bin",
-                                       "results/test5_decoded.txt");
+                                       NULL);
             break;
         case 6:  // Запуск всех тестов
             printf("\nЗапуск всех тестов...\n");
             for (int i = 1; i <= 5; i++) {
-                char input[50], encoded[50], decoded[50];
+                char input[50], encoded[50];
                 // Формируем имена файлов для каждого теста
                 sprintf(input, "test/test%d.txt", i);
                 sprintf(encoded, "results/test%d_encoded.bin", i);
-                sprintf(decoded, "results/test%d_decoded.txt", i);
 
                 printf("\n\n=== ТЕСТ %d ===\n", i);
-                huffman_compress_decompress(input, encoded, decoded);
+                huffman_compress_decompress(input, encoded, NULL);  // Проверка по CRC-32, без файла на диске
 
                 // Пауза между тестами (кроме последнего)
                 if (i < 5) {
@@ -1005,28 +5798,425 @@ void showMenu() {
     showMenu();                                       // Рекурсивный вызов меню
 }
 
+/**
+ * Функция parseSize - разбирает размер с необязательным суффиксом K, M или G
+ * @param text - строка вида "1048576", "256K", "4M"
+ * @param value - сюда записывается размер в байтах
+ * @return 1 при успехе, 0 если строка не является размером
+ *
+ * strtoull пропускает пробелы и молча превращает "-1" в 2^64 - 1, поэтому
+ * строка обязана начинаться с цифры, а переполнение отвергается по errno.
+ */
+int parseSize(const char* text, uint64_t* value) {
+    if (text[0] < '0' || text[0] > '9') {
+        return 0;                                    // Знак, пробел или пустая строка
+    }
+    char* end;
+    errno = 0;
+    unsigned long long number = strtoull(text, &end, 10);
+    if (end == text || errno == ERANGE) {
+        return 0;
+    }
+    int shift = 0;
+    if (*end == 'K' || *end == 'k') { shift = 10; end++; }
+    else if (*end == 'M' || *end == 'm') { shift = 20; end++; }
+    else if (*end == 'G' || *end == 'g') { shift = 30; end++; }
+    if (*end != '\0' || number > (UINT64_MAX >> shift)) {
+        return 0;
+    }
+    *value = (uint64_t)number << shift;
+    return 1;
+}
+
+/**
+ * Функция parseRange - разбирает диапазон исходных данных для decompress --range
+ * @param text - строка вида "смещение:длина", например "1073741824:4096" или "1G:64K"
+ * @param offset - сюда записывается смещение первого байта
+ * @param length - сюда записывается количество байтов
+ * @return 1 при успехе, 0 если строка не является диапазоном
+ */
+int parseRange(const char* text, uint64_t* offset, uint64_t* length) {
+    const char* colon = strchr(text, ':');
+    char number[32];
+    if (colon == NULL || colon == text || (size_t)(colon - text) >= sizeof(number)) {
+        return 0;
+    }
+    memcpy(number, text, (size_t)(colon - text));
+    number[colon - text] = '\0';
+    return parseSize(number, offset) && parseSize(colon + 1, length);
+}
+
+/**
+ * Функция parseCompressOptions - разбирает параметры сжатия из командной строки
+ * @param argc - количество аргументов
+ * @param argv - аргументы
+ * @param index - номер первого аргумента; после разбора - номер первого не-параметра
+ * @param options - параметры (заполняются значениями по умолчанию и из аргументов)
+ * @return 1 при успехе, 0 при ошибке в параметрах
+ *
+ * Поддерживаются --threads N (0 - по числу процессоров), --block-size N[K|M|G],
+ * --max-code-length N (ограничение длины кода, от MIN_CODE_LENGTH_LIMIT
+ * до DECODE_MAX_CODE_LENGTH бит), --adaptive (адаптивный код Хаффмана
+ * за один проход вместо двухпроходного), --order1 (таблица кодов
+ * выбирается по предыдущему байту), --utf8 (символы - кодовые точки
+ * UTF-8, см. HUFFMAN_MODE_UTF8), --dict словарь (коды из словаря,
+ * созданного командой train), --table-cache N (статический блок может
+ * повторить таблицу одного из предыдущих блоков, если сжатие хуже не
+ * больше чем на N процентов, см. HuffmanParams), --streams N (статический
+ * блок кодируется N независимыми потоками для быстрого восстановления,
+ * см. HUFFMAN_MODE_INTERLEAVED) и --profile файл.json (замеры по стадиям,
+ * см. profileFinish).
+ * Восстановление использует только --threads, --dict и --profile: размер
+ * блока и режим записаны в сжатом файле. Свой параметр восстановления
+ * --range смещение:длина разбирается в main (см. parseRange).
+ */
+int parseCompressOptions(int argc, char* argv[], int* index, CompressOptions* options) {
+    defaultCompressOptions(options);
+    while (*index < argc && strncmp(argv[*index], "--", 2) == 0) {
+        if (!parseCompressOption(argc, argv, index, options)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * Функция defaultCompressOptions - параметры сжатия по умолчанию
+ * @param options - структура для заполнения
+ */
+void defaultCompressOptions(CompressOptions* options) {
+    options->block_size = DEFAULT_BLOCK_SIZE;
+    options->threads = cpuCount();
+    options->mode = HUFFMAN_MODE_STATIC;
+    options->max_code_length = DEFAULT_CODE_LENGTH_LIMIT;
+    options->profile = NULL;
+    options->dictionary_file = NULL;
+    options->dictionary = NULL;
+    options->table_cache = -1;
+    options->streams = 1;
+}
+
+/**
+ * Функция parseCompressOption - разбирает один параметр сжатия (см. parseCompressOptions)
+ * @param argc - количество аргументов
+ * @param argv - аргументы
+ * @param index - номер параметра; после разбора - номер следующего аргумента
+ * @param options - параметры
+ * @return 1 при успехе, 0 при неизвестном параметре, ошибке в значении
+ *         или втором ключе режима блоков (--adaptive, --order1, --utf8, --dict)
+ */
+int parseCompressOption(int argc, char* argv[], int* index, CompressOptions* options) {
+    const char* name = argv[*index];
+    uint64_t value;
+    int mode = strcmp(name, "--adaptive") == 0 ? HUFFMAN_MODE_ADAPTIVE :
+               strcmp(name, "--order1") == 0 ? HUFFMAN_MODE_ORDER1 :
+               strcmp(name, "--utf8") == 0 ? HUFFMAN_MODE_UTF8 :
+               strcmp(name, "--dict") == 0 ? HUFFMAN_MODE_DICTIONARY : HUFFMAN_MODE_STATIC;
+    if (mode != HUFFMAN_MODE_STATIC && options->mode != HUFFMAN_MODE_STATIC && options->mode != mode) {
+        fprintf(stderr, "Ошибка: ключи --adaptive, --order1, --utf8 и --dict задают разные режимы блоков, "
+                "можно указать только один\n");
+        return 0;
+    }
+    if (mode == HUFFMAN_MODE_ADAPTIVE || mode == HUFFMAN_MODE_ORDER1 || mode == HUFFMAN_MODE_UTF8) {
+        options->mode = mode;                        // Параметры без значения
+        *index += 1;
+        return 1;
+    }
+    if (strcmp(name, "--profile") == 0 && *index + 1 < argc) {  // Параметр с именем файла
+        if (!USE_PROFILE) {
+            fprintf(stderr, "Ошибка: программа собрана без замеров (USE_PROFILE=0)\n");
+            return 0;
+        }
+        options->profile = argv[*index + 1];
+        *index += 2;
+        return 1;
+    }
+    if (strcmp(name, "--dict") == 0 && *index + 1 < argc) {  // Словарь загружает loadOptionsDictionary
+        options->dictionary_file = argv[*index + 1];
+        options->mode = HUFFMAN_MODE_DICTIONARY;
+        *index += 2;
+        return 1;
+    }
+    if (strcmp(name, "--threads") == 0) {
+        if (*index + 1 >= argc || !parseSize(argv[*index + 1], &value) || value > 1024) {
+            fprintf(stderr, "Ошибка: недопустимое количество потоков '%s' (от 0 до 1024, 0 - по числу процессоров)\n",
+                    *index + 1 < argc ? argv[*index + 1] : "");
+            return 0;
+        }
+        options->threads = value > 0 ? (int)value : cpuCount();
+        *index += 2;
+        return 1;
+    }
+    if (*index + 1 >= argc || !parseSize(argv[*index + 1], &value)) {
+        fprintf(stderr, "Ошибка: параметр %s требует числового значения\n", name);
+        return 0;
+    }
+    if (strcmp(name, "--block-size") == 0) {
+        if (value == 0 || value > MAX_BLOCK_SIZE) {
+            fprintf(stderr, "Ошибка: размер блока должен быть от 1 байта до %u байт\n",
+                    (unsigned)MAX_BLOCK_SIZE);
+            return 0;
+        }
+        options->block_size = (uint32_t)value;
+    } else if (strcmp(name, "--max-code-length") == 0) {
+        if (value < MIN_CODE_LENGTH_LIMIT || value > DECODE_MAX_CODE_LENGTH) {
+            fprintf(stderr, "Ошибка: длина кода должна быть от %d до %d бит\n",
+                    MIN_CODE_LENGTH_LIMIT, DECODE_MAX_CODE_LENGTH);
+            return 0;
+        }
+        options->max_code_length = (int)value;
+    } else if (strcmp(name, "--table-cache") == 0) {
+        if (value > 100) {
+            fprintf(stderr, "Ошибка: допустимая потеря сжатия кэша таблиц - от 0 до 100 процентов\n");
+            return 0;
+        }
+        options->table_cache = (int)value;
+    } else if (strcmp(name, "--streams") == 0) {
+        if (value == 0 || value > INTERLEAVED_MAX_STREAMS) {
+            fprintf(stderr, "Ошибка: количество потоков блока должно быть от 1 до %d\n",
+                    INTERLEAVED_MAX_STREAMS);
+            return 0;
+        }
+        options->streams = (int)value;
+    } else {
+        fprintf(stderr, "Ошибка: неизвестный параметр %s\n", name);
+        return 0;
+    }
+    *index += 2;
+    return 1;
+}
+
+/**
+ * Функция loadOptionsDictionary - загружает словарь, указанный ключом --dict
+ * @param options - параметры (при успешной загрузке options->dictionary указывает на dictionary)
+ * @param dictionary - буфер для содержимого словаря
+ * @return 1 при успехе или если словарь не указан, 0 если словарь не удалось загрузить
+ */
+int loadOptionsDictionary(CompressOptions* options, unsigned char dictionary[HUFFMAN_DICTIONARY_SIZE]) {
+    if (options->dictionary_file == NULL) {
+        return 1;
+    }
+    if (!loadDictionary(options->dictionary_file, dictionary)) {
+        return 0;
+    }
+    options->dictionary = dictionary;
+    return 1;
+}
+
 /**
  * Основная функция программы - точка входа
  * @param argc - количество аргументов командной строки
  * @param argv - массив аргументов командной строки
  * @return EXIT_SUCCESS при успешном выполнении, EXIT_FAILURE при ошибке
  *
- * Поддерживает два режима работы:
- * 1. С аргументами командной строки: программа.exe входной_файл сжатый_файл декодированный_файл
+ * Поддерживает восемь режимов работы:
+ * 1. С аргументами командной строки: программа.exe входной_файл сжатый_файл [декодированный_файл]
+ *    (без декодированного файла восстановление проверяется в памяти)
  * 2. Без аргументов: интерактивный режим с меню
+ * 3. Сжатие: программа.exe compress [--threads N] [--block-size N] [--max-code-length N] [--adaptive | --order1 | --utf8 | --dict словарь] [--table-cache N] [--streams N] [--profile файл.json] входной_файл сжатый_файл
+ * 4. Восстановление: программа.exe decompress [--threads N] [--dict словарь] [--range смещение:длина] [--profile файл.json] сжатый_файл выходной_файл
+ * 5. Бенчмарк кодирования/декодирования: программа.exe bench входной_файл
+ * 6. Проверка сжатого файла без записи: программа.exe verify [--threads N] [--dict словарь] [--profile файл.json] сжатый_файл
+ * 7. Пакетное сжатие: программа.exe batch [параметры сжатия] [--output-dir папка] [--list список.txt] файлы_или_папки...
+ * 8. Обучение словаря: программа.exe train [--max-code-length N] [--list список.txt] словарь образцы_или_папки...
+ * В режимах 3 и 4 имя "-" означает stdin (вход) или stdout (выход).
  */
 int main(int argc, char* argv[]) {
+#ifdef _WIN32
     // Настройка кодировки консоли Windows для корректного отображения кириллицы
     SetConsoleOutputCP(CP_UTF8);                      // Устанавливаем кодовую страницу вывода в UTF-8
     SetConsoleCP(CP_UTF8);                           // Устанавливаем кодовую страницу ввода в UTF-8
+#endif
 
     setlocale(LC_ALL, "ru_RU.UTF-8");                // Устанавливаем локаль для работы с кириллицей
 
+#ifdef HUFFMAN_BENCH_SUITE
+    return runBenchmarkSuite(argc, argv);            // Цель huffman_bench: только набор замеров
+#endif
+
     // Проверяем аргументы командной строки
-    if (argc == 4) {
+    if (argc >= 4 && strcmp(argv[1], "compress") == 0) {
+        // Режим 3: Только сжатие в самостоятельный сжатый файл
+        CompressOptions options;
+        int index = 2;
+        if (!parseCompressOptions(argc, argv, &index, &options)) {
+            return EXIT_FAILURE;
+        }
+        if (argc - index != 2) {
+            fprintf(stderr, "Использование: %s compress [--threads N] [--block-size N] [--max-code-length N] [--adaptive | --order1 | --utf8 | --dict словарь] [--table-cache N] [--streams N] [--profile файл.json] входной_файл сжатый_файл\n",
+                    argv[0]);
+            return EXIT_FAILURE;
+        }
+        unsigned char dictionary[HUFFMAN_DICTIONARY_SIZE];
+        if (!loadOptionsDictionary(&options, dictionary)) {
+            return EXIT_FAILURE;
+        }
+        if (options.profile != NULL) {
+            profileStart();
+        }
+        int result = compressFile(argv[index], argv[index + 1], &options, NULL);
+        if (options.profile != NULL &&
+            !profileFinish(options.profile, "compress", argv[index], argv[index + 1], result)) {
+            result = EXIT_FAILURE;
+        }
+        return result;
+    }
+    else if (argc >= 4 && strcmp(argv[1], "decompress") == 0) {
+        // Режим 4: Только восстановление по сжатому файлу (исходный файл не нужен)
+        CompressOptions options;
+        defaultCompressOptions(&options);
+        int ranged = 0;                              // --range: восстановить только часть файла
+        uint64_t offset = 0;
+        uint64_t length = 0;
+        int index = 2;
+        while (index < argc && strncmp(argv[index], "--", 2) == 0) {
+            if (strcmp(argv[index], "--range") == 0 && index + 1 < argc) {
+                if (!parseRange(argv[index + 1], &offset, &length)) {
+                    fprintf(stderr, "Ошибка: диапазон задается как смещение:длина (например, 1G:64K)\n");
+                    return EXIT_FAILURE;
+                }
+                ranged = 1;
+                index += 2;
+            } else if (!parseCompressOption(argc, argv, &index, &options)) {
+                return EXIT_FAILURE;
+            }
+        }
+        if (argc - index != 2) {
+            fprintf(stderr, "Использование: %s decompress [--threads N] [--dict словарь] [--range смещение:длина] [--profile файл.json] сжатый_файл выходной_файл\n",
+                    argv[0]);
+            return EXIT_FAILURE;
+        }
+        unsigned char dictionary[HUFFMAN_DICTIONARY_SIZE];
+        if (!loadOptionsDictionary(&options, dictionary)) {
+            return EXIT_FAILURE;
+        }
+        if (options.profile != NULL) {
+            profileStart();
+        }
+        int result = ranged ? decompressRange(argv[index], argv[index + 1], offset, length, options.dictionary)
+                            : decompressFile(argv[index], argv[index + 1], options.threads, options.dictionary);
+        if (options.profile != NULL &&
+            !profileFinish(options.profile, "decompress", argv[index], argv[index + 1], result)) {
+            result = EXIT_FAILURE;
+        }
+        return result;
+    }
+    else if (argc >= 3 && strcmp(argv[1], "verify") == 0) {
+        // Режим 6: Восстановление в памяти и сверка контрольных сумм, без выходного файла
+        CompressOptions options;
+        int index = 2;
+        if (!parseCompressOptions(argc, argv, &index, &options)) {
+            return EXIT_FAILURE;
+        }
+        if (argc - index != 1) {
+            fprintf(stderr, "Использование: %s verify [--threads N] [--dict словарь] [--profile файл.json] сжатый_файл\n",
+                    argv[0]);
+            return EXIT_FAILURE;
+        }
+        unsigned char dictionary[HUFFMAN_DICTIONARY_SIZE];
+        if (!loadOptionsDictionary(&options, dictionary)) {
+            return EXIT_FAILURE;
+        }
+        if (options.profile != NULL) {
+            profileStart();
+        }
+        int result = decompressFile(argv[index], NULL, options.threads, options.dictionary);
+        if (options.profile != NULL &&
+            !profileFinish(options.profile, "verify", argv[index], NULL, result)) {
+            result = EXIT_FAILURE;
+        }
+        return result;
+    }
+    else if (argc >= 3 && strcmp(argv[1], "batch") == 0) {
+        // Режим 7: Сжатие многих файлов общим пулом потоков
+        CompressOptions options;
+        defaultCompressOptions(&options);
+        const char* output_dir = NULL;
+        char** inputs = NULL;
+        int count = 0;
+        int capacity = 0;
+        int ok = 1;
+        for (int index = 2; index < argc && ok;) {
+            if (strcmp(argv[index], "--list") == 0 && index + 1 < argc) {
+                ok = readBatchList(argv[index + 1], &inputs, &count, &capacity);
+                index += 2;
+            } else if (strcmp(argv[index], "--output-dir") == 0 && index + 1 < argc) {
+                output_dir = argv[index + 1];
+                index += 2;
+            } else if (strncmp(argv[index], "--", 2) == 0) {
+                ok = parseCompressOption(argc, argv, &index, &options);
+            } else {
+                ok = collectBatchInputs(argv[index], &inputs, &count, &capacity);
+                index++;
+            }
+        }
+        if (ok && count == 0) {
+            fprintf(stderr, "Использование: %s batch [--threads N] [--block-size N] [--max-code-length N] [--adaptive | --order1 | --utf8 | --dict словарь] [--table-cache N] [--streams N] [--output-dir папка] [--list список.txt] [--profile файл.json] файлы_или_папки...\n",
+                    argv[0]);
+            ok = 0;
+        }
+        unsigned char dictionary[HUFFMAN_DICTIONARY_SIZE];
+        ok = ok && loadOptionsDictionary(&options, dictionary);
+        int result = EXIT_FAILURE;
+        if (ok) {
+            if (options.profile != NULL) {
+                profileStart();
+            }
+            result = compressBatch((const char* const*)inputs, count, output_dir, &options);
+            if (options.profile != NULL &&
+                !profileFinish(options.profile, "batch", count == 1 ? inputs[0] : NULL, output_dir, result)) {
+                result = EXIT_FAILURE;
+            }
+        }
+        for (int i = 0; i < count; i++) {
+            free(inputs[i]);
+        }
+        free(inputs);
+        return result;
+    }
+    else if (argc >= 4 && strcmp(argv[1], "train") == 0) {
+        // Режим 8: Обучение словаря по образцам для сжатия маленьких файлов и записей
+        CompressOptions options;
+        defaultCompressOptions(&options);
+        const char* dictionary_filename = NULL;
+        char** inputs = NULL;
+        int count = 0;
+        int capacity = 0;
+        int ok = 1;
+        for (int index = 2; index < argc && ok;) {
+            if (strcmp(argv[index], "--list") == 0 && index + 1 < argc) {
+                ok = readBatchList(argv[index + 1], &inputs, &count, &capacity);
+                index += 2;
+            } else if (strncmp(argv[index], "--", 2) == 0) {
+                ok = parseCompressOption(argc, argv, &index, &options);
+            } else if (dictionary_filename == NULL) {
+                dictionary_filename = argv[index++];  // Первое имя - файл словаря
+            } else {
+                ok = collectBatchInputs(argv[index], &inputs, &count, &capacity);
+                index++;
+            }
+        }
+        if (ok && count == 0) {
+            fprintf(stderr, "Использование: %s train [--max-code-length N] [--list список.txt] словарь образцы_или_папки...\n",
+                    argv[0]);
+            ok = 0;
+        }
+        int result = ok ? trainDictionary((const char* const*)inputs, count, options.max_code_length,
+                                          dictionary_filename) : EXIT_FAILURE;
+        for (int i = 0; i < count; i++) {
+            free(inputs[i]);
+        }
+        free(inputs);
+        return result;
+    }
+    else if (argc == 3 && strcmp(argv[1], "bench") == 0) {
+        // Режим 5: Замер скорости кодирования и декодирования на заданном файле
+        return runBenchmark(argv[2]);
+    }
+    else if (argc == 3 || argc == 4) {
         // Режим 1: Работа с конкретными файлами, указанными в командной строке
-        // Формат: программа.exe входной_файл сжатый_файл декодированный_файл
-        return huffman_compress_decompress(argv[1], argv[2], argv[3]);
+        // Формат: программа.exe входной_файл сжатый_файл [декодированный_файл]
+        return huffman_compress_decompress(argv[1], argv[2], argc == 4 ? argv[3] : NULL);
     }
     else if (argc == 1) {
         // Режим 2: Интерактивный режим с меню выбора
@@ -1036,9 +6226,16 @@ int main(int argc, char* argv[]) {
         // Неправильное количество аргументов
         printf("Использование программы:\n");
         printf("  1. Без аргументов: %s  (запуск с меню)\n", argv[0]);
-        printf("  2. С аргументами: %s входной_файл сжатый_файл декодированный_файл\n", argv[0]);
+        printf("  2. С аргументами: %s входной_файл сжатый_файл [декодированный_файл]\n", argv[0]);
+        printf("  3. Сжатие: %s compress [--threads N] [--block-size N] [--max-code-length N] [--adaptive | --order1 | --utf8 | --dict словарь] [--table-cache N] [--streams N] [--profile файл.json] входной_файл сжатый_файл\n", argv[0]);
+        printf("  4. Восстановление: %s decompress [--threads N] [--dict словарь] [--range смещение:длина] [--profile файл.json] сжатый_файл выходной_файл\n", argv[0]);
+        printf("  5. Бенчмарк: %s bench входной_файл\n", argv[0]);
+        printf("  6. Проверка: %s verify [--threads N] [--dict словарь] [--profile файл.json] сжатый_файл\n", argv[0]);
+        printf("  7. Пакетное сжатие: %s batch [параметры сжатия] [--output-dir папка] [--list список.txt] файлы_или_папки...\n", argv[0]);
+        printf("  8. Обучение словаря: %s train [--max-code-length N] [--list список.txt] словарь образцы_или_папки...\n", argv[0]);
+        printf("  В режимах 3 и 4 вместо имени файла можно указать '-' (stdin/stdout)\n");
         return EXIT_FAILURE;
     }
 
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
@@ -0,0 +1,70 @@
+# Сжатие и восстановление через конвейер ввода-вывода программы.
+# Пустой, однобайтовый, 255-байтовый (все байты, кроме нуля) и многоблочный
+# файлы сжимаются с одним и несколькими потоками, из файла и из stdin,
+# и должны восстанавливаться без изменений. Цель собирается в нескольких
+# вариантах (с отображением в память, без него, без io_uring), поэтому
+# один сценарий проверяет все способы ввода-вывода.
+# Параметры: -DHUFFMAN=путь к программе -DWORK_DIR=рабочая папка
+
+if(NOT HUFFMAN OR NOT WORK_DIR)
+    message(FATAL_ERROR "Нужны -DHUFFMAN и -DWORK_DIR")
+endif()
+
+file(REMOVE_RECURSE "${WORK_DIR}")
+file(MAKE_DIRECTORY "${WORK_DIR}")
+
+file(WRITE "${WORK_DIR}/empty.txt" "")
+file(WRITE "${WORK_DIR}/one.txt" "a")
+
+set(codes "")
+foreach(c RANGE 1 255)
+    list(APPEND codes ${c})
+endforeach()
+string(ASCII ${codes} symbols)
+file(WRITE "${WORK_DIR}/symbols.bin" "${symbols}")
+
+# Около 50 КБ текста: при --block-size 4K это 13 блоков, больше буферов конвейера
+string(REPEAT "the quick brown fox jumps over the lazy dog 0123456789\n" 900 text)
+file(WRITE "${WORK_DIR}/blocks.txt" "${text}")
+
+# Функция checkSame - сравнивает восстановленный файл с исходным
+function(checkSame original restored what)
+    execute_process(COMMAND "${CMAKE_COMMAND}" -E compare_files "${original}" "${restored}"
+                    RESULT_VARIABLE different)
+    if(different)
+        message(FATAL_ERROR "${what}: ${original} восстановлен неверно")
+    endif()
+endfunction()
+
+foreach(name empty.txt one.txt symbols.bin blocks.txt)
+    set(input "${WORK_DIR}/${name}")
+    foreach(threads 1 4)
+        set(packed "${input}.${threads}.huf")
+        set(what "compress --threads ${threads}")
+        execute_process(COMMAND "${HUFFMAN}" compress --threads ${threads} --block-size 4K "${input}" "${packed}"
+                        RESULT_VARIABLE status OUTPUT_QUIET)
+        if(NOT status EQUAL 0)
+            message(FATAL_ERROR "${what} ${input} завершилась с кодом ${status}")
+        endif()
+        execute_process(COMMAND "${HUFFMAN}" decompress --threads ${threads} "${packed}" "${packed}.out"
+                        RESULT_VARIABLE status OUTPUT_QUIET)
+        if(NOT status EQUAL 0)
+            message(FATAL_ERROR "decompress ${packed} завершилась с кодом ${status}")
+        endif()
+        checkSame("${input}" "${packed}.out" "${what}")
+    endforeach()
+
+    # Потоковый формат: вход - stdin, выход - stdout
+    set(packed "${input}.stream.huf")
+    execute_process(COMMAND "${HUFFMAN}" compress --block-size 4K - -
+                    INPUT_FILE "${input}" OUTPUT_FILE "${packed}" RESULT_VARIABLE status ERROR_QUIET)
+    if(NOT status EQUAL 0)
+        message(FATAL_ERROR "compress - - < ${input} завершилась с кодом ${status}")
+    endif()
+    execute_process(COMMAND "${HUFFMAN}" decompress - -
+                    INPUT_FILE "${packed}" OUTPUT_FILE "${packed}.out" RESULT_VARIABLE status ERROR_QUIET)
+    if(NOT status EQUAL 0)
+        message(FATAL_ERROR "decompress - - < ${packed} завершилась с кодом ${status}")
+    endif()
+    checkSame("${input}" "${packed}.out" "compress - -")
+endforeach()
@@ -0,0 +1,94 @@
+# Маленькие записи со словарем не должны становиться больше исходных.
+# Обучает словарь на образцах, сжимает записи от 100 до 500 байт,
+# сравнивает размеры и проверяет восстановление.
+# Параметры: -DHUFFMAN=путь к программе -DWORK_DIR=рабочая папка
+
+if(NOT HUFFMAN OR NOT WORK_DIR)
+    message(FATAL_ERROR "Нужны -DHUFFMAN и -DWORK_DIR")
+endif()
+
+set(users alice bob carol dave eve mallory trent peggy)
+set(tags red green blue admin guest beta)
+
+# Функция makeRecord - запись JSON с номером seed и events событиями
+function(makeRecord seed events result)
+    math(EXPR u "${seed} % 8")
+    math(EXPR t1 "${seed} % 6")
+    math(EXPR t2 "(${seed} * 7 + 3) % 6")
+    math(EXPR score "(${seed} * 37) % 100")
+    math(EXPR active "${seed} % 2")
+    list(GET users ${u} user)
+    list(GET tags ${t1} tag1)
+    list(GET tags ${t2} tag2)
+    if(active)
+        set(flag true)
+    else()
+        set(flag false)
+    endif()
+    set(text "{\"id\":${seed},\"user\":\"${user}\",\"email\":\"${user}@example.com\",\"active\":${flag},\"score\":${score}.5,\"tags\":[\"${tag1}\",\"${tag2}\"]")
+    if(events GREATER 0)
+        string(APPEND text ",\"events\":[")
+        foreach(e RANGE 1 ${events})
+            math(EXPR at "1700000000 + ${seed} * 60 + ${e}")
+            math(EXPR k "(${seed} + ${e}) % 6")
+            list(GET tags ${k} kind)
+            if(e GREATER 1)
+                string(APPEND text ",")
+            endif()
+            string(APPEND text "{\"at\":${at},\"kind\":\"${kind}\"}")
+        endforeach()
+        string(APPEND text "]")
+    endif()
+    string(APPEND text "}")
+    set(${result} "${text}" PARENT_SCOPE)
+endfunction()
+
+file(REMOVE_RECURSE "${WORK_DIR}")
+file(MAKE_DIRECTORY "${WORK_DIR}/samples")
+
+foreach(i RANGE 1 200)
+    math(EXPR events "${i} % 10")
+    makeRecord(${i} ${events} record)
+    file(WRITE "${WORK_DIR}/samples/r${i}.json" "${record}")
+endforeach()
+
+execute_process(COMMAND "${HUFFMAN}" train "${WORK_DIR}/records.hdict" "${WORK_DIR}/samples"
+                RESULT_VARIABLE status OUTPUT_QUIET)
+if(NOT status EQUAL 0)
+    message(FATAL_ERROR "train завершилась с кодом ${status}")
+endif()
+
+set(checked 0)
+foreach(i RANGE 1001 1040)
+    math(EXPR events "${i} % 11")
+    makeRecord(${i} ${events} record)
+    string(LENGTH "${record}" size)
+    if(size LESS 100 OR size GREATER 500)
+        continue()
+    endif()
+    set(input "${WORK_DIR}/record${i}.json")
+    file(WRITE "${input}" "${record}")
+
+    execute_process(COMMAND "${HUFFMAN}" compress --dict "${WORK_DIR}/records.hdict" "${input}" "${input}.huf"
+                    RESULT_VARIABLE status OUTPUT_QUIET)
+    if(NOT status EQUAL 0)
+        message(FATAL_ERROR "compress ${input} завершилась с кодом ${status}")
+    endif()
+    file(SIZE "${input}.huf" packed)
+    if(packed GREATER size)
+        message(FATAL_ERROR "Запись ${size} байт выросла до ${packed} байт")
+    endif()
+
+    execute_process(COMMAND "${HUFFMAN}" decompress --dict "${WORK_DIR}/records.hdict" "${input}.huf" "${input}.out"
+                    RESULT_VARIABLE status OUTPUT_QUIET)
+    file(READ "${input}.out" restored)
+    if(NOT status EQUAL 0 OR NOT restored STREQUAL record)
+        message(FATAL_ERROR "Запись ${input} восстановлена неверно")
+    endif()
+    message(STATUS "${size} -> ${packed} байт")
+    math(EXPR checked "${checked} + 1")
+endforeach()
+
+if(checked LESS 10)
+    message(FATAL_ERROR "Проверено только ${checked} записей от 100 до 500 байт")
+endif()